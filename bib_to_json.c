@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
 #include "cJSON.h" // Include the cJSON header
 
 // --- Global counters for statistics ---
@@ -393,15 +394,500 @@ cJSON* parse_bib_entry(FILE *f, char *entry_type_out, size_t type_buffer_size) {
 }
 
 
+// --- Sharded output ---
+// With --partition, entries are written to several shard files next to the output path
+// (e.g. data/corpus.year-0003.json) plus a manifest (data/corpus.manifest.json) listing each
+// shard's file, record count, byte size and, for year/venue partitions, the values it holds.
+typedef enum { PARTITION_NONE, PARTITION_HASH, PARTITION_YEAR, PARTITION_VENUE } partition_mode;
+
+static const char *partition_names[] = { "none", "hash", "year", "venue" };
+
+typedef struct {
+    cJSON *entries; // Array of the shard's entries
+    cJSON *values;  // Distinct partition values in the shard (year/venue partitions only)
+    int record_count;
+} output_shard;
+
+typedef struct {
+    partition_mode mode;
+    int fixed_count;        // Number of shards when fixed (--shards N); 0 = one shard per distinct value
+    output_shard *shards;
+    int shard_count;
+    int shard_capacity;
+    // Open-addressing table from partition value to shard index, for one shard per value
+    char **table_keys;
+    int *table_shards;
+    size_t table_size;
+} shard_writer;
+
+// 64-bit FNV-1a: stable across runs and platforms, so an ID always maps to the same shard
+static unsigned long long fnv1a_hash_bytes(const char *s, size_t len) {
+    unsigned long long h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static unsigned long long fnv1a_hash(const char *s) {
+    return fnv1a_hash_bytes(s, strlen(s));
+}
+
+// Copy of a string (strdup is not part of C99). Caller must free.
+static char* copy_string(const char *s) {
+    size_t len = strlen(s);
+    char *copy = (char*)malloc(len + 1);
+    if (copy) memcpy(copy, s, len + 1);
+    return copy;
+}
+
+// Appends an empty shard. Returns its index, or -1 on allocation failure.
+static int shard_writer_add_shard(shard_writer *w) {
+    if (w->shard_count == w->shard_capacity) {
+        int capacity = w->shard_capacity ? w->shard_capacity * 2 : 16;
+        output_shard *grown = (output_shard*)realloc(w->shards, capacity * sizeof(output_shard));
+        if (!grown) { perror("Failed to grow shard list"); return -1; }
+        w->shards = grown;
+        w->shard_capacity = capacity;
+    }
+    output_shard *shard = &w->shards[w->shard_count];
+    shard->entries = cJSON_CreateArray();
+    shard->values = cJSON_CreateArray();
+    shard->record_count = 0;
+    if (!shard->entries || !shard->values) {
+        perror("Failed to create shard arrays");
+        cJSON_Delete(shard->entries);
+        cJSON_Delete(shard->values);
+        return -1;
+    }
+    return w->shard_count++;
+}
+
+static int shard_writer_init(shard_writer *w, partition_mode mode, int fixed_count) {
+    memset(w, 0, sizeof(*w));
+    w->mode = mode;
+    w->fixed_count = fixed_count;
+    for (int i = 0; i < fixed_count; ++i) {
+        if (shard_writer_add_shard(w) < 0) return -1;
+    }
+    return 0;
+}
+
+static void shard_writer_free(shard_writer *w) {
+    for (int i = 0; i < w->shard_count; ++i) {
+        cJSON_Delete(w->shards[i].entries);
+        cJSON_Delete(w->shards[i].values);
+    }
+    free(w->shards);
+    for (size_t i = 0; i < w->table_size; ++i) free(w->table_keys[i]);
+    free(w->table_keys);
+    free(w->table_shards);
+}
+
+// Shard holding `value` when there is one shard per distinct value; created on first sight.
+static int shard_for_value(shard_writer *w, const char *value) {
+    // Keep the table at most half full
+    if ((size_t)(w->shard_count + 1) * 2 > w->table_size) {
+        size_t size = w->table_size ? w->table_size * 2 : 64;
+        char **keys = (char**)calloc(size, sizeof(char*));
+        int *shards = (int*)calloc(size, sizeof(int));
+        if (!keys || !shards) { perror("Failed to grow partition table"); free(keys); free(shards); return -1; }
+        for (size_t i = 0; i < w->table_size; ++i) {
+            if (!w->table_keys[i]) continue;
+            size_t slot = fnv1a_hash(w->table_keys[i]) & (size - 1);
+            while (keys[slot]) slot = (slot + 1) & (size - 1);
+            keys[slot] = w->table_keys[i];
+            shards[slot] = w->table_shards[i];
+        }
+        free(w->table_keys);
+        free(w->table_shards);
+        w->table_keys = keys;
+        w->table_shards = shards;
+        w->table_size = size;
+    }
+    size_t slot = fnv1a_hash(value) & (w->table_size - 1);
+    while (w->table_keys[slot]) {
+        if (strcmp(w->table_keys[slot], value) == 0) return w->table_shards[slot];
+        slot = (slot + 1) & (w->table_size - 1);
+    }
+    char *key = copy_string(value);
+    if (!key) { perror("Failed to copy partition value"); return -1; }
+    int shard = shard_writer_add_shard(w);
+    if (shard < 0) { free(key); return -1; }
+    w->table_keys[slot] = key;
+    w->table_shards[slot] = shard;
+    return shard;
+}
+
+// Partition value of an entry: its year, or its venue (booktitle, else journal); "unknown" if absent.
+static const char* partition_value(const cJSON *entry, partition_mode mode) {
+    const char *fields[2] = { mode == PARTITION_YEAR ? "year" : "booktitle", mode == PARTITION_YEAR ? NULL : "journal" };
+    for (int i = 0; i < 2 && fields[i]; ++i) {
+        const cJSON *item = cJSON_GetObjectItemCaseSensitive(entry, fields[i]);
+        if (cJSON_IsString(item) && item->valuestring[0] != '\0') return item->valuestring;
+    }
+    return "unknown";
+}
+
+// Moves `entry` into its shard. Returns 0, or -1 on allocation failure (entry is then freed).
+static int shard_writer_add(shard_writer *w, cJSON *entry) {
+    int shard;
+    const char *value = NULL;
+    if (w->mode == PARTITION_HASH) {
+        const cJSON *id = cJSON_GetObjectItemCaseSensitive(entry, "ID");
+        shard = (int)(fnv1a_hash(cJSON_IsString(id) ? id->valuestring : "") % (unsigned long long)w->fixed_count);
+    } else {
+        value = partition_value(entry, w->mode);
+        shard = w->fixed_count ? (int)(fnv1a_hash(value) % (unsigned long long)w->fixed_count) : shard_for_value(w, value);
+    }
+    if (shard < 0) { cJSON_Delete(entry); return -1; }
+    output_shard *s = &w->shards[shard];
+    if (value) {
+        // Record the value once per shard (shards hold one value unless --shards is fixed)
+        int seen = 0;
+        const cJSON *v;
+        cJSON_ArrayForEach(v, s->values) {
+            if (strcmp(v->valuestring, value) == 0) { seen = 1; break; }
+        }
+        if (!seen) cJSON_AddItemToArray(s->values, cJSON_CreateString(value));
+    }
+    cJSON_AddItemToArray(s->entries, entry);
+    s->record_count++;
+    return 0;
+}
+
+// Writes every shard and the manifest. `output_path` is the unsharded output, e.g. data/corpus.json.
+// Returns 0 on success.
+static int shard_writer_write(shard_writer *w, const char *output_path) {
+    // Shard files are "<stem>.<partition>-NNNN.json" next to the output path
+    size_t stem_len = strlen(output_path);
+    if (stem_len > 5 && strcmp(output_path + stem_len - 5, ".json") == 0) stem_len -= 5;
+    const char *dir_end = strrchr(output_path, '/');
+    size_t dir_len = dir_end ? (size_t)(dir_end - output_path) + 1 : 0;
+    size_t path_size = stem_len + 64;
+    char *path = (char*)malloc(path_size);
+    cJSON *manifest = cJSON_CreateObject();
+    cJSON *shard_list = cJSON_CreateArray();
+    if (!path || !manifest || !shard_list) {
+        perror("Failed to allocate manifest");
+        free(path); cJSON_Delete(manifest); cJSON_Delete(shard_list);
+        return -1;
+    }
+    cJSON_AddStringToObject(manifest, "partition", partition_names[w->mode]);
+    cJSON_AddNumberToObject(manifest, "num_shards", w->shard_count);
+    cJSON_AddNumberToObject(manifest, "records", valid_entries_converted);
+    cJSON_AddItemToObject(manifest, "shards", shard_list);
+
+    int status = 0;
+    for (int i = 0; i < w->shard_count && status == 0; ++i) {
+        output_shard *s = &w->shards[i];
+        snprintf(path, path_size, "%.*s.%s-%04d.json", (int)stem_len, output_path, partition_names[w->mode], i);
+        char *json_string = cJSON_Print(s->entries);
+        FILE *shard_file = fopen(path, "w");
+        if (!json_string || !shard_file) {
+            fprintf(stderr, "Error: Failed to write shard %s.\n", path);
+            status = -1;
+        } else {
+            fprintf(shard_file, "%s\n", json_string);
+            cJSON *shard_info = cJSON_CreateObject();
+            // Paths in the manifest are relative to its own directory
+            cJSON_AddStringToObject(shard_info, "path", path + dir_len);
+            cJSON_AddNumberToObject(shard_info, "records", s->record_count);
+            cJSON_AddNumberToObject(shard_info, "bytes", (double)(strlen(json_string) + 1));
+            if (w->mode != PARTITION_HASH) {
+                cJSON_AddItemToObject(shard_info, "values", s->values);
+                s->values = NULL; // Now owned by the manifest
+            }
+            cJSON_AddItemToArray(shard_list, shard_info);
+            printf("  %s: %d records\n", path + dir_len, s->record_count);
+        }
+        if (shard_file) fclose(shard_file);
+        free(json_string);
+    }
+
+    if (status == 0) {
+        snprintf(path, path_size, "%.*s.manifest.json", (int)stem_len, output_path);
+        char *manifest_string = cJSON_Print(manifest);
+        FILE *manifest_file = fopen(path, "w");
+        if (!manifest_string || !manifest_file) {
+            fprintf(stderr, "Error: Failed to write manifest %s.\n", path);
+            status = -1;
+        } else {
+            fprintf(manifest_file, "%s\n", manifest_string);
+            printf("Wrote %d shards and manifest %s.\n", w->shard_count, path);
+        }
+        if (manifest_file) fclose(manifest_file);
+        free(manifest_string);
+    }
+    free(path);
+    cJSON_Delete(manifest);
+    return status;
+}
+
+
+// --- Approximate field statistics ---
+// Distinct values per field (HyperLogLog) and the most frequent venues and authors (Count-Min
+// sketch plus a small candidate list), in fixed memory regardless of corpus size. Authors are
+// counted individually (the BibTeX "A and B" list is split); the venue is booktitle, else journal.
+#define HLL_PRECISION 14                   // 2^14 registers: ~0.8% standard error, 16 KB per field
+#define HLL_REGISTERS (1 << HLL_PRECISION)
+#define CMS_DEPTH 4
+#define CMS_WIDTH 4096                     // Overestimates by at most ~0.07% of the values added (e/width)
+#define TOP_K 10
+
+typedef struct {
+    char *name;
+    unsigned char *registers; // HLL_REGISTERS rank registers
+} field_sketch;
+
+typedef struct {
+    char *value;
+    unsigned long long hash; // Compared before the value
+    unsigned int estimate;
+} heavy_hitter;
+
+typedef struct {
+    unsigned int counts[CMS_DEPTH][CMS_WIDTH];
+    heavy_hitter top[TOP_K];
+    int top_count;
+    unsigned int floor; // Lowest candidate estimate once the list is full
+} count_min_sketch;
+
+typedef struct {
+    field_sketch *fields;
+    int field_count;
+    int field_capacity;
+    count_min_sketch *venues;
+    count_min_sketch *authors;
+} field_statistics;
+
+// Spreads FNV-1a's bits (its high bits mix poorly) before they index registers and rows
+static unsigned long long mix_hash(unsigned long long h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static void hll_add(unsigned char *registers, unsigned long long hash) {
+    unsigned int index = (unsigned int)(hash >> (64 - HLL_PRECISION));
+    unsigned long long rest = hash << HLL_PRECISION;
+    unsigned char rank = 1; // Position of the first set bit in the remaining 64 - p bits
+    while (rank <= 64 - HLL_PRECISION && !(rest & 0x8000000000000000ULL)) {
+        rest <<= 1;
+        rank++;
+    }
+    if (rank > registers[index]) registers[index] = rank;
+}
+
+static double hll_estimate(const unsigned char *registers) {
+    double m = HLL_REGISTERS, sum = 0.0;
+    int zeros = 0;
+    for (int i = 0; i < HLL_REGISTERS; ++i) {
+        sum += ldexp(1.0, -registers[i]);
+        if (registers[i] == 0) zeros++;
+    }
+    double estimate = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+    // Small cardinalities: linear counting over the empty registers is more accurate
+    if (estimate <= 2.5 * m && zeros > 0) estimate = m * log(m / zeros);
+    return estimate;
+}
+
+// Counts one occurrence of value[0..len) and keeps it among the top candidates if it is frequent enough
+static void cms_add(count_min_sketch *cms, const char *value, size_t len, unsigned long long hash) {
+    unsigned int estimate = 0xffffffffu;
+    unsigned int h1 = (unsigned int)hash, h2 = (unsigned int)(hash >> 32) | 1u;
+    for (int d = 0; d < CMS_DEPTH; ++d) {
+        unsigned int *cell = &cms->counts[d][(h1 + (unsigned int)d * h2) % CMS_WIDTH];
+        if (*cell < 0xffffffffu) (*cell)++;
+        if (*cell < estimate) estimate = *cell;
+    }
+    // Estimates only grow, so a value under the floor is neither a candidate nor about to become one
+    if (cms->top_count == TOP_K && estimate < cms->floor) return;
+    int lowest = 0, slot = -1;
+    for (int i = 0; i < cms->top_count; ++i) {
+        heavy_hitter *hit = &cms->top[i];
+        if (hit->hash == hash && strncmp(hit->value, value, len) == 0 && hit->value[len] == '\0') {
+            slot = i;
+            break;
+        }
+        if (hit->estimate < cms->top[lowest].estimate) lowest = i;
+    }
+    if (slot < 0) {
+        if (cms->top_count < TOP_K) slot = cms->top_count;
+        else if (estimate > cms->top[lowest].estimate) slot = lowest;
+        else return;
+        char *copy = (char*)malloc(len + 1);
+        if (!copy) return; // Statistics only; skip the candidate
+        memcpy(copy, value, len);
+        copy[len] = '\0';
+        if (slot == cms->top_count) cms->top_count++;
+        else free(cms->top[slot].value);
+        cms->top[slot].value = copy;
+        cms->top[slot].hash = hash;
+    }
+    cms->top[slot].estimate = estimate;
+    if (cms->top_count == TOP_K) {
+        cms->floor = cms->top[0].estimate;
+        for (int i = 1; i < TOP_K; ++i) {
+            if (cms->top[i].estimate < cms->floor) cms->floor = cms->top[i].estimate;
+        }
+    }
+}
+
+// Registers of field `name`. Entries mostly list fields in the same order, so *hint (the slot
+// after the previous field's) is checked first.
+static unsigned char* field_registers(field_statistics *stats, const char *name, int *hint) {
+    if (*hint < stats->field_count && strcmp(stats->fields[*hint].name, name) == 0) {
+        return stats->fields[(*hint)++].registers;
+    }
+    for (int i = 0; i < stats->field_count; ++i) {
+        if (strcmp(stats->fields[i].name, name) == 0) {
+            *hint = i + 1;
+            return stats->fields[i].registers;
+        }
+    }
+    if (stats->field_count == stats->field_capacity) {
+        int capacity = stats->field_capacity ? stats->field_capacity * 2 : 32;
+        field_sketch *grown = (field_sketch*)realloc(stats->fields, capacity * sizeof(field_sketch));
+        if (!grown) return NULL;
+        stats->fields = grown;
+        stats->field_capacity = capacity;
+    }
+    field_sketch *sketch = &stats->fields[stats->field_count];
+    sketch->name = copy_string(name);
+    sketch->registers = (unsigned char*)calloc(HLL_REGISTERS, 1);
+    if (!sketch->name || !sketch->registers) {
+        free(sketch->name);
+        free(sketch->registers);
+        return NULL;
+    }
+    *hint = ++stats->field_count;
+    return sketch->registers;
+}
+
+// Updates the sketches with one parsed entry
+static void field_statistics_add(field_statistics *stats, const cJSON *entry) {
+    if (!stats->venues) stats->venues = (count_min_sketch*)calloc(1, sizeof(count_min_sketch));
+    if (!stats->authors) stats->authors = (count_min_sketch*)calloc(1, sizeof(count_min_sketch));
+    const char *venue = NULL;
+    int hint = 0;
+    const cJSON *field;
+    cJSON_ArrayForEach(field, entry) {
+        if (!cJSON_IsString(field) || strcmp(field->string, "ENTRYTYPE") == 0) continue;
+        unsigned char *registers = field_registers(stats, field->string, &hint);
+        if (!registers) continue;
+        const char *value = field->valuestring;
+        if (strcmp(field->string, "author") != 0) {
+            unsigned long long hash = mix_hash(fnv1a_hash(value));
+            hll_add(registers, hash);
+            if (strcmp(field->string, "booktitle") == 0 || (!venue && strcmp(field->string, "journal") == 0)) venue = value;
+            continue;
+        }
+        // One sketch update per author in "A and B and C"
+        while (*value) {
+            while (isspace((unsigned char)*value)) value++;
+            const char *end = strstr(value, " and ");
+            size_t len = end ? (size_t)(end - value) : strlen(value);
+            size_t trimmed = len;
+            while (trimmed > 0 && isspace((unsigned char)value[trimmed - 1])) trimmed--;
+            if (trimmed > 0) {
+                unsigned long long hash = mix_hash(fnv1a_hash_bytes(value, trimmed));
+                hll_add(registers, hash);
+                if (stats->authors) cms_add(stats->authors, value, trimmed, hash);
+            }
+            value += end ? len + 5 : len;
+        }
+    }
+    if (venue && venue[0] != '\0' && stats->venues) cms_add(stats->venues, venue, strlen(venue), mix_hash(fnv1a_hash(venue)));
+}
+
+static int compare_heavy_hitters(const void *a, const void *b) {
+    unsigned int ea = ((const heavy_hitter*)a)->estimate, eb = ((const heavy_hitter*)b)->estimate;
+    return (ea < eb) - (ea > eb);
+}
+
+static void print_heavy_hitters(const char *title, count_min_sketch *cms) {
+    if (!cms || cms->top_count == 0) return;
+    printf("%s (Count-Min estimates):\n", title);
+    qsort(cms->top, cms->top_count, sizeof(heavy_hitter), compare_heavy_hitters);
+    for (int i = 0; i < cms->top_count; ++i) {
+        printf("  %u  %s\n", cms->top[i].estimate, cms->top[i].value);
+    }
+    printf("\n");
+}
+
+static void field_statistics_print(field_statistics *stats) {
+    if (stats->field_count == 0) return;
+    printf("Approximate distinct values per field (HyperLogLog, ~%.1f%% error; authors counted individually):\n",
+           104.0 / sqrt(HLL_REGISTERS));
+    for (int i = 0; i < stats->field_count; ++i) {
+        printf("  %s: ~%.0f\n", stats->fields[i].name, hll_estimate(stats->fields[i].registers));
+    }
+    printf("\n");
+    print_heavy_hitters("Top venues", stats->venues);
+    print_heavy_hitters("Top authors", stats->authors);
+}
+
+static void field_statistics_free(field_statistics *stats) {
+    for (int i = 0; i < stats->field_count; ++i) {
+        free(stats->fields[i].name);
+        free(stats->fields[i].registers);
+    }
+    free(stats->fields);
+    count_min_sketch *sketches[2] = { stats->venues, stats->authors };
+    for (int s = 0; s < 2; ++s) {
+        if (!sketches[s]) continue;
+        for (int i = 0; i < sketches[s]->top_count; ++i) free(sketches[s]->top[i].value);
+        free(sketches[s]);
+    }
+}
+
+
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <input_bib_file>\n", argv[0]);
+    const char *usage = "Usage: %s <input_bib_file> [--partition hash|year|venue] [--shards N] [--output PATH]\n"
+                        "  --partition  Write shards plus a manifest instead of one file (hash of ID, year or venue)\n"
+                        "  --shards     Number of shards (required for hash; year/venue default to one shard per value)\n"
+                        "  --output     Output path, default data/corpus.json (shards and manifest are written next to it)\n";
+    if (argc < 2) {
+        fprintf(stderr, usage, argv[0]);
         return 1;
     }
     const char *input_filename = argv[1];
 
-    // Use a fixed output filename
+    // Default output filename; shards use it as their stem
     const char *output_filename = "data/corpus.json";
+    partition_mode partition = PARTITION_NONE;
+    int shard_count = 0;
+    for (int i = 2; i < argc; ++i) {
+        if (i + 1 >= argc) {
+            fprintf(stderr, usage, argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--partition") == 0) {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "hash") == 0) partition = PARTITION_HASH;
+            else if (strcmp(mode, "year") == 0) partition = PARTITION_YEAR;
+            else if (strcmp(mode, "venue") == 0) partition = PARTITION_VENUE;
+            else { fprintf(stderr, "Error: Unknown partition '%s'.\n", mode); return 1; }
+        } else if (strcmp(argv[i], "--shards") == 0) {
+            shard_count = atoi(argv[++i]);
+            if (shard_count <= 0) { fprintf(stderr, "Error: --shards must be a positive number.\n"); return 1; }
+        } else if (strcmp(argv[i], "--output") == 0) {
+            output_filename = argv[++i];
+        } else {
+            fprintf(stderr, usage, argv[0]);
+            return 1;
+        }
+    }
+    if (partition == PARTITION_HASH && shard_count == 0) {
+        fprintf(stderr, "Error: --partition hash needs --shards N.\n");
+        return 1;
+    }
+    if (shard_count > 0 && partition == PARTITION_NONE) partition = PARTITION_HASH;
 
     FILE *bib_file;
     FILE *json_file;
@@ -429,9 +915,9 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // Open output JSON file for converted entries
-    json_file = fopen(output_filename, "w");
-    if (json_file == NULL) {
+    // Open output JSON file for converted entries (sharded output opens its files at the end)
+    json_file = partition == PARTITION_NONE ? fopen(output_filename, "w") : NULL;
+    if (partition == PARTITION_NONE && json_file == NULL) {
         perror("Error opening output JSON file");
         fclose(bib_file);
         cJSON_Delete(year_counts);
@@ -439,11 +925,16 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    shard_writer shards = {0};
+    int out_of_memory = 0; // Sharding stopped early: the output would be incomplete
+    field_statistics field_stats = {0};
     cJSON *json_root = cJSON_CreateArray(); // Create a JSON array to hold entries
-    if (!json_root) {
+    if (!json_root || shard_writer_init(&shards, partition, partition == PARTITION_NONE ? 0 : shard_count) < 0) {
         perror("Failed to create JSON root array");
+        shard_writer_free(&shards);
+        cJSON_Delete(json_root);
         fclose(bib_file);
-        fclose(json_file);
+        if (json_file) fclose(json_file);
         cJSON_Delete(year_counts);
         cJSON_Delete(all_key_counts);
         return 1;
@@ -456,7 +947,6 @@ int main(int argc, char *argv[]) {
     while ((entry_json = parse_bib_entry(bib_file, entry_type, sizeof(entry_type))) != NULL) {
         total_entries_processed++;
         if (!cJSON_IsNull(entry_json)) {
-             cJSON_AddItemToArray(json_root, entry_json);
              // valid_entries_converted is incremented inside parse_bib_entry
 
              // --- Collect Statistics for Yearly Paper Counts CSV ---
@@ -499,7 +989,15 @@ int main(int argc, char *argv[]) {
                  }
                  current_field = current_field->next;
              }
+             field_statistics_add(&field_stats, entry_json);
 
+             if (partition == PARTITION_NONE) {
+                 cJSON_AddItemToArray(json_root, entry_json);
+             } else if (shard_writer_add(&shards, entry_json) < 0) {
+                 fprintf(stderr, "Error: Out of memory while sharding entries.\n");
+                 out_of_memory = 1;
+                 break;
+             }
         } else {
              cJSON_Delete(entry_json); // Delete the null object indicating a disregarded entry
              // disregarded_entries_count is incremented inside parse_bib_entry
@@ -527,28 +1025,41 @@ int main(int argc, char *argv[]) {
         current_key_stat = current_key_stat->next;
     }
     printf("\n");
+    field_statistics_print(&field_stats);
 
-    // Write the main JSON array to the output file
-    char *json_string = cJSON_Print(json_root); // Use cJSON_Print for formatted output
-    // char *json_string = cJSON_PrintUnformatted(json_root); // Use this for smaller output size
-    if (json_string == NULL) {
-        perror("Failed to print main JSON");
-        // Clean up will happen below
+    int status = 0;
+    if (out_of_memory) {
+        // A manifest over the entries read so far would pass for the whole corpus
+        fprintf(stderr, "Error: Conversion stopped early; no shards or manifest were written.\n");
+        status = 1;
+    } else if (partition != PARTITION_NONE) {
+        // Write the shards and their manifest
+        status = shard_writer_write(&shards, output_filename) < 0 ? 1 : 0;
     } else {
-        fprintf(json_file, "%s\n", json_string);
-        free(json_string);
+        // Write the main JSON array to the output file
+        char *json_string = cJSON_Print(json_root); // Use cJSON_Print for formatted output
+        // char *json_string = cJSON_PrintUnformatted(json_root); // Use this for smaller output size
+        if (json_string == NULL) {
+            perror("Failed to print main JSON");
+            status = 1;
+        } else {
+            fprintf(json_file, "%s\n", json_string);
+            free(json_string);
+        }
     }
 
     // Clean up cJSON objects
     cJSON_Delete(json_root);
+    shard_writer_free(&shards);
+    field_statistics_free(&field_stats);
     cJSON_Delete(year_counts);
     cJSON_Delete(all_key_counts);
 
     // Close files
     fclose(bib_file);
-    fclose(json_file);
+    if (json_file) fclose(json_file);
 
     printf("Conversion and statistics generation complete.\n");
 
-    return 0;
+    return status;
 }
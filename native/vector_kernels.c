@@ -0,0 +1,506 @@
+// vector_kernels.c - Scan kernels for the native vector stores (loaded from Python via ctypes)
+//
+// Build:
+//   gcc -O3 -std=gnu99 -Wall -Wextra -shared -fPIC -o native/libvector_kernels.so native/vector_kernels.c
+//
+// No -march flag is needed: SIMD variants are compiled with per-function target
+// attributes and selected at runtime from the CPU's feature flags, with portable
+// scalar code as the fallback.
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VK_X86 1
+#endif
+
+// --- Feature bits reported by vk_cpu_features() ---
+#define VK_FEATURE_AVX2_FMA 1
+#define VK_FEATURE_F16C     2
+
+// --- Scalar conversions ---
+static float half_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign; // Signed zero
+        } else { // Subnormal: renormalize
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            mantissa &= 0x3FF;
+            bits = sign | (exponent << 23) | (mantissa << 13);
+        }
+    } else if (exponent == 0x1F) {
+        bits = sign | 0x7F800000 | (mantissa << 13); // Inf / NaN
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static float bfloat_to_float(uint16_t b) {
+    uint32_t bits = (uint32_t)b << 16;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static void scores_f16_scalar(const uint16_t *rows, size_t n, size_t dim, const float *query, float *out) {
+    for (size_t i = 0; i < n; ++i) {
+        const uint16_t *row = rows + i * dim;
+        float acc = 0.0f;
+        for (size_t j = 0; j < dim; ++j) acc += half_to_float(row[j]) * query[j];
+        out[i] = acc;
+    }
+}
+
+static void scores_bf16_scalar(const uint16_t *rows, size_t n, size_t dim, const float *query, float *out) {
+    for (size_t i = 0; i < n; ++i) {
+        const uint16_t *row = rows + i * dim;
+        float acc = 0.0f;
+        for (size_t j = 0; j < dim; ++j) acc += bfloat_to_float(row[j]) * query[j];
+        out[i] = acc;
+    }
+}
+
+static float dot_f32_scalar(const float *a, const float *b, size_t dim) {
+    float acc = 0.0f;
+    for (size_t j = 0; j < dim; ++j) acc += a[j] * b[j];
+    return acc;
+}
+
+#ifdef VK_X86
+// --- AVX2 variants: widen 8 lanes at a time straight into the FMA ---
+__attribute__((target("avx2,fma")))
+static float hsum256(__m256 v) {
+    __m128 lo = _mm256_castps256_ps128(v);
+    __m128 hi = _mm256_extractf128_ps(v, 1);
+    lo = _mm_add_ps(lo, hi);
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 0x55));
+    return _mm_cvtss_f32(lo);
+}
+
+__attribute__((target("avx2,fma,f16c")))
+static void scores_f16_avx2(const uint16_t *rows, size_t n, size_t dim, const float *query, float *out) {
+    for (size_t i = 0; i < n; ++i) {
+        const uint16_t *row = rows + i * dim;
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        size_t j = 0;
+        for (; j + 16 <= dim; j += 16) {
+            __m256 v0 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(row + j)));
+            __m256 v1 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(row + j + 8)));
+            acc0 = _mm256_fmadd_ps(v0, _mm256_loadu_ps(query + j), acc0);
+            acc1 = _mm256_fmadd_ps(v1, _mm256_loadu_ps(query + j + 8), acc1);
+        }
+        for (; j + 8 <= dim; j += 8) {
+            __m256 v0 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(row + j)));
+            acc0 = _mm256_fmadd_ps(v0, _mm256_loadu_ps(query + j), acc0);
+        }
+        float acc = hsum256(_mm256_add_ps(acc0, acc1));
+        for (; j < dim; ++j) acc += half_to_float(row[j]) * query[j];
+        out[i] = acc;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static __m256 load_bf16x8(const uint16_t *p) {
+    __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)p));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16));
+}
+
+__attribute__((target("avx2,fma")))
+static void scores_bf16_avx2(const uint16_t *rows, size_t n, size_t dim, const float *query, float *out) {
+    for (size_t i = 0; i < n; ++i) {
+        const uint16_t *row = rows + i * dim;
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        size_t j = 0;
+        for (; j + 16 <= dim; j += 16) {
+            acc0 = _mm256_fmadd_ps(load_bf16x8(row + j), _mm256_loadu_ps(query + j), acc0);
+            acc1 = _mm256_fmadd_ps(load_bf16x8(row + j + 8), _mm256_loadu_ps(query + j + 8), acc1);
+        }
+        for (; j + 8 <= dim; j += 8) {
+            acc0 = _mm256_fmadd_ps(load_bf16x8(row + j), _mm256_loadu_ps(query + j), acc0);
+        }
+        float acc = hsum256(_mm256_add_ps(acc0, acc1));
+        for (; j < dim; ++j) acc += bfloat_to_float(row[j]) * query[j];
+        out[i] = acc;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static float dot_f32_avx2(const float *a, const float *b, size_t dim) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t j = 0;
+    for (; j + 16 <= dim; j += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j + 8), _mm256_loadu_ps(b + j + 8), acc1);
+    }
+    for (; j + 8 <= dim; j += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j), acc0);
+    }
+    float acc = hsum256(_mm256_add_ps(acc0, acc1));
+    for (; j < dim; ++j) acc += a[j] * b[j];
+    return acc;
+}
+#endif
+
+// --- Runtime dispatch ---
+static int detected_features = -1;
+
+int vk_cpu_features(void) {
+    if (detected_features < 0) {
+        int features = 0;
+#ifdef VK_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) features |= VK_FEATURE_AVX2_FMA;
+        if (__builtin_cpu_supports("f16c")) features |= VK_FEATURE_F16C;
+#endif
+        detected_features = features;
+    }
+    return detected_features;
+}
+
+// Forces the scalar paths (used by tests and benchmarks to compare against SIMD).
+void vk_disable_simd(int disable) {
+    detected_features = disable ? 0 : -1;
+}
+
+// out[i] = dot(rows[i], query) for n rows of `dim` float16 values.
+void vk_scores_f16(const uint16_t *rows, size_t n, size_t dim, const float *query, float *out) {
+#ifdef VK_X86
+    if ((vk_cpu_features() & (VK_FEATURE_AVX2_FMA | VK_FEATURE_F16C)) == (VK_FEATURE_AVX2_FMA | VK_FEATURE_F16C)) {
+        scores_f16_avx2(rows, n, dim, query, out);
+        return;
+    }
+#endif
+    scores_f16_scalar(rows, n, dim, query, out);
+}
+
+// out[i] = dot(rows[i], query) for n rows of `dim` bfloat16 values.
+void vk_scores_bf16(const uint16_t *rows, size_t n, size_t dim, const float *query, float *out) {
+#ifdef VK_X86
+    if (vk_cpu_features() & VK_FEATURE_AVX2_FMA) {
+        scores_bf16_avx2(rows, n, dim, query, out);
+        return;
+    }
+#endif
+    scores_bf16_scalar(rows, n, dim, query, out);
+}
+
+// Late-interaction (MaxSim) scores. Document d owns token rows offsets[d] .. offsets[d+1]-1 of
+// `tokens`; out[d] = sum over query tokens of the best dot product with any of d's tokens.
+// Documents without tokens score 0. Returns 0, or -1 if the scratch allocation fails.
+static void maxsim_tokens_scalar(const float *query, size_t n_query, const float *tokens, size_t n_tokens,
+                                 size_t dim, float *best) {
+    for (size_t t = 0; t < n_tokens; ++t) {
+        for (size_t i = 0; i < n_query; ++i) {
+            float s = dot_f32_scalar(query + i * dim, tokens + t * dim, dim);
+            if (s > best[i]) best[i] = s;
+        }
+    }
+}
+
+#ifdef VK_X86
+// Register-blocked: 2 document tokens x 4 query tokens per pass, so every loaded vector
+// feeds several FMAs. Requires dim % 8 == 0 (checked by the caller).
+__attribute__((target("avx2,fma")))
+static void maxsim_tokens_avx2(const float *query, size_t n_query, const float *tokens, size_t n_tokens,
+                               size_t dim, float *best) {
+    size_t t = 0;
+    for (; t + 2 <= n_tokens; t += 2) {
+        const float *t0 = tokens + t * dim, *t1 = t0 + dim;
+        size_t i = 0;
+        for (; i + 4 <= n_query; i += 4) {
+            const float *q = query + i * dim;
+            __m256 a00 = _mm256_setzero_ps(), a01 = _mm256_setzero_ps(), a02 = _mm256_setzero_ps(), a03 = _mm256_setzero_ps();
+            __m256 a10 = _mm256_setzero_ps(), a11 = _mm256_setzero_ps(), a12 = _mm256_setzero_ps(), a13 = _mm256_setzero_ps();
+            for (size_t j = 0; j < dim; j += 8) {
+                __m256 x0 = _mm256_loadu_ps(t0 + j), x1 = _mm256_loadu_ps(t1 + j);
+                __m256 q0 = _mm256_loadu_ps(q + j), q1 = _mm256_loadu_ps(q + dim + j);
+                __m256 q2 = _mm256_loadu_ps(q + 2 * dim + j), q3 = _mm256_loadu_ps(q + 3 * dim + j);
+                a00 = _mm256_fmadd_ps(x0, q0, a00); a10 = _mm256_fmadd_ps(x1, q0, a10);
+                a01 = _mm256_fmadd_ps(x0, q1, a01); a11 = _mm256_fmadd_ps(x1, q1, a11);
+                a02 = _mm256_fmadd_ps(x0, q2, a02); a12 = _mm256_fmadd_ps(x1, q2, a12);
+                a03 = _mm256_fmadd_ps(x0, q3, a03); a13 = _mm256_fmadd_ps(x1, q3, a13);
+            }
+            float s0 = hsum256(a00), s1 = hsum256(a01), s2 = hsum256(a02), s3 = hsum256(a03);
+            float r0 = hsum256(a10), r1 = hsum256(a11), r2 = hsum256(a12), r3 = hsum256(a13);
+            s0 = s0 > r0 ? s0 : r0; s1 = s1 > r1 ? s1 : r1; s2 = s2 > r2 ? s2 : r2; s3 = s3 > r3 ? s3 : r3;
+            if (s0 > best[i]) best[i] = s0;
+            if (s1 > best[i + 1]) best[i + 1] = s1;
+            if (s2 > best[i + 2]) best[i + 2] = s2;
+            if (s3 > best[i + 3]) best[i + 3] = s3;
+        }
+        for (; i < n_query; ++i) {
+            float s = dot_f32_avx2(query + i * dim, t0, dim), r = dot_f32_avx2(query + i * dim, t1, dim);
+            if (r > s) s = r;
+            if (s > best[i]) best[i] = s;
+        }
+    }
+    for (; t < n_tokens; ++t) {
+        for (size_t i = 0; i < n_query; ++i) {
+            float s = dot_f32_avx2(query + i * dim, tokens + t * dim, dim);
+            if (s > best[i]) best[i] = s;
+        }
+    }
+}
+#endif
+
+int vk_maxsim_f32(const float *query, size_t n_query, const float *tokens, const int64_t *offsets,
+                  size_t n_docs, size_t dim, float *out) {
+    void (*scan)(const float *, size_t, const float *, size_t, size_t, float *) = maxsim_tokens_scalar;
+#ifdef VK_X86
+    if ((vk_cpu_features() & VK_FEATURE_AVX2_FMA) && dim % 8 == 0) scan = maxsim_tokens_avx2;
+#endif
+    float *best = malloc((n_query ? n_query : 1) * sizeof(float));
+    if (!best) return -1;
+    for (size_t d = 0; d < n_docs; ++d) {
+        int64_t begin = offsets[d], end = offsets[d + 1];
+        if (begin >= end) {
+            out[d] = 0.0f;
+            continue;
+        }
+        for (size_t i = 0; i < n_query; ++i) best[i] = -FLT_MAX;
+        scan(query, n_query, tokens + (size_t)begin * dim, (size_t)(end - begin), dim, best);
+        float total = 0.0f;
+        for (size_t i = 0; i < n_query; ++i) total += best[i];
+        out[d] = total;
+    }
+    free(best);
+    return 0;
+}
+
+// Decompresses residual-coded tokens: out[i] = normalize(centroids[codes[t]] + residual(t)) for
+// t = token_index[i]. Each byte of packed[t] expands to `per_byte` consecutive dimensions through
+// `lut` (256 x per_byte bucket weights).
+void vk_decode_residuals(const int32_t *codes, const uint8_t *packed, const int64_t *token_index, size_t n,
+                         const float *centroids, size_t dim, const float *lut, size_t per_byte, float *out) {
+    size_t row_bytes = dim / per_byte;
+    for (size_t i = 0; i < n; ++i) {
+        int64_t t = token_index[i];
+        const float *centroid = centroids + (size_t)codes[t] * dim;
+        const uint8_t *bytes = packed + (size_t)t * row_bytes;
+        float *dst = out + i * dim;
+        for (size_t b = 0; b < row_bytes; ++b) {
+            const float *weights = lut + (size_t)bytes[b] * per_byte;
+            for (size_t k = 0; k < per_byte; ++k) dst[b * per_byte + k] = centroid[b * per_byte + k] + weights[k];
+        }
+        float norm = 0.0f;
+        for (size_t j = 0; j < dim; ++j) norm += dst[j] * dst[j];
+        float scale = norm > 1e-24f ? 1.0f / sqrtf(norm) : 0.0f;
+        for (size_t j = 0; j < dim; ++j) dst[j] *= scale;
+    }
+}
+
+// --- Facet histograms ---
+// Values are counted into four interleaved sub-histograms so that runs of rows with the same
+// value (common: a handful of years or venues) do not serialize on one counter's
+// load-increment-store. Codes outside [0, num_values) (e.g. -1, missing) are skipped.
+static void facet_counts_scalar(const int32_t *codes, const int64_t *rows, size_t n, size_t num_values, uint32_t *sub) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (size_t lane = 0; lane < 4; ++lane) {
+            uint32_t code = (uint32_t)codes[rows ? rows[i + lane] : (int64_t)(i + lane)];
+            if (code < num_values) sub[lane * num_values + code]++;
+        }
+    }
+    for (; i < n; ++i) {
+        uint32_t code = (uint32_t)codes[rows ? rows[i] : (int64_t)i];
+        if (code < num_values) sub[code]++;
+    }
+}
+
+#ifdef VK_X86
+// Gathers eight codes per step (two 4-lane gathers through 64-bit row ids), then scatters.
+__attribute__((target("avx2")))
+static void facet_counts_avx2(const int32_t *codes, const int64_t *rows, size_t n, size_t num_values, uint32_t *sub) {
+    size_t i = 0;
+    uint32_t lanes[8];
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo, hi;
+        if (rows) {
+            lo = _mm256_i64gather_epi32((const int *)codes, _mm256_loadu_si256((const __m256i *)(rows + i)), 4);
+            hi = _mm256_i64gather_epi32((const int *)codes, _mm256_loadu_si256((const __m256i *)(rows + i + 4)), 4);
+        } else {
+            lo = _mm_loadu_si128((const __m128i *)(codes + i));
+            hi = _mm_loadu_si128((const __m128i *)(codes + i + 4));
+        }
+        _mm256_storeu_si256((__m256i *)lanes, _mm256_set_m128i(hi, lo));
+        for (size_t lane = 0; lane < 8; ++lane) {
+            if (lanes[lane] < num_values) sub[(lane & 3) * num_values + lanes[lane]]++;
+        }
+    }
+    facet_counts_scalar(rows ? codes : codes + i, rows ? rows + i : NULL, n - i, num_values, sub);
+}
+#endif
+
+// counts[v] = number of i < n with codes[rows[i]] == v (rows may be NULL: codes[0..n-1]).
+// Returns -1 if the sub-histograms cannot be allocated.
+int vk_facet_counts(const int32_t *codes, const int64_t *rows, size_t n, size_t num_values, int64_t *counts) {
+    uint32_t *sub = calloc(4 * (num_values ? num_values : 1), sizeof(uint32_t));
+    if (!sub) return -1;
+    void (*count)(const int32_t *, const int64_t *, size_t, size_t, uint32_t *) = facet_counts_scalar;
+#ifdef VK_X86
+    if (vk_cpu_features() & VK_FEATURE_AVX2_FMA) count = facet_counts_avx2;
+#endif
+    // uint32 sub-counters: split so that no single call can overflow one.
+    const size_t step = (size_t)1 << 31;
+    for (size_t v = 0; v < num_values; ++v) counts[v] = 0;
+    for (size_t start = 0; start < n; start += step) {
+        size_t len = n - start < step ? n - start : step;
+        count(rows ? codes : codes + start, rows ? rows + start : NULL, len, num_values, sub);
+        for (size_t v = 0; v < num_values; ++v) {
+            counts[v] += (int64_t)sub[v] + sub[num_values + v] + sub[2 * num_values + v] + sub[3 * num_values + v];
+        }
+        memset(sub, 0, 4 * num_values * sizeof(uint32_t));
+    }
+    free(sub);
+    return 0;
+}
+
+// --- Fuzzy title candidates (q-gram count filter) ---
+typedef struct {
+    int64_t row;
+    int32_t diagonal;
+    int32_t support;
+} qgram_candidate;
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_candidates(const void *a, const void *b) {
+    const qgram_candidate *x = a, *y = b;
+    if (x->support != y->support) return y->support - x->support;
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+// Candidate alignments for a fuzzy title match. Query 3-gram g sits at positions[g] and its
+// postings are post_rows/post_pos[gram_offsets[slots[g]] .. gram_offsets[slots[g] + 1]].
+// A title within max_edits edits of the query shares at least `needed` grams with it, at
+// offsets (diagonal = post_pos - positions[g]) that drift by at most max_edits. Writes each
+// passing row once, at its best-supported diagonal, most shared grams first (ties: lower row),
+// up to max_out. Returns the number written, or -1 if scratch memory cannot be allocated.
+int vk_qgram_candidates(const int32_t *post_rows, const int32_t *post_pos, const int64_t *gram_offsets,
+                        const int64_t *slots, const int32_t *positions, size_t n_grams, size_t num_titles,
+                        int32_t needed, int32_t max_edits, int64_t *out_rows, int32_t *out_diagonals,
+                        int32_t *out_support, size_t max_out) {
+    size_t total = 0;
+    for (size_t g = 0; g < n_grams; ++g) total += (size_t)(gram_offsets[slots[g] + 1] - gram_offsets[slots[g]]);
+    uint16_t *counts = calloc(num_titles ? num_titles : 1, sizeof(uint16_t));
+    uint64_t *keys = malloc((total ? total : 1) * sizeof(uint64_t));
+    int32_t *key_counts = malloc((total ? total : 1) * sizeof(int32_t));
+    qgram_candidate *candidates = malloc((total ? total : 1) * sizeof(qgram_candidate));
+    if (!counts || !keys || !key_counts || !candidates) {
+        free(counts); free(keys); free(key_counts); free(candidates);
+        return -1;
+    }
+    // Pass 1: shared grams per row, ignoring alignment
+    for (size_t g = 0; g < n_grams; ++g) {
+        for (int64_t p = gram_offsets[slots[g]]; p < gram_offsets[slots[g] + 1]; ++p) {
+            uint16_t *c = &counts[post_rows[p]];
+            if (*c < UINT16_MAX) (*c)++;
+        }
+    }
+    // Pass 2: (row, diagonal) keys of the rows passing the filter
+    size_t n_keys = 0;
+    for (size_t g = 0; g < n_grams; ++g) {
+        for (int64_t p = gram_offsets[slots[g]]; p < gram_offsets[slots[g] + 1]; ++p) {
+            if (counts[post_rows[p]] >= needed) {
+                uint32_t diagonal = (uint32_t)(post_pos[p] - positions[g] + (1 << 30));
+                keys[n_keys++] = ((uint64_t)(uint32_t)post_rows[p] << 32) | diagonal;
+            }
+        }
+    }
+    free(counts);
+    qsort(keys, n_keys, sizeof(uint64_t), compare_u64);
+    size_t n_unique = 0;
+    for (size_t i = 0; i < n_keys; ++i) {
+        if (n_unique && keys[n_unique - 1] == keys[i]) {
+            key_counts[n_unique - 1]++;
+        } else {
+            keys[n_unique] = keys[i];
+            key_counts[n_unique++] = 1;
+        }
+    }
+    // Support of an alignment: grams at diagonals within max_edits of it, in the same row
+    size_t n_candidates = 0;
+    for (size_t i = 0; i < n_unique;) {
+        uint64_t row = keys[i] >> 32;
+        size_t end = i;
+        while (end < n_unique && keys[end] >> 32 == row) end++;
+        int32_t best_support = -1;
+        uint32_t best_diagonal = 0;
+        for (size_t j = i; j < end; ++j) {
+            int32_t support = key_counts[j];
+            for (size_t l = j; l > i && keys[j] - keys[l - 1] <= (uint64_t)max_edits; --l) support += key_counts[l - 1];
+            for (size_t l = j + 1; l < end && keys[l] - keys[j] <= (uint64_t)max_edits; ++l) support += key_counts[l];
+            if (support > best_support) {
+                best_support = support;
+                best_diagonal = (uint32_t)keys[j];
+            }
+        }
+        if (best_support >= needed) {
+            candidates[n_candidates].row = (int64_t)row;
+            candidates[n_candidates].diagonal = (int32_t)best_diagonal - (1 << 30);
+            candidates[n_candidates++].support = best_support;
+        }
+        i = end;
+    }
+    qsort(candidates, n_candidates, sizeof(qgram_candidate), compare_candidates);
+    if (n_candidates > max_out) n_candidates = max_out;
+    for (size_t i = 0; i < n_candidates; ++i) {
+        out_rows[i] = candidates[i].row;
+        out_diagonals[i] = candidates[i].diagonal;
+        out_support[i] = candidates[i].support;
+    }
+    free(keys);
+    free(key_counts);
+    free(candidates);
+    return (int)n_candidates;
+}
+
+// out[i] = smallest edit distance between query and a substring of
+// text[starts[i] .. starts[i] + lengths[i]) beginning within its first `slack` bytes
+// (slack = 0: a prefix). Queries longer than 255 bytes are rejected with -1.
+int vk_prefix_edit_distances(const uint8_t *query, size_t query_len, const uint8_t *text, const int64_t *starts,
+                             const int64_t *lengths, size_t n, int32_t slack, int32_t *out) {
+    int32_t row[257];
+    if (query_len > 255) return -1;
+    for (size_t c = 0; c < n; ++c) {
+        const uint8_t *window = text + starts[c];
+        size_t len = (size_t)lengths[c];
+        // Column-major DP: row[i] = distance of query[0..i) against the window so far
+        for (size_t i = 0; i <= query_len; ++i) row[i] = (int32_t)i;
+        int32_t best = row[query_len];
+        for (size_t j = 1; j <= len; ++j) {
+            int32_t diagonal = row[0];
+            row[0] = (int32_t)j > slack ? (int32_t)j - slack : 0;
+            for (size_t i = 1; i <= query_len; ++i) {
+                int32_t value = diagonal + (query[i - 1] != window[j - 1]);
+                if (row[i] + 1 < value) value = row[i] + 1;
+                if (row[i - 1] + 1 < value) value = row[i - 1] + 1;
+                diagonal = row[i];
+                row[i] = value;
+            }
+            if (row[query_len] < best) best = row[query_len];
+        }
+        out[c] = best;
+    }
+    return 0;
+}
@@ -0,0 +1,467 @@
+#!/usr/bin/env python3
+"""
+Micro-benchmarks for the retrieval kernels.
+
+Runs on synthetic normalized embeddings, so no corpus or model is needed.
+Each benchmark is registered in BENCHMARKS and selected by name:
+
+    python scripts/bench_retrieval.py flat_scan --rows 200000 --dim 384 --repeats 20
+    python scripts/bench_retrieval.py --list
+"""
+import os
+import sys
+import time
+import json
+import asyncio
+import argparse
+import tempfile
+import multiprocessing
+import threading
+import tracemalloc
+from typing import Callable, Dict
+
+import numpy as np
+
+project_root = os.path.abspath(os.path.join(os.path.dirname(__file__), '..'))
+if project_root not in sys.path:
+    sys.path.insert(0, project_root)
+
+from src import kernels
+from src.multivector import MultiVectorIndex
+from src.external_build import ExternalBuild
+from src.index_bundle import IndexBundle, write_bundle_from_dir
+from src.locality import cluster_order, metadata_order
+from src.retrieval_metrics import recall_at_k
+from src.shared_segments import JSONSegment
+from src.title_index import TitleIndex
+from src.token_cache import update_token_cache
+from src.wal import OP_INSERT, SYNC_MODES, WriteAheadLog, encode_insert
+
+BENCHMARKS: Dict[str, Callable[[argparse.Namespace], None]] = {}
+
+def benchmark(name: str):
+    """Registers a benchmark under `name`."""
+    def register(fn):
+        BENCHMARKS[name] = fn
+        return fn
+    return register
+
+def synthetic_embeddings(rows: int, dim: int, seed: int) -> np.ndarray:
+    rng = np.random.default_rng(seed)
+    vectors = rng.standard_normal((rows, dim), dtype=np.float32)
+    vectors /= np.linalg.norm(vectors, axis=1, keepdims=True)
+    return vectors
+
+def time_ms(fn: Callable[[], object], repeats: int) -> float:
+    """Median wall time of `fn` in milliseconds after one warm-up call."""
+    fn()
+    samples = []
+    for _ in range(repeats):
+        start = time.perf_counter()
+        fn()
+        samples.append(time.perf_counter() - start)
+    return 1000 * float(np.median(samples))
+
+@benchmark("flat_scan")
+def bench_flat_scan(args: argparse.Namespace):
+    """Exact scan latency, memory and recall@k for each storage dtype."""
+    corpus = synthetic_embeddings(args.rows, args.dim, args.seed)
+    queries = synthetic_embeddings(args.queries, args.dim, args.seed + 1)
+    truth = [kernels.top_k_indices(corpus @ q, args.k)[0].tolist() for q in queries]
+    native = kernels.native_kernels_available()
+    print(f"flat_scan: {args.rows} x {args.dim}, {args.queries} queries, k={args.k}, native kernels: {'yes' if native else 'no'}")
+    print(f"  {'dtype':<10}{'path':<10}{'MB':>10}{'ms/query':>12}{'recall@k':>10}")
+    for dtype in kernels.STORAGE_DTYPES:
+        stored = kernels.encode_vectors(corpus, dtype)
+        paths = ["blas"] if dtype == "float32" else (["native", "numpy"] if native else ["numpy"])
+        for path in paths:
+            saved = kernels._native
+            if path == "numpy":
+                kernels._native = None
+            try:
+                latency = time_ms(lambda: kernels.flat_scores(stored, queries[0], dtype), args.repeats)
+                found = [kernels.top_k_indices(kernels.flat_scores(stored, q, dtype), args.k)[0].tolist() for q in queries]
+            finally:
+                kernels._native = saved
+            recall = recall_at_k(found, truth, args.k)
+            print(f"  {dtype:<10}{path:<10}{stored.nbytes / 2**20:>10.1f}{latency:>12.2f}{recall:>10.4f}")
+
+def synthetic_token_embeddings(docs: int, dim: int, seed: int):
+    """Token sets drawn around a few topics per document, so centroids have structure to find."""
+    rng = np.random.default_rng(seed)
+    topics = rng.standard_normal((max(16, docs // 20), dim), dtype=np.float32)
+    token_sets = []
+    for _ in range(docs):
+        picked = topics[rng.choice(len(topics), 3)]
+        n_tokens = int(rng.integers(32, 160))
+        tokens = picked[rng.integers(0, 3, n_tokens)] + 0.5 * rng.standard_normal((n_tokens, dim), dtype=np.float32)
+        token_sets.append(tokens / np.linalg.norm(tokens, axis=1, keepdims=True))
+    return token_sets
+
+@benchmark("multivector")
+def bench_multivector(args: argparse.Namespace):
+    """Late-interaction search: memory, latency and recall@k against exact MaxSim."""
+    docs = max(1, args.rows // 100)  # ~100 tokens per document
+    token_sets = synthetic_token_embeddings(docs, args.dim, args.seed)
+    start = time.perf_counter()
+    index = MultiVectorIndex.build([str(i) for i in range(docs)], token_sets, residual_bits=args.residual_bits)
+    build_s = time.perf_counter() - start
+    full = np.concatenate(token_sets)
+    queries = [token_sets[i][:32] for i in np.random.default_rng(args.seed + 1).choice(docs, min(args.queries, docs), replace=False)]
+    truth = [kernels.top_k_indices(kernels.maxsim_scores(q, full, index.doc_offsets), args.k)[0].tolist() for q in queries]
+    print(f"multivector: {docs} docs, {index.num_tokens} tokens x {args.dim}, {len(index.centroids)} centroids, "
+          f"{args.residual_bits}-bit residuals, built in {build_s:.1f}s")
+    print(f"  float32 tokens: {full.nbytes / 2**20:.1f} MB, compressed index: {index.nbytes / 2**20:.1f} MB")
+    print(f"  {'nprobe':>8}{'candidates':>12}{'ms/query':>12}{'recall@k':>10}")
+    for nprobe, candidates in ((2, 128), (4, 256), (8, 512)):
+        latency = time_ms(lambda: index.search(queries[0], args.k, nprobe=nprobe, candidates=candidates), args.repeats)
+        found = [index.search(q, args.k, nprobe=nprobe, candidates=candidates)[0].tolist() for q in queries]
+        print(f"  {nprobe:>8}{candidates:>12}{latency:>12.2f}{recall_at_k(found, truth, args.k):>10.4f}")
+
+@benchmark("facets")
+def bench_facets(args: argparse.Namespace):
+    """Facet histogram latency over all rows and over a top-N candidate set, native vs NumPy."""
+    rng = np.random.default_rng(args.seed)
+    codes = rng.integers(0, 64, args.rows).astype(np.int32)
+    candidates = rng.choice(args.rows, min(1000, args.rows), replace=False)
+    print(f"facets: {args.rows} rows, 64 values")
+    print(f"  {'rows':<12}{'path':<10}{'ms':>10}")
+    for label, rows in (("all", None), ("top-1000", candidates)):
+        for path in (["native", "numpy"] if kernels.native_kernels_available() else ["numpy"]):
+            saved = kernels._native
+            if path == "numpy":
+                kernels._native = None
+            try:
+                latency = time_ms(lambda: kernels.facet_counts(codes, rows, 64), args.repeats)
+            finally:
+                kernels._native = saved
+            print(f"  {label:<12}{path:<10}{latency:>10.3f}")
+
+@benchmark("wal_ingest")
+def bench_wal_ingest(args: argparse.Namespace):
+    """Durable insert throughput of the write-ahead log per sync mode and writer count."""
+    records = args.wal_records
+    vectors = synthetic_embeddings(records, args.dim, args.seed)
+    node = {"__type__": "1", "__data__": {"id_": "node", "text": "x" * 1000, "metadata": {"year": "2020"}}}
+    payloads = [encode_insert(node, vector) for vector in vectors]
+    print(f"wal_ingest: {records} inserts of {len(payloads[0])} bytes, one commit per insert")
+    print(f"  {'sync':<8}{'writers':>8}{'records/s':>12}{'MB/s':>8}{'fsyncs':>8}")
+    for sync in SYNC_MODES:
+        for writers in (1, args.writers):
+            with tempfile.TemporaryDirectory(prefix="bench_wal_") as tmp:
+                wal = WriteAheadLog(os.path.join(tmp, "index.wal"), sync=sync)
+
+                def write(part: int):
+                    for payload in payloads[part::writers]:
+                        wal.commit(wal.append(OP_INSERT, payload))
+
+                threads = [threading.Thread(target=write, args=(part,)) for part in range(writers)]
+                start = time.perf_counter()
+                for thread in threads:
+                    thread.start()
+                for thread in threads:
+                    thread.join()
+                elapsed = time.perf_counter() - start
+                wal.close()
+            rate = records / elapsed
+            print(f"  {sync:<8}{writers:>8}{rate:>12.0f}{rate * len(payloads[0]) / 2**20:>8.1f}{wal.fsyncs:>8}")
+
+@benchmark("typeahead")
+def bench_typeahead(args: argparse.Namespace):
+    """Title typeahead latency: exact prefixes and prefixes with one typo, native vs NumPy candidate filter."""
+    rng = np.random.default_rng(args.seed)
+    letters = np.array(list("abcdefghijklmnopqrstuvwxyz"))
+    words = np.array(["".join(letters[rng.integers(0, 26, rng.integers(3, 10))]) for _ in range(5000)])
+    titles = [" ".join(words[rng.integers(0, len(words), rng.integers(4, 12))]) for _ in range(args.titles)]
+    start = time.perf_counter()
+    index = TitleIndex.build([str(i) for i in range(len(titles))], titles)
+    print(f"typeahead: {len(titles)} titles, built in {time.perf_counter() - start:.1f}s, {index.nbytes / 2**20:.1f} MB")
+    prefixes = [titles[i][:12] for i in rng.choice(len(titles), args.queries)]
+    typos = [q[:5] + ("x" if q[5] != "x" else "y") + q[6:] for q in prefixes]
+    print(f"  {'queries':<10}{'path':<10}{'ms/query':>10}")
+    for label, queries in (("prefix", prefixes), ("typo", typos)):
+        for path in (["native", "numpy"] if kernels.native_kernels_available() else ["numpy"]):
+            saved = kernels._native
+            if path == "numpy":
+                kernels._native = None
+            try:
+                latency = time_ms(lambda: [index.search(q) for q in queries], args.repeats) / len(queries)
+            finally:
+                kernels._native = saved
+            print(f"  {label:<10}{path:<10}{latency:>10.3f}")
+
+@benchmark("prf")
+def bench_prf(args: argparse.Namespace):
+    """
+    Pseudo-relevance feedback: recall@k and latency with and without a Rocchio second pass.
+    Documents scatter around topics; each query is a noisy view of one document's topic (a short
+    query), and its relevant set is the exact top-k for the topic itself.
+    """
+    rng = np.random.default_rng(args.seed)
+    topics = synthetic_embeddings(max(16, args.rows // 200), args.dim, args.seed)
+    corpus = topics[rng.integers(0, len(topics), args.rows)] + 0.6 * rng.standard_normal((args.rows, args.dim), dtype=np.float32) / np.sqrt(args.dim)
+    corpus /= np.linalg.norm(corpus, axis=1, keepdims=True)
+    intents = topics[rng.integers(0, len(topics), args.queries)]
+    queries = intents + 1.2 * rng.standard_normal(intents.shape, dtype=np.float32) / np.sqrt(args.dim)
+    queries /= np.linalg.norm(queries, axis=1, keepdims=True)
+    truth = [kernels.top_k_indices(corpus @ t, args.k)[0].tolist() for t in intents]
+    plain = lambda q: kernels.flat_top_k(corpus, q, "float32", args.k)[0]
+    def feedback(q, top_m, pool):
+        rows, _ = kernels.flat_top_k(corpus, q, "float32", pool)
+        return kernels.feedback_top_k(corpus, q, "float32", rows, args.k, top_m, 1.0, 0.75)[0]
+    base_ms = time_ms(lambda: [plain(q) for q in queries], args.repeats) / len(queries)
+    base_recall = recall_at_k([plain(q).tolist() for q in queries], truth, args.k)
+    print(f"prf: {args.rows} x {args.dim}, {len(topics)} topics, {args.queries} queries, k={args.k}")
+    print(f"  {'top_m':>6}{'pool':>6}{'ms/query':>10}{'overhead':>10}{'recall@k':>10}")
+    print(f"  {'-':>6}{'-':>6}{base_ms:>10.2f}{'':>10}{base_recall:>10.4f}")
+    for top_m, pool in ((3, 100), (5, 100), (10, 100), (10, 1000)):
+        latency = time_ms(lambda: [feedback(q, top_m, pool) for q in queries], args.repeats) / len(queries)
+        recall = recall_at_k([feedback(q, top_m, pool).tolist() for q in queries], truth, args.k)
+        print(f"  {top_m:>6}{pool:>6}{latency:>10.2f}{latency / base_ms - 1:>10.1%}{recall:>10.4f}")
+
+@benchmark("locality")
+def bench_locality(args: argparse.Namespace):
+    """
+    Filtered scans over rows in corpus order vs reordered for locality (src.locality).
+    Rows get a random year and a venue whose documents share a topic. The filters keep one
+    year, one venue, or one venue in one year; masked scans only score blocks holding allowed rows.
+    """
+    rng = np.random.default_rng(args.seed)
+    venues = rng.integers(0, 64, args.rows)
+    years = rng.integers(1990, 2020, args.rows)
+    topics = synthetic_embeddings(64, args.dim, args.seed)
+    corpus = topics[venues] + 0.8 * rng.standard_normal((args.rows, args.dim), dtype=np.float32) / np.sqrt(args.dim)
+    corpus /= np.linalg.norm(corpus, axis=1, keepdims=True)
+    stored = kernels.encode_vectors(corpus, "float16")
+    queries = synthetic_embeddings(args.queries, args.dim, args.seed + 1)
+    metadata = [{"year": str(y), "venue": f"v{v:02d}"} for y, v in zip(years.tolist(), venues.tolist())]
+    orders = {
+        "corpus": np.arange(args.rows),
+        "year,venue": metadata_order(metadata, ["year", "venue"]),
+        "cluster": cluster_order(stored, "float16"),
+    }
+    filters = {"year": years == 2005, "venue": venues == 7, "year+venue": (years == 2005) & (venues == 7)}
+    print(f"locality: {args.rows} x {args.dim} float16, {args.queries} queries, k={args.k}")
+    print(f"  {'order':<12}{'filter':<12}{'selectivity':>12}{'rows scored':>13}{'ms/query':>10}")
+    for order_name, order in orders.items():
+        matrix = np.ascontiguousarray(stored[order])
+        for filter_name, allowed in filters.items():
+            mask = allowed[order]
+            before = kernels.counters.rows_scanned
+            kernels.flat_top_k(matrix, queries[0], "float16", args.k, mask=mask)
+            scored = kernels.counters.rows_scanned - before
+            latency = time_ms(lambda: [kernels.flat_top_k(matrix, q, "float16", args.k, mask=mask) for q in queries], args.repeats) / len(queries)
+            print(f"  {order_name:<12}{filter_name:<12}{mask.mean():>12.2%}{scored / args.rows:>13.1%}{latency:>10.3f}")
+
+@benchmark("concurrency")
+def bench_concurrency(args: argparse.Namespace):
+    """
+    Queries per second from one asyncio process issuing flat searches at several concurrency
+    levels. "loop" calls the search inside the coroutine, so it blocks the event loop.
+    "native_pool" awaits kernels.run_native, so the search runs on the native pool without the
+    GIL. "loop lag" is the worst delay of a 1 ms ticker that runs alongside the queries.
+    """
+    dtype = "float16" if kernels.native_kernels_available() else "float32"
+    corpus = kernels.encode_vectors(synthetic_embeddings(args.rows, args.dim, args.seed), dtype)
+    queries = synthetic_embeddings(args.queries, args.dim, args.seed + 1)
+    search = lambda q: kernels.flat_top_k(corpus, q, dtype, args.k)
+
+    async def run(mode: str, concurrency: int):
+        lag = 0.0
+        done = asyncio.Event()
+        async def ticker():
+            nonlocal lag
+            while not done.is_set():
+                start = time.perf_counter()
+                await asyncio.sleep(0.001)
+                lag = max(lag, time.perf_counter() - start - 0.001)
+        async def client(offset: int):
+            for i in range(offset, len(queries), concurrency):
+                if mode == "loop":
+                    search(queries[i])
+                    await asyncio.sleep(0)
+                else:
+                    await kernels.run_native(search, queries[i])
+        tick = asyncio.create_task(ticker())
+        start = time.perf_counter()
+        await asyncio.gather(*(client(offset) for offset in range(concurrency)))
+        elapsed = time.perf_counter() - start
+        done.set()
+        await tick
+        return len(queries) / elapsed, lag * 1000
+
+    threads = os.cpu_count() or 1
+    print(f"concurrency: {args.rows} x {args.dim} {dtype}, {args.queries} queries, {threads} CPUs")
+    print(f"  {'mode':<14}{'clients':>8}{'queries/s':>12}{'loop lag ms':>13}")
+    for concurrency in (1, 2, 4, 8):
+        kernels.configure_native_pool(min(concurrency, threads))
+        for mode in ("loop", "native_pool"):
+            qps, lag = asyncio.run(run(mode, concurrency))
+            print(f"  {mode:<14}{concurrency:>8}{qps:>12.1f}{lag:>13.2f}")
+    kernels.configure_native_pool(0)
+
+def _private_mb() -> float:
+    """
+    Memory this process has written (heap, copies), from /proc/self/smaps_rollup. Clean file-backed
+    pages are left out: the page cache holds one copy of them for every process mapping the file.
+    """
+    with open("/proc/self/smaps_rollup") as f:
+        return sum(int(line.split()[1]) for line in f if line.startswith("Private_Dirty")) / 1024
+
+def _serve_docstore(storage_dir: str, mode: str, ready, results):
+    """Worker process: loads the docstore like a serving process would, reads every node, reports private memory."""
+    before = _private_mb()
+    if mode == "json":
+        with open(os.path.join(storage_dir, "docstore.json"), "r", encoding="utf-8") as f:
+            docstore = json.load(f)
+        nodes = docstore["docstore/data"]
+        total = sum(len(node["__data__"]["text"]) for node in nodes.values())
+    else:
+        with IndexBundle(os.path.join(storage_dir, "index.bundle")) as bundle:
+            segment = JSONSegment.from_bundle(bundle)
+        total = sum(len(node["__data__"]["text"]) for _, node in segment.items("docstore/data"))
+    results.put((_private_mb() - before, total))
+    ready.wait()
+
+@benchmark("shared_docstore")
+def bench_shared_docstore(args: argparse.Namespace):
+    """Private memory per serving process: docstore parsed from JSON vs read from the shared mapped segment."""
+    if not os.path.exists("/proc/self/smaps_rollup"):
+        print("shared_docstore: needs /proc/self/smaps_rollup (Linux).")
+        return
+    rng = np.random.default_rng(args.seed)
+    words = np.array(["retrieval", "neural", "parsing", "translation", "speech", "model", "corpus", "attention"])
+    nodes = args.rows // 4
+    docstore = {"docstore/data": {
+        f"node-{i}": {"__data__": {"id_": f"node-{i}", "text": " ".join(words[rng.integers(0, len(words), 120)])}}
+        for i in range(nodes)
+    }}
+    with tempfile.TemporaryDirectory() as storage_dir:
+        with open(os.path.join(storage_dir, "docstore.json"), "w", encoding="utf-8") as f:
+            json.dump(docstore, f)
+        JSONSegment.build(docstore).save(storage_dir)
+        write_bundle_from_dir(storage_dir, os.path.join(storage_dir, "index.bundle"))
+        size_mb = os.path.getsize(os.path.join(storage_dir, "docstore.json")) / 2**20
+        print(f"shared_docstore: {nodes} nodes, docstore.json {size_mb:.1f} MB")
+        print(f"  {'mode':<10}{'workers':>8}{'private MB/worker':>20}{'total private MB':>18}")
+        context = multiprocessing.get_context("spawn")
+        for mode in ("json", "segment"):
+            for workers in (1, 2, 4):
+                ready, results = context.Event(), context.Queue()
+                processes = [context.Process(target=_serve_docstore, args=(storage_dir, mode, ready, results)) for _ in range(workers)]
+                for process in processes:
+                    process.start()
+                private = [results.get()[0] for _ in processes]
+                ready.set()
+                for process in processes:
+                    process.join()
+                print(f"  {mode:<10}{workers:>8}{np.mean(private):>20.1f}{sum(private):>18.1f}")
+
+@benchmark("external_build")
+def bench_external_build(args: argparse.Namespace):
+    """
+    Peak Python heap while collecting a build's vectors and docstore entries: all in memory
+    (dicts, then one concatenated matrix and JSONSegment.build) vs spilled to runs under a
+    memory cap and merged on disk (src.external_build). Mapped output pages are not counted.
+    """
+    rng = np.random.default_rng(args.seed)
+    words = np.array(["retrieval", "neural", "parsing", "translation", "speech", "model", "corpus", "attention"])
+    nodes, batch = args.rows // 4, 500
+
+    def batches():
+        for start in range(0, nodes, batch):
+            ids = [f"node-{i}" for i in range(start, min(start + batch, nodes))]
+            docstore = {"docstore/data": {
+                node_id: {"__data__": {"id_": node_id, "text": " ".join(words[rng.integers(0, len(words), 120)])}}
+                for node_id in ids
+            }}
+            yield docstore, kernels.encode_vectors(synthetic_embeddings(len(ids), args.dim, start), "float16"), ids
+
+    def in_memory(_):
+        collected, vectors = {}, []
+        for docstore, block, _ in batches():
+            collected.setdefault("docstore/data", {}).update(docstore["docstore/data"])
+            vectors.append(block)
+        return JSONSegment.build(collected), np.concatenate(vectors)
+
+    def external(memory_mb):
+        with tempfile.TemporaryDirectory() as spill_dir:
+            with ExternalBuild(os.path.join(spill_dir, "spill"), memory_mb * 2**20) as build:
+                for docstore, block, ids in batches():
+                    build.add_entries(docstore, stream=1)
+                    build.add_rows(block, ids, ids)
+                rows = build.merge_rows()
+                return build.merge_entries(), rows[0], build.runs
+
+    print(f"external_build: {nodes} nodes, {args.dim}-d float16 vectors")
+    print(f"  {'mode':<20}{'runs':>6}{'peak heap MB':>14}{'seconds':>10}")
+    for label, run, param in [("in memory", in_memory, None)] + [(f"spilled, {mb} MB cap", external, mb) for mb in (8, 32)]:
+        tracemalloc.start()
+        start = time.perf_counter()
+        result = run(param)
+        elapsed = time.perf_counter() - start
+        peak = tracemalloc.get_traced_memory()[1] / 2**20
+        tracemalloc.stop()
+        runs = result[2] if len(result) > 2 else "-"
+        print(f"  {label:<20}{runs:>6}{peak:>14.1f}{elapsed:>10.2f}")
+
+@benchmark("token_cache")
+def bench_token_cache(args: argparse.Namespace):
+    """
+    Rebuild tokenization cost with the token cache (src.token_cache): a cold build tokenizes
+    every document, an unchanged corpus nothing, and an edit only the changed documents.
+    A regex word splitter with a hashed vocabulary stands in for the WordPiece tokenizer.
+    """
+    import re
+    rng = np.random.default_rng(args.seed)
+    words = np.array(["retrieval", "neural", "parsing", "translation", "speech", "model", "corpus", "attention"])
+    documents = [" ".join(words[rng.integers(0, len(words), 150)]) + f" paper{i}" for i in range(args.rows // 20)]
+    pattern = re.compile(r"\w+|[^\w\s]")
+
+    def tokenize(texts):
+        results = []
+        for text in texts:
+            matches = list(pattern.finditer(text))
+            ids = np.fromiter((hash(m.group()) % 30000 for m in matches), dtype=np.uint32, count=len(matches))
+            results.append((ids, np.fromiter((m.start() for m in matches), dtype=np.uint32, count=len(matches))))
+        return results
+
+    edited = list(documents)
+    for i in range(0, len(edited), 100):
+        edited[i] += " revised"
+    print(f"token_cache: {len(documents)} documents of ~150 words")
+    print(f"  {'build':<22}{'tokenized':>10}{'seconds':>10}")
+    with tempfile.TemporaryDirectory() as cache_dir:
+        for label, corpus in (("cold", documents), ("unchanged corpus", documents), ("1% of documents edited", edited)):
+            start = time.perf_counter()
+            _, tokenized = update_token_cache(os.path.join(cache_dir, "token_cache"), "bench", corpus, tokenize)
+            print(f"  {label:<22}{tokenized:>10}{time.perf_counter() - start:>10.2f}")
+
+def main():
+    parser = argparse.ArgumentParser(description="Retrieval kernel micro-benchmarks.")
+    parser.add_argument("names", nargs="*", help="Benchmarks to run (default: all).")
+    parser.add_argument("--list", action="store_true", help="List available benchmarks and exit.")
+    parser.add_argument("--rows", type=int, default=200000, help="Number of corpus vectors.")
+    parser.add_argument("--dim", type=int, default=384, help="Embedding dimension.")
+    parser.add_argument("--queries", type=int, default=50, help="Number of queries for recall.")
+    parser.add_argument("--k", type=int, default=10)
+    parser.add_argument("--repeats", type=int, default=20, help="Timed repetitions per measurement.")
+    parser.add_argument("--residual-bits", type=int, default=2, help="Residual bits per dimension (multivector).")
+    parser.add_argument("--wal-records", type=int, default=2000, help="Inserts logged per configuration (wal_ingest).")
+    parser.add_argument("--writers", type=int, default=8, help="Concurrent writer threads (wal_ingest).")
+    parser.add_argument("--titles", type=int, default=100000, help="Number of synthetic titles (typeahead).")
+    parser.add_argument("--seed", type=int, default=0)
+    args = parser.parse_args()
+
+    if args.list:
+        for name, fn in BENCHMARKS.items():
+            print(f"{name:<16}{(fn.__doc__ or '').strip()}")
+        return
+    unknown = [name for name in args.names if name not in BENCHMARKS]
+    if unknown:
+        raise SystemExit(f"Unknown benchmark(s): {', '.join(unknown)}. Use --list.")
+    for name in args.names or list(BENCHMARKS):
+        BENCHMARKS[name](args)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,41 @@
+import sys
+import os
+import argparse
+
+# Adjust path to import from src
+project_root = os.path.abspath(os.path.join(os.path.dirname(__file__), '..'))
+if project_root not in sys.path:
+    sys.path.insert(0, project_root)
+
+from src.config_loader import AppConfig
+from src.core_components import initialize_hf_embedding_model
+from src.embedding_workers import run_worker
+
+def work(config_path: str, address: str, connect_timeout_s: float):
+    """
+    Embeds chunk batches for an index build running elsewhere (see src.embedding_workers).
+    The model and precision come from the config's index_builder section and must match the coordinator's.
+    """
+    index_config = AppConfig(config_path).get_index_builder_config()
+    embed_model = initialize_hf_embedding_model(
+        model_name=index_config.embedding_model_name, precision=index_config.embedding_precision
+    )
+    address = address or index_config.embedding_workers_address
+    if not address:
+        raise SystemExit("No coordinator address: pass --address or set embedding_workers_address.")
+    print(f"Embedding worker connecting to {address}...")
+    batches = run_worker(
+        address,
+        embed_model.get_text_embedding_batch,
+        model=f"{index_config.embedding_model_name}:{index_config.embedding_precision}",
+        connect_timeout_s=connect_timeout_s
+    )
+    print(f"Done: embedded {batches} batches.")
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Embed chunks for a distributed index build.")
+    parser.add_argument("--config", default="config.yaml", help="Config with the index_builder model settings.")
+    parser.add_argument("--address", default="", help="Coordinator address ('host:port' or 'unix:<path>'); defaults to embedding_workers_address.")
+    parser.add_argument("--connect-timeout", type=float, default=300.0, help="Seconds to keep retrying the connection.")
+    args = parser.parse_args()
+    work(args.config, args.address, args.connect_timeout)
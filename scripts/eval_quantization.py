@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""
+Measures the retrieval impact of int8 embedding inference.
+
+Embeds a sample of the corpus and a set of title queries with the float32 model and with
+the dynamically quantized int8 model, then reports recall@k of the int8 results against the
+float32 results, plus encoding throughput for both.
+
+    python scripts/eval_quantization.py --sample 2000 --queries 200 --k 10
+"""
+import os
+import sys
+import time
+import random
+import argparse
+
+import numpy as np
+
+project_root = os.path.abspath(os.path.join(os.path.dirname(__file__), '..'))
+if project_root not in sys.path:
+    sys.path.insert(0, project_root)
+
+from llama_index.embeddings.huggingface import HuggingFaceEmbedding
+
+from src.config_loader import AppConfig
+from src.core_components import quantize_embedding_model_int8
+from src.document_loader import DocumentLoader
+from src.retrieval_metrics import exact_top_k, recall_at_k
+
+def field_from_text(text: str, field: str) -> str:
+    """Recovers one text field from a Document built by DocumentLoader ("field: value" lines)."""
+    prefix = f"{field}: "
+    for line in text.splitlines():
+        if line.startswith(prefix):
+            return line[len(prefix):]
+    return ""
+
+def embed(model: HuggingFaceEmbedding, texts, batch_size: int, query: bool = False):
+    start = time.perf_counter()
+    if query:
+        vectors = [model.get_query_embedding(t) for t in texts]
+    else:
+        vectors = model.get_text_embedding_batch(texts, show_progress=False)
+    elapsed = time.perf_counter() - start
+    return np.asarray(vectors, dtype=np.float32), elapsed
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare int8 and float32 embedding retrieval recall.")
+    parser.add_argument("--config", default="config.yaml", help="Path to config.yaml.")
+    parser.add_argument("--sample", type=int, default=2000, help="Number of corpus documents to embed.")
+    parser.add_argument("--queries", type=int, default=200, help="Number of title queries.")
+    parser.add_argument("--query-field", default="title", help="Text field used as the query.")
+    parser.add_argument("--k", type=int, default=10, help="Cutoff for recall@k.")
+    parser.add_argument("--batch-size", type=int, default=32)
+    parser.add_argument("--seed", type=int, default=0)
+    args = parser.parse_args()
+
+    cfg = AppConfig(config_path=args.config).get_index_builder_config()
+    documents = DocumentLoader(
+        corpus_path=cfg.corpus_path,
+        text_fields=cfg.corpus_text_fields,
+        metadata_fields=cfg.corpus_metadata_fields,
+        id_field=cfg.corpus_id_field
+    ).load_data()
+    if not documents:
+        raise SystemExit("No documents loaded; check corpus_path.")
+    rng = random.Random(args.seed)
+    documents = rng.sample(documents, min(args.sample, len(documents)))
+    corpus_texts = [doc.get_content() for doc in documents]
+    query_texts = [field_from_text(doc.text, args.query_field) for doc in rng.sample(documents, min(args.queries, len(documents)))]
+    query_texts = [q for q in query_texts if q]
+
+    print(f"Model: {cfg.embedding_model_name}; {len(corpus_texts)} documents, {len(query_texts)} queries, k={args.k}")
+    float_model = HuggingFaceEmbedding(model_name=cfg.embedding_model_name, device="cpu", embed_batch_size=args.batch_size)
+    int8_model = quantize_embedding_model_int8(
+        HuggingFaceEmbedding(model_name=cfg.embedding_model_name, device="cpu", embed_batch_size=args.batch_size)
+    )
+
+    float_corpus, float_corpus_s = embed(float_model, corpus_texts, args.batch_size)
+    int8_corpus, int8_corpus_s = embed(int8_model, corpus_texts, args.batch_size)
+    float_queries, float_query_s = embed(float_model, query_texts, args.batch_size, query=True)
+    int8_queries, int8_query_s = embed(int8_model, query_texts, args.batch_size, query=True)
+
+    truth = exact_top_k(float_queries, float_corpus, args.k)
+    both_int8 = exact_top_k(int8_queries, int8_corpus, args.k)
+    query_int8 = exact_top_k(int8_queries, float_corpus, args.k)
+
+    print("\nThroughput (CPU):")
+    print(f"  corpus float32: {len(corpus_texts) / float_corpus_s:8.1f} docs/s")
+    print(f"  corpus int8:    {len(corpus_texts) / int8_corpus_s:8.1f} docs/s  ({float_corpus_s / int8_corpus_s:.2f}x)")
+    print(f"  query float32:  {1000 * float_query_s / len(query_texts):8.2f} ms/query")
+    print(f"  query int8:     {1000 * int8_query_s / len(query_texts):8.2f} ms/query  ({float_query_s / int8_query_s:.2f}x)")
+    print(f"\nRecall@{args.k} against float32 retrieval:")
+    print(f"  int8 corpus + int8 queries:    {recall_at_k(both_int8.tolist(), truth.tolist(), args.k):.4f}")
+    print(f"  float32 corpus + int8 queries: {recall_at_k(query_int8.tolist(), truth.tolist(), args.k):.4f}")
+    cosine = np.sum(float_corpus * int8_corpus, axis=1) / (
+        np.linalg.norm(float_corpus, axis=1) * np.linalg.norm(int8_corpus, axis=1) + 1e-12
+    )
+    print(f"  mean cosine(float32, int8) of document embeddings: {cosine.mean():.4f}")
+
+if __name__ == "__main__":
+    main()
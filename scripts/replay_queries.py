@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""
+Replays a query log (see src.query_log) against the configured index and reports the
+latency distribution next to the one observed when the log was recorded:
+
+    python scripts/run_chat_demo.py --query-log logs/queries.ndjson
+    python scripts/replay_queries.py logs/queries.ndjson --speed 2 --concurrency 8
+
+Queries are sent in arrival order on the log's schedule (--speed scales it; 0 sends them as fast
+as --concurrency allows), each with its recorded deadline, so two runs over the same log
+offer the same load and can be compared.
+"""
+import os
+import sys
+import json
+import argparse
+
+project_root = os.path.abspath(os.path.join(os.path.dirname(__file__), '..'))
+if project_root not in sys.path:
+    sys.path.insert(0, project_root)
+
+from src.config_loader import AppConfig
+from src.native_query_engine import NativeQueryEngine
+from src.query_log import QueryRecord, latency_summary, read_query_log, replay
+from src.startup import StartupOrchestrator
+
+def format_summary(summary: dict) -> str:
+    return ", ".join(f"{name} {value:.1f}" for name, value in summary.items()) or "n/a"
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay a query log against the configured index.")
+    parser.add_argument("log", help="NDJSON query log written with query_log_path or run_chat_demo.py --query-log.")
+    parser.add_argument("--config", default="config.yaml", help="Config of the index to replay against.")
+    parser.add_argument("--speed", type=float, default=1.0, help="Replay rate relative to the recorded one (0 = as fast as possible).")
+    parser.add_argument("--concurrency", type=int, default=4, help="Queries in flight at once.")
+    parser.add_argument("--limit", type=int, default=0, help="Replay only the first N queries (0 = all).")
+    parser.add_argument("--json", action="store_true", help="Print the report as JSON.")
+    args = parser.parse_args()
+
+    # Lines are written as queries complete; replay and --limit go by arrival time
+    records = sorted(read_query_log(args.log), key=lambda record: record.ts)
+    if args.limit:
+        records = records[:args.limit]
+    if not records:
+        sys.exit(f"No queries in {args.log}.")
+
+    app_config = AppConfig(args.config)
+    query_engine_cfg = app_config.get_query_engine_builder_config()
+    # Replayed queries are not logged again
+    query_engine_cfg.query_log_path = ""
+    query_engine, _ = StartupOrchestrator(app_config.get_index_builder_config(), query_engine_cfg, warmup_query=None).start()
+    # Warm up before the clock starts rather than alongside the first replayed queries
+    query_engine.query(records[0].query)
+
+    def run_query(record: QueryRecord) -> bool:
+        if isinstance(query_engine, NativeQueryEngine):
+            # 0 disables the engine's default deadline, as it was for unbounded logged queries
+            response = query_engine.query(record.query, deadline_ms=record.deadline_ms or 0)
+        else:
+            response = query_engine.query(record.query)
+        return bool((response.metadata or {}).get("partial"))
+
+    span_s = records[-1].ts - records[0].ts
+    print(f"Replaying {len(records)} queries recorded over {span_s:.1f}s at speed {args.speed:g} "
+          f"with concurrency {args.concurrency}...")
+    result = replay(records, run_query, speed=args.speed, concurrency=args.concurrency)
+    report = {
+        "replay": result.summary(),
+        "recorded": {
+            "rejected": sum(record.status == "rejected" for record in records),
+            "partial": sum(record.partial for record in records),
+            "latency_ms": latency_summary([record.latency_ms for record in records if record.status == "ok"]),
+        },
+    }
+    if args.json:
+        print(json.dumps(report, indent=2))
+        return
+    replayed = report["replay"]
+    print(f"Recorded latency (ms): {format_summary(report['recorded']['latency_ms'])}")
+    print(f"Replayed latency (ms): {format_summary(replayed['latency_ms'])}")
+    print(f"Replayed service (ms): {format_summary(replayed['service_ms'])}")
+    print(f"Replayed: {replayed['ok']} ok, {replayed['rejected']} rejected (recorded {report['recorded']['rejected']}), "
+          f"{replayed['partial']} partial (recorded {report['recorded']['partial']}), {replayed['errors']} errors, "
+          f"{replayed['throughput_qps']:.1f} queries/s")
+    for error in result.errors[:5]:
+        print(f"  error: {error}")
+
+if __name__ == "__main__":
+    main()
@@ -1,5 +1,8 @@
 import sys
 import os
+import json
+import time
+import argparse
 
 # Adjust path to import from src
 project_root = os.path.abspath(os.path.join(os.path.dirname(__file__), '..'))
@@ -7,11 +10,16 @@ if project_root not in sys.path:
     sys.path.insert(0, project_root)
 
 from src.config_loader import AppConfig
-from src.index_builder import IndexBuilder
-from src.query_engine_builder import QueryEngineBuilder
+from src.deadlines import QueryRejected
+from src.startup import StartupOrchestrator
 
-def main_chat_loop():
-    """Main loop for the chat demo."""
+def main_chat_loop(explain: bool = False, query_log: str = ""):
+    """
+    Main loop for the chat demo.
+    Args:
+        explain (bool): Print each query's profile (stage timings and search counters) as JSON.
+        query_log (str): Append each query to this log for scripts/replay_queries.py (overrides query_log_path).
+    """
     print("Initializing chat demo...")
     try:
         # 1. Load Configuration
@@ -20,27 +28,27 @@ def main_chat_loop():
         app_config = AppConfig() 
         index_builder_cfg = app_config.get_index_builder_config()
         query_engine_cfg = app_config.get_query_engine_builder_config()
+        if explain:
+            query_engine_cfg.explain = True
+        if query_log:
+            query_engine_cfg.query_log_path = query_log
         print("Configuration loaded.")
 
-        # 2. Initialize IndexBuilder and Load/Build Index
-        print("Initializing IndexBuilder...")
-        idx_builder = IndexBuilder(config=index_builder_cfg)
-        
-        # Try to load the index, or build it if it doesn't exist or force_rebuild is set in config (not typical for demo)
-        # The build() method with force_rebuild=False (default) handles this logic.
+        # 2. Load/Build Index and Build Query Engine
+        # The orchestrator loads the embedding model and the index storage concurrently,
+        # builds the index instead if none exists, and warms up retrieval in the background.
         print("Loading or building index... This might take a while on the first run.")
-        index = idx_builder.build(force_rebuild=False) # force_rebuild=False is default, explicit for clarity
-        print("Index ready.")
-
-        # 3. Initialize QueryEngineBuilder and Build Query Engine
-        print("Initializing QueryEngineBuilder...")
-        engine_builder = QueryEngineBuilder(index=index, config=query_engine_cfg)
-        query_engine = engine_builder.build()
+        orchestrator = StartupOrchestrator(index_builder_cfg, query_engine_cfg)
+        query_engine, startup_report = orchestrator.start()
+        print(f"Time to ready: {startup_report.time_to_ready_s:.2f}s "
+              f"(model {startup_report.model_load_s:.2f}s, storage {startup_report.storage_load_s:.2f}s loaded concurrently)")
         print("Query engine ready.")
         print("--- Chat Demo Started ---")
         print("Type 'quit' or 'exit' to end the session.")
+        if orchestrator.index_builder.title_index is not None:
+            print("Type '/title <partial title>' to look up papers by title.")
 
-        # 4. Chat Loop
+        # 3. Chat Loop
         while True:
             try:
                 query_text = input("\nQ: ")
@@ -49,11 +57,26 @@ def main_chat_loop():
                     break
                 if not query_text.strip():
                     continue
+                if query_text.startswith("/title ") and orchestrator.index_builder.title_index is not None:
+                    start = time.perf_counter()
+                    doc_ids = orchestrator.index_builder.search_titles(query_text[len("/title "):])
+                    print(f"{len(doc_ids)} titles in {(time.perf_counter() - start) * 1000:.2f} ms")
+                    for doc_id in doc_ids:
+                        print(f"  {doc_id}")
+                    continue
 
                 print("Processing query...")
                 response = query_engine.query(query_text)
                 
                 print(f"A: {response.response}")
+                if (response.metadata or {}).get("partial"):
+                    print("  (Partial results: the search deadline was reached.)")
+                for field, counts in ((response.metadata or {}).get("facets") or {}).items():
+                    top = ", ".join(f"{value} ({count})" for value, count in list(counts.items())[:5])
+                    print(f"  {field}: {top}")
+                if (response.metadata or {}).get("profile"):
+                    print("\n  Profile:")
+                    print(json.dumps(response.metadata["profile"], indent=2))
                 
                 if response.source_nodes:
                     print("\n  Sources:")
@@ -75,6 +98,8 @@ def main_chat_loop():
             except KeyboardInterrupt:
                 print("\nExiting chat demo (KeyboardInterrupt).")
                 break
+            except QueryRejected as e:
+                print(f"Query rejected: {e}")
             except Exception as e:
                 print(f"Error during query processing: {e}")
                 print("Please try a different query or restart the demo if issues persist.")
@@ -90,4 +115,8 @@ def main_chat_loop():
         print("Please check your setup and configuration.")
 
 if __name__ == "__main__":
-    main_chat_loop() 
\ No newline at end of file
+    parser = argparse.ArgumentParser(description="Interactive retrieval demo over the configured index.")
+    parser.add_argument("--explain", action="store_true", help="Print per-stage timings and search counters for each query.")
+    parser.add_argument("--query-log", default="", help="Append each query with its latency to this NDJSON log (see scripts/replay_queries.py).")
+    args = parser.parse_args()
+    main_chat_loop(explain=args.explain, query_log=args.query_log) 
\ No newline at end of file
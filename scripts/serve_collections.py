@@ -0,0 +1,55 @@
+import sys
+import os
+import argparse
+
+# Adjust path to import from src
+project_root = os.path.abspath(os.path.join(os.path.dirname(__file__), '..'))
+if project_root not in sys.path:
+    sys.path.insert(0, project_root)
+
+from src.collection_manager import CollectionManager
+from src.config_loader import AppConfig
+from src.deadlines import QueryRejected
+
+def serve(config_path: str):
+    """
+    Interactive loop over every collection in the config's serving section, in one process.
+    Queries go to the current collection; '@<name> <query>' routes one query elsewhere and
+    makes <name> current. Collections load on first use and are evicted LRU under the budget.
+    """
+    app_config = AppConfig(config_path)
+    manager = CollectionManager.from_app_config(app_config)
+    budget = manager.memory_budget_bytes
+    print(f"Collections: {', '.join(manager.names)} (memory budget: {f'{budget / 2**20:.0f} MB' if budget else 'unlimited'})")
+    print("Type '@<collection> <query>' to switch collection, 'quit' or 'exit' to end the session.")
+    current = manager.names[0]
+    while True:
+        try:
+            query_text = input(f"\n[{current}] Q: ").strip()
+            if query_text.lower() in ["quit", "exit"]:
+                break
+            if query_text.startswith("@"):
+                name, _, query_text = query_text[1:].partition(" ")
+                if name not in manager.names:
+                    print(f"Unknown collection '{name}'.")
+                    continue
+                current = name
+            if not query_text:
+                continue
+            response = manager.query(current, query_text)
+            print(f"A: {response.response}")
+            for i, node in enumerate(response.source_nodes or []):
+                print(f"  Source {i+1}: (Score: {node.score:.2f}) {node.get_content()[:100]}...")
+            print(f"  Loaded: {', '.join(manager.loaded())} ({manager.resident_bytes / 2**20:.0f} MB, "
+                  f"{manager.stats.loads} loads, {manager.stats.evictions} evictions)")
+        except (EOFError, KeyboardInterrupt):
+            break
+        except QueryRejected as e:
+            print(f"Query rejected: {e}")
+    print("Exiting.")
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Serve several collections from one process with a shared embedding model.")
+    parser.add_argument("--config", default="config.yaml", help="Config whose serving section lists the collections.")
+    args = parser.parse_args()
+    serve(args.config)
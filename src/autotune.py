@@ -0,0 +1,168 @@
+"""
+Recall-targeted tuning of approximate search parameters.
+
+The multi-vector index trades recall for work through `nprobe` (centroids probed per
+query token) and `candidates` (nodes decompressed and scored exactly). Good values
+depend on corpus size and content, so IndexBuilder tunes them after a build: it takes
+held-out queries (node titles), computes their exact MaxSim top-k with the brute-force
+kernel over every node, and looks for the cheapest setting whose recall@k meets the
+target. Cost is the number of tokens decompressed per query (src.kernels counters),
+which dominates search time and, unlike wall time, is reproducible.
+
+The result is persisted as tuning.json next to the index (and so in the bundle), and
+QueryEngineBuilder uses it in place of the configured nprobe and candidates.
+"""
+import os
+import json
+import time
+from dataclasses import asdict, dataclass, field
+from typing import Any, Dict, List, Optional, Sequence
+
+import numpy as np
+
+from src import kernels
+from src.index_bundle import IndexBundle
+from src.multivector import MultiVectorIndex
+from src.retrieval_metrics import recall_at_k
+
+TUNING_FILENAME = "tuning.json"
+NPROBE_GRID = (1, 2, 4, 8, 16, 32)
+CANDIDATES_GRID = (16, 32, 64, 128, 256, 512, 1024, 2048)
+# Nodes decompressed at a time for the exact ground truth
+EXACT_CHUNK_ROWS = 4096
+
+@dataclass
+class TuningResult:
+    """
+    Attributes:
+        params (Dict[str, int]): Chosen search parameters (nprobe, candidates).
+        recall (float): recall@k of the chosen setting on the tuning queries.
+        cost (float): Mean tokens decompressed per query.
+        latency_ms (float): Mean search time per query (informational).
+        met_target (bool): False if no setting reached target_recall; params then give the best recall seen.
+        trials (List[Dict[str, Any]]): Every setting evaluated, in order.
+    """
+    params: Dict[str, int]
+    recall: float
+    cost: float
+    latency_ms: float
+    target_recall: float
+    k: int
+    num_queries: int
+    met_target: bool
+    trials: List[Dict[str, Any]] = field(default_factory=list)
+
+    def save(self, directory: str):
+        path = os.path.join(directory, TUNING_FILENAME)
+        with open(path + ".tmp", "w", encoding="utf-8") as f:
+            json.dump(asdict(self), f, indent=2)
+        os.replace(path + ".tmp", path)
+
+    @classmethod
+    def load(cls, directory: str) -> Optional["TuningResult"]:
+        path = os.path.join(directory, TUNING_FILENAME)
+        if not os.path.exists(path):
+            return None
+        with open(path, "r", encoding="utf-8") as f:
+            return cls(**json.load(f))
+
+    @classmethod
+    def from_bundle(cls, bundle: IndexBundle) -> Optional["TuningResult"]:
+        return cls(**bundle.read_json(TUNING_FILENAME)) if TUNING_FILENAME in bundle else None
+
+def exact_maxsim_top_k(
+    index: MultiVectorIndex,
+    queries: Sequence[np.ndarray],
+    k: int,
+    chunk_rows: int = EXACT_CHUNK_ROWS
+) -> List[List[int]]:
+    """
+    Ground truth: MaxSim of every node, per query. Nodes are decompressed `chunk_rows` at a
+    time and scored against every query, keeping each query's running top-k, so memory is one
+    chunk of float32 tokens rather than the whole corpus.
+    """
+    queries = [
+        (query / np.maximum(np.linalg.norm(query, axis=-1, keepdims=True), 1e-12)).astype(np.float32)
+        for query in queries
+    ]
+    best = [(np.empty(0, dtype=np.int64), np.empty(0, dtype=np.float32)) for _ in queries]
+    for start in range(0, len(index), chunk_rows):
+        rows = np.arange(start, min(start + chunk_rows, len(index)), dtype=np.int64)
+        tokens, offsets = index.decompress(rows)
+        for i, query in enumerate(queries):
+            chunk_top, chunk_scores = kernels.top_k_indices(kernels.maxsim_scores(query, tokens, offsets), k)
+            merged_rows = np.concatenate([best[i][0], chunk_top + start])
+            merged_scores = np.concatenate([best[i][1], chunk_scores])
+            top, top_scores = kernels.top_k_indices(merged_scores, k)
+            best[i] = merged_rows[top], top_scores
+    return [rows.tolist() for rows, _ in best]
+
+def _evaluate(index: MultiVectorIndex, queries: Sequence[np.ndarray], truth: List[List[int]], k: int, nprobe: int, candidates: int) -> Dict[str, Any]:
+    before = kernels.counters.snapshot()
+    start = time.perf_counter()
+    found = [index.search(query, k, nprobe=nprobe, candidates=candidates)[0].tolist() for query in queries]
+    elapsed = time.perf_counter() - start
+    decoded = kernels.counters.snapshot()["tokens_decoded"] - before["tokens_decoded"]
+    return {
+        "nprobe": nprobe,
+        "candidates": candidates,
+        "recall": recall_at_k(found, truth, k),
+        "cost": decoded / len(queries),
+        "latency_ms": 1000 * elapsed / len(queries),
+    }
+
+def autotune_multivector(
+    index: MultiVectorIndex,
+    queries: Sequence[np.ndarray],
+    k: int = 10,
+    target_recall: float = 0.95,
+    nprobe_grid: Sequence[int] = NPROBE_GRID,
+    candidates_grid: Sequence[int] = CANDIDATES_GRID
+) -> TuningResult:
+    """
+    Finds the cheapest (nprobe, candidates) meeting `target_recall` at `k`.
+
+    For each nprobe, candidates grows until the target is met (more candidates only add
+    cost), stopping early once it covers every node or costs more than the best setting so far.
+    Ties in cost go to the smaller nprobe, which has less candidate-generation work.
+
+    Args:
+        index (MultiVectorIndex): Index to tune.
+        queries (Sequence[np.ndarray]): Held-out (Q_i, D) query token embeddings.
+        k (int): Cutoff for recall.
+        target_recall (float): Required recall@k against exact MaxSim.
+    """
+    if not queries:
+        raise ValueError("Autotuning needs at least one query.")
+    if not nprobe_grid:
+        raise ValueError("Autotuning needs at least one nprobe value.")
+    # Fewer candidates than k cannot return k results; when no grid value covers k, try k itself
+    candidate_values = sorted(c for c in candidates_grid if c >= k) or [k]
+    truth = exact_maxsim_top_k(index, queries, k)
+    trials: List[Dict[str, Any]] = []
+    best: Optional[Dict[str, Any]] = None
+    for nprobe in sorted(set(min(n, len(index.centroids)) for n in nprobe_grid)):
+        for candidates in candidate_values:
+            trial = _evaluate(index, queries, truth, k, nprobe, candidates)
+            trials.append(trial)
+            if best is not None and best["recall"] >= target_recall and trial["cost"] >= best["cost"]:
+                break
+            if trial["recall"] >= target_recall:
+                if best is None or best["recall"] < target_recall or trial["cost"] < best["cost"]:
+                    best = trial
+                break
+            if best is None or (best["recall"] < target_recall and trial["recall"] > best["recall"]):
+                best = trial
+            if candidates >= len(index):
+                break
+    return TuningResult(
+        params={"nprobe": best["nprobe"], "candidates": best["candidates"]},
+        recall=best["recall"],
+        cost=best["cost"],
+        latency_ms=best["latency_ms"],
+        target_recall=target_recall,
+        k=k,
+        num_queries=len(queries),
+        met_target=best["recall"] >= target_recall,
+        trials=trials
+    )
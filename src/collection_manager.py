@@ -0,0 +1,218 @@
+import os
+import time
+import threading
+from collections import OrderedDict
+from contextlib import contextmanager
+from dataclasses import dataclass, field
+from typing import Any, Callable, Dict, Iterator, List, Optional, Tuple
+
+from llama_index.core.base.base_query_engine import BaseQueryEngine
+
+from src.config_loader import AppConfig, IndexBuilderConfig, QueryEngineBuilderConfig
+from src.index_builder import IndexBuilder
+from src.query_engine_builder import QueryEngineBuilder
+
+@dataclass
+class LoadedCollection:
+    """A collection's serving state while it is resident."""
+    query_engine: BaseQueryEngine
+    nbytes: int
+    index_builder: Optional[IndexBuilder] = None
+    load_s: float = 0.0
+
+    def replaced(self) -> bool:
+        """True when the collection's index was rebuilt on disk after this copy was loaded."""
+        return self.index_builder is not None and self.index_builder.bundle_replaced()
+
+@dataclass
+class CollectionStats:
+    """Counters of one CollectionManager, for logs and tests."""
+    loads: int = 0
+    evictions: int = 0
+    hits: int = 0
+    load_s: float = 0.0
+    evicted: List[str] = field(default_factory=list)
+    reloads: int = 0
+
+def storage_footprint(index_builder_config: IndexBuilderConfig) -> int:
+    """
+    Estimated resident size of a collection: its bundle, or the files at the top level of
+    storage_dir when there is no bundle. Flat and multi-vector stores are memory-mapped, so
+    this is an upper bound for them; JSON stores (the "simple" vector store, the docstore)
+    are parsed into Python objects and take more.
+    """
+    storage_dir = index_builder_config.storage_dir
+    bundle_path = os.path.join(storage_dir, index_builder_config.bundle_filename)
+    if os.path.exists(bundle_path):
+        return os.path.getsize(bundle_path)
+    if not os.path.isdir(storage_dir):
+        return 0
+    return sum(entry.stat().st_size for entry in os.scandir(storage_dir) if entry.is_file())
+
+def load_collection(index_builder_config: IndexBuilderConfig, query_engine_config: QueryEngineBuilderConfig) -> LoadedCollection:
+    """
+    Loads a persisted index and builds its query engine. The embedding model comes from the
+    process-wide cache in src.core_components, so collections using the same model share one instance.
+    """
+    index_builder = IndexBuilder(config=index_builder_config)
+    if not index_builder.index_exists():
+        raise FileNotFoundError(f"No index persisted in {index_builder_config.storage_dir}; build it first (scripts/build_index.py).")
+    index = index_builder.load()
+    query_engine = QueryEngineBuilder(
+        index=index, config=query_engine_config, multivector_index=index_builder.multivector_index,
+        tuning=index_builder.tuning, metadata_columns=index_builder.metadata_columns,
+        segments=index_builder.live_segments
+    ).build()
+    return LoadedCollection(query_engine=query_engine, nbytes=storage_footprint(index_builder_config), index_builder=index_builder)
+
+class _Entry:
+    def __init__(self, configs: Tuple[IndexBuilderConfig, QueryEngineBuilderConfig]):
+        self.configs = configs
+        self.loaded: Optional[LoadedCollection] = None
+        self.pins = 0
+
+class CollectionManager:
+    """
+    Serves several named indexes (collections) from one process.
+
+    Each collection has its own index and query settings (usually its own config.yaml and
+    storage_dir). Collections are loaded on first use and kept in least-recently-used order;
+    when the estimated resident size (see storage_footprint) of the loaded collections would
+    exceed `memory_budget_bytes`, the least recently used ones not serving a query are
+    evicted. A collection that is evicted is reloaded on its next query.
+
+    Loads are serialized (they set the global LlamaIndex embedding model while they run);
+    queries to collections that are already loaded do not wait for them.
+
+    When a collection's index is rebuilt on disk (a new generation, see src.shared_segments),
+    the next query that finds the collection idle unloads the old generation and loads the new
+    one. Queries already running finish on the old generation.
+
+    Args:
+        collections (Dict[str, Tuple[IndexBuilderConfig, QueryEngineBuilderConfig]]): Settings per collection name.
+        memory_budget_bytes (int): Budget for loaded collections; 0 = unlimited.
+        loader (Callable): Loads one collection from its settings; defaults to load_collection.
+    """
+    def __init__(
+        self,
+        collections: Dict[str, Tuple[IndexBuilderConfig, QueryEngineBuilderConfig]],
+        memory_budget_bytes: int = 0,
+        loader: Callable[[IndexBuilderConfig, QueryEngineBuilderConfig], LoadedCollection] = load_collection
+    ):
+        if not collections:
+            raise ValueError("CollectionManager needs at least one collection.")
+        self.memory_budget_bytes = memory_budget_bytes
+        self.loader = loader
+        self.stats = CollectionStats()
+        self._entries = {name: _Entry(configs) for name, configs in collections.items()}
+        # Loaded collection names, least recently used first
+        self._lru: "OrderedDict[str, None]" = OrderedDict()
+        self._lock = threading.Lock()
+        self._load_lock = threading.Lock()
+
+    @classmethod
+    def from_app_config(cls, app_config: AppConfig, **kwargs: Any) -> "CollectionManager":
+        """Collections and budget from the config's serving section (see AppConfig.get_serving_config)."""
+        serving = app_config.get_serving_config()
+        collections = {}
+        for name, config_path in serving.collections.items():
+            collection_config = app_config if config_path is None else AppConfig(config_path)
+            collections[name] = (collection_config.get_index_builder_config(), collection_config.get_query_engine_builder_config())
+        return cls(collections, memory_budget_bytes=int(serving.memory_budget_mb * 2**20), **kwargs)
+
+    @property
+    def names(self) -> List[str]:
+        return list(self._entries)
+
+    def loaded(self) -> List[str]:
+        """Resident collections, least recently used first."""
+        with self._lock:
+            return list(self._lru)
+
+    @property
+    def resident_bytes(self) -> int:
+        with self._lock:
+            return sum(self._entries[name].loaded.nbytes for name in self._lru)
+
+    @contextmanager
+    def acquire(self, name: str) -> Iterator[LoadedCollection]:
+        """Loads `name` if needed and keeps it from being evicted until the block exits."""
+        entry = self._entries.get(name)
+        if entry is None:
+            raise KeyError(f"Unknown collection '{name}'. Known collections: {', '.join(self._entries)}.")
+        with self._lock:
+            if entry.loaded is not None and not entry.pins and entry.loaded.replaced():
+                self._unload(name, entry)
+                self.stats.reloads += 1
+            resident = entry.loaded is not None
+            if resident:
+                entry.pins += 1
+                self._lru.move_to_end(name)
+                self.stats.hits += 1
+        if not resident:
+            self._load(name, entry)
+        try:
+            yield entry.loaded
+        finally:
+            with self._lock:
+                entry.pins -= 1
+                self._evict_over_budget(0)
+
+    def query(self, name: str, query_text: str, **kwargs: Any) -> Any:
+        """Routes a query to collection `name`."""
+        with self.acquire(name) as collection:
+            return collection.query_engine.query(query_text, **kwargs)
+
+    def evict(self, name: str) -> bool:
+        """Unloads `name` now unless it is serving a query. Returns whether it was unloaded."""
+        with self._lock:
+            entry = self._entries[name]
+            if entry.loaded is None or entry.pins:
+                return False
+            self._unload(name, entry)
+            return True
+
+    def _load(self, name: str, entry: _Entry):
+        with self._load_lock:
+            with self._lock:
+                if entry.loaded is not None:
+                    # Loaded by another thread while this one waited
+                    entry.pins += 1
+                    self._lru.move_to_end(name)
+                    self.stats.hits += 1
+                    return
+                # Make room first, from the on-disk estimate
+                self._evict_over_budget(storage_footprint(entry.configs[0]))
+            start = time.perf_counter()
+            loaded = self.loader(*entry.configs)
+            loaded.load_s = time.perf_counter() - start
+            with self._lock:
+                entry.loaded = loaded
+                entry.pins += 1
+                self._lru[name] = None
+                self.stats.loads += 1
+                self.stats.load_s += loaded.load_s
+                self._evict_over_budget(0)
+        print(f"Collection '{name}' loaded in {loaded.load_s:.2f}s ({loaded.nbytes / 2**20:.1f} MB).")
+
+    def _evict_over_budget(self, incoming_bytes: int):
+        # Caller holds self._lock. Pinned collections are skipped; if only those remain,
+        # the budget is exceeded until they are released.
+        if not self.memory_budget_bytes:
+            return
+        resident = sum(self._entries[name].loaded.nbytes for name in self._lru)
+        for name in list(self._lru):
+            if resident + incoming_bytes <= self.memory_budget_bytes:
+                break
+            entry = self._entries[name]
+            if entry.pins:
+                continue
+            resident -= entry.loaded.nbytes
+            self._unload(name, entry)
+
+    def _unload(self, name: str, entry: _Entry):
+        # Dropping the last references unmaps the collection's stores.
+        entry.loaded = None
+        del self._lru[name]
+        self.stats.evictions += 1
+        self.stats.evicted.append(name)
@@ -18,9 +18,39 @@ class IndexBuilderConfig:
     corpus_metadata_fields: List[str]
     chunk_size: int
     chunk_overlap: int
+    corpus_partition_values: List[str] = field(default_factory=list)
     docstore_filename: str = "docstore.json"
     vector_store_filename: str = "vector_store.json"
     index_store_filename: str = "index_store.json"
+    bundle_filename: str = "index.bundle"
+    embedding_precision: str = "float32"
+    vector_store_type: str = "simple"
+    vector_store_dtype: str = "float32"
+    build_memory_mb: int = 0
+    build_batch_documents: int = 1000
+    locality_order: str = ""
+    locality_order_fields: List[str] = field(default_factory=lambda: ["year", "booktitle"])
+    locality_clusters: int = 0
+    multivector_enabled: bool = False
+    multivector_residual_bits: int = 2
+    multivector_num_centroids: int = 0
+    metadata_column_fields: List[str] = field(default_factory=list)
+    autotune_enabled: bool = False
+    autotune_target_recall: float = 0.95
+    autotune_queries: int = 100
+    autotune_k: int = 10
+    wal_enabled: bool = False
+    wal_sync: str = "group"
+    wal_group_commit_ms: float = 2.0
+    wal_checkpoint_records: int = 10000
+    title_index_enabled: bool = False
+    title_index_field: str = "title"
+    docstore_segment_enabled: bool = False
+    token_cache_enabled: bool = False
+    embedding_workers_address: str = ""
+    embedding_workers_batch_size: int = 64
+    embedding_workers_lease_s: float = 300
+    embedding_workers_timeout_s: float = 0
 
 @dataclass
 class QueryEngineBuilderConfig:
@@ -29,6 +59,36 @@ class QueryEngineBuilderConfig:
     chunk_size: int
     chunk_overlap: int
     similarity_top_k: int = 3
+    embedding_precision: str = "float32"
+    retrieval_mode: str = "vector"
+    multivector_nprobe: int = 4
+    multivector_candidates: int = 256
+    query_deadline_ms: float = 0
+    max_concurrent_queries: int = 4
+    native_pool_threads: int = 0
+    explain: bool = False
+    query_log_path: str = ""
+    facet_fields: List[str] = field(default_factory=list)
+    facet_candidates: int = 1000
+    facet_min_score: float = 0
+    prf_top_m: int = 0
+    prf_alpha: float = 1.0
+    prf_beta: float = 0.75
+    prf_candidates: int = 100
+    prf_max_query_words: int = 3
+    rerank_model: str = ""
+    rerank_precision: str = "float32"
+    rerank_candidates: int = 20
+    rerank_batch_size: int = 16
+    rerank_budget_ms: float = 0
+    rerank_max_length: int = 256
+
+@dataclass
+class ServingConfig:
+    """Collections served by one process (see src.collection_manager)."""
+    # Collection name -> config file (None: the config that declares them)
+    collections: Dict[str, Optional[str]] = field(default_factory=dict)
+    memory_budget_mb: float = 0
 
 @dataclass
 class RetrieverConfig:
@@ -57,6 +117,7 @@ class AppConfig:
         self.query_engine_builder_settings: Dict[str, Any] = raw_yaml_config.get("query_engine_builder", {})
         self.retriever_settings: Dict[str, Any] = raw_yaml_config.get("retriever", {})
         self.llm_settings: Dict[str, Any] = raw_yaml_config.get("llm", {})
+        self.serving_settings: Dict[str, Any] = raw_yaml_config.get("serving", {}) or {}
 
         # Validate essential LLM configurations if LLM section exists
         if self.llm_settings:
@@ -95,6 +156,23 @@ class AppConfig:
         """Return the config value for `key` from a section if present, else `default`."""
         return section.get(key, default)
 
+    def _optional_bool_from_section(self, section: Dict[str, Any], key: str, default: bool = False) -> bool:
+        """
+        Return a boolean flag from a section if present, else `default`. Accepts true/false and 1/0
+        (as YAML booleans, integers or strings, e.g. from an environment override) and raises on
+        anything else, so that a quoted "false" does not switch a feature on.
+        """
+        value = section.get(key)
+        if value is None:
+            return default
+        if isinstance(value, str):
+            value = value.strip().lower()
+        if value in (True, 1, "true", "1"):
+            return True
+        if value in (False, 0, "false", "0"):
+            return False
+        raise ValueError(f"Config value '{key}' must be true or false, got {value!r} in {self.config_path}.")
+
     def get_llm_config(self) -> Optional[Dict[str, Any]]:
         """Returns a dictionary with LLM related configurations if LLM is configured."""
         if not self.model_name or not self.openrouter_api_key:
@@ -122,9 +200,39 @@ class AppConfig:
             corpus_metadata_fields=self._require_from_section(cfg, "corpus_metadata_fields", section_name),
             chunk_size=int(self._require_from_section(cfg, "chunk_size", section_name)),
             chunk_overlap=int(self._require_from_section(cfg, "chunk_overlap", section_name)),
+            corpus_partition_values=[str(v) for v in self._optional_from_section(cfg, "corpus_partition_values", []) or []],
             docstore_filename=self._optional_from_section(cfg, "docstore_filename", "docstore.json"),
             vector_store_filename=self._optional_from_section(cfg, "vector_store_filename", "vector_store.json"),
-            index_store_filename=self._optional_from_section(cfg, "index_store_filename", "index_store.json")
+            index_store_filename=self._optional_from_section(cfg, "index_store_filename", "index_store.json"),
+            bundle_filename=self._optional_from_section(cfg, "bundle_filename", "index.bundle"),
+            embedding_precision=self._optional_from_section(cfg, "embedding_precision", "float32"),
+            vector_store_type=self._optional_from_section(cfg, "vector_store_type", "simple"),
+            vector_store_dtype=self._optional_from_section(cfg, "vector_store_dtype", "float32"),
+            build_memory_mb=int(self._optional_from_section(cfg, "build_memory_mb", 0)),
+            build_batch_documents=int(self._optional_from_section(cfg, "build_batch_documents", 1000)),
+            locality_order=self._optional_from_section(cfg, "locality_order", "") or "",
+            locality_order_fields=list(self._optional_from_section(cfg, "locality_order_fields", ["year", "booktitle"]) or []),
+            locality_clusters=int(self._optional_from_section(cfg, "locality_clusters", 0)),
+            multivector_enabled=self._optional_bool_from_section(cfg, "multivector_enabled", False),
+            multivector_residual_bits=int(self._optional_from_section(cfg, "multivector_residual_bits", 2)),
+            multivector_num_centroids=int(self._optional_from_section(cfg, "multivector_num_centroids", 0)),
+            metadata_column_fields=list(self._optional_from_section(cfg, "metadata_column_fields", []) or []),
+            autotune_enabled=self._optional_bool_from_section(cfg, "autotune_enabled", False),
+            autotune_target_recall=float(self._optional_from_section(cfg, "autotune_target_recall", 0.95)),
+            autotune_queries=int(self._optional_from_section(cfg, "autotune_queries", 100)),
+            autotune_k=int(self._optional_from_section(cfg, "autotune_k", 10)),
+            wal_enabled=self._optional_bool_from_section(cfg, "wal_enabled", False),
+            wal_sync=self._optional_from_section(cfg, "wal_sync", "group"),
+            wal_group_commit_ms=float(self._optional_from_section(cfg, "wal_group_commit_ms", 2.0)),
+            wal_checkpoint_records=int(self._optional_from_section(cfg, "wal_checkpoint_records", 10000)),
+            title_index_enabled=self._optional_bool_from_section(cfg, "title_index_enabled", False),
+            title_index_field=self._optional_from_section(cfg, "title_index_field", "title"),
+            docstore_segment_enabled=self._optional_bool_from_section(cfg, "docstore_segment_enabled", False),
+            token_cache_enabled=self._optional_bool_from_section(cfg, "token_cache_enabled", False),
+            embedding_workers_address=self._optional_from_section(cfg, "embedding_workers_address", "") or "",
+            embedding_workers_batch_size=int(self._optional_from_section(cfg, "embedding_workers_batch_size", 64)),
+            embedding_workers_lease_s=float(self._optional_from_section(cfg, "embedding_workers_lease_s", 300)),
+            embedding_workers_timeout_s=float(self._optional_from_section(cfg, "embedding_workers_timeout_s", 0))
         )
 
     def get_query_engine_builder_config(self) -> QueryEngineBuilderConfig:
@@ -137,9 +245,50 @@ class AppConfig:
             embedding_model_name=self._require_from_section(cfg, "embedding_model_name", section_name),
             chunk_size=int(self._require_from_section(cfg, "chunk_size", section_name)),
             chunk_overlap=int(self._require_from_section(cfg, "chunk_overlap", section_name)),
-            similarity_top_k=int(self._require_from_section(cfg, "similarity_top_k", section_name))
+            similarity_top_k=int(self._require_from_section(cfg, "similarity_top_k", section_name)),
+            embedding_precision=self._optional_from_section(cfg, "embedding_precision", "float32"),
+            retrieval_mode=self._optional_from_section(cfg, "retrieval_mode", "vector"),
+            multivector_nprobe=int(self._optional_from_section(cfg, "multivector_nprobe", 4)),
+            multivector_candidates=int(self._optional_from_section(cfg, "multivector_candidates", 256)),
+            query_deadline_ms=float(self._optional_from_section(cfg, "query_deadline_ms", 0)),
+            max_concurrent_queries=int(self._optional_from_section(cfg, "max_concurrent_queries", 4)),
+            native_pool_threads=int(self._optional_from_section(cfg, "native_pool_threads", 0)),
+            explain=self._optional_bool_from_section(cfg, "explain", False),
+            query_log_path=self._optional_from_section(cfg, "query_log_path", "") or "",
+            facet_fields=list(self._optional_from_section(cfg, "facet_fields", []) or []),
+            facet_candidates=int(self._optional_from_section(cfg, "facet_candidates", 1000)),
+            facet_min_score=float(self._optional_from_section(cfg, "facet_min_score", 0)),
+            prf_top_m=int(self._optional_from_section(cfg, "prf_top_m", 0)),
+            prf_alpha=float(self._optional_from_section(cfg, "prf_alpha", 1.0)),
+            prf_beta=float(self._optional_from_section(cfg, "prf_beta", 0.75)),
+            prf_candidates=int(self._optional_from_section(cfg, "prf_candidates", 100)),
+            prf_max_query_words=int(self._optional_from_section(cfg, "prf_max_query_words", 3)),
+            rerank_model=self._optional_from_section(cfg, "rerank_model", "") or "",
+            rerank_precision=self._optional_from_section(cfg, "rerank_precision", "float32"),
+            rerank_candidates=int(self._optional_from_section(cfg, "rerank_candidates", 20)),
+            rerank_batch_size=int(self._optional_from_section(cfg, "rerank_batch_size", 16)),
+            rerank_budget_ms=float(self._optional_from_section(cfg, "rerank_budget_ms", 0)),
+            rerank_max_length=int(self._optional_from_section(cfg, "rerank_max_length", 256))
         )
     
+    def get_serving_config(self) -> ServingConfig:
+        """
+        Returns a ServingConfig object. Collection config paths are relative to this config file;
+        with no collections listed, this config is served alone as "default".
+        """
+        cfg = self.serving_settings
+        base_dir = os.path.dirname(os.path.abspath(self.config_path))
+        collections: Dict[str, Optional[str]] = {}
+        for name, path in (self._optional_from_section(cfg, "collections", {}) or {}).items():
+            if path is None or os.path.abspath(os.path.join(base_dir, path)) == os.path.abspath(self.config_path):
+                collections[str(name)] = None
+            else:
+                collections[str(name)] = os.path.join(base_dir, path)
+        return ServingConfig(
+            collections=collections or {"default": None},
+            memory_budget_mb=float(self._optional_from_section(cfg, "memory_budget_mb", 0))
+        )
+
     def get_retriever_config(self) -> RetrieverConfig:
         """Returns a RetrieverConfig object."""
         cfg = self.retriever_settings
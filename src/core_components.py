@@ -1,28 +1,125 @@
+import threading
+import numpy as np
 import torch
 from llama_index.core import Settings
 from llama_index.embeddings.huggingface import HuggingFaceEmbedding
-from typing import Optional
+from typing import Optional, Dict, List, Tuple
 
 # Default embedding model name
 DEFAULT_EMBED_MODEL_NAME = "sentence-transformers/all-MiniLM-L6-v2"
 
-def initialize_hf_embedding_model(model_name: Optional[str] = None) -> HuggingFaceEmbedding:
+# Supported values for the `embedding_precision` config setting
+EMBEDDING_PRECISIONS = ("float32", "int8")
+
+# Process-wide cache of loaded models keyed by (model_name, device, precision). The lock makes
+# concurrent callers (e.g. startup threads) wait for a single load instead of racing.
+_embed_model_cache: Dict[Tuple[str, str, str], HuggingFaceEmbedding] = {}
+_embed_model_lock = threading.Lock()
+
+def select_quantized_engine() -> str:
+    """
+    Pick the int8 kernel backend for this CPU. "x86"/"fbgemm" dispatch to AVX512-VNNI or
+    AVX2 GEMM kernels at runtime and fall back to reference kernels otherwise;
+    "qnnpack" covers ARM hosts.
+    """
+    supported = torch.backends.quantized.supported_engines
+    for engine in ("x86", "fbgemm", "qnnpack"):
+        if engine in supported:
+            return engine
+    raise RuntimeError(f"No int8 quantized engine available in this torch build (supported: {supported}).")
+
+def quantize_embedding_model_int8(embed_model: HuggingFaceEmbedding) -> HuggingFaceEmbedding:
+    """
+    Replace every nn.Linear in the encoder with a dynamically quantized int8 version, in place.
+    Weights are quantized once per output channel; activations are quantized per batch at runtime.
+    """
+    torch.backends.quantized.engine = select_quantized_engine()
+    qconfig_spec = {torch.nn.Linear: torch.ao.quantization.per_channel_dynamic_qconfig}
+    embed_model._model = torch.ao.quantization.quantize_dynamic(
+        embed_model._model, qconfig_spec=qconfig_spec, dtype=torch.qint8
+    )
+    return embed_model
+
+def initialize_hf_embedding_model(model_name: Optional[str] = None, precision: str = "float32") -> HuggingFaceEmbedding:
     """
     Initialize and set the global embedding model for LlamaIndex.
+    Each (model, device, precision) combination is loaded at most once per process; later calls reuse it.
+
+    Args:
+        model_name (Optional[str]): Hugging Face model name. Defaults to DEFAULT_EMBED_MODEL_NAME.
+        precision (str): "float32", or "int8" for dynamically quantized CPU inference.
     """
     if model_name is None:
         model_name = DEFAULT_EMBED_MODEL_NAME
+    if precision not in EMBEDDING_PRECISIONS:
+        raise ValueError(f"Unsupported embedding precision '{precision}'. Expected one of {EMBEDDING_PRECISIONS}.")
 
-    # Determine the device to use
-    device = "cuda" if torch.cuda.is_available() else "cpu"
-
-    # Check against global Settings
-    if Settings.embed_model is not None and getattr(Settings.embed_model, 'model_name', None) == model_name and getattr(Settings.embed_model, 'device', None) == device:
-        print(f"Embedding model {model_name} is already initialized and set on {device}.")
-        return Settings.embed_model
+    # Determine the device to use; int8 dynamic quantization only runs on CPU
+    device = "cuda" if torch.cuda.is_available() and precision == "float32" else "cpu"
 
-    print(f"Initializing embedding model: {model_name} on {device}")
-    embed_model = HuggingFaceEmbedding(model_name=model_name, device=device)
-    Settings.embed_model = embed_model
+    with _embed_model_lock:
+        embed_model = _embed_model_cache.get((model_name, device, precision))
+        if embed_model is not None:
+            print(f"Embedding model {model_name} ({precision}) is already initialized on {device}.")
+        else:
+            print(f"Initializing embedding model: {model_name} ({precision}) on {device}")
+            embed_model = HuggingFaceEmbedding(model_name=model_name, device=device)
+            if precision == "int8":
+                quantize_embedding_model_int8(embed_model)
+                print(f"Quantized {model_name} to int8 using the '{torch.backends.quantized.engine}' engine.")
+            _embed_model_cache[(model_name, device, precision)] = embed_model
+        Settings.embed_model = embed_model
     print(f"Successfully set {model_name} as the global LlamaIndex embedding model (using {device}).")
-    return embed_model 
\ No newline at end of file
+    return embed_model
+
+def token_embeddings(embed_model: HuggingFaceEmbedding, texts: List[str], batch_size: int = 32) -> List[np.ndarray]:
+    """
+    Per-token output embeddings of the encoder (before pooling), one (tokens, D) float32 array
+    per text, padding excluded. Used by the multi-vector index (src.multivector).
+    """
+    outputs = embed_model._model.encode(
+        texts, batch_size=batch_size, output_value="token_embeddings", show_progress_bar=False
+    )
+    return [np.asarray(out.float().cpu().numpy() if isinstance(out, torch.Tensor) else out, dtype=np.float32) for out in outputs]
+
+def tokenize_with_offsets(embed_model: HuggingFaceEmbedding, texts: List[str]) -> List[Tuple[np.ndarray, np.ndarray]]:
+    """
+    The encoder tokenizer's ids for each text, without special tokens or truncation, and the
+    character offset where each token starts. Used by the token cache (src.token_cache).
+    """
+    encoded = embed_model._model.tokenizer(
+        texts, add_special_tokens=False, return_offsets_mapping=True, truncation=False, verbose=False
+    )
+    return [
+        (np.asarray(ids, dtype=np.uint32), np.asarray([start for start, _ in offsets], dtype=np.uint32))
+        for ids, offsets in zip(encoded["input_ids"], encoded["offset_mapping"])
+    ]
+
+def embed_token_ids(embed_model: HuggingFaceEmbedding, sequences: List[np.ndarray], batch_size: int = 32) -> List[List[float]]:
+    """
+    Pooled embeddings computed from already tokenized inputs (ids without special tokens), as
+    get_text_embedding_batch would compute them from the texts: the ids are framed with the
+    special tokens, truncated to the encoder's max_seq_length, and batched by length.
+    """
+    model = embed_model._model
+    tokenizer = model.tokenizer
+    limit = (model.max_seq_length or tokenizer.model_max_length) - 2
+    pad_id = tokenizer.pad_token_id or 0
+    embeddings: List[Optional[List[float]]] = [None] * len(sequences)
+    order = sorted(range(len(sequences)), key=lambda i: len(sequences[i]))
+    with torch.inference_mode():
+        for start in range(0, len(order), batch_size):
+            batch = order[start:start + batch_size]
+            rows = [[tokenizer.cls_token_id, *np.asarray(sequences[i][:limit]).tolist(), tokenizer.sep_token_id] for i in batch]
+            width = max(len(row) for row in rows)
+            input_ids = torch.tensor([row + [pad_id] * (width - len(row)) for row in rows], dtype=torch.long, device=model.device)
+            attention_mask = torch.tensor([[1] * len(row) + [0] * (width - len(row)) for row in rows], dtype=torch.long, device=model.device)
+            features = {"input_ids": input_ids, "attention_mask": attention_mask}
+            if "token_type_ids" in tokenizer.model_input_names:
+                features["token_type_ids"] = torch.zeros_like(input_ids)
+            pooled = model(features)["sentence_embedding"]
+            if embed_model.normalize:
+                pooled = torch.nn.functional.normalize(pooled, p=2, dim=1)
+            for i, vector in zip(batch, pooled.float().cpu().numpy()):
+                embeddings[i] = vector.tolist()
+    return embeddings
@@ -0,0 +1,166 @@
+import time
+import asyncio
+import threading
+from contextlib import asynccontextmanager, contextmanager
+from typing import AsyncIterator, Iterator, List, Optional, Tuple
+
+class QueryRejected(RuntimeError):
+    """Raised by admission control when a query cannot finish before its deadline."""
+
+class Deadline:
+    """
+    Absolute time budget of one query, on the time.monotonic() clock.
+
+    Search stages poll expired() between units of work (scan blocks, candidate chunks)
+    and call mark_partial() when they stop early with a best-so-far result, so the
+    caller can flag the response as partial.
+
+    Args:
+        expires_at (float): time.monotonic() value at which the budget runs out.
+    """
+    def __init__(self, expires_at: float):
+        self.expires_at = expires_at
+        self.partial_stages: List[str] = []
+
+    @classmethod
+    def after_ms(cls, milliseconds: float) -> "Deadline":
+        return cls(time.monotonic() + milliseconds / 1000.0)
+
+    def remaining_s(self) -> float:
+        return self.expires_at - time.monotonic()
+
+    def expired(self) -> bool:
+        return time.monotonic() >= self.expires_at
+
+    def mark_partial(self, stage: str):
+        """Records that `stage` stopped early because the deadline passed."""
+        if stage not in self.partial_stages:
+            self.partial_stages.append(stage)
+
+    @property
+    def partial(self) -> bool:
+        return bool(self.partial_stages)
+
+class AdmissionController:
+    """
+    Bounds the number of queries executing at once and turns away queries that would
+    miss their deadline anyway.
+
+    Service time is tracked as an exponentially weighted moving average. A query is
+    rejected up front when the estimated wait for a slot plus one service time exceeds
+    its remaining budget, and while queued if its deadline passes before a slot frees up.
+    Queries without a deadline are never rejected.
+
+    Args:
+        max_concurrent (int): Queries allowed to execute at once.
+        initial_service_ms (float): Service-time estimate before any query has completed.
+        smoothing (float): Weight of the newest observation in the moving average.
+    """
+    def __init__(self, max_concurrent: int = 4, initial_service_ms: float = 50.0, smoothing: float = 0.2):
+        if max_concurrent < 1:
+            raise ValueError("max_concurrent must be at least 1.")
+        self.max_concurrent = max_concurrent
+        self.smoothing = smoothing
+        self.service_s = initial_service_ms / 1000.0
+        self.admitted = 0
+        self.rejected = 0
+        self._running = 0
+        self._waiting = 0
+        self._cond = threading.Condition()
+        self._async_waiters: List[Tuple[asyncio.AbstractEventLoop, "asyncio.Future[None]"]] = []
+
+    def estimated_latency_s(self) -> float:
+        """Expected time until a query submitted now would complete."""
+        with self._cond:
+            return self._estimate_locked()
+
+    def _estimate_locked(self) -> float:
+        queued_ahead = self._running + self._waiting
+        waves = queued_ahead // self.max_concurrent
+        return (waves + 1) * self.service_s
+
+    def _reject_locked(self, reason: str):
+        self.rejected += 1
+        raise QueryRejected(reason)
+
+    @contextmanager
+    def admit(self, deadline: Optional[Deadline] = None) -> Iterator[None]:
+        """
+        Holds an execution slot for the duration of the block.
+        Raises QueryRejected if the query cannot meet `deadline`.
+        """
+        with self._cond:
+            self._check_budget_locked(deadline)
+            self._waiting += 1
+            try:
+                while self._running >= self.max_concurrent:
+                    timeout = deadline.remaining_s() if deadline is not None else None
+                    if timeout is not None and timeout <= 0:
+                        self._reject_locked("Deadline passed while waiting for an execution slot.")
+                    self._cond.wait(timeout)
+            finally:
+                self._waiting -= 1
+            self._running += 1
+            self.admitted += 1
+        start = time.monotonic()
+        try:
+            yield
+        finally:
+            self._release(time.monotonic() - start)
+
+    @asynccontextmanager
+    async def aadmit(self, deadline: Optional[Deadline] = None) -> AsyncIterator[None]:
+        """
+        admit() for coroutines: waits for a slot without blocking the event loop. Sync and
+        async callers share the same slots.
+        """
+        loop = asyncio.get_running_loop()
+        with self._cond:
+            self._check_budget_locked(deadline)
+            self._waiting += 1
+        try:
+            while True:
+                with self._cond:
+                    if self._running < self.max_concurrent:
+                        self._running += 1
+                        self.admitted += 1
+                        break
+                    timeout = deadline.remaining_s() if deadline is not None else None
+                    if timeout is not None and timeout <= 0:
+                        self._reject_locked("Deadline passed while waiting for an execution slot.")
+                    woken = loop.create_future()
+                    self._async_waiters.append((loop, woken))
+                try:
+                    await asyncio.wait_for(woken, timeout)
+                except asyncio.TimeoutError:
+                    pass
+        finally:
+            with self._cond:
+                self._waiting -= 1
+        start = time.monotonic()
+        try:
+            yield
+        finally:
+            self._release(time.monotonic() - start)
+
+    def _check_budget_locked(self, deadline: Optional[Deadline]):
+        if deadline is not None:
+            remaining = deadline.remaining_s()
+            estimate = self._estimate_locked()
+            if estimate > remaining:
+                self._reject_locked(f"Estimated latency {estimate * 1000:.0f} ms exceeds the remaining budget of {max(remaining, 0) * 1000:.0f} ms.")
+
+    def _release(self, elapsed: float):
+        with self._cond:
+            self._running -= 1
+            self.service_s += self.smoothing * (elapsed - self.service_s)
+            self._cond.notify()
+            # Waiting coroutines all re-check for the slot; ones that gave up are skipped
+            waiters, self._async_waiters = self._async_waiters, []
+        for loop, woken in waiters:
+            if not loop.is_closed():
+                loop.call_soon_threadsafe(_wake, woken)
+
+def _wake(woken: "asyncio.Future[None]"):
+    if not woken.done():
+        woken.set_result(None)
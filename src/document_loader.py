@@ -1,7 +1,9 @@
+import os
 import json
 import time
-from typing import List, Dict, Any, Optional
+from typing import List, Dict, Any, Iterator, Optional
 from llama_index.core import Document
+from src.external_build import iter_json_array
 
 class DocumentLoader:
     """
@@ -9,61 +11,102 @@ class DocumentLoader:
     The loader is domain-agnostic and can handle any document collection.
     Optionally, a list of metadata fields can be specified for extraction.
 
+    corpus_path may also be a shard manifest written by bib_to_json --partition (e.g.
+    data/corpus.manifest.json); the shards it lists are then read in order, and only those holding
+    one of partition_values when that is set.
+
+    load_data() returns every document at once; iter_documents() reads the files incrementally,
+    for builds that must not hold the corpus in memory.
+
     Args:
-        data_path (str): Path to the input JSON data file. Must be provided explicitly.
+        data_path (str): Path to the input JSON data file or shard manifest. Must be provided explicitly.
         metadata_fields (Optional[List[str]]): List of metadata fields to extract (optional).
+        partition_values (Optional[List[str]]): Years or venues to load from a year/venue manifest (optional).
     """
-    def __init__(self, corpus_path: str, text_fields: List[str], metadata_fields: List[str], id_field: str):
+    def __init__(self, corpus_path: str, text_fields: List[str], metadata_fields: List[str], id_field: str,
+                 partition_values: Optional[List[str]] = None):
         self.corpus_path = corpus_path
         self.text_fields = text_fields
         self.metadata_fields = metadata_fields
         self.id_field = id_field
+        self.partition_values = [str(value) for value in partition_values] if partition_values else None
 
-    def load_data(self) -> List[Document]:
-        """
-        Reads the corpus JSON file and converts each entry into a LlamaIndex Document.
-        text is formed from the specified text fields, metadata is formed from the specified metadata fields.
-        """
-        documents: List[Document] = []
+    def shard_paths(self, manifest: Dict[str, Any]) -> List[str]:
+        """Paths of the manifest's shards to load, skipping shards without any of partition_values."""
+        base_dir = os.path.dirname(self.corpus_path)
+        paths = []
+        for shard in manifest.get("shards", []):
+            if self.partition_values is not None:
+                if "values" not in shard:
+                    raise ValueError(f"{self.corpus_path} is partitioned by {manifest.get('partition')}; partition_values needs a year or venue manifest.")
+                if not set(shard["values"]) & set(self.partition_values):
+                    continue
+            paths.append(os.path.join(base_dir, shard["path"]))
+        return paths
+
+    def _read_entries(self) -> Optional[List[Any]]:
+        """Entries of the corpus file, or of the selected shards when it is a manifest; None on error."""
         try:
             with open(self.corpus_path, 'r', encoding='utf-8') as f:
                 data = json.load(f)
-        except FileNotFoundError:
-            print(f"Error: JSON file not found at {self.corpus_path}. Please ensure it exists.")
-            return documents
+            if isinstance(data, dict) and "shards" in data:
+                paths = self.shard_paths(data)
+                print(f"Reading {len(paths)} of {len(data['shards'])} shards listed in {self.corpus_path}.")
+                data = []
+                for path in paths:
+                    with open(path, 'r', encoding='utf-8') as f:
+                        data.extend(json.load(f))
+        except FileNotFoundError as e:
+            print(f"Error: JSON file not found at {e.filename or self.corpus_path}. Please ensure it exists.")
+            return None
         except json.JSONDecodeError as e:
             print(f"Error decoding JSON from {self.corpus_path}: {e}")
-            return documents
+            return None
 
         if not isinstance(data, list):
             print(f"Error: Expected a list of entries in {self.corpus_path}, but got {type(data)}.")
+            return None
+        return data
+
+    def _to_document(self, i: int, entry: Any) -> Optional[Document]:
+        """The Document for corpus entry #i, or None (with a warning) if it is not a dictionary."""
+        if not isinstance(entry, dict):
+            print(f"Warning: Skipping entry #{i} as it is not a dictionary: {entry}")
+            return None
+
+        # Extract main text
+        text_content = ""
+        for field in self.text_fields:
+            text_content += f"{field}: {entry.get(field, "")}\n"
+
+        # Prepare metadata
+        metadata = {}
+        for field in self.metadata_fields:
+            metadata[field] = entry.get(field, None)
+
+        # if entry has no id field, give a unique id
+        doc_id = entry.get(self.id_field, f"entry_{i}")
+
+        return Document(
+            text=text_content,
+            metadata=metadata,
+            doc_id=str(doc_id)
+        )
+
+    def load_data(self) -> List[Document]:
+        """
+        Reads the corpus JSON file and converts each entry into a LlamaIndex Document.
+        text is formed from the specified text fields, metadata is formed from the specified metadata fields.
+        """
+        documents: List[Document] = []
+        data = self._read_entries()
+        if data is None:
             return documents
 
         for i, entry in enumerate(data):
-            if not isinstance(entry, dict):
-                print(f"Warning: Skipping entry #{i} as it is not a dictionary: {entry}")
-                continue
-
-            # Extract main text
-            text_content = ""
-            for field in self.text_fields:
-                text_content += f"{field}: {entry.get(field, "")}\n"
-                
-
-            # Prepare metadata
-            metadata = {}
-            for field in self.metadata_fields:
-                metadata[field] = entry.get(field, None)
-
-            # if entry has no id field, give a unique id
-            doc_id = entry.get(self.id_field, f"entry_{i}")
-
-            doc = Document(
-                text=text_content,
-                metadata=metadata,
-                doc_id=str(doc_id)
-            )
-            documents.append(doc)
+            doc = self._to_document(i, entry)
+            if doc is not None:
+                documents.append(doc)
 
         if not documents:
             print(f"No documents were loaded from {self.corpus_path}. Check the file content and format.")
@@ -72,6 +115,28 @@ class DocumentLoader:
 
         return documents
 
+    def iter_documents(self) -> Iterator[Document]:
+        """
+        Yields the same Documents as load_data(), in the same order, parsing one corpus entry at a
+        time (see src.external_build.iter_json_array). Missing or malformed files raise instead of
+        yielding nothing.
+        """
+        with open(self.corpus_path, 'r', encoding='utf-8') as f:
+            is_manifest = f.read(4096).lstrip().startswith("{")
+        paths = [self.corpus_path]
+        if is_manifest:
+            with open(self.corpus_path, 'r', encoding='utf-8') as f:
+                manifest = json.load(f)
+            paths = self.shard_paths(manifest)
+            print(f"Reading {len(paths)} of {len(manifest.get('shards', []))} shards listed in {self.corpus_path}.")
+        i = 0
+        for path in paths:
+            for entry in iter_json_array(path):
+                doc = self._to_document(i, entry)
+                i += 1
+                if doc is not None:
+                    yield doc
+
 if __name__ == "__main__": #script testing
     # python -m src.document_loader
     from src.config_loader import AppConfig
@@ -0,0 +1,325 @@
+"""
+Distributed embedding for index builds.
+
+A coordinator (IndexBuilder.build, when embedding_workers_address is set) splits the chunk
+texts into fixed batches and serves them to worker processes on other hosts
+(scripts/embedding_worker.py). Each worker embeds a batch and streams the vectors back, keyed
+by node id.
+
+Every message is a frame
+
+    header length (u32) | payload length (u32) | JSON header | payload
+
+where the payload, if any, is a float32 (rows, dim) matrix. The conversation is
+
+    worker -> hello {model}        coordinator -> welcome | reject {message}
+    coordinator -> batch {batch, node_ids, texts}
+    worker -> result {batch, node_ids, dim} + vectors | error {batch, message}
+    ... until coordinator -> done
+
+Each connection has at most one batch outstanding. A batch is handed out again (to any worker) when
+its worker reports an error, disconnects, or does not answer within lease_s; after max_attempts
+failures the whole job fails. Batches are fixed by input order and results are assembled in that
+order (a late duplicate of a retried batch is ignored), so the output does not depend on which
+worker embedded what, as long as every worker runs the same model and precision (checked in
+the hello).
+
+Addresses are "host:port" for TCP or "unix:<path>" for a Unix socket.
+"""
+import os
+import json
+import time
+import socket
+import struct
+import threading
+from collections import deque
+from dataclasses import dataclass
+from typing import Any, Callable, Deque, Dict, List, Optional, Sequence, Tuple
+
+import numpy as np
+
+_FRAME = struct.Struct("<II")
+
+def parse_address(address: str) -> Tuple[int, Any]:
+    """(socket family, sockaddr) for "host:port" or "unix:<path>"."""
+    if address.startswith("unix:"):
+        return socket.AF_UNIX, address[len("unix:"):]
+    host, _, port = address.rpartition(":")
+    if not host or not port.isdigit():
+        raise ValueError(f"Invalid embedding worker address '{address}'. Expected 'host:port' or 'unix:<path>'.")
+    return socket.AF_INET, (host, int(port))
+
+def send_message(sock: socket.socket, header: Dict[str, Any], vectors: Optional[np.ndarray] = None):
+    body = json.dumps(header).encode("utf-8")
+    payload = b"" if vectors is None else np.ascontiguousarray(vectors, dtype=np.float32).tobytes()
+    sock.sendall(_FRAME.pack(len(body), len(payload)) + body + payload)
+
+def _recv_exact(sock: socket.socket, size: int) -> bytes:
+    buffer = bytearray(size)
+    view = memoryview(buffer)
+    received = 0
+    while received < size:
+        n = sock.recv_into(view[received:])
+        if not n:
+            raise ConnectionError("Connection closed mid-message.")
+        received += n
+    return bytes(buffer)
+
+def recv_message(sock: socket.socket) -> Tuple[Dict[str, Any], bytes]:
+    body_length, payload_length = _FRAME.unpack(_recv_exact(sock, _FRAME.size))
+    header = json.loads(_recv_exact(sock, body_length).decode("utf-8"))
+    return header, _recv_exact(sock, payload_length) if payload_length else b""
+
+@dataclass
+class EmbeddingJobStats:
+    """Counters of an EmbeddingCoordinator, for logs and tests."""
+    batches: int = 0
+    retries: int = 0
+    workers: int = 0
+    rejected_workers: int = 0
+
+class EmbeddingCoordinator:
+    """
+    Serves embedding batches to connected workers (see the module docstring for the protocol).
+    Workers may connect before or during a job and stay connected across jobs.
+
+    Args:
+        address (str): Where to listen; port 0 picks a free port (see .address).
+        model (str): Model identity workers must report, e.g. "<model name>:<precision>".
+        batch_size (int): Texts per batch.
+        lease_s (float): Time a worker has to return a batch before it is retried elsewhere.
+        max_attempts (int): Failures of one batch before the job fails.
+    """
+    def __init__(self, address: str, model: str = "", batch_size: int = 64, lease_s: float = 300.0, max_attempts: int = 3):
+        self.model = model
+        self.batch_size = batch_size
+        self.lease_s = lease_s
+        self.max_attempts = max_attempts
+        self.stats = EmbeddingJobStats()
+        family, sockaddr = parse_address(address)
+        if family == socket.AF_UNIX and os.path.exists(sockaddr):
+            os.unlink(sockaddr)
+        self._listener = socket.socket(family, socket.SOCK_STREAM)
+        if family == socket.AF_INET:
+            self._listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self._listener.bind(sockaddr)
+        self._listener.listen()
+        if family == socket.AF_INET:
+            host, port = self._listener.getsockname()[:2]
+            self.address = f"{host}:{port}"
+        else:
+            self.address = address
+        self._state = threading.Condition()
+        self._closed = False
+        self._job = 0
+        self._batches: List[Tuple[List[str], List[str]]] = []
+        self._pending: Deque[int] = deque()
+        self._attempts: Dict[int, int] = {}
+        self._results: Dict[int, np.ndarray] = {}
+        self._error: Optional[Exception] = None
+        self._handlers: List[threading.Thread] = []
+        self._accept_thread = threading.Thread(target=self._accept_loop, name="embedding-coordinator", daemon=True)
+        self._accept_thread.start()
+
+    def __enter__(self) -> "EmbeddingCoordinator":
+        return self
+
+    def __exit__(self, *exc_info):
+        self.close()
+
+    def embed(self, node_ids: Sequence[str], texts: Sequence[str], timeout_s: Optional[float] = None,
+              progress: Optional[Callable[[int, int], None]] = None) -> np.ndarray:
+        """
+        Embeds `texts` on the connected workers.
+        Returns:
+            np.ndarray: (len(texts), dim) float32 vectors, in input order.
+        Raises:
+            RuntimeError: A batch failed max_attempts times, or a worker returned malformed results.
+            TimeoutError: The job did not finish within timeout_s.
+        """
+        if len(node_ids) != len(texts):
+            raise ValueError("node_ids and texts must have the same length.")
+        batches = [
+            (list(node_ids[start:start + self.batch_size]), list(texts[start:start + self.batch_size]))
+            for start in range(0, len(texts), self.batch_size)
+        ]
+        deadline = None if timeout_s is None else time.monotonic() + timeout_s
+        with self._state:
+            if self._closed:
+                raise RuntimeError("EmbeddingCoordinator is closed.")
+            self._job += 1
+            self._batches = batches
+            self._pending = deque(range(len(batches)))
+            self._attempts = {}
+            self._results = {}
+            self._error = None
+            self._state.notify_all()
+            reported = -1
+            while len(self._results) < len(batches) and self._error is None:
+                if progress is not None and len(self._results) != reported:
+                    reported = len(self._results)
+                    progress(reported, len(batches))
+                remaining = None if deadline is None else deadline - time.monotonic()
+                if remaining is not None and remaining <= 0:
+                    self._pending.clear()
+                    raise TimeoutError(f"Embedding job incomplete after {timeout_s}s ({len(self._results)}/{len(batches)} batches).")
+                self._state.wait(remaining if remaining is not None else 1.0)
+            error, results = self._error, self._results
+            self._batches, self._pending, self._results = [], deque(), {}
+        if error is not None:
+            raise error
+        if progress is not None:
+            progress(len(batches), len(batches))
+        if not batches:
+            return np.empty((0, 0), dtype=np.float32)
+        return np.concatenate([results[i] for i in range(len(batches))])
+
+    def close(self):
+        """Tells idle workers the session is over and stops listening."""
+        with self._state:
+            self._closed = True
+            self._state.notify_all()
+        try:
+            self._listener.close()
+        finally:
+            for thread in list(self._handlers):
+                thread.join(timeout=1.0)
+            if self._listener.family == socket.AF_UNIX and os.path.exists(self.address[len("unix:"):]):
+                os.unlink(self.address[len("unix:"):])
+
+    # --- Coordinator side of one connection ---
+
+    def _accept_loop(self):
+        while True:
+            try:
+                conn, _ = self._listener.accept()
+            except OSError:
+                return
+            thread = threading.Thread(target=self._serve_worker, args=(conn,), daemon=True)
+            thread.start()
+            self._handlers.append(thread)
+
+    def _next_batch(self) -> Optional[Tuple[int, int, List[str], List[str]]]:
+        """Waits for a batch to hand out: (job, batch index, node ids, texts), or None once the coordinator closes."""
+        with self._state:
+            while not self._closed:
+                if self._pending and self._error is None:
+                    batch = self._pending.popleft()
+                    return (self._job, batch) + self._batches[batch]
+                self._state.wait()
+            return None
+
+    def _fail(self, job: int, batch: int, reason: str):
+        with self._state:
+            if job != self._job or batch in self._results:
+                return
+            self._attempts[batch] = self._attempts.get(batch, 0) + 1
+            if self._attempts[batch] >= self.max_attempts:
+                self._error = RuntimeError(f"Embedding batch {batch} failed {self._attempts[batch]} times; last error: {reason}")
+            else:
+                self.stats.retries += 1
+                # Retried first, so a failing batch does not wait behind the rest of the job
+                self._pending.appendleft(batch)
+            self._state.notify_all()
+
+    def _complete(self, job: int, batch: int, vectors: np.ndarray):
+        with self._state:
+            if job == self._job and batch not in self._results:
+                self._results[batch] = vectors
+                self.stats.batches += 1
+                self._state.notify_all()
+
+    def _serve_worker(self, conn: socket.socket):
+        with conn:
+            try:
+                conn.settimeout(self.lease_s)
+                hello, _ = recv_message(conn)
+                if hello.get("type") != "hello" or hello.get("model", "") != self.model:
+                    with self._state:
+                        self.stats.rejected_workers += 1
+                    send_message(conn, {"type": "reject", "message": f"Coordinator embeds with '{self.model}', worker has '{hello.get('model')}'."})
+                    return
+                send_message(conn, {"type": "welcome"})
+                with self._state:
+                    self.stats.workers += 1
+            except (OSError, ValueError):
+                return
+            while True:
+                assigned = self._next_batch()
+                if assigned is None:
+                    try:
+                        send_message(conn, {"type": "done"})
+                    except OSError:
+                        pass
+                    return
+                job, batch, node_ids, texts = assigned
+                try:
+                    send_message(conn, {"type": "batch", "batch": batch, "node_ids": node_ids, "texts": texts})
+                    reply, payload = recv_message(conn)
+                except (OSError, ValueError) as e:
+                    # Disconnected, timed out (lease expired) or garbled: retry elsewhere, drop this worker
+                    self._fail(job, batch, f"{type(e).__name__}: {e}")
+                    return
+                if reply.get("type") == "error":
+                    self._fail(job, batch, reply.get("message", "worker error"))
+                    continue
+                dim = int(reply.get("dim", 0))
+                if reply.get("type") != "result" or reply.get("batch") != batch or reply.get("node_ids") != node_ids \
+                        or dim <= 0 or len(payload) != 4 * dim * len(node_ids):
+                    self._fail(job, batch, "malformed result")
+                    return
+                self._complete(job, batch, np.frombuffer(payload, dtype=np.float32).reshape(len(node_ids), dim))
+
+def run_worker(
+    address: str,
+    embed_batch: Callable[[List[str]], Any],
+    model: str = "",
+    connect_timeout_s: float = 30.0
+) -> int:
+    """
+    Connects to a coordinator and embeds batches until it says done or disconnects.
+    Connection attempts are retried for connect_timeout_s, so workers may start first.
+
+    Args:
+        address (str): The coordinator's address.
+        embed_batch (Callable[[List[str]], Any]): Texts -> (len(texts), dim) embeddings.
+        model (str): Model identity, compared with the coordinator's.
+    Returns:
+        int: Batches embedded.
+    Raises:
+        ConnectionRefusedError: The coordinator rejected this worker's model.
+    """
+    family, sockaddr = parse_address(address)
+    give_up = time.monotonic() + connect_timeout_s
+    while True:
+        sock = socket.socket(family, socket.SOCK_STREAM)
+        try:
+            sock.connect(sockaddr)
+            break
+        except OSError:
+            sock.close()
+            if time.monotonic() >= give_up:
+                raise
+            time.sleep(0.2)
+    done = 0
+    with sock:
+        send_message(sock, {"type": "hello", "model": model})
+        reply, _ = recv_message(sock)
+        if reply.get("type") != "welcome":
+            raise ConnectionRefusedError(reply.get("message", "rejected by coordinator"))
+        while True:
+            try:
+                message, _ = recv_message(sock)
+            except ConnectionError:
+                return done
+            if message.get("type") != "batch":
+                return done
+            try:
+                vectors = np.asarray(embed_batch(message["texts"]), dtype=np.float32)
+                if vectors.shape[0] != len(message["texts"]):
+                    raise ValueError(f"embedded {vectors.shape[0]} of {len(message['texts'])} texts")
+            except Exception as e:
+                send_message(sock, {"type": "error", "batch": message["batch"], "message": f"{type(e).__name__}: {e}"})
+                continue
+            send_message(sock, {"type": "result", "batch": message["batch"], "node_ids": message["node_ids"], "dim": int(vectors.shape[1])}, vectors)
+            done += 1
@@ -0,0 +1,282 @@
+"""
+Out-of-core index build: spilled runs and their external merge.
+
+IndexBuilder.build normally holds every document, node and embedding in memory. With
+build_memory_mb set it streams instead (see IndexBuilder.build_out_of_core): documents are
+read incrementally (iter_json_array), parsed and embedded in batches, and each batch's flat
+store rows and docstore entries are handed to an ExternalBuild. That buffers them up to the
+memory cap and then spills them to a run on disk:
+
+- rows: the batch's vectors, node ids and ref doc ids, in insertion order;
+- entries: per stream, a JSONSegment (keys sorted, plus their insertion order).
+
+merge_rows() concatenates the row runs into memory-mapped .npy arrays and merge_entries()
+k-way merges the sorted key runs into one JSONSegment, copying each value's JSON bytes once.
+Neither holds more than a block of any run in memory. The merged collections keep the
+insertion order of dicts filled stream by stream, run by run, so the segment reproduces the
+docstore an in-memory build would have written (see SegmentKVStore.write_json).
+Nothing here imports LlamaIndex.
+"""
+import os
+import json
+import heapq
+import shutil
+from typing import Any, Dict, Iterator, List, Sequence, Tuple
+
+import numpy as np
+
+from src.index_views import encode_ids
+from src.shared_segments import JSONSegment, segment_filename, write_segment_header
+
+# Directory inside storage_dir holding the runs while a build is in progress; write_bundle_from_dir
+# only packs files directly inside storage_dir, so it is never bundled
+BUILD_SPILL_DIR = "build_spill"
+# Characters read per step by iter_json_array
+JSON_CHUNK_CHARS = 1 << 20
+# Keys read per step from each run while merging
+_MERGE_BLOCK = 4096
+
+def iter_json_array(path: str, chunk_chars: int = JSON_CHUNK_CHARS) -> Iterator[Any]:
+    """
+    Yields the elements of the JSON array in `path` one at a time, holding about one chunk
+    (or one element, if larger) in memory. Raises json.JSONDecodeError on malformed input.
+    """
+    decoder = json.JSONDecoder()
+    with open(path, "r", encoding="utf-8") as f:
+        buffer, pos, eof = "", 0, False
+
+        def fill(need_more: bool) -> bool:
+            # Appends the next chunk, dropping what was consumed; False at end of file
+            nonlocal buffer, pos, eof
+            if eof:
+                return False
+            chunk = f.read(max(chunk_chars, len(buffer) - pos) if need_more else chunk_chars)
+            if not chunk:
+                eof = True
+                return False
+            buffer, pos = buffer[pos:] + chunk, 0
+            return True
+
+        def skip_whitespace() -> str:
+            nonlocal pos
+            while True:
+                while pos < len(buffer) and buffer[pos] in " \t\n\r":
+                    pos += 1
+                if pos < len(buffer) or not fill(False):
+                    return buffer[pos] if pos < len(buffer) else ""
+
+        if skip_whitespace() != "[":
+            raise json.JSONDecodeError("Expected a JSON array", buffer, pos)
+        pos += 1
+        first = True
+        while True:
+            char = skip_whitespace()
+            if char == "]":
+                return
+            if not first:
+                if char != ",":
+                    raise json.JSONDecodeError("Expected ',' or ']'", buffer, pos)
+                pos += 1
+                skip_whitespace()
+            while True:
+                try:
+                    value, end = decoder.raw_decode(buffer, pos)
+                except json.JSONDecodeError:
+                    if fill(True):
+                        continue
+                    raise
+                # A number cut by the end of the buffer ("-0." of "-0.5") looks complete; an
+                # element is only done once the next character is read
+                if (end < len(buffer) and buffer[end] in " \t\n\r,]") or not fill(True):
+                    break
+            pos = end
+            first = False
+            yield value
+
+def _open_npy(path: str, dtype: np.dtype, shape: Tuple[int, ...]) -> np.ndarray:
+    """A writable memory-mapped .npy file; empty arrays are saved directly (nothing to map)."""
+    if not int(np.prod(shape)):
+        np.save(path, np.empty(shape, dtype=dtype))
+        return np.load(path)
+    return np.lib.format.open_memmap(path, mode="w+", dtype=dtype, shape=shape)
+
+class ExternalBuild:
+    """
+    Buffers flat store rows and docstore entries under a memory cap, spilling them to runs in
+    `directory`, and merges the runs once everything was added.
+
+    Entries are added per stream: merged collections list every stream 0 key before any
+    stream 1 key, whichever run they were spilled in (e.g. the document hashes
+    VectorStoreIndex.from_documents records before it adds any node). Keys must be unique
+    within a collection; a repeated key raises ValueError when it is added or when the runs merge.
+
+    Args:
+        directory (str): Spill directory; replaced if it exists, removed by close().
+        memory_bytes (int): Buffered vector and JSON bytes that trigger a spill.
+    """
+    def __init__(self, directory: str, memory_bytes: int):
+        self.directory = directory
+        self.memory_bytes = memory_bytes
+        shutil.rmtree(directory, ignore_errors=True)
+        os.makedirs(directory)
+        self.runs = 0
+        self.rows = 0
+        self._row_runs: List[str] = []
+        self._entry_runs: Dict[int, List[str]] = {}
+        self._vectors: List[np.ndarray] = []
+        self._node_ids: List[str] = []
+        self._ref_doc_ids: List[str] = []
+        self._entries: Dict[int, Dict[str, Dict[str, bytes]]] = {}
+        self._buffered = 0
+
+    def __enter__(self) -> "ExternalBuild":
+        return self
+
+    def __exit__(self, exc_type, exc, tb):
+        self.close()
+
+    def close(self):
+        """Removes the spill directory; merged arrays that are still mapped stay readable."""
+        shutil.rmtree(self.directory, ignore_errors=True)
+
+    @property
+    def buffered_bytes(self) -> int:
+        return self._buffered
+
+    def add_rows(self, vectors: np.ndarray, node_ids: Sequence[str], ref_doc_ids: Sequence[str]):
+        """Appends flat store rows: (n, D) vectors in storage format and their ids."""
+        if len(vectors) != len(node_ids) or len(node_ids) != len(ref_doc_ids):
+            raise ValueError("vectors, node_ids and ref_doc_ids must have the same length.")
+        if not len(node_ids):
+            return
+        if self._vectors and vectors.shape[1:] != self._vectors[0].shape[1:]:
+            raise ValueError(f"Vector shape {vectors.shape[1:]} does not match {self._vectors[0].shape[1:]}.")
+        self._vectors.append(np.array(vectors))
+        self._node_ids.extend(node_ids)
+        self._ref_doc_ids.extend(ref_doc_ids)
+        self.rows += len(node_ids)
+        self._buffered += vectors.nbytes + sum(len(i) for i in node_ids) + sum(len(i) for i in ref_doc_ids)
+        self._maybe_spill()
+
+    def add_entries(self, data: Dict[str, Dict[str, Any]], stream: int = 0):
+        """Appends {collection: {key: JSON-serializable value}}, e.g. a batch docstore's to_dict()."""
+        buffered = self._entries.setdefault(stream, {})
+        for name, values in data.items():
+            collection = buffered.setdefault(name, {})
+            for key, value in values.items():
+                if key in collection:
+                    raise ValueError(f"Duplicate key '{key}' in collection '{name}'.")
+                encoded = json.dumps(value).encode("utf-8")
+                collection[key] = encoded
+                self._buffered += len(key) + len(encoded)
+        self._maybe_spill()
+
+    def _maybe_spill(self):
+        if self._buffered >= self.memory_bytes:
+            self.spill()
+
+    def spill(self):
+        """Writes the buffered rows and entries to a new run."""
+        if not self._buffered:
+            return
+        run_dir = os.path.join(self.directory, f"run-{self.runs:05d}")
+        os.makedirs(run_dir)
+        if self._vectors:
+            np.save(os.path.join(run_dir, "vectors.npy"), np.concatenate(self._vectors, axis=0))
+            np.save(os.path.join(run_dir, "node_ids.npy"), encode_ids(self._node_ids))
+            np.save(os.path.join(run_dir, "ref_doc_ids.npy"), encode_ids(self._ref_doc_ids))
+            self._row_runs.append(run_dir)
+        for stream, data in self._entries.items():
+            stream_dir = os.path.join(run_dir, f"stream-{stream}")
+            JSONSegment.from_encoded(data).save(stream_dir)
+            self._entry_runs.setdefault(stream, []).append(stream_dir)
+        self._vectors, self._node_ids, self._ref_doc_ids, self._entries = [], [], [], {}
+        self._buffered = 0
+        self.runs += 1
+
+    def merge_rows(self) -> Tuple[np.ndarray, np.ndarray, np.ndarray]:
+        """
+        Concatenates the row runs, in the order they were added, into memory-mapped
+        (vectors, node ids, ref doc ids) arrays, the ids as in src.index_views.encode_ids.
+        """
+        self.spill()
+        if not self._row_runs:
+            raise ValueError("No rows were added to the build.")
+        parts = {
+            part: [np.load(os.path.join(run, f"{part}.npy"), mmap_mode="r") for run in self._row_runs]
+            for part in ("vectors", "node_ids", "ref_doc_ids")
+        }
+        merged_dir = os.path.join(self.directory, "merged")
+        os.makedirs(merged_dir, exist_ok=True)
+        merged = []
+        for part, runs in parts.items():
+            dtype = runs[0].dtype if part == "vectors" else f"S{max(run.dtype.itemsize for run in runs)}"
+            out = _open_npy(os.path.join(merged_dir, f"rows.{part}.npy"), dtype, (self.rows,) + runs[0].shape[1:])
+            start = 0
+            for run in runs:
+                out[start:start + len(run)] = run
+                start += len(run)
+            if isinstance(out, np.memmap):
+                out.flush()
+            merged.append(np.load(os.path.join(merged_dir, f"rows.{part}.npy"), mmap_mode="r"))
+        return tuple(merged)
+
+    def merge_entries(self) -> JSONSegment:
+        """
+        Merges the entry runs into one JSONSegment, memory-mapped from the spill directory.
+        Collections and keys keep their insertion order: stream by stream, then run by run.
+        """
+        self.spill()
+        sources = [JSONSegment.load(run) for stream in sorted(self._entry_runs) for run in self._entry_runs[stream]]
+        names: List[str] = []
+        for source in sources:
+            names.extend(name for name in source.collections if name not in names)
+        merged_dir = os.path.join(self.directory, "merged")
+        os.makedirs(merged_dir, exist_ok=True)
+        for index, name in enumerate(names):
+            self._merge_collection(merged_dir, index, name, [source for source in sources if name in source.collections])
+        write_segment_header(merged_dir, names, ordered=True)
+        return JSONSegment.load(merged_dir)
+
+    def _merge_collection(self, merged_dir: str, index: int, name: str, sources: List[JSONSegment]):
+        # k-way merge of the runs' sorted keys; values are copied in merged key order
+        parts = [source.arrays(name) for source in sources]
+        total = sum(len(keys) for keys, _, _, _ in parts)
+        width = max(keys.dtype.itemsize for keys, _, _, _ in parts)
+        path = lambda part: os.path.join(merged_dir, segment_filename(index, part))
+        keys_out = _open_npy(path("keys"), np.dtype(f"S{width}"), (total,))
+        offsets_out = _open_npy(path("offsets"), np.dtype(np.int64), (total + 1,))
+        blob_out = _open_npy(path("blob"), np.dtype(np.uint8), (sum(len(blob) for _, _, blob, _ in parts),))
+        # Merged row of each source row, to translate the sources' insertion order afterwards
+        rows_of = [_open_npy(os.path.join(merged_dir, f"rows-{index}-{i}.npy"), np.dtype(np.int64), (len(keys),))
+                   for i, (keys, _, _, _) in enumerate(parts)]
+
+        def source_keys(i: int) -> Iterator[Tuple[bytes, int, int]]:
+            keys = parts[i][0]
+            for start in range(0, len(keys), _MERGE_BLOCK):
+                for row, key in enumerate(keys[start:start + _MERGE_BLOCK].tolist(), start):
+                    yield key, i, row
+
+        out_row, out_offset, previous = 0, 0, None
+        offsets_out[0] = 0
+        for key, i, row in heapq.merge(*(source_keys(i) for i in range(len(parts)))):
+            if key == previous:
+                raise ValueError(f"Duplicate key '{key.decode('utf-8')}' in collection '{name}' across build runs.")
+            _, offsets, blob, _ = parts[i]
+            value = blob[offsets[row]:offsets[row + 1]]
+            keys_out[out_row] = key
+            blob_out[out_offset:out_offset + len(value)] = value
+            out_offset += len(value)
+            offsets_out[out_row + 1] = out_offset
+            rows_of[i][row] = out_row
+            out_row += 1
+            previous = key
+
+        order_out = _open_npy(path("order"), np.dtype(np.int64), (total,))
+        start = 0
+        for (_, _, _, source_order), rows in zip(parts, rows_of):
+            order_out[start:start + len(source_order)] = rows[source_order]
+            start += len(source_order)
+        for array in (keys_out, offsets_out, blob_out, order_out):
+            if isinstance(array, np.memmap):
+                array.flush()
@@ -1,13 +1,49 @@
 import os
+import json
 import time
-from typing import Optional, List
+import shutil
+import threading
+import dataclasses
+import numpy as np
+from contextlib import contextmanager
+from itertools import batched, chain
+from typing import Dict, Iterable, Iterator, Optional, List, Sequence, Set
 from llama_index.core import VectorStoreIndex, StorageContext, load_index_from_storage, Document
 from llama_index.core.settings import Settings
 from llama_index.core.node_parser import SentenceSplitter
+from llama_index.core.schema import BaseNode, MetadataMode, NodeRelationship, TextNode
+from llama_index.core.data_structs.data_structs import IndexDict
+from llama_index.core.storage.docstore.utils import doc_to_json, json_to_doc
+from llama_index.core.storage.docstore import SimpleDocumentStore
+from llama_index.core.storage.index_store import SimpleIndexStore
+from llama_index.core.graph_stores import SimpleGraphStore
+from llama_index.core.vector_stores import SimpleVectorStore
 from src.document_loader import DocumentLoader
-from src.core_components import initialize_hf_embedding_model
+from src.external_build import BUILD_SPILL_DIR, ExternalBuild
+from src.index_bundle import IndexBundle, write_bundle_from_dir
+from src.index_segments import SegmentManifest
+from src.vector_store import FlatVectorStore, DEFAULT_VECTOR_STORE_FILENAME
+from src.locality import LOCALITY_ORDERS, describe_order, locality_order
+from src.multivector import MultiVectorIndex, MULTIVECTOR_HEADER
+from src.index_views import MetadataColumns, METADATA_HEADER
+from src.autotune import TuningResult, TUNING_FILENAME, autotune_multivector
+from src.title_index import TitleIndex, TITLE_INDEX_HEADER
+from src.embedding_workers import EmbeddingCoordinator
+from src.segment_docstore import segment_docstore, unmodified_segment
+from src.shared_segments import (
+    DOCSTORE_SEGMENT_HEADER, GENERATION_FILENAME, JSONSegment, bundle_identity, read_generation, write_next_generation
+)
+from src.wal import WriteAheadLog, OP_INSERT, OP_DELETE, encode_insert, decode_insert, encode_delete, decode_delete
+from src.core_components import initialize_hf_embedding_model, token_embeddings, tokenize_with_offsets, embed_token_ids
+from src.kernels import decode_vectors
+from src.token_cache import TOKEN_CACHE_DIR, content_key, token_windows, update_token_cache
 from src.config_loader import IndexBuilderConfig
 
+# The log lives in a subdirectory so write_bundle_from_dir does not pack it
+WAL_PATH = os.path.join("wal", "index.wal")
+# LSN of the last log record folded into the persisted index, written by persist()
+WAL_CHECKPOINT_FILENAME = "wal_checkpoint.json"
+
 class IndexBuilder:
     """
     Encapsulates the lifecycle and operations of a VectorStoreIndex for a generic document collection.
@@ -26,23 +62,73 @@ class IndexBuilder:
         self.config = config
         self.storage_dir = config.storage_dir
         self.embedding_model_name = config.embedding_model_name
+        self.embedding_precision = config.embedding_precision
         self.corpus_path = config.corpus_path
         self.corpus_id_field = config.corpus_id_field
         self.corpus_text_fields = config.corpus_text_fields
         self.corpus_metadata_fields = config.corpus_metadata_fields
+        self.corpus_partition_values = config.corpus_partition_values
         self.chunk_size = config.chunk_size
         self.chunk_overlap = config.chunk_overlap
         self.docstore_filename = config.docstore_filename
         self.vector_store_filename = config.vector_store_filename
         self.index_store_filename = config.index_store_filename
+        self.bundle_path = os.path.join(self.storage_dir, config.bundle_filename)
+        self.vector_store_type = config.vector_store_type
+        self.vector_store_dtype = config.vector_store_dtype
+        if self.vector_store_type not in ("simple", "flat"):
+            raise ValueError(f"Unknown vector_store_type '{self.vector_store_type}'. Expected 'simple' or 'flat'.")
+        self.build_memory_mb = config.build_memory_mb
+        if self.build_memory_mb and self.vector_store_type != "flat":
+            raise ValueError("build_memory_mb (out-of-core build) needs vector_store_type 'flat'.")
+        self.locality_order = config.locality_order
+        if self.locality_order not in LOCALITY_ORDERS:
+            raise ValueError(f"Unknown locality_order '{self.locality_order}'. Expected one of {LOCALITY_ORDERS}.")
+        if self.locality_order and self.vector_store_type != "flat":
+            raise ValueError("locality_order needs vector_store_type 'flat'.")
+        if self.locality_order and self.build_memory_mb:
+            raise ValueError("locality_order permutes the whole vector matrix in memory; unset build_memory_mb.")
+        self.multivector_enabled = config.multivector_enabled
+        self.metadata_column_fields = config.metadata_column_fields
+        self.autotune_enabled = config.autotune_enabled
+        self.wal_enabled = config.wal_enabled
+        self.wal_checkpoint_records = config.wal_checkpoint_records
+        self.title_index_enabled = config.title_index_enabled
+        self.title_index_field = config.title_index_field
+        self.embedding_workers_address = config.embedding_workers_address
+        self.docstore_segment_enabled = config.docstore_segment_enabled
+        self.token_cache_enabled = config.token_cache_enabled
+        if self.token_cache_enabled and (self.build_memory_mb or self.embedding_workers_address):
+            raise ValueError("token_cache_enabled embeds in memory in this process; unset build_memory_mb and embedding_workers_address.")
         
         self.node_parser = node_parser or SentenceSplitter(chunk_size=self.chunk_size, chunk_overlap=self.chunk_overlap)
         self.index: Optional[VectorStoreIndex] = None
+        self.multivector_index: Optional[MultiVectorIndex] = None
+        self.metadata_columns: Optional[MetadataColumns] = None
+        self.tuning: Optional[TuningResult] = None
+        self.title_index: Optional[TitleIndex] = None
+        # Node ids the derived structures above cover; checkpoints only encode nodes added since
+        self._derived_node_ids: Set[str] = set()
+        self.wal: Optional[WriteAheadLog] = None
+        # Generation of the persisted index this builder holds, and the bundle file it came from
+        self.generation = 0
+        self._bundle_identity = None
+        # Serializes applying updates to the in-memory index (log commits happen outside it)
+        self._update_lock = threading.Lock()
+        # Checkpoints wait for in-flight updates, so the persisted log position matches the index
+        self._updates = threading.Condition()
+        self._updates_in_flight = 0
+        self._checkpointing = False
+        # Live segments searched besides the index until merge_segments folds them in (see src.index_segments)
+        self.segment_manifest = SegmentManifest(self.storage_dir)
+        self.segments: Dict[str, "IndexBuilder"] = {}
+        self._segments_lock = threading.Lock()
+        self._merge_lock = threading.Lock()
 
     def build(self, documents: Optional[List[Document]] = None, force_rebuild: bool = False) -> VectorStoreIndex:
         """
         Build the index from a list of documents, or load them from corpus_path if not provided.
-        Persists the index to disk.
+        Persists the index to disk. A rebuild replaces the whole index: live segments are dropped.
         Args:
             documents (Optional[List[Document]]): Documents to index. If None, loads from corpus_path.
             force_rebuild (bool): If True, rebuild even if index exists on disk.
@@ -50,14 +136,13 @@ class IndexBuilder:
             VectorStoreIndex: The built index.
         """
         os.makedirs(self.storage_dir, exist_ok=True)
-        index_exists = os.path.exists(os.path.join(self.storage_dir, self.docstore_filename))
-        if index_exists and not force_rebuild:
+        if self.index_exists() and not force_rebuild:
             return self.load()
         
         print("--- Starting Index Building Process ---")
         print(f"Index storage directory: {self.storage_dir}")
         print(f"Embedding model specified: {self.embedding_model_name}")
-        initialize_hf_embedding_model(model_name=self.embedding_model_name)
+        initialize_hf_embedding_model(model_name=self.embedding_model_name, precision=self.embedding_precision)
         Settings.node_parser = self.node_parser
         print(f"Node parser configured with chunk size: {self.node_parser.chunk_size}, overlap: {self.node_parser.chunk_overlap}")
         if documents is None:
@@ -68,38 +153,504 @@ class IndexBuilder:
                 corpus_path=self.corpus_path,
                 text_fields=self.corpus_text_fields,
                 metadata_fields=self.corpus_metadata_fields,
-                id_field=self.corpus_id_field
+                id_field=self.corpus_id_field,
+                partition_values=self.corpus_partition_values
             )
-            documents = loader.load_data()
-        print(f"Loaded {len(documents)} documents.")
-        if not documents:
-            raise ValueError("No documents loaded. Cannot build index.")
-        print("Creating VectorStoreIndex (this may take a while)...")
-        self.index = VectorStoreIndex.from_documents(documents, show_progress=True)
+            documents = loader.iter_documents() if self.build_memory_mb else loader.load_data()
+        if self.build_memory_mb:
+            print(f"Building out of core ({self.build_memory_mb} MB buffered per run, batches of {self.config.build_batch_documents} documents)...")
+            self.index = self.build_out_of_core(documents)
+        else:
+            print(f"Loaded {len(documents)} documents.")
+            if not documents:
+                raise ValueError("No documents loaded. Cannot build index.")
+            print("Creating VectorStoreIndex (this may take a while)...")
+            storage_context = None
+            if self.vector_store_type == "flat":
+                print(f"Using flat vector store ({self.vector_store_dtype}).")
+                storage_context = StorageContext.from_defaults(vector_store=FlatVectorStore(dtype=self.vector_store_dtype))
+            if self.token_cache_enabled:
+                nodes = self.chunk_with_token_cache(documents)
+                self.index = VectorStoreIndex(nodes, storage_context=storage_context, show_progress=True)
+            elif self.embedding_workers_address:
+                nodes = self.node_parser.get_nodes_from_documents(documents, show_progress=True)
+                self.embed_with_workers(nodes)
+                # Nodes that already carry embeddings are not sent to the model again
+                self.index = VectorStoreIndex(nodes, storage_context=storage_context, show_progress=True)
+            else:
+                self.index = VectorStoreIndex.from_documents(documents, storage_context=storage_context, show_progress=True)
         print("VectorStoreIndex created successfully.")
+        if self.locality_order:
+            self.apply_locality_order()
+        if self.multivector_enabled:
+            self.multivector_index = self.build_multivector_index()
+            if self.autotune_enabled:
+                self.tuning = self.autotune()
+        if self.metadata_column_fields:
+            self.metadata_columns = self.build_metadata_columns()
+        if self.title_index_enabled:
+            self.title_index = self.build_title_index()
+        self._mark_derived_current()
+        if self.wal_enabled:
+            # Records logged against a previous index must not be replayed over this one.
+            self._open_wal()
         self.persist()
+        if self.wal is not None:
+            self.wal.reset()
+        self._retire_segments(list(self.segment_manifest.names))
         return self.index
 
-    def load(self) -> VectorStoreIndex:
+    def build_out_of_core(self, documents: Iterable[Document]) -> VectorStoreIndex:
+        """
+        Streaming build holding about build_memory_mb of nodes and vectors (see src.external_build).
+        Documents are split, embedded and indexed build_batch_documents at a time, exactly as
+        VectorStoreIndex.from_documents would; each batch's flat store rows and docstore entries
+        are buffered, spilled to sorted runs, and finally merged on disk into a memory-mapped flat
+        store and docstore segment. Persisting the result writes the same files as an in-memory build.
+        """
+        spill_dir = os.path.join(self.storage_dir, BUILD_SPILL_DIR)
+        start = time.perf_counter()
+        with ExternalBuild(spill_dir, self.build_memory_mb * 2**20) as external:
+            num_documents = 0
+            for batch in batched(documents, self.config.build_batch_documents):
+                # from_documents records every document hash before adding any node
+                hashes = SimpleDocumentStore()
+                for document in batch:
+                    hashes.set_document_hash(document.get_doc_id(), document.hash)
+                nodes = self.node_parser.get_nodes_from_documents(batch)
+                if self.embedding_workers_address:
+                    self.embed_with_workers(nodes)
+                docstore = SimpleDocumentStore()
+                vector_store = FlatVectorStore(dtype=self.vector_store_dtype)
+                VectorStoreIndex(nodes, storage_context=StorageContext.from_defaults(docstore=docstore, vector_store=vector_store))
+                external.add_entries(hashes.to_dict(), stream=0)
+                external.add_entries(docstore.to_dict(), stream=1)
+                external.add_rows(vector_store.vectors, vector_store.node_ids, vector_store.ref_doc_ids)
+                num_documents += len(batch)
+                print(f"  Indexed {num_documents} documents, {external.rows} nodes ({external.runs} runs spilled)", end="\r", flush=True)
+            print()
+            if not num_documents:
+                raise ValueError("No documents loaded. Cannot build index.")
+            vector_store = FlatVectorStore.from_arrays(*external.merge_rows(), dtype=self.vector_store_dtype)
+            segment = external.merge_entries()
+        # The merged arrays stay mapped after the spill directory is removed
+        print(f"Merged {external.runs} runs into {len(vector_store)} rows and {len(segment)} docstore entries "
+              f"in {time.perf_counter() - start:.1f}s.")
+        # VectorStoreIndex maps each vector store id (the node id for a flat store) to its node id
+        index_struct = IndexDict()
+        for node_id in vector_store.node_ids:
+            index_struct.nodes_dict[node_id] = node_id
+        storage_context = StorageContext.from_defaults(docstore=segment_docstore(segment), vector_store=vector_store)
+        return VectorStoreIndex(index_struct=index_struct, storage_context=storage_context)
+
+    def apply_locality_order(self):
+        """
+        Permutes the flat store's rows by locality_order (see src.locality), so rows sharing a
+        year/venue or a topic sit together. Runs before any row-aligned side data is built.
+        """
+        vector_store = self.index.vector_store
+        fields = self.config.locality_order_fields
+        metadata = [node.metadata for node in self._nodes_in_row_order()] if self.locality_order == "metadata" else None
+        start = time.perf_counter()
+        order = locality_order(
+            self.locality_order, vector_store.vectors, vector_store.dtype,
+            metadata=metadata, fields=fields, num_clusters=self.config.locality_clusters or None
+        )
+        vector_store.reorder(order, describe_order(self.locality_order, fields))
+        print(f"Reordered {len(order)} rows by {vector_store.ordering} in {time.perf_counter() - start:.1f}s.")
+
+    def chunk_with_token_cache(self, documents: Sequence[Document]) -> List[BaseNode]:
+        """
+        Split documents into nodes of at most chunk_size WordPiece tokens, counting the metadata
+        header embedded with every chunk, consecutive nodes overlapping by chunk_overlap tokens,
+        and embed them from the token ids. Ids come from the token cache (src.token_cache), so
+        only texts changed since the last build are tokenized.
+        """
+        embed_model = Settings.embed_model
+        headers = [document.get_metadata_str(mode=MetadataMode.EMBED) for document in documents]
+        start = time.perf_counter()
+        cache, tokenized = update_token_cache(
+            os.path.join(self.storage_dir, TOKEN_CACHE_DIR),
+            self.embedding_model_name,
+            chain((document.text for document in documents), headers),
+            lambda texts: tokenize_with_offsets(embed_model, texts)
+        )
+        print(f"Token cache: tokenized {tokenized} of {len(cache)} texts in {time.perf_counter() - start:.1f}s, reused the rest.")
+        nodes, sequences = [], []
+        for document, header in zip(documents, headers):
+            ids, starts = cache.tokens(content_key(document.text))
+            if not len(ids):
+                continue
+            header_ids = cache.tokens(content_key(header))[0] if header else ids[:0]
+            size = self.chunk_size - len(header_ids)
+            if size <= 0:
+                raise ValueError(f"Metadata of document {document.doc_id} ({len(header_ids)} tokens) leaves no room in chunk_size {self.chunk_size}.")
+            document_nodes = []
+            for first, last in token_windows(len(ids), size, min(self.chunk_overlap, size - 1)):
+                start_char = int(starts[first])
+                end_char = int(starts[last]) if last < len(ids) else len(document.text)
+                text = document.text[start_char:end_char].rstrip()
+                document_nodes.append(TextNode(
+                    text=text,
+                    metadata=dict(document.metadata),
+                    excluded_embed_metadata_keys=list(document.excluded_embed_metadata_keys),
+                    excluded_llm_metadata_keys=list(document.excluded_llm_metadata_keys),
+                    start_char_idx=start_char,
+                    end_char_idx=start_char + len(text),
+                    relationships={NodeRelationship.SOURCE: document.as_related_node_info()}
+                ))
+                # The header's and the text's ids concatenate to the ids of the embedded "header\n\ntext"
+                sequences.append(np.concatenate([header_ids, ids[first:last]]))
+            for previous, node in zip(document_nodes, document_nodes[1:]):
+                previous.relationships[NodeRelationship.NEXT] = node.as_related_node_info()
+                node.relationships[NodeRelationship.PREVIOUS] = previous.as_related_node_info()
+            nodes.extend(document_nodes)
+        print(f"Embedding {len(nodes)} nodes from token ids...")
+        for node, embedding in zip(nodes, embed_token_ids(embed_model, sequences)):
+            node.embedding = embedding
+        return nodes
+
+    def embed_with_workers(self, nodes: Sequence[BaseNode]):
+        """
+        Sets each node's embedding using worker processes (see src.embedding_workers) that connect to
+        embedding_workers_address. Workers must run the same model and precision; the text embedded is
+        the one VectorStoreIndex would embed (MetadataMode.EMBED), so the result matches an in-process build.
+        """
+        model = f"{self.embedding_model_name}:{self.embedding_precision}"
+        with EmbeddingCoordinator(
+            self.embedding_workers_address,
+            model=model,
+            batch_size=self.config.embedding_workers_batch_size,
+            lease_s=self.config.embedding_workers_lease_s
+        ) as coordinator:
+            print(f"Waiting for embedding workers on {coordinator.address} ({model}); start them with "
+                  f"scripts/embedding_worker.py --address {coordinator.address}")
+            start = time.perf_counter()
+            vectors = coordinator.embed(
+                [node.node_id for node in nodes],
+                [node.get_content(metadata_mode=MetadataMode.EMBED) for node in nodes],
+                timeout_s=self.config.embedding_workers_timeout_s or None,
+                progress=lambda done, total: print(f"  Embedded {done}/{total} batches", end="\r", flush=True)
+            )
+            stats = coordinator.stats
+        print(f"\nEmbedded {len(nodes)} nodes on {stats.workers} workers in {time.perf_counter() - start:.1f}s "
+              f"({stats.retries} batches retried).")
+        for node, vector in zip(nodes, vectors):
+            node.embedding = vector.tolist()
+
+    def index_exists(self) -> bool:
+        """
+        Returns True if a persisted index (loose files or bundle) is present in storage_dir.
+        """
+        return os.path.exists(os.path.join(self.storage_dir, self.docstore_filename)) or os.path.exists(self.bundle_path)
+
+    def load_storage_context(self) -> StorageContext:
+        """
+        Read the persisted stores from disk without touching the embedding model.
+        Prefers the single-file bundle when one exists in storage_dir.
+        Safe to run concurrently with model initialization.
+        Returns:
+            StorageContext: The loaded storage context.
+        """
+        if os.path.exists(self.bundle_path):
+            return self._storage_context_from_bundle()
+        print("DEBUG: Calling StorageContext.from_defaults...")
+        self.generation = read_generation(self.storage_dir)
+        if self.vector_store_type == "flat":
+            return StorageContext.from_defaults(
+                persist_dir=self.storage_dir,
+                vector_store=FlatVectorStore.from_persist_path(os.path.join(self.storage_dir, DEFAULT_VECTOR_STORE_FILENAME))
+            )
+        return StorageContext.from_defaults(
+            persist_dir=self.storage_dir
+        )
+
+    def load(self, storage_context: Optional[StorageContext] = None) -> VectorStoreIndex:
         """
         Load the index from disk. Initializes embedding model and node parser.
+        Args:
+            storage_context (Optional[StorageContext]): Already loaded stores (see load_storage_context).
+                If None, they are read from storage_dir.
         Returns:
             VectorStoreIndex: The loaded index.
         """
         print(f"Loading index from {self.storage_dir}...")
-        print("DEBUG: Calling StorageContext.from_defaults...")
-        initialize_hf_embedding_model(model_name=self.embedding_model_name)
+        initialize_hf_embedding_model(model_name=self.embedding_model_name, precision=self.embedding_precision)
         Settings.node_parser = self.node_parser
-        storage_context = StorageContext.from_defaults(
-            persist_dir=self.storage_dir
-        )
+        if storage_context is None:
+            storage_context = self.load_storage_context()
         self.index = load_index_from_storage(storage_context)
+        if self.multivector_enabled:
+            self.multivector_index = self.load_multivector_index()
+            self.tuning = self._load_sidecar(
+                TUNING_FILENAME, TuningResult.from_bundle, TuningResult.load,
+                lambda directory: os.path.exists(os.path.join(directory, TUNING_FILENAME))
+            )
+            if self.autotune_enabled and self.tuning is None:
+                self.tuning = self.autotune()
+                self.persist()
+        if self.metadata_column_fields:
+            self.metadata_columns = self.load_metadata_columns()
+        if self.title_index_enabled:
+            self.title_index = self.load_title_index()
+        # Before replay: the persisted derived structures do not cover logged updates
+        self._mark_derived_current()
+        if self.wal_enabled:
+            self.replay_wal()
+        if self.segment_manifest.names:
+            self._load_segments()
         print("Index loaded successfully.")
         return self.index
 
+    def build_multivector_index(self) -> MultiVectorIndex:
+        """
+        Encode every node in the docstore token by token and build the multi-vector index.
+        Uses the embedding model already set in Settings.
+        """
+        if not self.index:
+            raise RuntimeError("Build or load the index before the multi-vector index.")
+        nodes = self._nodes_in_row_order()
+        print(f"Building multi-vector index over {len(nodes)} nodes...")
+        texts = [node.get_content(metadata_mode=MetadataMode.EMBED) for node in nodes]
+        multivector_index = MultiVectorIndex.build(
+            [node.node_id for node in nodes],
+            token_embeddings(Settings.embed_model, texts),
+            residual_bits=self.config.multivector_residual_bits,
+            num_centroids=self.config.multivector_num_centroids or None
+        )
+        print(f"Multi-vector index built: {multivector_index.num_tokens} tokens, {multivector_index.nbytes / 2**20:.1f} MB.")
+        return multivector_index
+
+    def autotune(self) -> TuningResult:
+        """
+        Pick the cheapest multi-vector nprobe / candidates meeting autotune_target_recall.
+        Queries are the first text line (the title) of a sample of nodes, encoded token by
+        token; ground truth is exact MaxSim over all nodes (see src.autotune).
+        """
+        if self.multivector_index is None:
+            raise RuntimeError("Autotuning needs a multi-vector index.")
+        nodes = self._nodes_in_row_order()
+        rng = np.random.default_rng(0)
+        sample = rng.choice(len(nodes), min(self.config.autotune_queries, len(nodes)), replace=False)
+        texts = []
+        for row in sample:
+            first_line = nodes[row].get_content().strip().split("\n", 1)[0]
+            # DocumentLoader writes "field: value" lines
+            texts.append(first_line.split(": ", 1)[-1])
+        print(f"Autotuning multi-vector search on {len(texts)} title queries (target recall@{self.config.autotune_k} = {self.config.autotune_target_recall})...")
+        tuning = autotune_multivector(
+            self.multivector_index,
+            token_embeddings(Settings.embed_model, texts),
+            k=self.config.autotune_k,
+            target_recall=self.config.autotune_target_recall
+        )
+        status = "met" if tuning.met_target else "NOT met; using the best recall found"
+        print(f"Autotuned {tuning.params}: recall {tuning.recall:.3f} ({status}), {tuning.cost:.0f} tokens decoded per query.")
+        return tuning
+
+    def _nodes_in_row_order(self) -> list:
+        """Docstore nodes, ordered like the flat vector store's rows when the index uses one."""
+        vector_store = self.index.vector_store
+        if isinstance(vector_store, FlatVectorStore):
+            return self.index.docstore.get_nodes(vector_store.node_ids)
+        return list(self.index.docstore.docs.values())
+
+    def _node_ids_in_row_order(self) -> List[str]:
+        """Node ids of _nodes_in_row_order, without reading the docstore."""
+        vector_store = self.index.vector_store
+        if isinstance(vector_store, FlatVectorStore):
+            return list(vector_store.node_ids)
+        return list(self.index.index_struct.nodes_dict.values())
+
+    def _mark_derived_current(self):
+        has_derived = self.multivector_index is not None or self.metadata_columns is not None or self.title_index is not None
+        self._derived_node_ids = set(self._node_ids_in_row_order()) if has_derived else set()
+
+    def update_derived_structures(self):
+        """
+        Bring the derived structures up to date with updates applied since they were built:
+        only nodes added since are read from the docstore (and, for the multi-vector index,
+        encoded), deleted nodes are dropped. Multi-vector centroids, residual codec and tuning
+        are kept; run build_multivector_index and autotune to retrain them.
+        """
+        if self.multivector_index is None and self.metadata_columns is None and self.title_index is None:
+            return
+        node_ids = self._node_ids_in_row_order()
+        new_ids = [node_id for node_id in node_ids if node_id not in self._derived_node_ids]
+        removed = len(node_ids) - len(new_ids) < len(self._derived_node_ids)
+        if not new_ids and not removed:
+            return
+        new_nodes = self.index.docstore.get_nodes(new_ids) if new_ids else []
+        if self.multivector_index is not None:
+            texts = [node.get_content(metadata_mode=MetadataMode.EMBED) for node in new_nodes]
+            self.multivector_index = self.multivector_index.updated(
+                node_ids, dict(zip(new_ids, token_embeddings(Settings.embed_model, texts))) if texts else {}
+            )
+        if self.metadata_columns is not None:
+            self.metadata_columns = self.metadata_columns.updated(
+                node_ids, {node.node_id: (node.ref_doc_id or "", node.metadata) for node in new_nodes}
+            )
+        if self.title_index is not None:
+            live_doc_ids = None
+            if removed:
+                vector_store = self.index.vector_store
+                ref_doc_ids = vector_store.ref_doc_ids if isinstance(vector_store, FlatVectorStore) else self.index.ref_doc_info
+                # Nodes without a source document are titled under their own id
+                live_doc_ids = set(ref_doc_ids) | set(node_ids)
+            self.title_index = self.title_index.updated(live_doc_ids, self._document_titles(new_nodes))
+        self._derived_node_ids = set(node_ids)
+        print(f"Derived structures updated: {len(new_ids)} nodes added, {len(node_ids)} in total.")
+
+    def build_metadata_columns(self) -> MetadataColumns:
+        """
+        Dictionary-encode the configured metadata fields of every node into columns
+        that src.index_views exposes as NumPy arrays.
+        """
+        if not self.index:
+            raise RuntimeError("Build or load the index before the metadata columns.")
+        nodes = self._nodes_in_row_order()
+        metadata_columns = MetadataColumns.build(
+            [node.node_id for node in nodes],
+            [node.ref_doc_id or "" for node in nodes],
+            [node.metadata for node in nodes],
+            self.metadata_column_fields
+        )
+        print(f"Metadata columns built: {', '.join(metadata_columns.fields)} ({metadata_columns.nbytes / 2**20:.1f} MB).")
+        return metadata_columns
+
+    def build_title_index(self) -> TitleIndex:
+        """
+        Index the title of every source document for typeahead search (see src.title_index).
+        The title is the node metadata field title_index_field, or else the
+        "title_index_field: value" line DocumentLoader writes into the text.
+        """
+        if not self.index:
+            raise RuntimeError("Build or load the index before the title index.")
+        titles = self._document_titles(self._nodes_in_row_order())
+        title_index = TitleIndex.build(list(titles), list(titles.values()))
+        print(f"Title index built: {len(title_index)} titles ({title_index.nbytes / 2**20:.1f} MB).")
+        return title_index
+
+    def _document_titles(self, nodes: Sequence[BaseNode]) -> Dict[str, str]:
+        """Title per source document of `nodes`, taken from its first node that has one."""
+        prefix = f"{self.title_index_field}: "
+        titles = {}
+        for node in nodes:
+            doc_id = node.ref_doc_id or node.node_id
+            if doc_id in titles:
+                continue
+            title = node.metadata.get(self.title_index_field)
+            if title is None:
+                title = next((line[len(prefix):] for line in node.get_content().split("\n") if line.startswith(prefix)), None)
+            if title:
+                titles[doc_id] = str(title)
+        return titles
+
+    def load_title_index(self) -> TitleIndex:
+        """Load the persisted title index, building and persisting it if missing."""
+        title_index = self._load_sidecar(TITLE_INDEX_HEADER, TitleIndex.from_bundle, TitleIndex.load, TitleIndex.exists)
+        if title_index is not None:
+            return title_index
+        print("No title index found in storage; building it from the docstore.")
+        self.title_index = self.build_title_index()
+        self.persist()
+        return self.title_index
+
+    def search_titles(self, query: str, limit: int = 10) -> List[str]:
+        """Typeahead: ids of documents whose title starts with, contains a word starting with, or nearly matches `query`."""
+        if self.title_index is None:
+            raise RuntimeError("Title index not built; set title_index_enabled.")
+        return self.title_index.search(query, limit=limit)
+
+    def _load_sidecar(self, header_section: str, from_bundle, from_dir, exists_in_dir):
+        """
+        Load a structure persisted next to the index, from the bundle when present, else from storage_dir.
+        Returns None if it was never persisted.
+        """
+        if os.path.exists(self.bundle_path):
+            bundle = IndexBundle(self.bundle_path)
+            try:
+                # Arrays are views into the bundle mapping, which they keep alive after close().
+                return from_bundle(bundle) if header_section in bundle else None
+            finally:
+                bundle.close()
+        if exists_in_dir(self.storage_dir):
+            return from_dir(self.storage_dir)
+        return None
+
+    def load_metadata_columns(self) -> MetadataColumns:
+        """
+        Load the persisted metadata columns, building and persisting them if missing
+        or if the configured fields changed.
+        """
+        metadata_columns = self._load_sidecar(METADATA_HEADER, MetadataColumns.from_bundle, MetadataColumns.load, MetadataColumns.exists)
+        if metadata_columns is not None and metadata_columns.fields == list(self.metadata_column_fields):
+            return metadata_columns
+        print("Metadata columns missing or outdated; building them from the docstore.")
+        self.metadata_columns = self.build_metadata_columns()
+        self.persist()
+        return self.metadata_columns
+
+    def load_multivector_index(self) -> MultiVectorIndex:
+        """
+        Load the persisted multi-vector index (from the bundle when present).
+        If none was persisted, e.g. it was enabled after the index was built, build and persist it now.
+        """
+        multivector_index = self._load_sidecar(MULTIVECTOR_HEADER, MultiVectorIndex.from_bundle, MultiVectorIndex.load, MultiVectorIndex.exists)
+        if multivector_index is not None:
+            return multivector_index
+        print("No multi-vector index found in storage; building it from the docstore.")
+        self.multivector_index = self.build_multivector_index()
+        self.persist()
+        return self.multivector_index
+
+    def _storage_context_from_bundle(self) -> StorageContext:
+        """
+        Rebuild a StorageContext from the bundle's sections. Section names are the
+        file names LlamaIndex persists, so the mapping mirrors StorageContext.from_defaults.
+        """
+        print(f"Loading storage from bundle {self.bundle_path}...")
+        self._bundle_identity = bundle_identity(self.bundle_path)
+        with IndexBundle(self.bundle_path) as bundle:
+            self.generation = int(bundle.read_json(GENERATION_FILENAME)["generation"]) if GENERATION_FILENAME in bundle else 0
+            vector_stores = {}
+            for name in bundle.names():
+                namespace, sep, fname = name.partition("__")
+                if sep and fname == "vector_store.json":
+                    data = bundle.read_json(name)
+                    if FlatVectorStore.is_flat_header(data):
+                        vector_stores[namespace] = FlatVectorStore.from_bundle(bundle, name)
+                    else:
+                        vector_stores[namespace] = SimpleVectorStore.from_dict(data)
+            return StorageContext.from_defaults(
+                docstore=self._docstore_from_bundle(bundle),
+                index_store=SimpleIndexStore.from_dict(bundle.read_json("index_store.json")),
+                graph_store=SimpleGraphStore.from_dict(bundle.read_json("graph_store.json")) if "graph_store.json" in bundle else None,
+                vector_stores=vector_stores
+            )
+
+    def _docstore_from_bundle(self, bundle: IndexBundle) -> SimpleDocumentStore:
+        """The docstore as a shared mapped segment when one was written for this generation, else parsed from JSON."""
+        if self.docstore_segment_enabled and DOCSTORE_SEGMENT_HEADER in bundle:
+            segment = JSONSegment.from_bundle(bundle)
+            if segment.generation == self.generation:
+                print(f"Docstore mapped from the bundle ({len(segment)} entries, {segment.nbytes / 2**20:.1f} MB shared).")
+                return segment_docstore(segment)
+        return SimpleDocumentStore.from_dict(bundle.read_json("docstore.json"))
+
+    def bundle_replaced(self) -> bool:
+        """
+        True when the bundle on disk is no longer the one this builder loaded, e.g. another process
+        rebuilt the index. The loaded generation stays valid (its mapping keeps the old file alive);
+        load a new IndexBuilder to serve the new one.
+        """
+        current = bundle_identity(self.bundle_path)
+        return self._bundle_identity is not None and current is not None and current != self._bundle_identity
+
     def persist(self):
         """
-        Persist the current index to disk.
+        Persist the current index to disk, then pack the persisted files into the bundle
+        and remove them from storage_dir.
         """
         if not self.index:
             raise RuntimeError("No index to persist. Build or load the index first.")
@@ -107,8 +658,281 @@ class IndexBuilder:
         self.index.storage_context.persist(
             persist_dir=self.storage_dir
         )
+        if self.multivector_index is not None:
+            self.multivector_index.save(self.storage_dir)
+        if self.metadata_columns is not None:
+            self.metadata_columns.save(self.storage_dir)
+        if self.tuning is not None:
+            self.tuning.save(self.storage_dir)
+        if self.title_index is not None:
+            self.title_index.save(self.storage_dir)
+        if self.wal is not None:
+            self._write_wal_checkpoint(self.wal.last_lsn)
+        self.generation = write_next_generation(self.storage_dir)
+        if self.docstore_segment_enabled:
+            segment = unmodified_segment(self.index.docstore)
+            if segment is None:
+                with open(os.path.join(self.storage_dir, self.docstore_filename), "r", encoding="utf-8") as f:
+                    segment = JSONSegment.build(json.load(f))
+            segment.save(self.storage_dir, generation=self.generation)
+        packed = write_bundle_from_dir(self.storage_dir, self.bundle_path)
+        if packed:
+            self._bundle_identity = bundle_identity(self.bundle_path)
+            # Loading only reads the bundle, so the loose copies are dropped. The generation
+            # file stays: the next persist() numbers its generation from it.
+            for name in packed:
+                if name != GENERATION_FILENAME:
+                    os.remove(os.path.join(self.storage_dir, name))
+            print(f"Index bundle written to {self.bundle_path} (generation {self.generation}).")
         print("Index persisted successfully.")
 
+    # --- Incremental updates ---
+
+    def _open_wal(self) -> WriteAheadLog:
+        if self.wal is None:
+            self.wal = WriteAheadLog(
+                os.path.join(self.storage_dir, WAL_PATH),
+                sync=self.config.wal_sync,
+                group_commit_ms=self.config.wal_group_commit_ms
+            )
+        return self.wal
+
+    def _read_wal_checkpoint(self) -> int:
+        if os.path.exists(self.bundle_path):
+            with IndexBundle(self.bundle_path) as bundle:
+                if WAL_CHECKPOINT_FILENAME in bundle:
+                    return int(bundle.read_json(WAL_CHECKPOINT_FILENAME)["lsn"])
+                return 0
+        path = os.path.join(self.storage_dir, WAL_CHECKPOINT_FILENAME)
+        if os.path.exists(path):
+            with open(path, "r", encoding="utf-8") as f:
+                return int(json.load(f)["lsn"])
+        return 0
+
+    def _write_wal_checkpoint(self, lsn: int):
+        path = os.path.join(self.storage_dir, WAL_CHECKPOINT_FILENAME)
+        with open(path + ".tmp", "w", encoding="utf-8") as f:
+            json.dump({"lsn": lsn}, f)
+        os.replace(path + ".tmp", path)
+
+    def replay_wal(self) -> int:
+        """
+        Re-apply logged updates newer than the persisted index's checkpoint.
+        Called by load(); logged embeddings are reused, so the model is not run.
+        Returns:
+            int: Number of records replayed.
+        """
+        wal = self._open_wal()
+        checkpoint_lsn = self._read_wal_checkpoint()
+        replayed = 0
+        for _, op, payload in wal.records(after_lsn=checkpoint_lsn):
+            if op == OP_INSERT:
+                node_json, embedding = decode_insert(payload)
+                node = json_to_doc(node_json)
+                node.embedding = embedding.tolist()
+                self.index.insert_nodes([node])
+            elif op == OP_DELETE:
+                self.index.delete_ref_doc(decode_delete(payload), delete_from_docstore=True)
+            replayed += 1
+        if replayed:
+            print(f"Replayed {replayed} write-ahead log records.")
+        return replayed
+
+    def insert_nodes(self, nodes: Sequence[BaseNode]):
+        """
+        Durably add nodes to the loaded index: embed them, log them, then apply them in memory.
+        Returns once the log records are on disk; persisted stores are only rewritten at checkpoints.
+        Safe to call from several threads, which then share log fsyncs (group commit);
+        concurrent calls must not touch the same source documents.
+        """
+        if not self.index:
+            raise RuntimeError("Build or load the index before inserting nodes.")
+        if not self.wal_enabled:
+            self.index.insert_nodes(list(nodes))
+            return
+        missing = [node for node in nodes if node.embedding is None]
+        if missing:
+            embeddings = Settings.embed_model.get_text_embedding_batch(
+                [node.get_content(metadata_mode=MetadataMode.EMBED) for node in missing]
+            )
+            for node, embedding in zip(missing, embeddings):
+                node.embedding = embedding
+        wal = self._open_wal()
+        with self._update():
+            lsn = 0
+            for node in nodes:
+                node_json = doc_to_json(node)
+                node_json["__data__"]["embedding"] = None
+                lsn = wal.append(OP_INSERT, encode_insert(node_json, node.embedding))
+            wal.commit(lsn)
+            with self._update_lock:
+                self.index.insert_nodes(list(nodes))
+        self._maybe_checkpoint()
+
+    def delete_ref_doc(self, ref_doc_id: str):
+        """Durably delete a source document's nodes from the loaded index (see insert_nodes)."""
+        if not self.index:
+            raise RuntimeError("Build or load the index before deleting documents.")
+        with self._update():
+            if self.wal_enabled:
+                wal = self._open_wal()
+                wal.commit(wal.append(OP_DELETE, encode_delete(ref_doc_id)))
+            with self._update_lock:
+                self.index.delete_ref_doc(ref_doc_id, delete_from_docstore=True)
+        self._maybe_checkpoint()
+
+    @contextmanager
+    def _update(self) -> Iterator[None]:
+        with self._updates:
+            while self._checkpointing:
+                self._updates.wait()
+            self._updates_in_flight += 1
+        try:
+            yield
+        finally:
+            with self._updates:
+                self._updates_in_flight -= 1
+                self._updates.notify_all()
+
+    def _maybe_checkpoint(self):
+        if self.wal is not None and self.wal.records_since_checkpoint >= self.wal_checkpoint_records:
+            self.checkpoint()
+
+    def checkpoint(self):
+        """
+        Fold logged updates into the persisted index: extend the derived structures with the
+        nodes added since the last checkpoint (see update_derived_structures), persist (the
+        bundle is replaced atomically and records the log position), then empty the log.
+        """
+        with self._updates:
+            if self._checkpointing:
+                return
+            self._checkpointing = True
+            while self._updates_in_flight:
+                self._updates.wait()
+        try:
+            self.update_derived_structures()
+            self.persist()
+            if self.wal is not None:
+                self.wal.reset()
+        finally:
+            with self._updates:
+                self._checkpointing = False
+                self._updates.notify_all()
+
+    def _segment_builder(self, name: str, partition_values: Optional[Sequence[str]] = None) -> "IndexBuilder":
+        """A builder for one segment: flat vectors and docstore only, derived structures are extended at merge."""
+        config = dataclasses.replace(
+            self.config,
+            storage_dir=self.segment_manifest.segment_dir(name),
+            corpus_partition_values=list(partition_values) if partition_values is not None else self.corpus_partition_values,
+            locality_order="",
+            multivector_enabled=False,
+            autotune_enabled=False,
+            metadata_column_fields=[],
+            title_index_enabled=False,
+            wal_enabled=False
+        )
+        return IndexBuilder(config, node_parser=self.node_parser)
+
+    def _load_segments(self):
+        segments = {}
+        for name in self.segment_manifest.names:
+            segment = self._segment_builder(name)
+            segment.load()
+            segments[name] = segment
+        with self._segments_lock:
+            self.segments = segments
+        print(f"Loaded {len(segments)} index segments.")
+
+    def live_segments(self) -> List[VectorStoreIndex]:
+        """Indexes of the live segments, oldest first; queries search them besides the index."""
+        with self._segments_lock:
+            return [segment.index for segment in self.segments.values()]
+
+    def add_segment(self, documents: Optional[List[Document]] = None, partition_values: Optional[Sequence[str]] = None) -> str:
+        """
+        Build `documents`, or the corpus restricted to `partition_values` (e.g. a new year's shard
+        of a bib_to_json manifest), as a new segment and make it searchable without touching the
+        index. Their document ids must not be indexed yet. Deletes (delete_ref_doc) only apply to
+        the index, so merge a segment before deleting its documents.
+        Returns:
+            str: The segment's name.
+        """
+        if not self.index:
+            raise RuntimeError("Build or load the index before adding segments.")
+        if self.vector_store_type != "flat":
+            raise ValueError("Index segments need vector_store_type 'flat'.")
+        with self._segments_lock:
+            name = self.segment_manifest.new_name()
+        segment = self._segment_builder(name, partition_values)
+        # A segment whose build was interrupted was never listed in the manifest
+        shutil.rmtree(segment.storage_dir, ignore_errors=True)
+        segment.build(documents, force_rebuild=True)
+        doc_ids = set(segment.index.vector_store.ref_doc_ids)
+        with self._segments_lock:
+            indexed = [self.index] + [live.index for live in self.segments.values()]
+            duplicates = sorted(d for d in doc_ids if any(index.docstore.get_ref_doc_info(d) is not None for index in indexed))
+            if duplicates:
+                shutil.rmtree(segment.storage_dir, ignore_errors=True)
+                raise ValueError(f"{len(duplicates)} documents are already indexed (e.g. '{duplicates[0]}').")
+            self.segments[name] = segment
+            self.segment_manifest.add(name)
+        print(f"Added segment {name} ({len(doc_ids)} documents, {len(segment.index.vector_store.node_ids)} nodes).")
+        return name
+
+    def merge_segments(self) -> int:
+        """
+        Fold the live segments into the index with their stored vectors (nothing is re-embedded),
+        then checkpoint: derived structures are extended and the index is persisted as a new
+        generation. Only then are the segments retired, so queries find their nodes throughout
+        and a merge interrupted before that is simply redone. Returns the number of segments merged.
+        """
+        if not self.index:
+            raise RuntimeError("Build or load the index before merging segments.")
+        with self._merge_lock:
+            with self._segments_lock:
+                merging = list(self.segments.items())
+            if not merging:
+                return 0
+            start = time.perf_counter()
+            merged_nodes = 0
+            for name, segment in merging:
+                store = segment.index.vector_store
+                nodes = segment.index.docstore.get_nodes(list(store.node_ids))
+                vectors = decode_vectors(store.vectors, store.dtype)
+                # Nodes already in the index were merged by an earlier, interrupted merge
+                indexed = set(self.index.vector_store.node_ids)
+                nodes = [(node, row) for row, node in enumerate(nodes) if node.node_id not in indexed]
+                for node, row in nodes:
+                    node.embedding = vectors[row].tolist()
+                with self._update():
+                    with self._update_lock:
+                        # Docstore first: queries fetch the nodes as soon as their rows are searchable
+                        self.index.docstore.add_documents([node for node, _ in nodes])
+                        self.index.insert_nodes([node for node, _ in nodes])
+                merged_nodes += len(nodes)
+            self.checkpoint()
+            self._retire_segments([name for name, _ in merging])
+            print(f"Merged {len(merging)} segments ({merged_nodes} nodes) into the index in {time.perf_counter() - start:.1f}s.")
+            return len(merging)
+
+    def start_merge(self) -> threading.Thread:
+        """Run merge_segments in a background thread; queries keep searching the segments meanwhile."""
+        thread = threading.Thread(target=self.merge_segments, name="segment-merge", daemon=True)
+        thread.start()
+        return thread
+
+    def _retire_segments(self, names: Sequence[str]):
+        if not names:
+            return
+        with self._segments_lock:
+            for name in names:
+                self.segments.pop(name, None)
+            self.segment_manifest.remove(names)
+        for name in names:
+            shutil.rmtree(self.segment_manifest.segment_dir(name), ignore_errors=True)
+
     def get_index(self) -> VectorStoreIndex:
         """
         Return the underlying VectorStoreIndex object.
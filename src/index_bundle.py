@@ -0,0 +1,257 @@
+import io
+import os
+import json
+import mmap
+import struct
+from contextlib import ExitStack
+import numpy as np
+from typing import Dict, List, Optional, Any
+
+# google-crc32c uses the SSE4.2 crc32 instruction when the CPU has it.
+try:
+    import google_crc32c
+except ImportError:
+    google_crc32c = None
+
+BUNDLE_MAGIC = b"ARAGBNDL"
+BUNDLE_VERSION = 1
+SECTION_ALIGNMENT = 64
+
+# magic, version, section_count, table_offset, table_length, table_crc
+_HEADER = struct.Struct("<8sIIQQI")
+HEADER_SIZE = 64
+# name, offset, length, crc32c
+_SECTION_ENTRY = struct.Struct("<64sQQI")
+# Upper bound on an .npy header (magic + version + length field + header text)
+_NPY_HEADER_MAX = 65536 + 12
+
+
+class BundleFormatError(ValueError):
+    """Raised when a bundle file is malformed or fails checksum verification."""
+
+
+def _make_crc32c_table() -> List[int]:
+    table = []
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x82F63B78 if crc & 1 else crc >> 1
+        table.append(crc)
+    return table
+
+
+_CRC32C_TABLE = _make_crc32c_table()
+_CRC_CHUNK_BYTES = 1 << 20
+
+
+def crc32c(data) -> int:
+    """
+    CRC32C (Castagnoli) of a bytes-like object.
+    Uses the hardware-accelerated google-crc32c extension when installed and a
+    table-driven fallback otherwise.
+    """
+    if google_crc32c is not None:
+        # The extension only accepts bytes; feed large views in bounded chunks.
+        view = memoryview(data)
+        crc = 0
+        for start in range(0, len(view), _CRC_CHUNK_BYTES):
+            crc = google_crc32c.extend(crc, bytes(view[start:start + _CRC_CHUNK_BYTES]))
+        return crc
+    crc = 0xFFFFFFFF
+    table = _CRC32C_TABLE
+    view = memoryview(data)
+    for start in range(0, len(view), _CRC_CHUNK_BYTES):
+        for byte in bytes(view[start:start + _CRC_CHUNK_BYTES]):
+            crc = table[(crc ^ byte) & 0xFF] ^ (crc >> 8)
+    return crc ^ 0xFFFFFFFF
+
+
+def _align(offset: int) -> int:
+    return (offset + SECTION_ALIGNMENT - 1) // SECTION_ALIGNMENT * SECTION_ALIGNMENT
+
+
+def write_bundle(sections: Dict[str, bytes], bundle_path: str) -> None:
+    """
+    Writes named sections into a single bundle file.
+
+    Layout: a 64-byte header, the section table, then each section's payload
+    starting on a 64-byte boundary. Every section carries its own CRC32C.
+    The file is written next to `bundle_path` and renamed into place, so readers
+    never observe a half-written bundle.
+
+    Args:
+        sections (Dict[str, bytes]): Section name -> payload (any bytes-like object, e.g. an mmap). Names must fit in 64 UTF-8 bytes.
+        bundle_path (str): Destination file.
+    """
+    names = sorted(sections)
+    table_offset = HEADER_SIZE
+    table_length = _SECTION_ENTRY.size * len(names)
+    offset = _align(table_offset + table_length)
+
+    entries = []
+    layout = []
+    for name in names:
+        encoded_name = name.encode("utf-8")
+        if len(encoded_name) > 64:
+            raise ValueError(f"Section name too long for bundle: {name}")
+        payload = sections[name]
+        entries.append(_SECTION_ENTRY.pack(encoded_name, offset, len(payload), crc32c(payload)))
+        layout.append((offset, payload))
+        offset = _align(offset + len(payload))
+    table = b"".join(entries)
+
+    header = _HEADER.pack(BUNDLE_MAGIC, BUNDLE_VERSION, len(names), table_offset, table_length, crc32c(table))
+    tmp_path = bundle_path + ".tmp"
+    with open(tmp_path, "wb") as f:
+        f.write(header.ljust(HEADER_SIZE, b"\0"))
+        f.write(table)
+        for section_offset, payload in layout:
+            f.seek(section_offset)
+            f.write(payload)
+        f.truncate(offset)
+        f.flush()
+        os.fsync(f.fileno())
+    os.replace(tmp_path, bundle_path)
+
+
+def write_bundle_from_dir(storage_dir: str, bundle_path: str) -> List[str]:
+    """
+    Packs every regular file directly inside `storage_dir` into a bundle at `bundle_path`.
+    The bundle itself and leftover temporary files are skipped. Files are memory-mapped rather
+    than read, so packing a large index does not copy it into this process's memory.
+
+    Returns:
+        List[str]: Names of the packed sections (empty if nothing was written).
+    """
+    bundle_name = os.path.basename(bundle_path)
+    sections: Dict[str, bytes] = {}
+    with ExitStack() as stack:
+        for name in sorted(os.listdir(storage_dir)):
+            path = os.path.join(storage_dir, name)
+            if name == bundle_name or name.endswith(".tmp") or not os.path.isfile(path):
+                continue
+            f = stack.enter_context(open(path, "rb"))
+            # Empty files cannot be mapped
+            sections[name] = stack.enter_context(mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)) if os.fstat(f.fileno()).st_size else b""
+        if sections:
+            write_bundle(sections, bundle_path)
+    return list(sections)
+
+
+class IndexBundle:
+    """
+    Read-only view of a bundle file, backed by a single mmap.
+
+    Sections are returned as zero-copy memoryviews into the mapping. Checksums are
+    verified lazily: a section is checked the first time it is read, so opening a
+    bundle costs one header and table parse regardless of its size.
+
+    Args:
+        bundle_path (str): Path to the bundle file.
+        verify (bool): If False, skip per-section CRC checks (the table is always checked).
+    """
+    def __init__(self, bundle_path: str, verify: bool = True):
+        self.bundle_path = bundle_path
+        self.verify = verify
+        self._file = open(bundle_path, "rb")
+        try:
+            self._mmap = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        except ValueError:
+            self._file.close()
+            raise BundleFormatError(f"Bundle {bundle_path} is empty.")
+        self._view = memoryview(self._mmap)
+        self._sections: Dict[str, tuple] = {}
+        self._verified: set = set()
+        try:
+            self._parse_table()
+        except BundleFormatError:
+            self.close()
+            raise
+
+    def _parse_table(self):
+        if len(self._view) < HEADER_SIZE:
+            raise BundleFormatError(f"Bundle {self.bundle_path} is truncated (no header).")
+        magic, version, count, table_offset, table_length, table_crc = _HEADER.unpack_from(self._view, 0)
+        if magic != BUNDLE_MAGIC:
+            raise BundleFormatError(f"{self.bundle_path} is not an index bundle.")
+        if version != BUNDLE_VERSION:
+            raise BundleFormatError(f"Unsupported bundle version {version} in {self.bundle_path}.")
+        if table_length != count * _SECTION_ENTRY.size or table_offset + table_length > len(self._view):
+            raise BundleFormatError(f"Bundle {self.bundle_path} has a corrupt section table.")
+        table = self._view[table_offset:table_offset + table_length]
+        if crc32c(table) != table_crc:
+            raise BundleFormatError(f"Section table checksum mismatch in {self.bundle_path}.")
+        for i in range(count):
+            raw_name, offset, length, crc = _SECTION_ENTRY.unpack_from(table, i * _SECTION_ENTRY.size)
+            if offset % SECTION_ALIGNMENT or offset + length > len(self._view):
+                raise BundleFormatError(f"Bundle {self.bundle_path} has an out-of-range section.")
+            self._sections[raw_name.rstrip(b"\0").decode("utf-8")] = (offset, length, crc)
+
+    def names(self) -> List[str]:
+        """Returns the section names stored in the bundle."""
+        return list(self._sections)
+
+    def __contains__(self, name: str) -> bool:
+        return name in self._sections
+
+    def section(self, name: str) -> memoryview:
+        """
+        Returns a zero-copy view of a section, verifying its checksum on first access.
+        Raises KeyError if absent and BundleFormatError on checksum mismatch.
+        """
+        offset, length, crc = self._sections[name]
+        view = self._view[offset:offset + length]
+        if self.verify and name not in self._verified:
+            if crc32c(view) != crc:
+                raise BundleFormatError(f"Checksum mismatch for section '{name}' in {self.bundle_path}.")
+            self._verified.add(name)
+        return view
+
+    def read_json(self, name: str) -> Any:
+        """Decodes a JSON section."""
+        return json.loads(bytes(self.section(name)))
+
+    def read_array(self, name: str) -> np.ndarray:
+        """
+        Returns a read-only NumPy array over a section holding an .npy file, without copying.
+        NumPy pads .npy headers to 64 bytes, so the data stays 64-byte aligned inside the mapping.
+        """
+        view = self.section(name)
+        header = io.BytesIO(bytes(view[:min(len(view), _NPY_HEADER_MAX)]))
+        version = np.lib.format.read_magic(header)
+        if version == (1, 0):
+            shape, fortran_order, dtype = np.lib.format.read_array_header_1_0(header)
+        else:
+            shape, fortran_order, dtype = np.lib.format.read_array_header_2_0(header)
+        count = int(np.prod(shape)) if shape else 1
+        array = np.frombuffer(view, dtype=dtype, count=count, offset=header.tell())
+        return array.reshape(shape, order="F" if fortran_order else "C")
+
+    def verify_all(self) -> None:
+        """Eagerly verifies every section."""
+        for name in self._sections:
+            self.section(name)
+
+    def close(self):
+        # Views and arrays handed out by section()/read_array() keep the mapping alive; only release ours.
+        self._view.release()
+        try:
+            self._mmap.close()
+        except BufferError:
+            pass
+        self._file.close()
+
+    def __enter__(self) -> "IndexBundle":
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+if __name__ == "__main__": #script testing
+    # python -m src.index_bundle ./storage/index.bundle
+    import sys
+    path = sys.argv[1] if len(sys.argv) > 1 else "./storage/index.bundle"
+    with IndexBundle(path) as bundle:
+        for section_name in bundle.names():
+            print(f"{section_name}: {len(bundle.section(section_name))} bytes, checksum OK")
@@ -0,0 +1,84 @@
+"""
+Independently built index segments, merged into the main index in the background (as LSM trees do).
+
+New papers do not need a rebuild of the whole index: IndexBuilder.add_segment builds a batch
+(e.g. one new year of a bib_to_json manifest) as its own small index under
+storage_dir/segments/<name>/ and lists it in the segment manifest. Queries search the main
+index and every live segment and merge their top-k (retrievers.SegmentedRetriever).
+IndexBuilder.merge_segments, or start_merge in a background thread, folds the live segments
+into the main index with their stored vectors (nothing is re-embedded), rebuilds the main
+index's derived structures, persists it as a new generation and then retires the segments.
+Queries keep searching the segments until then; a node found in both is returned once.
+"""
+import os
+import json
+from typing import List, Sequence, Tuple
+
+import numpy as np
+
+# A subdirectory, so write_bundle_from_dir does not pack segments into the main bundle
+SEGMENTS_DIR = "segments"
+SEGMENT_MANIFEST_FILENAME = "manifest.json"
+
+class SegmentManifest:
+    """
+    Names of an index's live segments, oldest first, in storage_dir/segments/manifest.json.
+    Every change is written to a temporary file and renamed into place.
+    """
+    def __init__(self, storage_dir: str):
+        self.directory = os.path.join(storage_dir, SEGMENTS_DIR)
+        self.path = os.path.join(self.directory, SEGMENT_MANIFEST_FILENAME)
+        self.names: List[str] = []
+        self.next_id = 1
+        try:
+            with open(self.path, "r", encoding="utf-8") as f:
+                data = json.load(f)
+        except FileNotFoundError:
+            return
+        self.names = list(data["segments"])
+        self.next_id = int(data["next_id"])
+
+    def segment_dir(self, name: str) -> str:
+        return os.path.join(self.directory, name)
+
+    def new_name(self) -> str:
+        """Reserves the name of the next segment; it only becomes live once added."""
+        name = f"segment-{self.next_id:06d}"
+        self.next_id += 1
+        return name
+
+    def add(self, name: str):
+        self.names.append(name)
+        self._save()
+
+    def remove(self, names: Sequence[str]):
+        retired = set(names)
+        self.names = [name for name in self.names if name not in retired]
+        self._save()
+
+    def _save(self):
+        os.makedirs(self.directory, exist_ok=True)
+        tmp_path = self.path + ".tmp"
+        with open(tmp_path, "w", encoding="utf-8") as f:
+            json.dump({"segments": self.names, "next_id": self.next_id}, f)
+        os.replace(tmp_path, self.path)
+
+def merge_top_k(results: Sequence[Tuple[Sequence[str], np.ndarray]], k: int) -> Tuple[List[str], np.ndarray]:
+    """
+    Merges per-segment (node_ids, scores) top-k lists into one, best first. A node found in
+    several segments (the main index and a segment being merged into it) is kept once;
+    ties keep the earlier list's node.
+    """
+    node_ids = [node_id for ids, _ in results for node_id in ids]
+    if not node_ids or k <= 0:
+        return [], np.empty(0, dtype=np.float32)
+    scores = np.concatenate([np.asarray(s, dtype=np.float32) for _, s in results])
+    seen = set()
+    top: List[int] = []
+    for row in np.argsort(-scores, kind="stable").tolist():
+        if node_ids[row] not in seen:
+            seen.add(node_ids[row])
+            top.append(row)
+            if len(top) == k:
+                break
+    return [node_ids[row] for row in top], scores[top]
@@ -0,0 +1,282 @@
+"""
+Read-only NumPy views over a persisted index, for offline analytics and evaluation.
+
+Embeddings, node/doc id arrays and metadata columns are returned as views over the
+memory-mapped files (or over the index bundle's mapping) without copying, so a full
+index can be scanned in Python at the cost of its page cache only. Nothing here
+imports LlamaIndex.
+
+    views = IndexViews.open("./storage")
+    for start, block in views.iter_float32_blocks():
+        ...  # block is (rows, D) float32, rows aligned with views.node_ids[start:]
+"""
+import os
+import json
+from typing import Any, Dict, Iterator, List, Optional, Sequence, Tuple
+
+import numpy as np
+
+from src.index_bundle import IndexBundle
+from src.kernels import BLOCK_ROWS, decode_vectors, facet_counts
+
+METADATA_PREFIX = "metadata"
+METADATA_HEADER = f"{METADATA_PREFIX}.json"
+# Code of a node that has no value for a column
+MISSING_CODE = -1
+
+def encode_ids(ids: Sequence[str]) -> np.ndarray:
+    """Packs string ids into a fixed-width UTF-8 bytes array ('S' dtype), the on-disk id format."""
+    encoded = [i.encode("utf-8") for i in ids]
+    width = max((len(e) for e in encoded), default=1) or 1
+    return np.array(encoded, dtype=f"S{width}")
+
+def decode_ids(ids: np.ndarray) -> List[str]:
+    """Inverse of encode_ids (copies into Python strings)."""
+    return [i.decode("utf-8") for i in ids.tolist()]
+
+def flat_store_files(header_filename: str) -> Dict[str, str]:
+    """
+    Companion .npy files of a FlatVectorStore header, e.g. default__vector_store.vectors.npy,
+    default__vector_store.node_ids.npy and default__vector_store.ref_doc_ids.npy.
+    """
+    stem = os.path.splitext(header_filename)[0]
+    return {part: f"{stem}.{part}.npy" for part in ("vectors", "node_ids", "ref_doc_ids")}
+
+def read_only(array: np.ndarray) -> np.ndarray:
+    """A non-writeable view of `array` (no copy)."""
+    view = array.view()
+    view.flags.writeable = False
+    return view
+
+def _save_npy(path: str, array: np.ndarray):
+    with open(path + ".tmp", "wb") as f:
+        np.save(f, array)
+    os.replace(path + ".tmp", path)
+
+def _encode_value(value: Any, index_of: Dict[Any, int]) -> int:
+    """Dictionary code of a metadata value, adding it to `index_of` if new; lists and dicts are keyed by their JSON."""
+    if value is None:
+        return MISSING_CODE
+    if isinstance(value, (list, dict)):
+        value = json.dumps(value, sort_keys=True)
+    return index_of.setdefault(value, len(index_of))
+
+class MetadataColumns:
+    """
+    Node metadata stored column-wise. Each field is dictionary-encoded: an int32 code per
+    node row (MISSING_CODE when absent) plus the list of distinct values. Rows follow
+    `node_ids`, which IndexBuilder keeps in the same order as the vector store rows.
+
+    Args:
+        node_ids (np.ndarray): 'S' array of node ids, one per row.
+        ref_doc_ids (np.ndarray): 'S' array of source document ids, one per row.
+        dictionaries (Dict[str, List[Any]]): Distinct values per field; codes index into these.
+        codes (Dict[str, np.ndarray]): int32 code arrays per field.
+    """
+    def __init__(self, node_ids: np.ndarray, ref_doc_ids: np.ndarray, dictionaries: Dict[str, List[Any]], codes: Dict[str, np.ndarray]):
+        self._node_ids = node_ids
+        self._ref_doc_ids = ref_doc_ids
+        self.dictionaries = dictionaries
+        self._codes = codes
+
+    @classmethod
+    def build(
+        cls,
+        node_ids: Sequence[str],
+        ref_doc_ids: Sequence[str],
+        metadata: Sequence[Dict[str, Any]],
+        fields: Sequence[str]
+    ) -> "MetadataColumns":
+        dictionaries: Dict[str, List[Any]] = {}
+        codes: Dict[str, np.ndarray] = {}
+        for field in fields:
+            index_of: Dict[Any, int] = {}
+            column = np.full(len(metadata), MISSING_CODE, dtype=np.int32)
+            for row, entry in enumerate(metadata):
+                column[row] = _encode_value(entry.get(field), index_of)
+            dictionaries[field] = list(index_of)
+            codes[field] = column
+        return cls(encode_ids(node_ids), encode_ids(ref_doc_ids), dictionaries, codes)
+
+    def updated(self, node_ids: Sequence[str], new_nodes: Dict[str, Tuple[str, Dict[str, Any]]]) -> "MetadataColumns":
+        """
+        Columns over `node_ids`, in that order. Nodes already covered keep their codes; the others
+        come from `new_nodes` (node id -> (ref doc id, metadata)), extending the dictionaries.
+        """
+        row_of = {node_id: row for row, node_id in enumerate(decode_ids(self._node_ids))}
+        rows = np.array([row_of.get(node_id, -1) for node_id in node_ids], dtype=np.int64)
+        known = rows >= 0
+        added = np.flatnonzero(~known)
+        old_ref_doc_ids = self._ref_doc_ids.tolist()
+        ref_doc_ids = [
+            old_ref_doc_ids[row].decode("utf-8") if row >= 0 else new_nodes[node_id][0]
+            for node_id, row in zip(node_ids, rows.tolist())
+        ]
+        dictionaries: Dict[str, List[Any]] = {}
+        codes: Dict[str, np.ndarray] = {}
+        for field in self.fields:
+            index_of = {value: code for code, value in enumerate(self.dictionaries[field])}
+            column = np.full(len(node_ids), MISSING_CODE, dtype=np.int32)
+            column[known] = np.asarray(self._codes[field])[rows[known]]
+            for row in added.tolist():
+                column[row] = _encode_value(new_nodes[node_ids[row]][1].get(field), index_of)
+            dictionaries[field] = list(index_of)
+            codes[field] = column
+        return MetadataColumns(encode_ids(node_ids), encode_ids(ref_doc_ids), dictionaries, codes)
+
+    # --- Views ---
+
+    def __len__(self) -> int:
+        return len(self._node_ids)
+
+    @property
+    def fields(self) -> List[str]:
+        return list(self.dictionaries)
+
+    @property
+    def node_ids(self) -> np.ndarray:
+        """Read-only 'S' array of node ids, aligned with the code arrays."""
+        return read_only(self._node_ids)
+
+    @property
+    def ref_doc_ids(self) -> np.ndarray:
+        """Read-only 'S' array of source document ids, aligned with the code arrays."""
+        return read_only(self._ref_doc_ids)
+
+    def codes(self, field: str) -> np.ndarray:
+        """Read-only int32 codes of `field` (index into dictionaries[field], MISSING_CODE if absent)."""
+        return read_only(self._codes[field])
+
+    def values(self, field: str) -> np.ndarray:
+        """Decoded values of `field` as an object array (this one copies); None where missing."""
+        lookup = np.array(self.dictionaries[field] + [None], dtype=object)
+        return lookup[self._codes[field]]
+
+    def aligned_codes(self, field: str, node_ids: np.ndarray) -> np.ndarray:
+        """
+        Codes of `field` for the rows of another store, given its 'S' node id array.
+        A read-only view when the rows already line up; otherwise remapped by node id,
+        with MISSING_CODE for nodes the columns do not cover.
+        """
+        if len(node_ids) == len(self._node_ids) and np.array_equal(node_ids, self._node_ids):
+            return self.codes(field)
+        row_of = {node_id: row for row, node_id in enumerate(self._node_ids.tolist())}
+        rows = np.fromiter((row_of.get(node_id, -1) for node_id in node_ids.tolist()), dtype=np.int64, count=len(node_ids))
+        codes = np.asarray(self._codes[field])[np.maximum(rows, 0)]
+        codes[rows < 0] = MISSING_CODE
+        return codes
+
+    def facet_counts(self, field: str, codes: np.ndarray, rows: Optional[np.ndarray] = None) -> Dict[Any, int]:
+        """
+        Hit counts per value of `field` over `rows` (None: all rows), most frequent first.
+        `codes` are this field's codes in the rows' numbering (see aligned_codes).
+        """
+        counts = facet_counts(codes, rows, len(self.dictionaries[field]))
+        values = self.dictionaries[field]
+        return {values[v]: int(counts[v]) for v in np.argsort(-counts, kind="stable") if counts[v]}
+
+    @property
+    def nbytes(self) -> int:
+        return self._node_ids.nbytes + self._ref_doc_ids.nbytes + sum(c.nbytes for c in self._codes.values())
+
+    # --- Persistence ---
+
+    def save(self, directory: str):
+        """Writes the header and arrays into `directory` (temporary files, then rename)."""
+        os.makedirs(directory, exist_ok=True)
+        _save_npy(os.path.join(directory, metadata_filename("node_ids")), self._node_ids)
+        _save_npy(os.path.join(directory, metadata_filename("ref_doc_ids")), self._ref_doc_ids)
+        for field, column in self._codes.items():
+            _save_npy(os.path.join(directory, metadata_filename(f"{field}.codes")), column)
+        header_path = os.path.join(directory, METADATA_HEADER)
+        with open(header_path + ".tmp", "w", encoding="utf-8") as f:
+            json.dump({"fields": self.fields, "dictionaries": self.dictionaries}, f)
+        os.replace(header_path + ".tmp", header_path)
+
+    @staticmethod
+    def exists(directory: str) -> bool:
+        return os.path.exists(os.path.join(directory, METADATA_HEADER))
+
+    @classmethod
+    def _from_header(cls, header: Dict[str, Any], read_array) -> "MetadataColumns":
+        return cls(
+            read_array(metadata_filename("node_ids")),
+            read_array(metadata_filename("ref_doc_ids")),
+            {field: header["dictionaries"][field] for field in header["fields"]},
+            {field: read_array(metadata_filename(f"{field}.codes")) for field in header["fields"]}
+        )
+
+    @classmethod
+    def load(cls, directory: str) -> "MetadataColumns":
+        """Loads columns saved with save(); arrays are memory-mapped read-only."""
+        with open(os.path.join(directory, METADATA_HEADER), "r", encoding="utf-8") as f:
+            header = json.load(f)
+        return cls._from_header(header, lambda name: np.load(os.path.join(directory, name), mmap_mode="r"))
+
+    @classmethod
+    def from_bundle(cls, bundle: IndexBundle) -> "MetadataColumns":
+        """Loads columns as zero-copy views into the bundle mapping."""
+        return cls._from_header(bundle.read_json(METADATA_HEADER), bundle.read_array)
+
+def metadata_filename(name: str) -> str:
+    return f"{METADATA_PREFIX}.{name}.npy"
+
+class IndexViews:
+    """
+    Read-only views of a persisted flat vector store and its metadata columns.
+    Open with IndexViews.open(storage_dir); prefers the index bundle when present.
+
+    Attributes:
+        vectors (np.ndarray): (N, D) embeddings in their storage format (bfloat16 as raw uint16).
+        dtype (str): Storage format of `vectors`.
+        node_ids (np.ndarray): 'S' node ids, one per row of `vectors`.
+        ref_doc_ids (np.ndarray): 'S' source document ids, one per row of `vectors`.
+        columns (Optional[MetadataColumns]): Metadata columns, if they were built.
+    """
+    def __init__(self, vectors: np.ndarray, dtype: str, node_ids: np.ndarray, ref_doc_ids: np.ndarray,
+                 columns: Optional[MetadataColumns] = None, bundle: Optional[IndexBundle] = None):
+        self.vectors = read_only(vectors)
+        self.dtype = dtype
+        self.node_ids = read_only(node_ids)
+        self.ref_doc_ids = read_only(ref_doc_ids)
+        self.columns = columns
+        self._bundle = bundle
+
+    @classmethod
+    def open(cls, storage_dir: str, bundle_filename: str = "index.bundle", vector_store_filename: str = "default__vector_store.json") -> "IndexViews":
+        bundle_path = os.path.join(storage_dir, bundle_filename)
+        names = flat_store_files(vector_store_filename)
+        if os.path.exists(bundle_path):
+            bundle = IndexBundle(bundle_path)
+            header = bundle.read_json(vector_store_filename)
+            columns = MetadataColumns.from_bundle(bundle) if METADATA_HEADER in bundle else None
+            return cls(bundle.read_array(names["vectors"]), header["dtype"], bundle.read_array(names["node_ids"]),
+                       bundle.read_array(names["ref_doc_ids"]), columns, bundle)
+        with open(os.path.join(storage_dir, vector_store_filename), "r", encoding="utf-8") as f:
+            header = json.load(f)
+        load = lambda name: np.load(os.path.join(storage_dir, name), mmap_mode="r")
+        columns = MetadataColumns.load(storage_dir) if MetadataColumns.exists(storage_dir) else None
+        return cls(load(names["vectors"]), header["dtype"], load(names["node_ids"]), load(names["ref_doc_ids"]), columns)
+
+    def __len__(self) -> int:
+        return len(self.node_ids)
+
+    def iter_float32_blocks(self, block_rows: int = BLOCK_ROWS) -> Iterator[Tuple[int, np.ndarray]]:
+        """
+        Yields (start_row, block) with each block widened to float32 in a reused buffer,
+        so half-precision indexes can be processed without a full float32 copy.
+        Consume each block before advancing; the buffer is overwritten.
+        """
+        n_rows = len(self.vectors)
+        if self.dtype == "float32":
+            for start in range(0, n_rows, block_rows):
+                yield start, self.vectors[start:start + block_rows]
+            return
+        buffer = np.empty((min(block_rows, n_rows), self.vectors.shape[1]), dtype=np.float32)
+        for start in range(0, n_rows, block_rows):
+            stop = min(start + block_rows, n_rows)
+            yield start, decode_vectors(self.vectors[start:stop], self.dtype, out=buffer[:stop - start])
+
+    def close(self):
+        if self._bundle is not None:
+            self._bundle.close()
@@ -0,0 +1,539 @@
+"""
+Vectorized search kernels shared by the native vector stores.
+
+Everything here works on plain NumPy arrays so it can run over memory-mapped
+storage without copying, and so it stays testable without LlamaIndex.
+Half-precision scans use the C kernels in native/vector_kernels.c when the shared
+library has been built, and fall back to blockwise NumPy otherwise.
+"""
+import os
+import ctypes
+import asyncio
+import threading
+import functools
+import contextvars
+import numpy as np
+from concurrent.futures import ThreadPoolExecutor
+from typing import Any, Callable, Dict, List, Optional, Tuple
+
+from src.deadlines import Deadline
+
+# Storage formats for embedding matrices
+STORAGE_DTYPES = ("float32", "float16", "bfloat16")
+
+# Rows decoded per step of a scan. A block of 384-dim float32 rows is ~3 MB, which keeps
+# the widened copy cache-resident while the dot products run over it.
+BLOCK_ROWS = 2048
+
+# Rows scanned between deadline checks in flat_top_k (a few milliseconds of work at 384 dims)
+DEADLINE_CHECK_ROWS = 16 * BLOCK_ROWS
+
+# Granularity at which a masked scan skips rows: blocks without any allowed row are not scored
+MASK_BLOCK_ROWS = 256
+
+_DEFAULT_NATIVE_LIB = os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), "native", "libvector_kernels.so")
+
+def _load_native_kernels() -> Optional[ctypes.CDLL]:
+    """Loads the optional C kernels. ctypes.CDLL releases the GIL for the duration of each call."""
+    path = os.environ.get("RAG_VECTOR_KERNELS", _DEFAULT_NATIVE_LIB)
+    try:
+        lib = ctypes.CDLL(path)
+    except OSError:
+        return None
+    scan_args = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_void_p]
+    for fn in (lib.vk_scores_f16, lib.vk_scores_bf16):
+        fn.argtypes = scan_args
+        fn.restype = None
+    lib.vk_maxsim_f32.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_void_p,
+                                  ctypes.c_size_t, ctypes.c_size_t, ctypes.c_void_p]
+    lib.vk_maxsim_f32.restype = ctypes.c_int
+    lib.vk_decode_residuals.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t,
+                                        ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p]
+    lib.vk_decode_residuals.restype = None
+    lib.vk_facet_counts.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_size_t, ctypes.c_void_p]
+    lib.vk_facet_counts.restype = ctypes.c_int
+    lib.vk_qgram_candidates.argtypes = [ctypes.c_void_p] * 5 + [ctypes.c_size_t, ctypes.c_size_t, ctypes.c_int32, ctypes.c_int32,
+                                                                ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t]
+    lib.vk_qgram_candidates.restype = ctypes.c_int
+    lib.vk_prefix_edit_distances.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
+                                             ctypes.c_size_t, ctypes.c_int32, ctypes.c_void_p]
+    lib.vk_prefix_edit_distances.restype = ctypes.c_int
+    lib.vk_cpu_features.restype = ctypes.c_int
+    lib.vk_disable_simd.argtypes = [ctypes.c_int]
+    return lib
+
+_native = _load_native_kernels()
+
+class KernelCounters(threading.local):
+    """
+    Per-thread work counters, bumped once per kernel call from its arguments, so they
+    are exact for both the native and the NumPy paths and cost a few integer adds.
+    Diff two snapshot()s to attribute work to one query (see src.profiling).
+    """
+    def __init__(self):
+        self.rows_scanned = 0
+        self.distance_computations = 0
+        self.tokens_decoded = 0
+
+    def snapshot(self) -> Dict[str, int]:
+        return {
+            "rows_scanned": self.rows_scanned,
+            "distance_computations": self.distance_computations,
+            "tokens_decoded": self.tokens_decoded,
+        }
+
+counters = KernelCounters()
+
+# --- Native thread pool ---
+# The C kernels (ctypes.CDLL calls), BLAS and NumPy's loops over large arrays all run without
+# the GIL, and so do the embedding and cross-encoder forward passes (torch) and fast
+# tokenizers. Search stages submitted to this pool therefore overlap across threads, and an
+# asyncio server awaiting them keeps its event loop free (see run_native).
+_pool: Optional[ThreadPoolExecutor] = None
+_pool_threads = 0
+_pool_lock = threading.Lock()
+
+def configure_native_pool(threads: int = 0):
+    """Sets the pool size (0 = one thread per CPU). Takes effect when the pool is next created."""
+    global _pool, _pool_threads
+    with _pool_lock:
+        if _pool is not None and threads != _pool_threads:
+            _pool.shutdown(wait=False)
+            _pool = None
+        _pool_threads = threads
+
+def native_pool() -> ThreadPoolExecutor:
+    """The shared pool that awaitable search stages complete on, created on first use."""
+    global _pool
+    with _pool_lock:
+        if _pool is None:
+            _pool = ThreadPoolExecutor(max_workers=_pool_threads or os.cpu_count() or 1, thread_name_prefix="native")
+        return _pool
+
+async def run_native(fn: Callable[..., Any], *args: Any, **kwargs: Any) -> Any:
+    """Awaitable fn(*args, **kwargs), run on the native pool with the caller's context variables."""
+    call = functools.partial(contextvars.copy_context().run, fn, *args, **kwargs)
+    return await asyncio.get_running_loop().run_in_executor(native_pool(), call)
+
+def native_kernels_available() -> bool:
+    """True if native/libvector_kernels.so was found and loaded."""
+    return _native is not None
+
+def numpy_storage_dtype(dtype: str) -> np.dtype:
+    """NumPy dtype used to hold vectors of the given storage format (bfloat16 is kept as raw uint16)."""
+    if dtype == "float32":
+        return np.dtype(np.float32)
+    if dtype == "float16":
+        return np.dtype(np.float16)
+    if dtype == "bfloat16":
+        return np.dtype(np.uint16)
+    raise ValueError(f"Unsupported vector storage dtype '{dtype}'. Expected one of {STORAGE_DTYPES}.")
+
+def encode_vectors(vectors: np.ndarray, dtype: str) -> np.ndarray:
+    """
+    Converts float32 vectors to the storage format.
+    bfloat16 uses round-to-nearest-even on the upper 16 bits of each float32.
+    """
+    vectors = np.ascontiguousarray(vectors, dtype=np.float32)
+    if dtype == "float32":
+        return vectors
+    if dtype == "float16":
+        return vectors.astype(np.float16)
+    if dtype == "bfloat16":
+        bits = vectors.view(np.uint32)
+        rounding = ((bits >> 16) & 1) + np.uint32(0x7FFF)
+        return ((bits + rounding) >> 16).astype(np.uint16)
+    raise ValueError(f"Unsupported vector storage dtype '{dtype}'. Expected one of {STORAGE_DTYPES}.")
+
+def decode_vectors(stored: np.ndarray, dtype: str, out: Optional[np.ndarray] = None) -> np.ndarray:
+    """
+    Widens stored vectors back to float32, optionally into a preallocated buffer.
+    float16 goes through NumPy's half-precision cast;
+    bfloat16 is a shift of the raw bits into the high half of a float32.
+    """
+    if out is None:
+        out = np.empty(stored.shape, dtype=np.float32)
+    if dtype == "float32" or dtype == "float16":
+        np.copyto(out, stored, casting="unsafe")
+    elif dtype == "bfloat16":
+        np.left_shift(stored, 16, out=out.view(np.uint32), dtype=np.uint32)
+    else:
+        raise ValueError(f"Unsupported vector storage dtype '{dtype}'. Expected one of {STORAGE_DTYPES}.")
+    return out
+
+def flat_scores(matrix: np.ndarray, query: np.ndarray, dtype: str, block_rows: int = BLOCK_ROWS) -> np.ndarray:
+    """
+    Dot product of `query` against every row of `matrix`.
+
+    float32 matrices go straight to BLAS. Half-width matrices are widened on the fly,
+    so the scan reads half the bytes from memory and never materializes a full float32
+    copy: the native kernel converts inside its FMA loop, the NumPy fallback widens one
+    block at a time into a reused buffer.
+
+    Args:
+        matrix (np.ndarray): (N, D) stored vectors in the given storage format.
+        query (np.ndarray): (D,) float32 query.
+        dtype (str): Storage format of `matrix`.
+        block_rows (int): Rows widened per step.
+    Returns:
+        np.ndarray: (N,) float32 scores.
+    """
+    query = np.ascontiguousarray(query, dtype=np.float32)
+    n_rows = matrix.shape[0]
+    counters.rows_scanned += n_rows
+    counters.distance_computations += n_rows
+    if dtype == "float32":
+        return np.asarray(matrix @ query, dtype=np.float32)
+    scores = np.empty(n_rows, dtype=np.float32)
+    if _native is not None and matrix.flags.c_contiguous and n_rows:
+        # Fused widen+FMA kernel (F16C/AVX2 with scalar fallback), one block per call.
+        scan = _native.vk_scores_f16 if dtype == "float16" else _native.vk_scores_bf16
+        dim = matrix.shape[1]
+        row_bytes = dim * matrix.itemsize
+        base = matrix.ctypes.data
+        for start in range(0, n_rows, block_rows):
+            stop = min(start + block_rows, n_rows)
+            scan(base + start * row_bytes, stop - start, dim, query.ctypes.data, scores[start:].ctypes.data)
+        return scores
+    buffer = np.empty((min(block_rows, n_rows), matrix.shape[1]), dtype=np.float32)
+    for start in range(0, n_rows, block_rows):
+        stop = min(start + block_rows, n_rows)
+        block = decode_vectors(matrix[start:stop], dtype, out=buffer[:stop - start])
+        np.matmul(block, query, out=scores[start:stop])
+    return scores
+
+def maxsim_scores(query_tokens: np.ndarray, doc_tokens: np.ndarray, offsets: np.ndarray) -> np.ndarray:
+    """
+    Late-interaction (MaxSim) scores: for each document, the sum over query tokens of the
+    best dot product with any of the document's tokens.
+
+    Args:
+        query_tokens (np.ndarray): (Q, D) float32 query token embeddings.
+        doc_tokens (np.ndarray): (T, D) float32 token embeddings of all documents, concatenated.
+        offsets (np.ndarray): (N+1,) int64; document i owns rows offsets[i]:offsets[i+1].
+    Returns:
+        np.ndarray: (N,) float32 scores; documents without tokens score 0.
+    """
+    query_tokens = np.ascontiguousarray(query_tokens, dtype=np.float32)
+    doc_tokens = np.ascontiguousarray(doc_tokens, dtype=np.float32)
+    offsets = np.ascontiguousarray(offsets, dtype=np.int64)
+    n_docs = len(offsets) - 1
+    scores = np.zeros(n_docs, dtype=np.float32)
+    if n_docs <= 0 or not len(query_tokens):
+        return scores
+    counters.distance_computations += len(query_tokens) * int(offsets[-1] - offsets[0])
+    if _native is not None:
+        status = _native.vk_maxsim_f32(
+            query_tokens.ctypes.data, query_tokens.shape[0], doc_tokens.ctypes.data, offsets.ctypes.data,
+            n_docs, query_tokens.shape[1], scores.ctypes.data
+        )
+        if status != 0:
+            raise MemoryError("vk_maxsim_f32 could not allocate its scratch buffer.")
+        return scores
+    # (Q, T) similarity matrix, max-reduced per document segment, then summed over query tokens.
+    nonempty = offsets[1:] > offsets[:-1]
+    if not nonempty.any():
+        return scores
+    similarities = query_tokens @ doc_tokens[:offsets[-1]].T
+    best = np.maximum.reduceat(similarities, offsets[:-1][nonempty], axis=1)
+    scores[nonempty] = best.sum(axis=0)
+    return scores
+
+def decode_residuals(
+    codes: np.ndarray,
+    packed: np.ndarray,
+    token_index: np.ndarray,
+    centroids: np.ndarray,
+    lut: np.ndarray
+) -> np.ndarray:
+    """
+    Reconstructs residual-coded token embeddings (see src.multivector.ResidualCodec).
+
+    Args:
+        codes (np.ndarray): (T,) int32 centroid id per token.
+        packed (np.ndarray): (T, D / per_byte) uint8 packed residual buckets.
+        token_index (np.ndarray): Tokens to decode.
+        centroids (np.ndarray): (C, D) float32.
+        lut (np.ndarray): (256, per_byte) float32 expansion of one packed byte.
+    Returns:
+        np.ndarray: (len(token_index), D) float32, L2-normalized.
+    """
+    token_index = np.ascontiguousarray(token_index, dtype=np.int64)
+    dim = centroids.shape[1]
+    counters.tokens_decoded += len(token_index)
+    if _native is not None and codes.flags.c_contiguous and packed.flags.c_contiguous and centroids.flags.c_contiguous:
+        codes = np.asarray(codes, dtype=np.int32)
+        lut = np.ascontiguousarray(lut, dtype=np.float32)
+        out = np.empty((len(token_index), dim), dtype=np.float32)
+        _native.vk_decode_residuals(
+            codes.ctypes.data, packed.ctypes.data, token_index.ctypes.data, len(token_index),
+            centroids.ctypes.data, dim, lut.ctypes.data, lut.shape[1], out.ctypes.data
+        )
+        return out
+    tokens = centroids[codes[token_index]] + lut[packed[token_index]].reshape(len(token_index), dim)
+    return tokens / np.maximum(np.linalg.norm(tokens, axis=1, keepdims=True), 1e-12)
+
+def top_k_indices(scores: np.ndarray, k: int, mask: Optional[np.ndarray] = None) -> Tuple[np.ndarray, np.ndarray]:
+    """
+    Indices and scores of the k best entries, best first.
+
+    Args:
+        scores (np.ndarray): (N,) scores.
+        k (int): Number of results.
+        mask (Optional[np.ndarray]): (N,) bool; False entries are never returned.
+    """
+    if mask is not None:
+        candidates = np.flatnonzero(mask)
+        scores = scores[candidates]
+    else:
+        candidates = None
+    k = min(k, scores.shape[0])
+    if k <= 0:
+        return np.empty(0, dtype=np.int64), np.empty(0, dtype=np.float32)
+    top = np.argpartition(-scores, k - 1)[:k]
+    top = top[np.argsort(-scores[top], kind="stable")]
+    top_scores = scores[top]
+    if candidates is not None:
+        top = candidates[top]
+    return top.astype(np.int64), top_scores.astype(np.float32)
+
+def masked_row_ranges(mask: np.ndarray, block_rows: int = MASK_BLOCK_ROWS) -> List[Tuple[int, int]]:
+    """(start, stop) row ranges made of whole blocks holding at least one allowed row; adjacent blocks merge."""
+    n_rows = len(mask)
+    if not n_rows:
+        return []
+    active = np.logical_or.reduceat(mask, np.arange(0, n_rows, block_rows))
+    edges = np.flatnonzero(np.diff(np.concatenate(([0], active.view(np.int8), [0]))))
+    return [(int(start) * block_rows, min(int(stop) * block_rows, n_rows)) for start, stop in zip(edges[0::2], edges[1::2])]
+
+def masked_top_k(
+    matrix: np.ndarray,
+    query: np.ndarray,
+    dtype: str,
+    k: int,
+    mask: np.ndarray,
+    block_rows: int = MASK_BLOCK_ROWS
+) -> Tuple[np.ndarray, np.ndarray]:
+    """
+    Exact top-k over the rows `mask` allows, scoring only the blocks that hold any of them.
+    How much is skipped depends on the row order: when rows sharing a filter value are
+    stored together (see src.locality), a selective filter reads a few contiguous ranges.
+    When most blocks are active anyway, the whole matrix is scanned in one pass.
+    """
+    ranges = masked_row_ranges(mask, block_rows)
+    if sum(stop - start for start, stop in ranges) * 2 >= matrix.shape[0]:
+        return top_k_indices(flat_scores(matrix, query, dtype), k, mask=mask)
+    if not ranges:
+        return np.empty(0, dtype=np.int64), np.empty(0, dtype=np.float32)
+    rows = np.concatenate([np.arange(start, stop) for start, stop in ranges])
+    scores = np.concatenate([flat_scores(matrix[start:stop], query, dtype) for start, stop in ranges])
+    top, top_scores = top_k_indices(scores, k, mask=mask[rows])
+    return rows[top], top_scores
+
+def flat_top_k(
+    matrix: np.ndarray,
+    query: np.ndarray,
+    dtype: str,
+    k: int,
+    mask: Optional[np.ndarray] = None,
+    deadline: Optional[Deadline] = None
+) -> Tuple[np.ndarray, np.ndarray]:
+    """
+    Exact top-k over every row of `matrix` (see flat_scores and top_k_indices).
+
+    With a deadline, rows are scanned in chunks of DEADLINE_CHECK_ROWS while a running
+    top-k is kept. Once the deadline passes, the scan stops after the current chunk,
+    returns the best rows seen so far and marks the deadline partial ("flat_scan").
+    At least one chunk is always scanned. Without a deadline, a mask skips blocks of
+    rows it excludes entirely (see masked_top_k).
+    """
+    n_rows = matrix.shape[0]
+    if deadline is None or n_rows <= DEADLINE_CHECK_ROWS:
+        if mask is not None:
+            return masked_top_k(matrix, query, dtype, k, mask)
+        return top_k_indices(flat_scores(matrix, query, dtype), k, mask=mask)
+    best_rows = np.empty(0, dtype=np.int64)
+    best_scores = np.empty(0, dtype=np.float32)
+    for start in range(0, n_rows, DEADLINE_CHECK_ROWS):
+        stop = min(start + DEADLINE_CHECK_ROWS, n_rows)
+        rows, scores = top_k_indices(
+            flat_scores(matrix[start:stop], query, dtype), k, mask=None if mask is None else mask[start:stop]
+        )
+        merged_rows = np.concatenate([best_rows, rows + start])
+        merged_scores = np.concatenate([best_scores, scores])
+        keep, best_scores = top_k_indices(merged_scores, k)
+        best_rows = merged_rows[keep]
+        if stop < n_rows and deadline.expired():
+            deadline.mark_partial("flat_scan")
+            break
+    return best_rows, best_scores
+
+def flat_top_k_with_candidates(
+    matrix: np.ndarray,
+    query: np.ndarray,
+    dtype: str,
+    k: int,
+    candidates: int,
+    min_score: Optional[float] = None,
+    mask: Optional[np.ndarray] = None
+) -> Tuple[np.ndarray, np.ndarray, np.ndarray]:
+    """
+    Exact top-k plus the candidate set around it, from one scan.
+    The candidate set is every row scoring at least `min_score` when it is given,
+    otherwise the best `candidates` rows (the top-k is always part of it).
+    Returns:
+        Tuple[np.ndarray, np.ndarray, np.ndarray]: Top-k rows, their scores, candidate rows.
+    """
+    scores = flat_scores(matrix, query, dtype)
+    if min_score is None:
+        candidate_rows, candidate_scores = top_k_indices(scores, max(k, candidates), mask=mask)
+        return candidate_rows[:k], candidate_scores[:k], candidate_rows
+    keep = scores >= min_score
+    if mask is not None:
+        keep &= mask
+    rows, top_scores = top_k_indices(scores, k, mask=mask)
+    return rows, top_scores, np.flatnonzero(keep)
+
+def rocchio_query(query: np.ndarray, feedback: np.ndarray, alpha: float, beta: float) -> np.ndarray:
+    """
+    Rocchio refinement: alpha * query + beta * centroid of the (M, D) feedback vectors,
+    normalized to unit length like the stored embeddings.
+    """
+    refined = alpha * np.asarray(query, dtype=np.float32)
+    if len(feedback):
+        refined = refined + beta * feedback.mean(axis=0, dtype=np.float32)
+    return (refined / max(float(np.linalg.norm(refined)), 1e-12)).astype(np.float32)
+
+def feedback_top_k(
+    matrix: np.ndarray,
+    query: np.ndarray,
+    dtype: str,
+    rows: np.ndarray,
+    k: int,
+    feedback_rows: int,
+    alpha: float,
+    beta: float
+) -> Tuple[np.ndarray, np.ndarray]:
+    """
+    Pseudo-relevance feedback second pass over a first pass's result `rows` (best first):
+    the query is refined towards the stored vectors of the best `feedback_rows` (rocchio_query),
+    and only `rows` are rescored with it, so the cost is len(rows) dot products rather than a scan.
+    Returns:
+        Tuple[np.ndarray, np.ndarray]: The k best of `rows` for the refined query, and their scores.
+    """
+    rows = np.asarray(rows, dtype=np.int64)
+    if not len(rows):
+        return rows, np.empty(0, dtype=np.float32)
+    pool = matrix[rows]
+    refined = rocchio_query(query, decode_vectors(pool[:feedback_rows], dtype), alpha, beta)
+    top, scores = top_k_indices(flat_scores(pool, refined, dtype), k)
+    return rows[top], scores
+
+def facet_counts(codes: np.ndarray, rows: Optional[np.ndarray], num_values: int) -> np.ndarray:
+    """
+    Histogram of dictionary codes (see src.index_views.MetadataColumns) over `rows`.
+
+    Args:
+        codes (np.ndarray): (N,) int32 code per row; negative codes (missing) are not counted.
+        rows (Optional[np.ndarray]): Rows to count; None counts every row.
+        num_values (int): Dictionary size.
+    Returns:
+        np.ndarray: (num_values,) int64 counts.
+    """
+    if _native is not None and codes.dtype == np.int32 and codes.flags.c_contiguous:
+        counts = np.empty(num_values, dtype=np.int64)
+        if rows is not None:
+            rows = np.ascontiguousarray(rows, dtype=np.int64)
+        n = len(codes) if rows is None else len(rows)
+        if _native.vk_facet_counts(codes.ctypes.data, None if rows is None else rows.ctypes.data, n, num_values, counts.ctypes.data) == 0:
+            return counts
+    selected = np.asarray(codes if rows is None else codes[rows])
+    return np.bincount(selected[(selected >= 0) & (selected < num_values)], minlength=num_values)[:num_values].astype(np.int64)
+
+def qgram_candidates(
+    post_rows: np.ndarray,
+    post_pos: np.ndarray,
+    gram_offsets: np.ndarray,
+    slots: np.ndarray,
+    positions: np.ndarray,
+    num_titles: int,
+    needed: int,
+    max_edits: int,
+    max_out: int
+) -> Tuple[np.ndarray, np.ndarray]:
+    """
+    q-gram count filter for fuzzy title search (see src.title_index).
+
+    Query gram g at positions[g] has postings post_rows/post_pos[gram_offsets[slots[g]]:gram_offsets[slots[g] + 1]].
+    A title within `max_edits` edits of the query shares at least `needed` of its grams, at
+    alignments (diagonal = post_pos - positions[g]) that drift by at most `max_edits`.
+    Returns:
+        Tuple[np.ndarray, np.ndarray]: Passing rows, each once at its best-supported diagonal,
+        most shared grams first (ties: lower row), at most `max_out`.
+    """
+    slots = np.ascontiguousarray(slots, dtype=np.int64)
+    positions = np.ascontiguousarray(positions, dtype=np.int32)
+    if (_native is not None and post_rows.dtype == np.int32 and post_pos.dtype == np.int32 and gram_offsets.dtype == np.int64
+            and post_rows.flags.c_contiguous and post_pos.flags.c_contiguous and gram_offsets.flags.c_contiguous):
+        rows = np.empty(max_out, dtype=np.int64)
+        diagonals = np.empty(max_out, dtype=np.int32)
+        support = np.empty(max_out, dtype=np.int32)
+        n = _native.vk_qgram_candidates(post_rows.ctypes.data, post_pos.ctypes.data, gram_offsets.ctypes.data, slots.ctypes.data,
+                                        positions.ctypes.data, len(slots), num_titles, needed, max_edits,
+                                        rows.ctypes.data, diagonals.ctypes.data, support.ctypes.data, max_out)
+        if n >= 0:
+            return rows[:n], diagonals[:n].astype(np.int64)
+    empty = np.empty(0, dtype=np.int64), np.empty(0, dtype=np.int64)
+    if not len(slots):
+        return empty
+    rows = np.concatenate([post_rows[gram_offsets[s]:gram_offsets[s + 1]] for s in slots])
+    diagonals = np.concatenate([post_pos[gram_offsets[s]:gram_offsets[s + 1]] - p for s, p in zip(slots, positions)])
+    # Count filter per row first (cheap), then find each surviving row's alignment
+    passing = np.flatnonzero(np.bincount(rows, minlength=num_titles) >= needed)
+    if not len(passing):
+        return empty
+    keep = np.isin(rows, passing)
+    keys = (rows[keep].astype(np.int64) << 32) | (diagonals[keep].astype(np.int64) + (1 << 30))
+    keys, counts = np.unique(keys, return_counts=True)
+    # Grams at nearby alignments (within max_edits, same row) support the same match
+    support = counts.copy()
+    for shift in range(1, max_edits + 1):
+        near = keys[shift:] - keys[:-shift] <= max_edits
+        support[shift:] += np.where(near, counts[:-shift], 0)
+        support[:-shift] += np.where(near, counts[shift:], 0)
+    keys, support = keys[support >= needed], support[support >= needed]
+    # Best alignment per row, rows with the most shared grams first
+    keys = keys[np.argsort(-support, kind="stable")]
+    _, first = np.unique(keys >> 32, return_index=True)
+    keys = keys[np.sort(first)][:max_out]
+    return keys >> 32, (keys & ((1 << 32) - 1)) - (1 << 30)
+
+def prefix_edit_distances(query: bytes, text: np.ndarray, starts: np.ndarray, lengths: np.ndarray, slack: int = 0) -> np.ndarray:
+    """
+    For each window text[starts[i]:starts[i] + lengths[i]] of a uint8 array, the smallest edit
+    distance between `query` and a substring of the window beginning within its first `slack`
+    bytes (slack=0: any prefix of the window).
+    Returns:
+        np.ndarray: (N,) int32 distances.
+    """
+    starts = np.ascontiguousarray(starts, dtype=np.int64)
+    lengths = np.ascontiguousarray(lengths, dtype=np.int64)
+    if _native is not None and text.dtype == np.uint8 and text.flags.c_contiguous and len(query) <= 255:
+        out = np.empty(len(starts), dtype=np.int32)
+        if _native.vk_prefix_edit_distances(query, len(query), text.ctypes.data, starts.ctypes.data, lengths.ctypes.data,
+                                            len(starts), slack, out.ctypes.data) == 0:
+            return out
+    # One DP row per query byte, vectorized over all windows; insertions along a row use a running minimum
+    width = int(lengths.max()) if len(lengths) else 0
+    windows = text[np.minimum(starts[:, None] + np.arange(width), max(len(text) - 1, 0))] if len(text) else np.zeros((len(starts), 0), np.uint8)
+    columns = np.arange(width + 1, dtype=np.int32)
+    previous = np.broadcast_to(np.maximum(columns - slack, 0), (len(starts), width + 1)).copy()
+    for i, byte in enumerate(query, start=1):
+        current = np.empty_like(previous)
+        current[:, 0] = i
+        current[:, 1:] = np.minimum(previous[:, :-1] + (windows != byte), previous[:, 1:] + 1)
+        # current[j] = min over l <= j of current[l] + (j - l)
+        previous = np.minimum.accumulate(current - columns, axis=1) + columns
+    # Substrings cannot extend past the end of the window
+    previous[columns[None, :] > lengths[:, None]] = np.iinfo(np.int32).max
+    return previous.min(axis=1).astype(np.int32)
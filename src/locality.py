@@ -0,0 +1,97 @@
+"""
+Locality-aware row ordering for the flat vector store.
+
+Documents reach the index in corpus (BibTeX file) order, so the rows of one venue, year or
+topic are spread over the whole matrix. A filtered scan then touches every block of the
+matrix even when it only keeps a few percent of the rows (see src.kernels.masked_top_k).
+
+An ordering is a permutation of the rows, computed once at build time:
+
+- "metadata": sort by metadata fields, e.g. (year, booktitle), so each filter value is a
+  few contiguous ranges.
+- "cluster": spherical k-means over the embeddings; clusters are laid out so that
+  neighbouring clusters are similar, which keeps the rows of one topic together.
+
+Rows keep their node and ref doc ids (FlatVectorStore.reorder permutes those arrays with
+the matrix), so results still map back to doc_ids. Row-aligned side data (multi-vector
+index, metadata columns) is built after the reorder and follows the new order.
+Nothing here imports LlamaIndex.
+"""
+from typing import Any, Dict, List, Optional, Sequence
+
+import numpy as np
+
+from src.kernels import decode_vectors
+from src.multivector import _normalize, assign_centroids, train_centroids
+
+LOCALITY_ORDERS = ("", "metadata", "cluster")
+
+# Rows decoded per step while assigning clusters
+_DECODE_BLOCK = 8192
+
+def metadata_order(metadata: Sequence[Dict[str, Any]], fields: Sequence[str]) -> np.ndarray:
+    """
+    Row permutation sorting by `fields` (first field most significant). Missing values sort
+    last; ties keep corpus order.
+    """
+    def key(row: int):
+        values = metadata[row]
+        return tuple((values.get(field) is None, str(values.get(field) or "")) for field in fields)
+    return np.asarray(sorted(range(len(metadata)), key=key), dtype=np.int64)
+
+def chain_order(centroids: np.ndarray) -> np.ndarray:
+    """Greedy nearest-neighbour walk over the centroids, starting at the first one."""
+    similarities = centroids @ centroids.T
+    order = [0]
+    visited = np.zeros(len(centroids), dtype=bool)
+    visited[0] = True
+    for _ in range(len(centroids) - 1):
+        scores = np.where(visited, -np.inf, similarities[order[-1]])
+        order.append(int(np.argmax(scores)))
+        visited[order[-1]] = True
+    return np.asarray(order, dtype=np.int64)
+
+def cluster_order(matrix: np.ndarray, dtype: str, num_clusters: Optional[int] = None, seed: int = 0) -> np.ndarray:
+    """
+    Row permutation grouping rows by their nearest k-means centroid. Clusters follow
+    chain_order; rows within a cluster keep corpus order.
+
+    Args:
+        matrix (np.ndarray): (N, D) stored vectors in storage format `dtype`.
+        num_clusters (Optional[int]): Defaults to about sqrt(N).
+    """
+    n_rows = len(matrix)
+    if n_rows <= 1:
+        return np.arange(n_rows, dtype=np.int64)
+    num_clusters = min(n_rows, num_clusters or max(1, int(np.sqrt(n_rows))))
+    vectors = np.empty((n_rows, matrix.shape[1]), dtype=np.float32)
+    for start in range(0, n_rows, _DECODE_BLOCK):
+        decode_vectors(matrix[start:start + _DECODE_BLOCK], dtype, out=vectors[start:start + _DECODE_BLOCK])
+    vectors = _normalize(vectors)
+    centroids = train_centroids(vectors, num_clusters, seed=seed)
+    rank = np.empty(num_clusters, dtype=np.int64)
+    rank[chain_order(centroids)] = np.arange(num_clusters)
+    return np.argsort(rank[assign_centroids(vectors, centroids)], kind="stable").astype(np.int64)
+
+def locality_order(
+    strategy: str,
+    matrix: np.ndarray,
+    dtype: str,
+    metadata: Optional[List[Dict[str, Any]]] = None,
+    fields: Sequence[str] = (),
+    num_clusters: Optional[int] = None
+) -> Optional[np.ndarray]:
+    """The permutation for `strategy` (one of LOCALITY_ORDERS), or None for no reordering."""
+    if strategy not in LOCALITY_ORDERS:
+        raise ValueError(f"Unknown locality order '{strategy}'. Expected one of {LOCALITY_ORDERS}.")
+    if strategy == "metadata":
+        if metadata is None or not fields:
+            raise ValueError("The metadata locality order needs metadata and at least one field.")
+        return metadata_order(metadata, fields)
+    if strategy == "cluster":
+        return cluster_order(matrix, dtype, num_clusters)
+    return None
+
+def describe_order(strategy: str, fields: Sequence[str] = ()) -> str:
+    """Label stored with the reordered store, e.g. "metadata:year,booktitle"."""
+    return f"{strategy}:{','.join(fields)}" if strategy == "metadata" else strategy
@@ -0,0 +1,383 @@
+"""
+Multi-vector (late-interaction, ColBERT-style) index.
+
+Every node keeps one embedding per token instead of a single pooled vector. Token
+embeddings are compressed the way ColBERTv2 does it: each token is stored as the id
+of its nearest centroid plus a residual quantized to `residual_bits` bits per
+dimension. Search has two stages:
+
+1. Candidate generation: every query token probes its `nprobe` closest centroids and
+   the posting lists of those centroids give the candidate nodes. When there are more
+   than `candidates` of them, they are pruned with a cheap centroid-only MaxSim.
+2. Scoring: the candidates' tokens are decompressed and scored with exact MaxSim
+   (see src.kernels.maxsim_scores).
+
+The index is plain NumPy, persisted as .npy files next to the other stores in
+storage_dir (and therefore also packed into the index bundle).
+"""
+import os
+import json
+from dataclasses import dataclass
+from typing import Dict, List, Optional, Sequence, Tuple
+
+import numpy as np
+
+from src.deadlines import Deadline
+from src.index_bundle import IndexBundle
+from src.profiling import QueryProfile
+from src.kernels import decode_residuals, maxsim_scores, top_k_indices
+
+MULTIVECTOR_PREFIX = "multivector"
+MULTIVECTOR_HEADER = f"{MULTIVECTOR_PREFIX}.json"
+RESIDUAL_BITS = (1, 2, 4, 8)
+
+# Arrays persisted as <prefix>.<name>.npy
+_ARRAYS = ("centroids", "bucket_cutoffs", "bucket_weights", "codes", "residuals", "doc_offsets", "ivf_offsets", "ivf_docs")
+
+# Tokens sampled to train centroids and residual buckets
+_TRAINING_SAMPLE = 1 << 16
+_KMEANS_ITERATIONS = 10
+# Tokens assigned to centroids per step while encoding
+_ASSIGN_BLOCK = 8192
+# Candidates decompressed and scored between deadline checks
+_SCORE_CHUNK = 64
+
+def _normalize(vectors: np.ndarray) -> np.ndarray:
+    vectors = np.asarray(vectors, dtype=np.float32)
+    return vectors / np.maximum(np.linalg.norm(vectors, axis=-1, keepdims=True), 1e-12)
+
+def default_num_centroids(num_tokens: int) -> int:
+    """ColBERTv2's heuristic: the power of two nearest below 16 * sqrt(#tokens)."""
+    if num_tokens <= 1:
+        return 1
+    return int(min(num_tokens, 2 ** int(np.floor(np.log2(16 * np.sqrt(num_tokens))))))
+
+def train_centroids(tokens: np.ndarray, num_centroids: int, seed: int = 0) -> np.ndarray:
+    """Spherical k-means over (a sample of) normalized token embeddings."""
+    rng = np.random.default_rng(seed)
+    if len(tokens) > _TRAINING_SAMPLE:
+        tokens = tokens[rng.choice(len(tokens), _TRAINING_SAMPLE, replace=False)]
+    centroids = tokens[rng.choice(len(tokens), num_centroids, replace=False)].copy()
+    for _ in range(_KMEANS_ITERATIONS):
+        assignment = np.argmax(tokens @ centroids.T, axis=1)
+        sums = np.zeros_like(centroids)
+        np.add.at(sums, assignment, tokens)
+        counts = np.bincount(assignment, minlength=num_centroids)
+        # Empty clusters keep their previous centroid.
+        centroids = np.where(counts[:, None] > 0, _normalize(sums), centroids)
+    return np.ascontiguousarray(centroids, dtype=np.float32)
+
+def assign_centroids(tokens: np.ndarray, centroids: np.ndarray) -> np.ndarray:
+    codes = np.empty(len(tokens), dtype=np.int32)
+    for start in range(0, len(tokens), _ASSIGN_BLOCK):
+        codes[start:start + _ASSIGN_BLOCK] = np.argmax(tokens[start:start + _ASSIGN_BLOCK] @ centroids.T, axis=1)
+    return codes
+
+class ResidualCodec:
+    """
+    Quantizes residuals (token - centroid) to `bits` bits per dimension.
+    Bucket cutoffs are quantiles of the training residuals and each bucket decodes to the
+    mean residual that fell into it. Codes are packed little-end-first into uint8 bytes, and
+    decoding goes through a 256-entry table that expands one byte to 8 / bits values.
+    """
+    def __init__(self, bits: int, cutoffs: np.ndarray, weights: np.ndarray):
+        if bits not in RESIDUAL_BITS:
+            raise ValueError(f"Unsupported residual_bits {bits}. Expected one of {RESIDUAL_BITS}.")
+        self.bits = bits
+        self.cutoffs = np.asarray(cutoffs, dtype=np.float32)
+        self.weights = np.asarray(weights, dtype=np.float32)
+        self.per_byte = 8 // bits
+        byte_values = np.arange(256, dtype=np.uint16)[:, None]
+        shifts = np.arange(self.per_byte, dtype=np.uint16)[None, :] * bits
+        self._lut = self.weights[(byte_values >> shifts) & ((1 << bits) - 1)]
+
+    @classmethod
+    def train(cls, residuals: np.ndarray, bits: int) -> "ResidualCodec":
+        buckets = 1 << bits
+        flat = residuals.ravel()
+        cutoffs = np.quantile(flat, np.arange(1, buckets) / buckets).astype(np.float32)
+        assignment = np.searchsorted(cutoffs, flat)
+        sums = np.bincount(assignment, weights=flat, minlength=buckets)
+        counts = np.bincount(assignment, minlength=buckets)
+        weights = np.where(counts > 0, sums / np.maximum(counts, 1), 0.0)
+        return cls(bits, cutoffs, weights)
+
+    def bytes_per_token(self, dim: int) -> int:
+        return dim // self.per_byte
+
+    def encode(self, residuals: np.ndarray) -> np.ndarray:
+        n, dim = residuals.shape
+        if dim % self.per_byte:
+            raise ValueError(f"Embedding dimension {dim} is not a multiple of {self.per_byte} (residual_bits={self.bits}).")
+        buckets = np.searchsorted(self.cutoffs, residuals).astype(np.uint8).reshape(n, -1, self.per_byte)
+        packed = np.zeros(buckets.shape[:2], dtype=np.uint8)
+        for i in range(self.per_byte):
+            packed |= buckets[:, :, i] << np.uint8(i * self.bits)
+        return packed
+
+    @property
+    def lut(self) -> np.ndarray:
+        """(256, 8 / bits) bucket weights of every packed byte value."""
+        return self._lut
+
+    def decode(self, packed: np.ndarray) -> np.ndarray:
+        return self._lut[packed].reshape(len(packed), -1)
+
+def _posting_lists(codes: np.ndarray, lengths: np.ndarray, num_centroids: int) -> Tuple[np.ndarray, np.ndarray]:
+    """IVF offsets and node rows: unique (centroid, node) pairs, grouped by centroid."""
+    num_nodes = max(len(lengths), 1)
+    token_doc = np.repeat(np.arange(len(lengths), dtype=np.int64), lengths)
+    pairs = np.unique(codes.astype(np.int64) * num_nodes + token_doc)
+    ivf_docs = (pairs % num_nodes).astype(np.int32)
+    ivf_offsets = np.searchsorted(pairs // num_nodes, np.arange(num_centroids + 1)).astype(np.int64)
+    return ivf_offsets, ivf_docs
+
+@dataclass
+class MultiVectorIndex:
+    """
+    Compressed per-token embeddings of a set of nodes with centroid posting lists.
+    Build with MultiVectorIndex.build; load with load / from_bundle.
+    """
+    node_ids: List[str]
+    residual_bits: int
+    centroids: np.ndarray       # (C, D) float32
+    bucket_cutoffs: np.ndarray  # (2^bits - 1,) float32
+    bucket_weights: np.ndarray  # (2^bits,) float32
+    codes: np.ndarray           # (T,) int32 centroid id per token
+    residuals: np.ndarray       # (T, D * bits / 8) uint8 packed residual codes
+    doc_offsets: np.ndarray     # (N+1,) int64; node i owns tokens doc_offsets[i]:doc_offsets[i+1]
+    ivf_offsets: np.ndarray     # (C+1,) int64; centroid c lists nodes ivf_docs[ivf_offsets[c]:ivf_offsets[c+1]]
+    ivf_docs: np.ndarray        # int32 node rows, sorted within each posting list
+
+    def __post_init__(self):
+        self.codec = ResidualCodec(self.residual_bits, self.bucket_cutoffs, self.bucket_weights)
+
+    # --- Construction ---
+
+    @classmethod
+    def build(
+        cls,
+        node_ids: Sequence[str],
+        token_embeddings: Sequence[np.ndarray],
+        residual_bits: int = 2,
+        num_centroids: Optional[int] = None,
+        seed: int = 0
+    ) -> "MultiVectorIndex":
+        """
+        Args:
+            node_ids (Sequence[str]): One id per node.
+            token_embeddings (Sequence[np.ndarray]): Per node, a (tokens, D) array.
+            residual_bits (int): Bits per dimension for residuals (1, 2, 4 or 8).
+            num_centroids (Optional[int]): Defaults to default_num_centroids(#tokens).
+            seed (int): Seed for centroid training.
+        """
+        if len(node_ids) != len(token_embeddings):
+            raise ValueError("node_ids and token_embeddings must have one entry per node.")
+        if not node_ids:
+            raise ValueError("Cannot build a multi-vector index without nodes.")
+        lengths = np.array([len(t) for t in token_embeddings], dtype=np.int64)
+        doc_offsets = np.concatenate([[0], np.cumsum(lengths)]).astype(np.int64)
+        tokens = _normalize(np.concatenate([np.asarray(t, dtype=np.float32) for t in token_embeddings], axis=0))
+        centroids = train_centroids(tokens, num_centroids or default_num_centroids(len(tokens)), seed=seed)
+        codes = assign_centroids(tokens, centroids)
+        residuals = tokens - centroids[codes]
+        codec = ResidualCodec.train(residuals, residual_bits)
+        packed = codec.encode(residuals)
+
+        ivf_offsets, ivf_docs = _posting_lists(codes, lengths, len(centroids))
+        return cls(
+            node_ids=list(node_ids),
+            residual_bits=residual_bits,
+            centroids=centroids,
+            bucket_cutoffs=codec.cutoffs,
+            bucket_weights=codec.weights,
+            codes=codes,
+            residuals=packed,
+            doc_offsets=doc_offsets,
+            ivf_offsets=ivf_offsets,
+            ivf_docs=ivf_docs
+        )
+
+    def updated(self, node_ids: Sequence[str], new_token_embeddings: Dict[str, np.ndarray]) -> "MultiVectorIndex":
+        """
+        The index over `node_ids`, in that order. Nodes already indexed keep their encoded tokens;
+        the others are taken from `new_token_embeddings` and encoded with the existing centroids
+        and residual codec. Neither is retrained, so build() again once much of the corpus changed.
+        """
+        row_of = {node_id: row for row, node_id in enumerate(self.node_ids)}
+        added = [node_id for node_id in node_ids if node_id not in row_of]
+        if added:
+            added_lengths = np.array([len(new_token_embeddings[node_id]) for node_id in added], dtype=np.int64)
+            tokens = _normalize(np.concatenate([np.asarray(new_token_embeddings[node_id], dtype=np.float32) for node_id in added], axis=0))
+            added_codes = assign_centroids(tokens, self.centroids)
+            added_residuals = self.codec.encode(tokens - self.centroids[added_codes])
+        else:
+            added_lengths = np.empty(0, dtype=np.int64)
+            added_codes = np.empty(0, dtype=self.codes.dtype)
+            added_residuals = np.empty((0, self.residuals.shape[1]), dtype=self.residuals.dtype)
+        all_codes = np.concatenate([self.codes, added_codes])
+        all_residuals = np.concatenate([self.residuals, added_residuals])
+
+        # Token range of every node in all_codes / all_residuals: old rows first, then the added nodes.
+        added_row = {node_id: len(self.node_ids) + i for i, node_id in enumerate(added)}
+        source_rows = np.array([row_of[node_id] if node_id in row_of else added_row[node_id] for node_id in node_ids], dtype=np.int64)
+        source_offsets = np.concatenate([self.doc_offsets, self.doc_offsets[-1] + np.cumsum(added_lengths)])
+        starts = source_offsets[source_rows]
+        lengths = source_offsets[source_rows + 1] - starts
+        doc_offsets = np.concatenate([[0], np.cumsum(lengths)]).astype(np.int64)
+        token_index = np.repeat(starts - doc_offsets[:-1], lengths) + np.arange(doc_offsets[-1])
+        codes = all_codes[token_index]
+        ivf_offsets, ivf_docs = _posting_lists(codes, lengths, len(self.centroids))
+        return MultiVectorIndex(
+            node_ids=list(node_ids),
+            residual_bits=self.residual_bits,
+            centroids=self.centroids,
+            bucket_cutoffs=self.bucket_cutoffs,
+            bucket_weights=self.bucket_weights,
+            codes=codes,
+            residuals=all_residuals[token_index],
+            doc_offsets=doc_offsets,
+            ivf_offsets=ivf_offsets,
+            ivf_docs=ivf_docs
+        )
+
+    # --- Accessors ---
+
+    def __len__(self) -> int:
+        return len(self.node_ids)
+
+    @property
+    def num_tokens(self) -> int:
+        return len(self.codes)
+
+    @property
+    def nbytes(self) -> int:
+        """Bytes held by the index arrays."""
+        return sum(getattr(self, name).nbytes for name in _ARRAYS)
+
+    def decompress(self, rows: np.ndarray) -> Tuple[np.ndarray, np.ndarray]:
+        """
+        Reconstructs the token embeddings of the given node rows.
+        Returns:
+            Tuple[np.ndarray, np.ndarray]: (T, D) normalized float32 tokens and (len(rows)+1,) offsets into them.
+        """
+        starts = self.doc_offsets[rows]
+        lengths = self.doc_offsets[rows + 1] - starts
+        offsets = np.concatenate([[0], np.cumsum(lengths)]).astype(np.int64)
+        # Token indices of all requested rows, in row order.
+        token_index = np.repeat(starts - offsets[:-1], lengths) + np.arange(offsets[-1])
+        return decode_residuals(self.codes, self.residuals, token_index, self.centroids, self.codec.lut), offsets
+
+    # --- Search ---
+
+    def candidates(self, query_tokens: np.ndarray, nprobe: int, centroid_scores: Optional[np.ndarray] = None) -> np.ndarray:
+        """Node rows appearing in the posting lists of each query token's `nprobe` closest centroids."""
+        if centroid_scores is None:
+            centroid_scores = _normalize(query_tokens) @ self.centroids.T
+        nprobe = min(nprobe, len(self.centroids))
+        probed = np.unique(np.argpartition(-centroid_scores, nprobe - 1, axis=1)[:, :nprobe])
+        postings = [self.ivf_docs[self.ivf_offsets[c]:self.ivf_offsets[c + 1]] for c in probed]
+        return np.unique(np.concatenate(postings)) if postings else np.empty(0, dtype=np.int32)
+
+    def search(
+        self,
+        query_tokens: np.ndarray,
+        top_k: int,
+        nprobe: int = 4,
+        candidates: int = 256,
+        mask: Optional[np.ndarray] = None,
+        deadline: Optional[Deadline] = None,
+        profile: Optional[QueryProfile] = None
+    ) -> Tuple[np.ndarray, np.ndarray]:
+        """
+        Late-interaction top-k.
+        Args:
+            query_tokens (np.ndarray): (Q, D) query token embeddings.
+            top_k (int): Number of results.
+            nprobe (int): Centroids probed per query token.
+            candidates (int): Nodes kept for exact scoring after centroid-only pruning.
+            mask (Optional[np.ndarray]): (N,) bool; False rows are never returned.
+            deadline (Optional[Deadline]): Exact scoring runs in chunks of candidates (best
+                centroid-only score first when pruned) and stops once the deadline passes,
+                returning the best of the candidates scored so far.
+            profile (Optional[QueryProfile]): Receives candidate and selectivity counters.
+        Returns:
+            Tuple[np.ndarray, np.ndarray]: Node rows and MaxSim scores, best first.
+        """
+        query_tokens = _normalize(query_tokens)
+        centroid_scores = query_tokens @ self.centroids.T
+        rows = self.candidates(query_tokens, nprobe, centroid_scores).astype(np.int64)
+        if profile is not None:
+            profile.count("centroids_probed", min(nprobe, len(self.centroids)) * len(query_tokens))
+            profile.count("candidates_generated", len(rows))
+        if mask is not None:
+            rows = rows[mask[rows]]
+            if profile is not None:
+                profile.set("filter_selectivity", float(mask.mean()) if len(mask) else 0.0)
+        if len(rows) > candidates:
+            # Centroid-only MaxSim: token scores are looked up from the (Q, C) centroid scores.
+            starts = self.doc_offsets[rows]
+            lengths = self.doc_offsets[rows + 1] - starts
+            offsets = np.concatenate([[0], np.cumsum(lengths)])
+            token_index = np.repeat(starts - offsets[:-1], lengths) + np.arange(offsets[-1])
+            approx = np.maximum.reduceat(centroid_scores[:, self.codes[token_index]], offsets[:-1], axis=1).sum(axis=0)
+            rows = rows[top_k_indices(approx, candidates)[0]]
+        if profile is not None:
+            profile.count("candidates_scored", len(rows))
+        if not len(rows):
+            return np.empty(0, dtype=np.int64), np.empty(0, dtype=np.float32)
+        if deadline is None:
+            tokens, offsets = self.decompress(rows)
+            order, scores = top_k_indices(maxsim_scores(query_tokens, tokens, offsets), top_k)
+            return rows[order], scores
+        exact = np.empty(len(rows), dtype=np.float32)
+        scored = len(rows)
+        for start in range(0, len(rows), _SCORE_CHUNK):
+            if start and deadline.expired():
+                deadline.mark_partial("maxsim")
+                scored = start
+                break
+            tokens, offsets = self.decompress(rows[start:start + _SCORE_CHUNK])
+            exact[start:start + _SCORE_CHUNK] = maxsim_scores(query_tokens, tokens, offsets)
+        order, scores = top_k_indices(exact[:scored], top_k)
+        return rows[order], scores
+
+    # --- Persistence ---
+
+    def _header(self) -> Dict:
+        return {"node_ids": self.node_ids, "residual_bits": self.residual_bits}
+
+    def save(self, directory: str):
+        """Writes the header and arrays into `directory` (temporary files, then rename)."""
+        os.makedirs(directory, exist_ok=True)
+        for name in _ARRAYS:
+            path = os.path.join(directory, array_filename(name))
+            with open(path + ".tmp", "wb") as f:
+                np.save(f, getattr(self, name))
+            os.replace(path + ".tmp", path)
+        header_path = os.path.join(directory, MULTIVECTOR_HEADER)
+        with open(header_path + ".tmp", "w", encoding="utf-8") as f:
+            json.dump(self._header(), f)
+        os.replace(header_path + ".tmp", header_path)
+
+    @staticmethod
+    def exists(directory: str) -> bool:
+        return os.path.exists(os.path.join(directory, MULTIVECTOR_HEADER))
+
+    @classmethod
+    def load(cls, directory: str) -> "MultiVectorIndex":
+        """Loads an index saved with save(); arrays are memory-mapped read-only."""
+        with open(os.path.join(directory, MULTIVECTOR_HEADER), "r", encoding="utf-8") as f:
+            header = json.load(f)
+        arrays = {name: np.load(os.path.join(directory, array_filename(name)), mmap_mode="r") for name in _ARRAYS}
+        return cls(node_ids=header["node_ids"], residual_bits=header["residual_bits"], **arrays)
+
+    @classmethod
+    def from_bundle(cls, bundle: IndexBundle) -> "MultiVectorIndex":
+        """Loads the index from bundle sections as zero-copy views into the bundle mapping."""
+        header = bundle.read_json(MULTIVECTOR_HEADER)
+        arrays = {name: bundle.read_array(array_filename(name)) for name in _ARRAYS}
+        return cls(node_ids=header["node_ids"], residual_bits=header["residual_bits"], **arrays)
+
+def array_filename(name: str) -> str:
+    return f"{MULTIVECTOR_PREFIX}.{name}.npy"
@@ -0,0 +1,183 @@
+import time
+from contextlib import AsyncExitStack, ExitStack, contextmanager
+from typing import Iterator, List, Optional, Tuple
+
+from llama_index.core.base.response.schema import RESPONSE_TYPE
+from llama_index.core.query_engine import RetrieverQueryEngine
+from llama_index.core.schema import NodeWithScore, QueryBundle, QueryType
+
+from src import kernels
+from src.deadlines import AdmissionController, Deadline, QueryRejected
+from src.profiling import QueryProfile
+from src.query_log import QueryLog, QueryRecord
+from src.retrievers import Facets, NativeRetriever
+
+class NativeQueryEngine(RetrieverQueryEngine):
+    """
+    RetrieverQueryEngine with per-query deadlines, admission control and explain output.
+
+    query() accepts a deadline in milliseconds (or uses `default_deadline_ms`). Queries
+    that cannot finish in time are rejected with QueryRejected before doing any work;
+    admitted queries pass the deadline to NativeRetriever search stages, which stop early
+    with their best results so far. Such responses carry metadata["partial"] = True.
+    Other retrievers run to completion and only get admission control.
+
+    When the retriever computes facet counts (FlatVectorRetriever with facet fields),
+    metadata["facets"] maps each field to {value: hits} over the search's candidate set.
+
+    With explain enabled, metadata["profile"] holds a QueryProfile dict: per-stage timings
+    (queue, embed, search, fetch, rerank, synthesize), kernel work counters (rows scanned,
+    distance computations, tokens decoded) and search counters (candidates, filter
+    selectivity, query cache hits).
+
+    aquery() is the awaitable form: it waits for admission on the event loop, runs retrieval
+    on the native thread pool (see src.kernels.run_native), whose search kernels, BLAS calls
+    and model forward passes release the GIL, and awaits response synthesis, so an asyncio
+    server can overlap many queries in one process. Admission control still bounds how many
+    execute at once.
+
+    With a `query_log`, every query (including rejected and failed ones) is recorded with its
+    arrival time, deadline, latency and outcome, for replay (see src.query_log).
+
+    Build with from_args(), then set `default_deadline_ms`, `admission`, `explain` and `query_log` (see QueryEngineBuilder).
+    """
+    def __init__(
+        self,
+        *args,
+        default_deadline_ms: Optional[float] = None,
+        admission: Optional[AdmissionController] = None,
+        explain: bool = False,
+        query_log: Optional[QueryLog] = None,
+        **kwargs
+    ):
+        super().__init__(*args, **kwargs)
+        self.default_deadline_ms = default_deadline_ms
+        self.admission = admission or AdmissionController()
+        self.explain = explain
+        self.query_log = query_log
+
+    def retrieve_within(
+        self,
+        query_bundle: QueryBundle,
+        deadline: Optional[Deadline],
+        profile: Optional[QueryProfile] = None
+    ) -> List[NodeWithScore]:
+        return self.retrieve_with_facets(query_bundle, deadline, profile)[0]
+
+    def retrieve_with_facets(
+        self,
+        query_bundle: QueryBundle,
+        deadline: Optional[Deadline],
+        profile: Optional[QueryProfile] = None
+    ) -> Tuple[List[NodeWithScore], Optional[Facets]]:
+        profile = profile or QueryProfile()
+        before = kernels.counters.snapshot()
+        facets = None
+        if isinstance(self._retriever, NativeRetriever):
+            nodes, facets = self._retriever.retrieve_with_facets(query_bundle, deadline, profile)
+        else:
+            with profile.stage("retrieve"):
+                nodes = self._retriever.retrieve(query_bundle)
+        profile.add_counter_deltas(before, kernels.counters.snapshot())
+        with profile.stage("rerank"):
+            return self._apply_node_postprocessors(nodes, query_bundle=query_bundle), facets
+
+    def query(self, str_or_query_bundle: QueryType, deadline_ms: Optional[float] = None, explain: Optional[bool] = None) -> RESPONSE_TYPE:
+        """
+        Args:
+            str_or_query_bundle (QueryType): The query.
+            deadline_ms (Optional[float]): Time budget; defaults to default_deadline_ms. 0 or None disables it.
+            explain (Optional[bool]): Attach the query profile to metadata["profile"]; defaults to self.explain.
+        Raises:
+            QueryRejected: If admission control predicts the deadline cannot be met.
+        """
+        query_bundle, deadline_ms, explain = self._query_args(str_or_query_bundle, deadline_ms, explain)
+        with self._logged(query_bundle, deadline_ms, explain) as record:
+            deadline = Deadline.after_ms(deadline_ms) if deadline_ms else None
+            profile = QueryProfile()
+            with ExitStack() as slot:
+                with profile.stage("queue"):
+                    slot.enter_context(self.admission.admit(deadline))
+                nodes, facets = self.retrieve_with_facets(query_bundle, deadline, profile)
+                with profile.stage("synthesize"):
+                    response = self.synthesize(query_bundle, nodes)
+            return self._finish(response, record, deadline, facets, profile, explain)
+
+    async def aquery(self, str_or_query_bundle: QueryType, deadline_ms: Optional[float] = None, explain: Optional[bool] = None) -> RESPONSE_TYPE:
+        """
+        Awaitable query(); same arguments and result. Admission waits on the event loop, only
+        retrieval (embedding, search kernels, reranking) runs on the native pool, and synthesis
+        is awaited with asynthesize(), so a slow LLM call does not hold a pool thread.
+        """
+        query_bundle, deadline_ms, explain = self._query_args(str_or_query_bundle, deadline_ms, explain)
+        with self._logged(query_bundle, deadline_ms, explain) as record:
+            deadline = Deadline.after_ms(deadline_ms) if deadline_ms else None
+            profile = QueryProfile()
+            async with AsyncExitStack() as slot:
+                with profile.stage("queue"):
+                    await slot.enter_async_context(self.admission.aadmit(deadline))
+                nodes, facets = await self.aretrieve_with_facets(query_bundle, deadline, profile)
+                with profile.stage("synthesize"):
+                    response = await self.asynthesize(query_bundle, nodes)
+            return self._finish(response, record, deadline, facets, profile, explain)
+
+    def _query_args(
+        self,
+        str_or_query_bundle: QueryType,
+        deadline_ms: Optional[float],
+        explain: Optional[bool]
+    ) -> Tuple[QueryBundle, Optional[float], bool]:
+        query_bundle = QueryBundle(str_or_query_bundle) if isinstance(str_or_query_bundle, str) else str_or_query_bundle
+        if deadline_ms is None:
+            deadline_ms = self.default_deadline_ms
+        return query_bundle, deadline_ms, self.explain if explain is None else explain
+
+    @contextmanager
+    def _logged(self, query_bundle: QueryBundle, deadline_ms: Optional[float], explain: bool) -> Iterator[QueryRecord]:
+        """Writes the query's record to query_log (if set) when the block exits, however it exits."""
+        arrived, start = time.time(), time.perf_counter()
+        record = QueryRecord(ts=arrived, query=query_bundle.query_str, latency_ms=0.0, status="error",
+                             deadline_ms=deadline_ms or None, explain=explain)
+        try:
+            yield record
+            record.status = "ok"
+        except QueryRejected:
+            record.status = "rejected"
+            raise
+        finally:
+            if self.query_log is not None:
+                record.latency_ms = (time.perf_counter() - start) * 1000.0
+                self.query_log.write(record)
+
+    def _finish(
+        self,
+        response: RESPONSE_TYPE,
+        record: QueryRecord,
+        deadline: Optional[Deadline],
+        facets: Optional[Facets],
+        profile: QueryProfile,
+        explain: bool
+    ) -> RESPONSE_TYPE:
+        profile.finish()
+        metadata = {
+            **(response.metadata or {}),
+            "partial": bool(deadline is not None and deadline.partial),
+            "partial_stages": list(deadline.partial_stages) if deadline is not None else [],
+        }
+        if facets is not None:
+            metadata["facets"] = facets
+        if explain:
+            metadata["profile"] = profile.to_dict()
+        response.metadata = metadata
+        record.partial = metadata["partial"]
+        record.results = len(response.source_nodes)
+        return response
+
+    async def aretrieve_with_facets(
+        self,
+        query_bundle: QueryBundle,
+        deadline: Optional[Deadline],
+        profile: Optional[QueryProfile] = None
+    ) -> Tuple[List[NodeWithScore], Optional[Facets]]:
+        """Awaitable retrieve_with_facets(), run on the native pool in one thread so kernel counters stay per query."""
+        return await kernels.run_native(self.retrieve_with_facets, query_bundle, deadline, profile)
@@ -0,0 +1,55 @@
+import json
+import time
+from contextlib import contextmanager
+from typing import Any, Dict, Iterator, Optional
+
+class QueryProfile:
+    """
+    Explain output for one query: wall time per stage and work counters.
+
+    Stages are timed with `with profile.stage(name):` and accumulate if entered more
+    than once. Counters come from the search code (candidates, selectivity, cache hits)
+    and from the kernel counters in src.kernels (rows scanned, distance computations).
+    Everything here is a dict update or a perf_counter() call, so profiles are cheap
+    enough to collect for every query.
+    """
+    def __init__(self):
+        self.stages_ms: Dict[str, float] = {}
+        self.counters: Dict[str, Any] = {}
+        self.total_ms: Optional[float] = None
+        self._start = time.perf_counter()
+
+    def finish(self):
+        """Records the wall time since the profile was created as the query total."""
+        self.total_ms = (time.perf_counter() - self._start) * 1000.0
+
+    @contextmanager
+    def stage(self, name: str) -> Iterator[None]:
+        start = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.stages_ms[name] = self.stages_ms.get(name, 0.0) + (time.perf_counter() - start) * 1000.0
+
+    def count(self, name: str, amount: int = 1):
+        self.counters[name] = self.counters.get(name, 0) + amount
+
+    def set(self, name: str, value: Any):
+        self.counters[name] = value
+
+    def add_counter_deltas(self, before: Dict[str, int], after: Dict[str, int]):
+        """Adds the growth of each counter between two snapshots (e.g. src.kernels.counters.snapshot())."""
+        for name, value in after.items():
+            delta = value - before.get(name, 0)
+            if delta:
+                self.count(name, delta)
+
+    def to_dict(self) -> Dict[str, Any]:
+        return {
+            "total_ms": round(self.total_ms if self.total_ms is not None else sum(self.stages_ms.values()), 3),
+            "stages_ms": {name: round(ms, 3) for name, ms in self.stages_ms.items()},
+            "counters": dict(self.counters),
+        }
+
+    def to_json(self, indent: int = 2) -> str:
+        return json.dumps(self.to_dict(), indent=indent)
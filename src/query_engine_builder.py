@@ -1,28 +1,63 @@
-from typing import Optional
+from typing import Callable, List, Optional, Sequence
 
 from llama_index.core import VectorStoreIndex, Settings
 from llama_index.core.base.base_query_engine import BaseQueryEngine
 
+from src import kernels
+from src.autotune import TuningResult
 from src.config_loader import QueryEngineBuilderConfig
+from src.index_views import MetadataColumns
 from src.core_components import initialize_hf_embedding_model
+from src.deadlines import AdmissionController
+from src.multivector import MultiVectorIndex
+from src.native_query_engine import NativeQueryEngine
+from src.query_log import QueryLog
+from src.reranker import CrossEncoder, CrossEncoderReranker
+from src.retrievers import FlatVectorRetriever, MultiVectorRetriever, NativeRetriever, SegmentedRetriever
+from src.vector_store import FlatVectorStore
 
 class QueryEngineBuilder:
     """
     Builds a query engine from a VectorStoreIndex and configuration.
     """
-    def __init__(self, index: VectorStoreIndex, config: QueryEngineBuilderConfig):
+    def __init__(
+        self,
+        index: VectorStoreIndex,
+        config: QueryEngineBuilderConfig,
+        multivector_index: Optional[MultiVectorIndex] = None,
+        tuning: Optional[TuningResult] = None,
+        metadata_columns: Optional[MetadataColumns] = None,
+        segments: Optional[Callable[[], List[VectorStoreIndex]]] = None
+    ):
         """
         Args:
             index (VectorStoreIndex): The VectorStoreIndex to query.
             config (QueryEngineBuilderConfig): Configuration for the query engine.
+            multivector_index (Optional[MultiVectorIndex]): Per-token index, required when
+                config.retrieval_mode is "multivector" (see IndexBuilder.multivector_index).
+            tuning (Optional[TuningResult]): Autotuned search parameters (see IndexBuilder.tuning);
+                override the configured multivector_nprobe and multivector_candidates.
+            metadata_columns (Optional[MetadataColumns]): Metadata columns (see IndexBuilder.metadata_columns),
+                required for config.facet_fields.
+            segments (Optional[Callable[[], List[VectorStoreIndex]]]): Live index segments searched
+                besides the index (see IndexBuilder.live_segments); flat vector retrieval only.
         """
         if not isinstance(index, VectorStoreIndex):
             raise TypeError("index must be an instance of VectorStoreIndex")
         if not isinstance(config, QueryEngineBuilderConfig):
             raise TypeError("config must be an instance of QueryEngineBuilderConfig")
 
+        if config.retrieval_mode not in ("vector", "multivector"):
+            raise ValueError(f"Unknown retrieval_mode '{config.retrieval_mode}'. Expected 'vector' or 'multivector'.")
+        if config.retrieval_mode == "multivector" and multivector_index is None:
+            raise ValueError("retrieval_mode 'multivector' requires a multi-vector index (set multivector_enabled in index_builder).")
+
         self.index = index
         self.config = config
+        self.multivector_index = multivector_index
+        self.tuning = tuning
+        self.metadata_columns = metadata_columns
+        self.segments = segments
 
     def build(self) -> BaseQueryEngine:
         """
@@ -35,7 +70,7 @@ class QueryEngineBuilder:
         # This is crucial if the index was loaded from storage without an active embed model in Settings,
         # or if a different model is desired for querying (though typically they should match).
         print(f"QueryEngineBuilder: Setting embed model in LlamaIndex.Settings: {self.config.embedding_model_name}")
-        initialize_hf_embedding_model(model_name=self.config.embedding_model_name)
+        initialize_hf_embedding_model(model_name=self.config.embedding_model_name, precision=self.config.embedding_precision)
 
         # Set chunk size and overlap from config for consistency, though these primarily affect indexing.
         # If the index is already built, these might not have a direct effect on a standard query engine
@@ -51,13 +86,101 @@ class QueryEngineBuilder:
             # Settings.chunk_overlap = self.config.chunk_overlap # Deprecated
             pass
 
-        print(f"QueryEngineBuilder: Building query engine with similarity_top_k={self.config.similarity_top_k}")
-        query_engine = self.index.as_query_engine(
-            similarity_top_k=self.config.similarity_top_k
-        )
+        print(f"QueryEngineBuilder: Building {self.config.retrieval_mode} query engine with similarity_top_k={self.config.similarity_top_k}")
+        node_postprocessors = self._node_postprocessors()
+        retriever = self._native_retriever()
+        if self.config.facet_fields and not isinstance(retriever, (FlatVectorRetriever, SegmentedRetriever)):
+            raise ValueError("facet_fields requires vector_store_type 'flat' and retrieval_mode 'vector'.")
+        if retriever is None and not self.config.query_deadline_ms and not self.config.explain and not self.config.query_log_path:
+            query_engine = self.index.as_query_engine(
+                similarity_top_k=self.retrieval_top_k,
+                node_postprocessors=node_postprocessors
+            )
+        else:
+            # Native search stages honor per-query deadlines and report search counters;
+            # other retrievers only get admission control and a single "retrieve" timing.
+            query_engine = NativeQueryEngine.from_args(
+                retriever or self.index.as_retriever(similarity_top_k=self.retrieval_top_k),
+                node_postprocessors=node_postprocessors
+            )
+            query_engine.default_deadline_ms = self.config.query_deadline_ms or None
+            query_engine.admission = AdmissionController(max_concurrent=self.config.max_concurrent_queries)
+            kernels.configure_native_pool(self.config.native_pool_threads)
+            query_engine.explain = self.config.explain
+            if self.config.query_log_path:
+                query_engine.query_log = QueryLog(self.config.query_log_path)
+                print(f"QueryEngineBuilder: Logging queries to {self.config.query_log_path}.")
+            if self.config.query_deadline_ms:
+                print(f"QueryEngineBuilder: Default query deadline {self.config.query_deadline_ms} ms, "
+                      f"at most {self.config.max_concurrent_queries} concurrent queries.")
         print("QueryEngineBuilder: Query engine built successfully.")
         return query_engine
 
+    @property
+    def retrieval_top_k(self) -> int:
+        """Nodes retrieved per query: similarity_top_k, or more when a re-ranker narrows them down."""
+        if self.config.rerank_model:
+            return max(self.config.similarity_top_k, self.config.rerank_candidates)
+        return self.config.similarity_top_k
+
+    def _node_postprocessors(self) -> list:
+        if not self.config.rerank_model:
+            return []
+        print(f"QueryEngineBuilder: Re-ranking {self.retrieval_top_k} candidates with {self.config.rerank_model} "
+              f"({self.config.rerank_precision}, budget {self.config.rerank_budget_ms or 'unbounded'} ms).")
+        encoder = CrossEncoder.from_pretrained(
+            self.config.rerank_model, precision=self.config.rerank_precision, max_length=self.config.rerank_max_length
+        )
+        return [CrossEncoderReranker(
+            encoder,
+            top_n=self.config.similarity_top_k,
+            batch_size=self.config.rerank_batch_size,
+            budget_ms=self.config.rerank_budget_ms
+        )]
+
+    def _native_retriever(self) -> Optional[NativeRetriever]:
+        """The project's own retriever for this index, or None when LlamaIndex's default applies."""
+        if self.config.retrieval_mode == "multivector":
+            nprobe, candidates = self.config.multivector_nprobe, self.config.multivector_candidates
+            if self.tuning is not None:
+                nprobe, candidates = self.tuning.params["nprobe"], self.tuning.params["candidates"]
+                print(f"QueryEngineBuilder: Using autotuned nprobe={nprobe}, candidates={candidates} "
+                      f"(recall@{self.tuning.k} {self.tuning.recall:.3f}).")
+            return MultiVectorRetriever(
+                self.multivector_index,
+                self.index.docstore,
+                similarity_top_k=self.retrieval_top_k,
+                nprobe=nprobe,
+                candidates=candidates
+            )
+        if isinstance(self.index.vector_store, FlatVectorStore):
+            retriever = self._flat_retriever(self.index, self.metadata_columns, self.config.facet_fields)
+            if self.segments is not None:
+                return SegmentedRetriever(retriever, self.segments, lambda segment: self._flat_retriever(segment))
+            return retriever
+        return None
+
+    def _flat_retriever(
+        self,
+        index: VectorStoreIndex,
+        metadata_columns: Optional[MetadataColumns] = None,
+        facet_fields: Sequence[str] = ()
+    ) -> FlatVectorRetriever:
+        return FlatVectorRetriever(
+            index.vector_store,
+            index.docstore,
+            metadata_columns=metadata_columns,
+            facet_fields=facet_fields,
+            facet_candidates=self.config.facet_candidates,
+            facet_min_score=self.config.facet_min_score or None,
+            prf_top_m=self.config.prf_top_m,
+            prf_alpha=self.config.prf_alpha,
+            prf_beta=self.config.prf_beta,
+            prf_candidates=self.config.prf_candidates,
+            prf_max_query_words=self.config.prf_max_query_words,
+            similarity_top_k=self.retrieval_top_k
+        )
+
 if __name__ == "__main__":
     # This is a placeholder for potential direct testing of QueryEngineBuilder.
     # To run this, you would need:
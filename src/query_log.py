@@ -0,0 +1,178 @@
+"""
+Query log capture and load replay.
+
+With query_log_path set, NativeQueryEngine appends one NDJSON line per query: arrival time,
+query text, parameters (deadline, explain), observed latency, outcome and result count.
+replay() re-issues a log against an index on the log's own schedule, optionally sped up or
+slowed down, with bounded concurrency (see scripts/replay_queries.py). Latency is measured
+from each query's scheduled send time, so queueing behind slow queries is counted rather than
+silently lowering the offered load.
+"""
+import os
+import json
+import time
+import atexit
+import threading
+from concurrent.futures import ThreadPoolExecutor
+from dataclasses import asdict, dataclass, field
+from typing import Callable, Dict, Iterator, List, Optional, Sequence
+
+import numpy as np
+
+from src.deadlines import QueryRejected
+
+@dataclass
+class QueryRecord:
+    """One logged query. `ts` is its arrival time (time.time()); status is "ok", "rejected" or "error"."""
+    ts: float
+    query: str
+    latency_ms: float
+    status: str = "ok"
+    deadline_ms: Optional[float] = None
+    explain: bool = False
+    partial: bool = False
+    results: int = 0
+
+class QueryLog:
+    """
+    Appends QueryRecords to an NDJSON file. Lines are buffered and written by the query that
+    fills the buffer, so logging costs one json.dumps per query; the rest is written by flush(),
+    close() or at interpreter exit. Safe to share between threads.
+
+    Args:
+        path (str): Log file; appended to if it exists.
+        flush_every (int): Records buffered before they are written.
+    """
+    def __init__(self, path: str, flush_every: int = 64):
+        directory = os.path.dirname(path)
+        if directory:
+            os.makedirs(directory, exist_ok=True)
+        self.path = path
+        self.flush_every = max(1, flush_every)
+        self._file = open(path, "ab")
+        self._lines: List[str] = []
+        self._lock = threading.Lock()
+        atexit.register(self.close)
+
+    def write(self, record: QueryRecord):
+        line = json.dumps(asdict(record), ensure_ascii=False, separators=(",", ":")) + "\n"
+        with self._lock:
+            self._lines.append(line)
+            if len(self._lines) >= self.flush_every:
+                self._flush_locked()
+
+    def flush(self):
+        with self._lock:
+            self._flush_locked()
+
+    def _flush_locked(self):
+        if self._lines and not self._file.closed:
+            # One write per batch, so lines from several logs on the same file do not interleave
+            self._file.write("".join(self._lines).encode("utf-8"))
+            self._file.flush()
+        self._lines.clear()
+
+    def close(self):
+        with self._lock:
+            self._flush_locked()
+            self._file.close()
+        atexit.unregister(self.close)
+
+def read_query_log(path: str) -> Iterator[QueryRecord]:
+    """Records in log order. A torn last line (the process died mid-write) is skipped."""
+    with open(path, "rb") as f:
+        lines = f.read().decode("utf-8").splitlines()
+    for i, line in enumerate(lines):
+        if not line.strip():
+            continue
+        try:
+            data = json.loads(line)
+        except json.JSONDecodeError:
+            if i == len(lines) - 1:
+                return
+            raise
+        yield QueryRecord(**data)
+
+def latency_summary(latencies_ms: Sequence[float]) -> Dict[str, float]:
+    """Mean, p50, p90, p99 and max of a latency sample, in milliseconds."""
+    values = np.asarray(latencies_ms, dtype=np.float64)
+    if not len(values):
+        return {}
+    p50, p90, p99 = np.percentile(values, [50, 90, 99])
+    return {"mean": float(values.mean()), "p50": float(p50), "p90": float(p90), "p99": float(p99), "max": float(values.max())}
+
+@dataclass
+class ReplayResult:
+    """
+    Per-query outcome of a replay, in arrival order. latencies_ms run from each query's scheduled
+    send time to its completion; service_ms from when a worker actually started it.
+    """
+    latencies_ms: np.ndarray
+    service_ms: np.ndarray
+    statuses: List[str]
+    partial: int
+    wall_s: float
+    errors: List[str] = field(default_factory=list)
+
+    def summary(self) -> Dict[str, object]:
+        ok = np.array([status == "ok" for status in self.statuses], dtype=bool)
+        return {
+            "queries": len(self.statuses),
+            "ok": int(ok.sum()),
+            "rejected": self.statuses.count("rejected"),
+            "errors": self.statuses.count("error"),
+            "partial": self.partial,
+            "throughput_qps": len(self.statuses) / self.wall_s if self.wall_s > 0 else 0.0,
+            "latency_ms": latency_summary(self.latencies_ms[ok]),
+            "service_ms": latency_summary(self.service_ms[ok]),
+        }
+
+def replay(
+    records: Sequence[QueryRecord],
+    run_query: Callable[[QueryRecord], bool],
+    speed: float = 1.0,
+    concurrency: int = 4
+) -> ReplayResult:
+    """
+    Re-issues `records` in arrival (`ts`) order at their original spacing divided by `speed`
+    (0 sends them all at once), with at most `concurrency` queries running at a time.
+    run_query executes one record and returns whether its results were partial; it raises
+    QueryRejected for queries turned away by admission control.
+    """
+    if concurrency < 1:
+        raise ValueError("concurrency must be at least 1.")
+    # The log is written in completion order; queries are re-sent in arrival order
+    records = sorted(records, key=lambda record: record.ts)
+    count = len(records)
+    latencies = np.zeros(count, dtype=np.float64)
+    service = np.zeros(count, dtype=np.float64)
+    statuses = ["ok"] * count
+    partial = np.zeros(count, dtype=bool)
+    errors: List[str] = []
+    offsets = np.array([record.ts for record in records], dtype=np.float64)
+    if count:
+        offsets -= offsets.min()
+    offsets = offsets / speed if speed > 0 else np.zeros(count)
+
+    def issue(i: int, scheduled: float):
+        started = time.perf_counter()
+        try:
+            partial[i] = bool(run_query(records[i]))
+        except QueryRejected:
+            statuses[i] = "rejected"
+        except Exception as e:
+            statuses[i] = "error"
+            errors.append(f"{records[i].query!r}: {e}")
+        finished = time.perf_counter()
+        latencies[i] = (finished - scheduled) * 1000.0
+        service[i] = (finished - started) * 1000.0
+
+    start = time.perf_counter()
+    with ThreadPoolExecutor(max_workers=concurrency, thread_name_prefix="replay") as pool:
+        for i in range(count):
+            scheduled = start + offsets[i]
+            delay = scheduled - time.perf_counter()
+            if delay > 0:
+                time.sleep(delay)
+            pool.submit(issue, i, scheduled)
+    return ReplayResult(latencies, service, statuses, int(partial.sum()), time.perf_counter() - start, errors)
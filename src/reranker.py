@@ -0,0 +1,186 @@
+"""
+Cross-encoder re-ranking of retrieved nodes.
+
+A cross-encoder reads the query and a candidate together, so it orders nuanced matches
+better than the bi-encoder's dot product, at the cost of one forward pass per candidate.
+CrossEncoderReranker is a LlamaIndex node postprocessor (QueryEngineBuilder adds it when
+rerank_model is set). It keeps that cost bounded:
+
+* Pairs are tokenized once, then grouped by length into batches, so a long abstract does
+  not pad a batch of short ones.
+* Each query has a latency budget. The reranker keeps a running estimate of the cost per
+  padded token and scores only as many of the best bi-encoder candidates as the budget
+  allows. It stops between batches if the budget runs out anyway. Candidates that were not
+  scored follow the scored ones, in their original order.
+
+Inference runs on the CPU path used for embeddings (src.core_components): with precision
+"int8", Linear layers are dynamically quantized for the VNNI/AVX2 int8 kernels.
+"""
+import time
+import threading
+from typing import Any, Dict, List, Optional, Sequence, Tuple
+
+import numpy as np
+import torch
+from llama_index.core.bridge.pydantic import Field, PrivateAttr
+from llama_index.core.postprocessor.types import BaseNodePostprocessor
+from llama_index.core.schema import MetadataMode, NodeWithScore, QueryBundle
+
+from src.core_components import EMBEDDING_PRECISIONS, select_quantized_engine
+from src.kernels import run_native
+
+# Process-wide cache of loaded cross-encoders keyed by (model_name, precision)
+_cross_encoder_cache: Dict[Tuple[str, str], "CrossEncoder"] = {}
+_cross_encoder_lock = threading.Lock()
+
+class CrossEncoder:
+    """
+    A sequence-pair classification model (e.g. cross-encoder/ms-marco-MiniLM-L-6-v2) and its
+    tokenizer. The relevance score is the single logit, or the last one for multi-label heads.
+
+    Args:
+        model (torch.nn.Module): A transformers *ForSequenceClassification model.
+        tokenizer: The matching transformers tokenizer.
+        max_length (int): Token limit per (query, text) pair; the text is truncated.
+    """
+    def __init__(self, model: torch.nn.Module, tokenizer: Any, max_length: int = 256):
+        self.model = model.eval()
+        self.tokenizer = tokenizer
+        self.max_length = max_length
+
+    @classmethod
+    def from_pretrained(cls, model_name: str, precision: str = "float32", max_length: int = 256) -> "CrossEncoder":
+        """Loads (once per process) a Hugging Face cross-encoder for CPU inference."""
+        if precision not in EMBEDDING_PRECISIONS:
+            raise ValueError(f"Unsupported rerank precision '{precision}'. Expected one of {EMBEDDING_PRECISIONS}.")
+        with _cross_encoder_lock:
+            encoder = _cross_encoder_cache.get((model_name, precision))
+            if encoder is None:
+                from transformers import AutoModelForSequenceClassification, AutoTokenizer
+                print(f"Initializing cross-encoder: {model_name} ({precision}) on cpu")
+                model = AutoModelForSequenceClassification.from_pretrained(model_name)
+                encoder = cls(model, AutoTokenizer.from_pretrained(model_name), max_length=max_length)
+                if precision == "int8":
+                    encoder.quantize_int8()
+                _cross_encoder_cache[(model_name, precision)] = encoder
+        return encoder
+
+    def quantize_int8(self):
+        """Dynamically quantize every nn.Linear to int8, in place (see quantize_embedding_model_int8)."""
+        torch.backends.quantized.engine = select_quantized_engine()
+        qconfig_spec = {torch.nn.Linear: torch.ao.quantization.per_channel_dynamic_qconfig}
+        self.model = torch.ao.quantization.quantize_dynamic(self.model, qconfig_spec=qconfig_spec, dtype=torch.qint8)
+
+    def tokenize(self, query: str, texts: Sequence[str]) -> List[Dict[str, List[int]]]:
+        """Unpadded encodings of each (query, text) pair."""
+        encoded = self.tokenizer(
+            [query] * len(texts), list(texts), truncation="only_second", max_length=self.max_length, padding=False
+        )
+        keys = [key for key in ("input_ids", "attention_mask", "token_type_ids") if key in encoded]
+        return [{key: encoded[key][i] for key in keys} for i in range(len(texts))]
+
+    def score(self, pairs: Sequence[Dict[str, List[int]]]) -> np.ndarray:
+        """Relevance scores of a batch of tokenized pairs, padded to the longest."""
+        width = max(len(pair["input_ids"]) for pair in pairs)
+        pad_id = self.tokenizer.pad_token_id or 0
+        batch = {}
+        for key in pairs[0]:
+            fill = pad_id if key == "input_ids" else 0
+            batch[key] = torch.tensor([pair[key] + [fill] * (width - len(pair[key])) for pair in pairs], dtype=torch.long)
+        with torch.inference_mode():
+            logits = self.model(**batch).logits
+        return logits[:, -1].float().numpy()
+
+def length_buckets(lengths: Sequence[int], batch_size: int) -> List[np.ndarray]:
+    """
+    Groups items into batches of at most `batch_size` with similar lengths (sorted by length).
+    Batches are returned in order of the earliest item they contain, so under a budget the
+    best-ranked candidates are scored first.
+    """
+    order = np.argsort(np.asarray(lengths), kind="stable")
+    batches = [order[start:start + batch_size] for start in range(0, len(order), batch_size)]
+    return sorted(batches, key=lambda batch: int(batch.min()))
+
+class CrossEncoderReranker(BaseNodePostprocessor):
+    """
+    Re-orders retrieved nodes by cross-encoder score within a latency budget.
+
+    Args:
+        encoder (CrossEncoder): The scoring model.
+        top_n (int): Nodes returned.
+        batch_size (int): Pairs per forward pass.
+        budget_ms (float): Time allowed per query for scoring (0 = unbounded).
+    """
+    top_n: int = Field(default=3)
+    batch_size: int = Field(default=16)
+    budget_ms: float = Field(default=0)
+
+    _encoder: CrossEncoder = PrivateAttr()
+    # Running estimate of scoring cost per padded token, None until the first batch
+    _ms_per_token: Optional[float] = PrivateAttr(default=None)
+    _lock: threading.Lock = PrivateAttr(default_factory=threading.Lock)
+    _last_run: Dict[str, Any] = PrivateAttr(default_factory=dict)
+
+    def __init__(self, encoder: CrossEncoder, **kwargs: Any):
+        super().__init__(**kwargs)
+        self._encoder = encoder
+        self._lock = threading.Lock()
+
+    @classmethod
+    def class_name(cls) -> str:
+        return "CrossEncoderReranker"
+
+    @property
+    def ms_per_token(self) -> Optional[float]:
+        return self._ms_per_token
+
+    @property
+    def last_run(self) -> Dict[str, Any]:
+        """Candidates, how many were scored, whether the budget cut scoring short, and time taken, for the last query."""
+        return self._last_run
+
+    def _postprocess_nodes(self, nodes: List[NodeWithScore], query_bundle: Optional[QueryBundle] = None) -> List[NodeWithScore]:
+        if query_bundle is None or not nodes:
+            return nodes[:self.top_n]
+        start = time.perf_counter()
+        texts = [node.node.get_content(metadata_mode=MetadataMode.EMBED) for node in nodes]
+        pairs = self._encoder.tokenize(query_bundle.query_str, texts)
+        lengths = [len(pair["input_ids"]) for pair in pairs]
+        admitted = self._admit(lengths, start)
+        scores: Dict[int, float] = {}
+        for batch in length_buckets(lengths[:admitted], self.batch_size):
+            if self.budget_ms and scores and (time.perf_counter() - start) * 1000.0 >= self.budget_ms:
+                break
+            batch_start = time.perf_counter()
+            batch_scores = self._encoder.score([pairs[i] for i in batch])
+            self._observe((time.perf_counter() - batch_start) * 1000.0, len(batch) * max(lengths[i] for i in batch))
+            scores.update(zip(batch.tolist(), batch_scores.tolist()))
+        scored = sorted(scores, key=lambda i: -scores[i])
+        reranked = [NodeWithScore(node=nodes[i].node, score=scores[i]) for i in scored]
+        reranked += [nodes[i] for i in range(len(nodes)) if i not in scores]
+        self._last_run = {
+            "candidates": len(nodes),
+            "scored": len(scores),
+            "partial": len(scores) < len(nodes),
+            "ms": (time.perf_counter() - start) * 1000.0,
+        }
+        return reranked[:self.top_n]
+
+    async def _apostprocess_nodes(self, nodes: List[NodeWithScore], query_bundle: Optional[QueryBundle] = None) -> List[NodeWithScore]:
+        # Tokenization and the forward passes release the GIL; run them on the native pool, off the event loop
+        return await run_native(self._postprocess_nodes, nodes, query_bundle)
+
+    def _admit(self, lengths: List[int], start: float) -> int:
+        """Number of leading candidates whose estimated scoring cost fits the remaining budget (at least one)."""
+        if not self.budget_ms or self._ms_per_token is None:
+            return len(lengths)
+        remaining = self.budget_ms - (time.perf_counter() - start) * 1000.0
+        # Padding within a length bucket is small; estimate with the unpadded token count
+        cost = np.cumsum(lengths) * self._ms_per_token
+        return max(1, int(np.searchsorted(cost, remaining, side="right")))
+
+    def _observe(self, elapsed_ms: float, padded_tokens: int):
+        per_token = elapsed_ms / max(padded_tokens, 1)
+        with self._lock:
+            # Exponential moving average over recent batches
+            self._ms_per_token = per_token if self._ms_per_token is None else 0.8 * self._ms_per_token + 0.2 * per_token
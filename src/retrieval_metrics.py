@@ -0,0 +1,36 @@
+import numpy as np
+from typing import Sequence
+
+def exact_top_k(queries: np.ndarray, corpus: np.ndarray, k: int) -> np.ndarray:
+    """
+    Brute-force top-k by dot product (cosine similarity for normalized embeddings).
+
+    Args:
+        queries (np.ndarray): (Q, D) query embeddings.
+        corpus (np.ndarray): (N, D) document embeddings.
+        k (int): Number of neighbours per query.
+    Returns:
+        np.ndarray: (Q, min(k, N)) row indices into `corpus`, best first.
+    """
+    scores = np.asarray(queries, dtype=np.float32) @ np.asarray(corpus, dtype=np.float32).T
+    k = min(k, scores.shape[1])
+    top = np.argpartition(-scores, k - 1, axis=1)[:, :k]
+    order = np.argsort(-np.take_along_axis(scores, top, axis=1), axis=1, kind="stable")
+    return np.take_along_axis(top, order, axis=1)
+
+def recall_at_k(retrieved: Sequence[Sequence], ground_truth: Sequence[Sequence], k: int) -> float:
+    """
+    Mean fraction of each query's true top-k found in its retrieved top-k.
+    Works on any hashable ids (row indices, node ids, doc ids).
+    """
+    if len(retrieved) != len(ground_truth):
+        raise ValueError("retrieved and ground_truth must have one entry per query.")
+    total = 0.0
+    evaluated = 0
+    for found, truth in zip(retrieved, ground_truth):
+        truth_k = list(truth)[:k]
+        if not truth_k:
+            continue
+        total += len(set(list(found)[:k]) & set(truth_k)) / len(truth_k)
+        evaluated += 1
+    return total / evaluated if evaluated else 0.0
@@ -0,0 +1,319 @@
+import threading
+from collections import OrderedDict
+from typing import Any, Callable, Dict, List, Optional, Sequence, Tuple
+
+import numpy as np
+from llama_index.core import Settings
+from llama_index.core.base.base_retriever import BaseRetriever
+from llama_index.core.callbacks import CallbackManager
+from llama_index.core.schema import NodeWithScore, QueryBundle
+from llama_index.core.storage.docstore.types import BaseDocumentStore
+from llama_index.embeddings.huggingface import HuggingFaceEmbedding
+
+from src.core_components import token_embeddings
+from src.deadlines import Deadline
+from src.index_segments import merge_top_k
+from src.index_views import MetadataColumns, encode_ids
+from src.kernels import run_native
+from src.multivector import MultiVectorIndex
+from src.profiling import QueryProfile
+from src.vector_store import FlatHits, FlatSnapshot, FlatVectorStore
+
+# Query encodings kept per retriever, so repeated queries skip the encoder
+QUERY_CACHE_SIZE = 256
+
+# Facet field -> {value: hit count}, most frequent first
+Facets = Dict[str, Dict[Any, int]]
+
+class NativeRetriever(BaseRetriever):
+    """
+    Base class for retrievers backed by this project's own search code rather than a
+    LlamaIndex vector store query. Subclasses implement _search; node contents are
+    fetched from the docstore. retrieve_within() runs a search under a per-query Deadline
+    and can record an explain profile (embed / search / fetch timings and counters);
+    retrieve_with_facets() also returns facet counts when the retriever computes them.
+    The awaitable variants (aretrieve, aretrieve_with_facets) complete each stage on the
+    native thread pool (see src.kernels.run_native) instead of the event loop.
+
+    Args:
+        docstore (BaseDocumentStore): Store holding the indexed nodes.
+        embed_model (Optional[HuggingFaceEmbedding]): Query encoder; defaults to Settings.embed_model.
+        similarity_top_k (int): Number of nodes returned.
+    """
+    def __init__(
+        self,
+        docstore: BaseDocumentStore,
+        embed_model: Optional[HuggingFaceEmbedding] = None,
+        similarity_top_k: int = 3,
+        callback_manager: Optional[CallbackManager] = None
+    ):
+        super().__init__(callback_manager=callback_manager)
+        self.docstore = docstore
+        self.embed_model = embed_model or Settings.embed_model
+        self.similarity_top_k = similarity_top_k
+        self._query_cache: "OrderedDict[str, Any]" = OrderedDict()
+        self._query_cache_lock = threading.Lock()
+
+    def _search(self, query_bundle: QueryBundle, deadline: Optional[Deadline], profile: QueryProfile) -> Tuple[Sequence[str], np.ndarray, Optional[Facets]]:
+        """Returns node ids and scores, best first, and facet counts (None if not computed)."""
+        raise NotImplementedError
+
+    def _encode_query(self, query_str: str, encode: Callable[[str], Any], profile: QueryProfile) -> Any:
+        """Returns encode(query_str), served from a small LRU cache when the query repeats."""
+        with profile.stage("embed"):
+            with self._query_cache_lock:
+                cached = self._query_cache.get(query_str)
+                if cached is not None:
+                    self._query_cache.move_to_end(query_str)
+            if cached is not None:
+                profile.count("query_cache_hits")
+                return cached
+            profile.count("query_cache_misses")
+            encoded = encode(query_str)
+            with self._query_cache_lock:
+                self._query_cache[query_str] = encoded
+                if len(self._query_cache) > QUERY_CACHE_SIZE:
+                    self._query_cache.popitem(last=False)
+            return encoded
+
+    def _retrieve(self, query_bundle: QueryBundle) -> List[NodeWithScore]:
+        return self.retrieve_within(query_bundle, None)
+
+    async def _aretrieve(self, query_bundle: QueryBundle) -> List[NodeWithScore]:
+        return (await self.aretrieve_with_facets(query_bundle))[0]
+
+    def retrieve_within(
+        self,
+        query_bundle: QueryBundle,
+        deadline: Optional[Deadline],
+        profile: Optional[QueryProfile] = None
+    ) -> List[NodeWithScore]:
+        """
+        Retrieves under `deadline`. Search stages that run out of time return their best
+        results so far and record it on the deadline (deadline.partial).
+        """
+        return self.retrieve_with_facets(query_bundle, deadline, profile)[0]
+
+    def retrieve_with_facets(
+        self,
+        query_bundle: QueryBundle,
+        deadline: Optional[Deadline] = None,
+        profile: Optional[QueryProfile] = None
+    ) -> Tuple[List[NodeWithScore], Optional[Facets]]:
+        """Like retrieve_within, also returning the facet counts computed by the same search."""
+        profile = profile or QueryProfile()
+        node_ids, scores, facets = self._search(query_bundle, deadline, profile)
+        return self._fetch(node_ids, scores, profile), facets
+
+    async def aretrieve_with_facets(
+        self,
+        query_bundle: QueryBundle,
+        deadline: Optional[Deadline] = None,
+        profile: Optional[QueryProfile] = None
+    ) -> Tuple[List[NodeWithScore], Optional[Facets]]:
+        """Awaitable retrieve_with_facets: the search (with query encoding) and the fetch each run on the native pool."""
+        profile = profile or QueryProfile()
+        node_ids, scores, facets = await run_native(self._search, query_bundle, deadline, profile)
+        return await run_native(self._fetch, node_ids, scores, profile), facets
+
+    def _fetch(self, node_ids: Sequence[str], scores: np.ndarray, profile: QueryProfile) -> List[NodeWithScore]:
+        with profile.stage("fetch"):
+            nodes = self.docstore.get_nodes(list(node_ids))
+        profile.set("results", len(nodes))
+        return [NodeWithScore(node=node, score=float(score)) for node, score in zip(nodes, scores)]
+
+class FlatVectorRetriever(NativeRetriever):
+    """
+    Exact single-vector retrieval over a FlatVectorStore, with deadline-aware scanning.
+
+    With facet fields set, each search also counts hits per metadata value over a candidate
+    set from the same scan: the best `facet_candidates` rows, or every row scoring at least
+    `facet_min_score`. Facet searches scan every row and ignore the deadline.
+
+    Args:
+        vector_store (FlatVectorStore): The index's vector store.
+        metadata_columns (Optional[MetadataColumns]): Dictionary-encoded metadata (see IndexBuilder).
+        facet_fields (Sequence[str]): Columns to count; must be in metadata_columns.
+        facet_candidates (int): Size of the top-N candidate set.
+        facet_min_score (Optional[float]): Score threshold defining the candidate set instead.
+        prf_top_m (int): Pseudo-relevance feedback: refine short queries towards the stored
+            vectors of the first pass's best `prf_top_m` rows (0 = off).
+        prf_alpha (float): Rocchio weight of the original query.
+        prf_beta (float): Rocchio weight of the feedback centroid.
+        prf_candidates (int): First-pass rows the refined query rescores.
+        prf_max_query_words (int): Longer queries skip feedback (0 = no limit).
+    """
+    def __init__(
+        self,
+        vector_store: FlatVectorStore,
+        docstore: BaseDocumentStore,
+        metadata_columns: Optional[MetadataColumns] = None,
+        facet_fields: Sequence[str] = (),
+        facet_candidates: int = 1000,
+        facet_min_score: Optional[float] = None,
+        prf_top_m: int = 0,
+        prf_alpha: float = 1.0,
+        prf_beta: float = 0.75,
+        prf_candidates: int = 100,
+        prf_max_query_words: int = 3,
+        **kwargs
+    ):
+        super().__init__(docstore, **kwargs)
+        missing = [f for f in facet_fields if metadata_columns is None or f not in metadata_columns.fields]
+        if missing:
+            raise ValueError(f"Facet fields {missing} have no metadata columns (add them to metadata_column_fields).")
+        self.vector_store = vector_store
+        self.metadata_columns = metadata_columns
+        self.facet_fields = list(facet_fields)
+        self.facet_candidates = facet_candidates
+        self.facet_min_score = facet_min_score
+        self.prf_top_m = prf_top_m
+        self.prf_alpha = prf_alpha
+        self.prf_beta = prf_beta
+        self.prf_candidates = prf_candidates
+        self.prf_max_query_words = prf_max_query_words
+        self._facet_codes: Dict[str, np.ndarray] = {}
+        self._facet_codes_version = -1
+        self._facet_lock = threading.Lock()
+
+    def _row_codes(self, snapshot: FlatSnapshot) -> Dict[str, np.ndarray]:
+        """Facet codes aligned with the rows of `snapshot`, recomputed after inserts and deletes."""
+        with self._facet_lock:
+            if self._facet_codes_version != snapshot.version:
+                node_ids = encode_ids(snapshot.node_ids)
+                self._facet_codes = {f: self.metadata_columns.aligned_codes(f, node_ids) for f in self.facet_fields}
+                self._facet_codes_version = snapshot.version
+            return self._facet_codes
+
+    def _use_feedback(self, query_str: str) -> bool:
+        if self.prf_top_m <= 0:
+            return False
+        return not self.prf_max_query_words or len(query_str.split()) <= self.prf_max_query_words
+
+    def _feedback(self, embedding: Sequence[float], hits: FlatHits, profile: QueryProfile) -> FlatHits:
+        """Second pass of pseudo-relevance feedback, over the first pass's hits only."""
+        with profile.stage("feedback"):
+            return self.vector_store.rescore_with_feedback(
+                embedding, hits, self.similarity_top_k, self.prf_top_m, alpha=self.prf_alpha, beta=self.prf_beta
+            )
+
+    def _search(self, query_bundle: QueryBundle, deadline: Optional[Deadline], profile: QueryProfile) -> Tuple[Sequence[str], np.ndarray, Optional[Facets]]:
+        embedding = query_bundle.embedding or self._encode_query(query_bundle.query_str, self.embed_model.get_query_embedding, profile)
+        feedback = self._use_feedback(query_bundle.query_str)
+        # With feedback, the first pass keeps a larger pool for the refined query to rescore
+        first_k = max(self.similarity_top_k, self.prf_candidates) if feedback else self.similarity_top_k
+        if feedback:
+            profile.set("feedback_candidates", first_k)
+        if not self.facet_fields:
+            with profile.stage("search"):
+                hits = self.vector_store.search(embedding, first_k, deadline=deadline, profile=profile)
+            if feedback:
+                hits = self._feedback(embedding, hits, profile)
+            return hits.node_ids, hits.scores, None
+        with profile.stage("search"):
+            hits, candidates = self.vector_store.search_with_candidates(
+                embedding, first_k, self.facet_candidates, min_score=self.facet_min_score, profile=profile
+            )
+        if feedback:
+            hits = self._feedback(embedding, hits, profile)
+        with profile.stage("facets"):
+            codes = self._row_codes(hits.snapshot)
+            facets = {f: self.metadata_columns.facet_counts(f, codes[f], candidates) for f in self.facet_fields}
+        profile.set("facet_candidates", len(candidates))
+        return hits.node_ids, hits.scores, facets
+
+class SegmentedRetriever(NativeRetriever):
+    """
+    Searches the main index and every live segment (see src.index_segments) with one query
+    encoding, and merges their top-k. Facet counts come from the main index only. Segments
+    are looked up on each query, so segments added or retired by a merge take effect at once.
+
+    Args:
+        base (FlatVectorRetriever): Retriever over the main index.
+        segments (Callable[[], Sequence[Any]]): Live segment indexes (see IndexBuilder.live_segments).
+        make_retriever (Callable[[Any], FlatVectorRetriever]): Builds the retriever for a segment index.
+    """
+    def __init__(
+        self,
+        base: FlatVectorRetriever,
+        segments: Callable[[], Sequence[Any]],
+        make_retriever: Callable[[Any], FlatVectorRetriever],
+        **kwargs
+    ):
+        super().__init__(base.docstore, embed_model=base.embed_model, similarity_top_k=base.similarity_top_k, **kwargs)
+        self.base = base
+        self.segments = segments
+        self.make_retriever = make_retriever
+        self._segment_retrievers: Dict[int, Tuple[Any, FlatVectorRetriever]] = {}
+        self._segment_lock = threading.Lock()
+
+    def _live_retrievers(self) -> List[FlatVectorRetriever]:
+        indexes = self.segments()
+        with self._segment_lock:
+            live = {id(index): self._segment_retrievers.get(id(index)) or (index, self.make_retriever(index)) for index in indexes}
+            self._segment_retrievers = live
+            return [retriever for _, retriever in live.values()]
+
+    def _search(self, query_bundle: QueryBundle, deadline: Optional[Deadline], profile: QueryProfile) -> Tuple[Sequence[str], np.ndarray, Optional[Facets]]:
+        embedding = query_bundle.embedding or self._encode_query(query_bundle.query_str, self.embed_model.get_query_embedding, profile)
+        query_bundle = QueryBundle(query_str=query_bundle.query_str, embedding=embedding)
+        node_ids, scores, facets = self.base._search(query_bundle, deadline, profile)
+        segments = self._live_retrievers()
+        if not segments:
+            return node_ids, scores, facets
+        profile.set("segments", len(segments))
+        results = [(node_ids, scores)] + [retriever._search(query_bundle, deadline, profile)[:2] for retriever in segments]
+        node_ids, scores = merge_top_k(results, self.similarity_top_k)
+        return node_ids, scores, facets
+
+    def _fetch(self, node_ids: Sequence[str], scores: np.ndarray, profile: QueryProfile) -> List[NodeWithScore]:
+        segments = self._live_retrievers()
+        if not segments:
+            return super()._fetch(node_ids, scores, profile)
+        # A node is in the main index or in a segment (both while a merge is in progress);
+        # one retired between search and fetch has already been merged into the main index.
+        docstores = [self.docstore] + [retriever.docstore for retriever in segments]
+        results = []
+        with profile.stage("fetch"):
+            for node_id, score in zip(node_ids, scores):
+                for docstore in docstores:
+                    node = docstore.get_node(node_id, raise_error=False)
+                    if node is not None:
+                        results.append(NodeWithScore(node=node, score=float(score)))
+                        break
+        profile.set("results", len(results))
+        return results
+
+class MultiVectorRetriever(NativeRetriever):
+    """
+    Retrieves nodes with late-interaction (MaxSim) scoring over a MultiVectorIndex.
+    Query tokens come from the same encoder as the indexed tokens.
+
+    Args:
+        multivector_index (MultiVectorIndex): Per-token index of the nodes.
+        nprobe (int): Centroids probed per query token.
+        candidates (int): Nodes kept for exact MaxSim scoring.
+    """
+    def __init__(
+        self,
+        multivector_index: MultiVectorIndex,
+        docstore: BaseDocumentStore,
+        nprobe: int = 4,
+        candidates: int = 256,
+        **kwargs
+    ):
+        super().__init__(docstore, **kwargs)
+        self.multivector_index = multivector_index
+        self.nprobe = nprobe
+        self.candidates = candidates
+
+    def _search(self, query_bundle: QueryBundle, deadline: Optional[Deadline], profile: QueryProfile) -> Tuple[Sequence[str], np.ndarray, Optional[Facets]]:
+        query_tokens = self._encode_query(
+            query_bundle.query_str, lambda text: token_embeddings(self.embed_model, [text])[0], profile
+        )
+        with profile.stage("search"):
+            rows, scores = self.multivector_index.search(
+                query_tokens, self.similarity_top_k, nprobe=self.nprobe, candidates=self.candidates,
+                deadline=deadline, profile=profile
+            )
+        return [self.multivector_index.node_ids[row] for row in rows], scores, None
@@ -0,0 +1,141 @@
+"""
+A LlamaIndex docstore backed by a shared JSONSegment (see src.shared_segments).
+
+SegmentKVStore answers reads from the mapped segment and keeps writes (WAL replay,
+insert_nodes, deletes) in a small in-process overlay. persist() streams the merged contents
+in SimpleKVStore's format and key order, so docstore.json stays readable by SimpleDocumentStore
+and is written without holding the docstore in memory.
+"""
+import os
+import json
+import threading
+from typing import Any, Dict, List, Optional, Set, TextIO
+
+import fsspec
+from llama_index.core.storage.docstore import SimpleDocumentStore
+from llama_index.core.storage.kvstore.types import DEFAULT_COLLECTION, BaseInMemoryKVStore
+
+from src.shared_segments import JSONSegment
+
+class SegmentKVStore(BaseInMemoryKVStore):
+    """
+    Key-value store reading from a JSONSegment, with an in-memory overlay for changes.
+
+    Args:
+        segment (JSONSegment): Mapped collections, e.g. JSONSegment.from_bundle(bundle).
+    """
+    def __init__(self, segment: JSONSegment):
+        self._segment = segment
+        self._overlay: Dict[str, Dict[str, dict]] = {}
+        self._deleted: Dict[str, Set[str]] = {}
+        self._lock = threading.Lock()
+
+    @property
+    def segment(self) -> JSONSegment:
+        return self._segment
+
+    @property
+    def modified(self) -> bool:
+        """True once anything was put or deleted, i.e. the contents differ from the segment."""
+        with self._lock:
+            return any(self._overlay.values()) or any(self._deleted.values())
+
+    def put(self, key: str, val: dict, collection: str = DEFAULT_COLLECTION) -> None:
+        with self._lock:
+            self._overlay.setdefault(collection, {})[key] = val.copy()
+            self._deleted.get(collection, set()).discard(key)
+
+    async def aput(self, key: str, val: dict, collection: str = DEFAULT_COLLECTION) -> None:
+        self.put(key, val, collection)
+
+    def get(self, key: str, collection: str = DEFAULT_COLLECTION) -> Optional[dict]:
+        with self._lock:
+            if key in self._overlay.get(collection, ()):
+                return self._overlay[collection][key].copy()
+            if key in self._deleted.get(collection, ()):
+                return None
+        return self._segment.get(collection, key)
+
+    async def aget(self, key: str, collection: str = DEFAULT_COLLECTION) -> Optional[dict]:
+        return self.get(key, collection)
+
+    def get_all(self, collection: str = DEFAULT_COLLECTION) -> Dict[str, dict]:
+        with self._lock:
+            deleted = set(self._deleted.get(collection, ()))
+            overlay = {key: val.copy() for key, val in self._overlay.get(collection, {}).items()}
+        values = {key: val for key, val in self._segment.items(collection) if key not in deleted}
+        values.update(overlay)
+        return values
+
+    async def aget_all(self, collection: str = DEFAULT_COLLECTION) -> Dict[str, dict]:
+        return self.get_all(collection)
+
+    def delete(self, key: str, collection: str = DEFAULT_COLLECTION) -> bool:
+        with self._lock:
+            removed = self._overlay.get(collection, {}).pop(key, None) is not None
+            if (collection, key) in self._segment and key not in self._deleted.get(collection, ()):
+                self._deleted.setdefault(collection, set()).add(key)
+                removed = True
+            return removed
+
+    async def adelete(self, key: str, collection: str = DEFAULT_COLLECTION) -> bool:
+        return self.delete(key, collection)
+
+    def _collection_names(self) -> List[str]:
+        return self._segment.collections + [name for name in self._overlay if name not in self._segment.collections]
+
+    def to_dict(self) -> Dict[str, Dict[str, dict]]:
+        """Merged contents, in SimpleKVStore's layout."""
+        return {collection: self.get_all(collection) for collection in self._collection_names()}
+
+    def write_json(self, f: TextIO) -> None:
+        """
+        Writes json.dumps(self.to_dict()) to `f` piece by piece. Segment values are copied as
+        stored, without decoding them; segment keys come first, in insertion order, then keys
+        only in the overlay.
+        """
+        with self._lock:
+            overlay = {collection: dict(values) for collection, values in self._overlay.items()}
+            deleted = {collection: set(keys) for collection, keys in self._deleted.items()}
+        f.write("{")
+        for i, collection in enumerate(self._collection_names()):
+            f.write(f"{', ' if i else ''}{json.dumps(collection)}: {{")
+            changed = overlay.get(collection, {})
+            removed = deleted.get(collection, set())
+            separator = ""
+            for key, raw in self._segment.raw_items(collection):
+                if key in removed:
+                    continue
+                value = json.dumps(changed.pop(key)) if key in changed else raw.decode("utf-8")
+                f.write(f"{separator}{json.dumps(key)}: {value}")
+                separator = ", "
+            for key, val in changed.items():
+                f.write(f"{separator}{json.dumps(key)}: {json.dumps(val)}")
+                separator = ", "
+            f.write("}")
+        f.write("}")
+
+    def persist(self, persist_path: str, fs: Optional[fsspec.AbstractFileSystem] = None) -> None:
+        fs = fs or fsspec.filesystem("file")
+        dirpath = os.path.dirname(persist_path)
+        if not fs.exists(dirpath):
+            fs.makedirs(dirpath)
+        with fs.open(persist_path, "w") as f:
+            self.write_json(f)
+
+    @classmethod
+    def from_persist_path(cls, persist_path: str, fs: Optional[fsspec.AbstractFileSystem] = None) -> "SegmentKVStore":
+        fs = fs or fsspec.filesystem("file")
+        with fs.open(persist_path, "rb") as f:
+            return cls(JSONSegment.build(json.load(f)))
+
+def segment_docstore(segment: JSONSegment, **kwargs: Any) -> SimpleDocumentStore:
+    """A SimpleDocumentStore over `segment`; it persists to docstore.json like any other."""
+    return SimpleDocumentStore(simple_kvstore=SegmentKVStore(segment), **kwargs)
+
+def unmodified_segment(docstore: SimpleDocumentStore) -> Optional[JSONSegment]:
+    """The segment behind a segment_docstore whose contents it still matches, else None."""
+    kvstore = getattr(docstore, "_kvstore", None)
+    if isinstance(kvstore, SegmentKVStore) and not kvstore.modified:
+        return kvstore.segment
+    return None
@@ -0,0 +1,226 @@
+"""
+Index segments shared between serving processes.
+
+Several serving processes on one host can load the same persisted index. Arrays that are
+memory-mapped from the bundle (flat vectors, multi-vector codes, metadata columns, the title
+index) already share one copy of their pages through the page cache. The docstore, however,
+is JSON: each process that parses it keeps a private copy of every node.
+
+JSONSegment stores JSON key-value collections (the docstore's) as sorted keys, offsets and
+one byte blob. A lookup binary-searches the mapped keys and decodes a single value, so a
+process only holds the values it is using. Everything else stays in shared, clean,
+file-backed pages.
+
+Generations: IndexBuilder.persist numbers each index it writes (GENERATION_FILENAME) and
+replaces the bundle with a rename. A process that has the old bundle mapped keeps reading the
+old generation: the kernel holds the old file until its last mapping goes away. This is the
+reference count, and it also covers processes that crash. bundle_identity tells a process
+that the bundle was replaced, so it can load the new generation when it is idle (see
+CollectionManager). Nothing here imports LlamaIndex.
+"""
+import os
+import json
+from typing import Any, Dict, Iterator, List, Optional, Tuple
+
+import numpy as np
+
+from src.index_bundle import IndexBundle
+from src.index_views import encode_ids
+
+DOCSTORE_SEGMENT_PREFIX = "docstore_segment"
+DOCSTORE_SEGMENT_HEADER = f"{DOCSTORE_SEGMENT_PREFIX}.json"
+GENERATION_FILENAME = "generation.json"
+
+def segment_filename(index: int, part: str) -> str:
+    return f"{DOCSTORE_SEGMENT_PREFIX}.{index}.{part}.npy"
+
+class JSONSegment:
+    """
+    Read-only JSON key-value collections over mapped arrays.
+
+    Per collection: keys ('S', sorted), offsets (int64, one more than keys) and a uint8 blob
+    holding each value's JSON at blob[offsets[i]:offsets[i + 1]]. An optional int64 order array
+    lists the rows in insertion order, so keys() and items() follow the source dict (and
+    docstore.json) rather than key order; segments written without it iterate sorted.
+
+    Args:
+        collections (Dict[str, Tuple[np.ndarray, np.ndarray, np.ndarray]]): Name -> (keys, offsets, blob).
+        order (Optional[Dict[str, np.ndarray]]): Name -> rows in insertion order.
+    """
+    def __init__(
+        self,
+        collections: Dict[str, Tuple[np.ndarray, np.ndarray, np.ndarray]],
+        generation: int = 0,
+        order: Optional[Dict[str, np.ndarray]] = None
+    ):
+        self._collections = collections
+        self._order = order or {}
+        # Index generation the segment was written for (see write_next_generation)
+        self.generation = generation
+
+    @classmethod
+    def build(cls, data: Dict[str, Dict[str, Any]]) -> "JSONSegment":
+        """From {collection: {key: JSON-serializable value}}, e.g. a parsed docstore.json."""
+        return cls.from_encoded({
+            name: {key: json.dumps(value).encode("utf-8") for key, value in values.items()}
+            for name, values in data.items()
+        })
+
+    @classmethod
+    def from_encoded(cls, data: Dict[str, Dict[str, bytes]]) -> "JSONSegment":
+        """Like build, from values already serialized with json.dumps and UTF-8 encoded."""
+        collections, order = {}, {}
+        for name, values in data.items():
+            inserted = list(values)
+            rows = sorted(range(len(inserted)), key=inserted.__getitem__)
+            encoded = [values[inserted[row]] for row in rows]
+            offsets = np.zeros(len(rows) + 1, dtype=np.int64)
+            np.cumsum([len(e) for e in encoded], out=offsets[1:])
+            blob = np.frombuffer(b"".join(encoded), dtype=np.uint8)
+            collections[name] = (encode_ids([inserted[row] for row in rows]), offsets, blob)
+            order[name] = np.empty(len(rows), dtype=np.int64)
+            order[name][rows] = np.arange(len(rows))
+        return cls(collections, order=order)
+
+    @property
+    def collections(self) -> List[str]:
+        return list(self._collections)
+
+    def __len__(self) -> int:
+        return sum(len(keys) for keys, _, _ in self._collections.values())
+
+    @property
+    def nbytes(self) -> int:
+        return sum(keys.nbytes + offsets.nbytes + blob.nbytes for keys, offsets, blob in self._collections.values())
+
+    def _row(self, collection: str, key: str) -> int:
+        parts = self._collections.get(collection)
+        if parts is None or not len(parts[0]):
+            return -1
+        keys = parts[0]
+        encoded = key.encode("utf-8")
+        if len(encoded) > keys.dtype.itemsize:
+            return -1
+        row = int(np.searchsorted(keys, encoded))
+        return row if row < len(keys) and keys[row] == encoded else -1
+
+    def __contains__(self, item: Tuple[str, str]) -> bool:
+        return self._row(*item) >= 0
+
+    def get(self, collection: str, key: str) -> Optional[Any]:
+        """Decoded value of `key`, or None."""
+        row = self._row(collection, key)
+        if row < 0:
+            return None
+        _, offsets, blob = self._collections[collection]
+        return json.loads(blob[offsets[row]:offsets[row + 1]].tobytes())
+
+    def arrays(self, collection: str) -> Tuple[np.ndarray, np.ndarray, np.ndarray, np.ndarray]:
+        """(keys, offsets, blob, order) of a collection; order is the sorted rows when none was recorded."""
+        keys, offsets, blob = self._collections[collection]
+        order = self._order.get(collection)
+        return keys, offsets, blob, np.arange(len(keys), dtype=np.int64) if order is None else order
+
+    def _rows(self, collection: str) -> Iterator[int]:
+        parts = self._collections.get(collection)
+        if parts is None:
+            return iter(())
+        order = self._order.get(collection)
+        return iter(range(len(parts[0]))) if order is None else iter(order.tolist())
+
+    def keys(self, collection: str) -> List[str]:
+        """Keys of a collection, in insertion order when the segment recorded it."""
+        parts = self._collections.get(collection)
+        if parts is None:
+            return []
+        order = self._order.get(collection)
+        keys = parts[0] if order is None else parts[0][order]
+        return [key.decode("utf-8") for key in keys.tolist()]
+
+    def raw_items(self, collection: str) -> Iterator[Tuple[str, bytes]]:
+        """Every (key, JSON bytes) of a collection, without decoding the values."""
+        parts = self._collections.get(collection)
+        if parts is None:
+            return
+        keys, offsets, blob = parts
+        for row in self._rows(collection):
+            yield keys[row].decode("utf-8"), blob[offsets[row]:offsets[row + 1]].tobytes()
+
+    def items(self, collection: str) -> Iterator[Tuple[str, Any]]:
+        """Every (key, value) of a collection, decoding as it goes."""
+        for key, raw in self.raw_items(collection):
+            yield key, json.loads(raw)
+
+    # --- Persistence ---
+
+    def save(self, directory: str, generation: int = 0):
+        """Writes the header and arrays into `directory` (temporary files, then rename)."""
+        os.makedirs(directory, exist_ok=True)
+        ordered = all(name in self._order for name in self._collections)
+        for index, (name, (keys, offsets, blob)) in enumerate(self._collections.items()):
+            parts = [("keys", keys), ("offsets", offsets), ("blob", blob)]
+            if ordered:
+                parts.append(("order", self._order[name]))
+            for part, array in parts:
+                path = os.path.join(directory, segment_filename(index, part))
+                with open(path + ".tmp", "wb") as f:
+                    np.save(f, array)
+                os.replace(path + ".tmp", path)
+        write_segment_header(directory, self.collections, generation, ordered)
+
+    @staticmethod
+    def exists(directory: str) -> bool:
+        return os.path.exists(os.path.join(directory, DOCSTORE_SEGMENT_HEADER))
+
+    @classmethod
+    def _from_header(cls, header: Dict[str, Any], read_array) -> "JSONSegment":
+        names = header["collections"]
+        return cls({
+            name: tuple(read_array(segment_filename(index, part)) for part in ("keys", "offsets", "blob"))
+            for index, name in enumerate(names)
+        }, generation=int(header.get("generation", 0)), order={
+            name: read_array(segment_filename(index, "order")) for index, name in enumerate(names)
+        } if header.get("ordered") else None)
+
+    @classmethod
+    def load(cls, directory: str) -> "JSONSegment":
+        """Loads a segment saved with save(); arrays are memory-mapped read-only."""
+        with open(os.path.join(directory, DOCSTORE_SEGMENT_HEADER), "r", encoding="utf-8") as f:
+            header = json.load(f)
+        return cls._from_header(header, lambda name: np.load(os.path.join(directory, name), mmap_mode="r"))
+
+    @classmethod
+    def from_bundle(cls, bundle: IndexBundle) -> "JSONSegment":
+        """Loads the segment as zero-copy views into the bundle mapping."""
+        return cls._from_header(bundle.read_json(DOCSTORE_SEGMENT_HEADER), bundle.read_array)
+
+def write_segment_header(directory: str, collections: List[str], generation: int = 0, ordered: bool = False):
+    """Writes the header naming a segment's collections, after their arrays are in place."""
+    header_path = os.path.join(directory, DOCSTORE_SEGMENT_HEADER)
+    with open(header_path + ".tmp", "w", encoding="utf-8") as f:
+        json.dump({"collections": collections, "generation": generation, "ordered": ordered}, f)
+    os.replace(header_path + ".tmp", header_path)
+
+def write_next_generation(directory: str) -> int:
+    """Increments the generation number stored in `directory` and returns it (1 for a new index)."""
+    generation = read_generation(directory) + 1
+    path = os.path.join(directory, GENERATION_FILENAME)
+    with open(path + ".tmp", "w", encoding="utf-8") as f:
+        json.dump({"generation": generation}, f)
+    os.replace(path + ".tmp", path)
+    return generation
+
+def read_generation(directory: str) -> int:
+    path = os.path.join(directory, GENERATION_FILENAME)
+    if not os.path.exists(path):
+        return 0
+    with open(path, "r", encoding="utf-8") as f:
+        return int(json.load(f)["generation"])
+
+def bundle_identity(bundle_path: str) -> Optional[Tuple[int, int]]:
+    """(device, inode) of the bundle file, which changes whenever persist replaces it; None if absent."""
+    try:
+        st = os.stat(bundle_path)
+    except FileNotFoundError:
+        return None
+    return st.st_dev, st.st_ino
@@ -0,0 +1,120 @@
+import time
+import threading
+from concurrent.futures import ThreadPoolExecutor
+from dataclasses import dataclass, asdict
+from typing import Optional, Dict, Any, Tuple
+
+from llama_index.core import VectorStoreIndex
+from llama_index.core.base.base_query_engine import BaseQueryEngine
+
+from src.config_loader import IndexBuilderConfig, QueryEngineBuilderConfig
+from src.core_components import initialize_hf_embedding_model
+from src.index_builder import IndexBuilder
+from src.query_engine_builder import QueryEngineBuilder
+
+@dataclass
+class StartupReport:
+    """Wall-clock timings (seconds) of one startup, measured from StartupOrchestrator.start()."""
+    model_load_s: float = 0.0
+    storage_load_s: float = 0.0
+    index_ready_s: float = 0.0
+    time_to_ready_s: float = 0.0
+    warmup_s: Optional[float] = None
+    built_index: bool = False
+
+    def to_dict(self) -> Dict[str, Any]:
+        return asdict(self)
+
+class StartupOrchestrator:
+    """
+    Brings up an index and query engine with the slow steps overlapped.
+
+    The embedding model and the persisted index stores do not depend on each other,
+    so they are loaded on two threads. The index object is assembled once both are
+    available, the query engine reuses the already initialized model, and a warmup
+    retrieval runs in the background so the first real query does not pay for lazy
+    initialization.
+
+    Args:
+        index_builder_config (IndexBuilderConfig): Index settings.
+        query_engine_config (QueryEngineBuilderConfig): Query engine settings.
+        warmup_query (Optional[str]): Text used for the background warmup; None disables it.
+    """
+    def __init__(
+        self,
+        index_builder_config: IndexBuilderConfig,
+        query_engine_config: QueryEngineBuilderConfig,
+        warmup_query: Optional[str] = "warmup"
+    ):
+        self.index_builder = IndexBuilder(config=index_builder_config)
+        self.query_engine_config = query_engine_config
+        self.warmup_query = warmup_query
+        self.report = StartupReport()
+        self.index: Optional[VectorStoreIndex] = None
+        self._warmup_thread: Optional[threading.Thread] = None
+
+    def start(self) -> Tuple[BaseQueryEngine, StartupReport]:
+        """
+        Loads (or builds, if nothing is persisted) the index and builds the query engine.
+        Returns as soon as the engine can serve queries; warmup continues in the background.
+        Returns:
+            Tuple[BaseQueryEngine, StartupReport]: The query engine and timings so far.
+        """
+        t0 = time.perf_counter()
+        model_name = self.index_builder.embedding_model_name
+        if self.index_builder.index_exists():
+            with ThreadPoolExecutor(max_workers=2, thread_name_prefix="startup") as pool:
+                model_future = pool.submit(
+                    self._timed, initialize_hf_embedding_model,
+                    model_name=model_name, precision=self.index_builder.embedding_precision
+                )
+                storage_future = pool.submit(self._timed, self.index_builder.load_storage_context)
+                _, self.report.model_load_s = model_future.result()
+                storage_context, self.report.storage_load_s = storage_future.result()
+            self.index = self.index_builder.load(storage_context=storage_context)
+        else:
+            # Nothing to load concurrently: building needs the model first.
+            self.index = self.index_builder.build()
+            self.report.built_index = True
+        self.report.index_ready_s = time.perf_counter() - t0
+
+        query_engine = QueryEngineBuilder(
+            index=self.index, config=self.query_engine_config, multivector_index=self.index_builder.multivector_index,
+            tuning=self.index_builder.tuning, metadata_columns=self.index_builder.metadata_columns,
+            segments=self.index_builder.live_segments
+        ).build()
+        self.report.time_to_ready_s = time.perf_counter() - t0
+
+        if self.warmup_query:
+            self._warmup_thread = threading.Thread(target=self._warmup, args=(t0,), name="startup-warmup", daemon=True)
+            self._warmup_thread.start()
+        return query_engine, self.report
+
+    def wait_for_warmup(self, timeout: Optional[float] = None) -> StartupReport:
+        """Blocks until the background warmup finishes (or timeout) and returns the report."""
+        if self._warmup_thread is not None:
+            self._warmup_thread.join(timeout)
+        return self.report
+
+    def _warmup(self, t0: float):
+        try:
+            retriever = self.index.as_retriever(similarity_top_k=1)
+            retriever.retrieve(self.warmup_query)
+            self.report.warmup_s = time.perf_counter() - t0
+        except Exception as e:
+            print(f"Warning: startup warmup query failed: {e}")
+
+    @staticmethod
+    def _timed(fn, *args, **kwargs):
+        start = time.perf_counter()
+        result = fn(*args, **kwargs)
+        return result, time.perf_counter() - start
+
+if __name__ == "__main__": #script testing
+    # python -m src.startup
+    from src.config_loader import AppConfig
+    app_config = AppConfig()
+    orchestrator = StartupOrchestrator(app_config.get_index_builder_config(), app_config.get_query_engine_builder_config())
+    _, report = orchestrator.start()
+    print(f"Time to ready: {report.time_to_ready_s:.2f}s")
+    print(orchestrator.wait_for_warmup().to_dict())
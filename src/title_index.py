@@ -0,0 +1,281 @@
+"""
+Typeahead search over paper titles, without running the embedding model.
+
+Titles are normalized (accents folded, lowercased, punctuation removed), so the index
+works on plain ASCII bytes. Two structures are built over the normalized titles:
+
+* A word-start suffix array: every position where a word begins, sorted by the text that
+  follows it. Any prefix of any part of a title that starts at a word boundary is one
+  contiguous range of it, found by binary search. This answers the same lookups as a
+  prefix automaton, with two int32 arrays over a single byte blob.
+* A positional 3-gram index for typos. A title containing a string within k edits of the
+  query shares at least (len - 2) - 3k of the query's 3-grams, at nearly the same offset.
+  Titles passing that count filter are checked with an edit distance. Both steps use the
+  C kernels in native/vector_kernels.c when built (see src.kernels), NumPy otherwise.
+  Queries too short for the filter to keep anything are checked against every word start
+  with the same first letter, found in the suffix array.
+
+Everything is NumPy arrays, persisted as title_index.*.npy next to the other stores.
+"""
+import os
+import json
+import unicodedata
+from dataclasses import dataclass, field
+from typing import Dict, List, Optional, Sequence, Set, Tuple
+
+import numpy as np
+
+from src.index_bundle import IndexBundle
+from src.index_views import decode_ids, encode_ids
+from src.kernels import prefix_edit_distances, qgram_candidates
+
+TITLE_INDEX_PREFIX = "title_index"
+TITLE_INDEX_HEADER = f"{TITLE_INDEX_PREFIX}.json"
+_ARRAYS = ("doc_ids", "blob", "title_offsets", "suffix_rows", "suffix_starts", "gram_keys", "gram_offsets", "post_rows", "post_pos")
+
+# Suffixes are ordered by at most this many bytes; longer queries are checked against the full text
+_SUFFIX_KEY_BYTES = 64
+# Only the start of each title is indexed for fuzzy matching
+_FUZZY_CHARS = 128
+# Titles verified with edit distance per query (best q-gram counts first)
+_FUZZY_VERIFY = 64
+
+def normalize_title(title: str) -> str:
+    """ASCII, lowercase, alphanumeric words separated by single spaces."""
+    folded = unicodedata.normalize("NFKD", title).encode("ascii", "ignore").decode("ascii").lower()
+    return " ".join("".join(c if c.isalnum() else " " for c in folded).split())
+
+def default_max_edits(query_length: int) -> int:
+    """Typo tolerance by query length: none for very short queries, up to 2 edits."""
+    return 0 if query_length < 4 else 1 if query_length < 8 else 2
+
+def _gram_codes(data: np.ndarray) -> np.ndarray:
+    """3-gram codes (b0 << 16 | b1 << 8 | b2) of a uint8 array."""
+    if len(data) < 3:
+        return np.empty(0, dtype=np.int64)
+    data = data.astype(np.int64)
+    return (data[:-2] << 16) | (data[1:-1] << 8) | data[2:]
+
+@dataclass
+class TitleIndex:
+    """
+    Attributes:
+        doc_ids (np.ndarray): 'S' document id per title row.
+        blob (np.ndarray): uint8 normalized titles, back to back.
+        title_offsets (np.ndarray): (T + 1,) int64 start of each title in blob.
+        suffix_rows, suffix_starts (np.ndarray): int32 word-start suffixes (title row, offset
+            within the title), sorted by the text that follows.
+        gram_keys, gram_offsets, post_rows, post_pos (np.ndarray): 3-gram postings in CSR form:
+            gram_keys[g]'s occurrences are rows/positions gram_offsets[g] .. gram_offsets[g + 1].
+    """
+    doc_ids: np.ndarray
+    blob: np.ndarray
+    title_offsets: np.ndarray
+    suffix_rows: np.ndarray
+    suffix_starts: np.ndarray
+    gram_keys: np.ndarray
+    gram_offsets: np.ndarray
+    post_rows: np.ndarray
+    post_pos: np.ndarray
+    _lengths: Optional[np.ndarray] = field(default=None, repr=False, compare=False)
+
+    @classmethod
+    def build(cls, doc_ids: Sequence[str], titles: Sequence[str]) -> "TitleIndex":
+        normalized = [normalize_title(title).encode("ascii") for title in titles]
+        blob = np.frombuffer(b"".join(normalized), dtype=np.uint8)
+        lengths = np.array([len(t) for t in normalized], dtype=np.int64)
+        title_offsets = np.concatenate([[0], np.cumsum(lengths)]).astype(np.int64)
+
+        suffixes: List[Tuple[bytes, int, int]] = []
+        for row, title in enumerate(normalized):
+            start = 0
+            while True:
+                suffixes.append((title[start:start + _SUFFIX_KEY_BYTES], row, start))
+                space = title.find(b" ", start)
+                if space < 0:
+                    break
+                start = space + 1
+        suffixes.sort()
+        suffix_rows = np.array([row for _, row, _ in suffixes], dtype=np.int32)
+        suffix_starts = np.array([start for _, _, start in suffixes], dtype=np.int32)
+
+        gram_lists, row_lists, pos_lists = [], [], []
+        for row, title in enumerate(normalized):
+            codes = _gram_codes(np.frombuffer(title[:_FUZZY_CHARS], dtype=np.uint8))
+            gram_lists.append(codes)
+            row_lists.append(np.full(len(codes), row, dtype=np.int32))
+            pos_lists.append(np.arange(len(codes), dtype=np.int32))
+        grams = np.concatenate(gram_lists) if gram_lists else np.empty(0, dtype=np.int64)
+        order = np.argsort(grams, kind="stable")
+        gram_keys, counts = np.unique(grams[order], return_counts=True)
+        return cls(
+            doc_ids=encode_ids(doc_ids),
+            blob=blob,
+            title_offsets=title_offsets,
+            suffix_rows=suffix_rows,
+            suffix_starts=suffix_starts,
+            gram_keys=gram_keys.astype(np.int64),
+            gram_offsets=np.concatenate([[0], np.cumsum(counts)]).astype(np.int64),
+            post_rows=(np.concatenate(row_lists) if row_lists else np.empty(0, dtype=np.int32))[order],
+            post_pos=(np.concatenate(pos_lists) if pos_lists else np.empty(0, dtype=np.int32))[order]
+        )
+
+    def updated(self, live_doc_ids: Optional[Set[str]], titles: Dict[str, str]) -> "TitleIndex":
+        """
+        This index without the documents missing from `live_doc_ids` (None keeps them all), plus
+        `titles` (doc id -> title) added or replaced. Kept titles come from the blob, so no
+        document is re-read.
+        """
+        kept = [
+            (doc_id, self.title(row)) for row, doc_id in enumerate(decode_ids(self.doc_ids))
+            if (live_doc_ids is None or doc_id in live_doc_ids) and doc_id not in titles
+        ]
+        return TitleIndex.build(
+            [doc_id for doc_id, _ in kept] + list(titles),
+            [title for _, title in kept] + list(titles.values())
+        )
+
+    def __len__(self) -> int:
+        return len(self.doc_ids)
+
+    @property
+    def title_lengths(self) -> np.ndarray:
+        if self._lengths is None:
+            self._lengths = np.diff(self.title_offsets)
+        return self._lengths
+
+    @property
+    def nbytes(self) -> int:
+        return sum(getattr(self, name).nbytes for name in _ARRAYS)
+
+    def title(self, row: int) -> str:
+        """Normalized title of a row."""
+        return self.blob[self.title_offsets[row]:self.title_offsets[row + 1]].tobytes().decode("ascii")
+
+    def _suffix(self, i: int, length: int) -> bytes:
+        row = self.suffix_rows[i]
+        start = self.title_offsets[row] + self.suffix_starts[i]
+        return self.blob[start:min(start + length, self.title_offsets[row + 1])].tobytes()
+
+    # --- Search ---
+
+    def prefix_rows(self, query: bytes) -> Tuple[np.ndarray, np.ndarray]:
+        """Title rows containing `query` at a word start, with the offset of the match."""
+        key = query[:_SUFFIX_KEY_BYTES]
+        lo, hi = 0, len(self.suffix_rows)
+        while lo < hi:
+            mid = (lo + hi) // 2
+            if self._suffix(mid, len(key)) < key:
+                lo = mid + 1
+            else:
+                hi = mid
+        first, hi = lo, len(self.suffix_rows)
+        while lo < hi:
+            mid = (lo + hi) // 2
+            if self._suffix(mid, len(key)) <= key:
+                lo = mid + 1
+            else:
+                hi = mid
+        rows, starts = self.suffix_rows[first:lo], self.suffix_starts[first:lo]
+        if len(query) > _SUFFIX_KEY_BYTES:
+            keep = [self._suffix(i, len(query)) == query for i in range(first, lo)]
+            rows, starts = rows[keep], starts[keep]
+        return rows, starts
+
+    def fuzzy_rows(self, query: bytes, max_edits: int) -> Tuple[np.ndarray, np.ndarray]:
+        """Title rows with a substring within `max_edits` edits of `query`, and that distance."""
+        empty = np.empty(0, dtype=np.int64), np.empty(0, dtype=np.int32)
+        codes = _gram_codes(np.frombuffer(query, dtype=np.uint8))
+        needed = len(codes) - 3 * max_edits
+        if needed <= 0:
+            return self._word_start_fuzzy_rows(query, max_edits)
+        if not len(self.gram_keys):
+            return empty
+        slots = np.minimum(np.searchsorted(self.gram_keys, codes), len(self.gram_keys) - 1)
+        found = self.gram_keys[slots] == codes
+        cand_rows, diagonals = qgram_candidates(
+            self.post_rows, self.post_pos, self.gram_offsets, slots[found], np.flatnonzero(found),
+            len(self), needed, max_edits, _FUZZY_VERIFY
+        )
+        if not len(cand_rows):
+            return empty
+        # The alignment is known to within max_edits either way
+        cand_starts = np.maximum(diagonals - max_edits, 0)
+
+        lengths = self.title_lengths[cand_rows] - cand_starts
+        lengths = np.clip(lengths, 0, len(query) + 3 * max_edits)
+        distances = prefix_edit_distances(query, self.blob, self.title_offsets[cand_rows] + cand_starts, lengths, slack=2 * max_edits)
+        match = distances <= max_edits
+        return cand_rows[match], distances[match]
+
+    def _word_start_fuzzy_rows(self, query: bytes, max_edits: int) -> Tuple[np.ndarray, np.ndarray]:
+        """
+        fuzzy_rows for queries too short for the 3-gram count filter (every 3-gram may be
+        broken by an edit): checks every word start that begins with the query's first byte,
+        which typeahead users rarely get wrong.
+        """
+        rows, starts = self.prefix_rows(query[:1])
+        lengths = np.minimum(self.title_lengths[rows] - starts, len(query) + max_edits)
+        distances = prefix_edit_distances(query, self.blob, self.title_offsets[rows] + starts, lengths)
+        match = distances <= max_edits
+        rows, distances = rows[match].astype(np.int64), distances[match]
+        # Closest match per title
+        order = np.lexsort((distances, rows))
+        rows, distances = rows[order], distances[order]
+        first = np.concatenate([[True], rows[1:] != rows[:-1]]) if len(rows) else np.empty(0, dtype=bool)
+        return rows[first], distances[first]
+
+    def search(self, query: str, limit: int = 10, max_edits: Optional[int] = None) -> List[str]:
+        """
+        Document ids whose title contains `query` (normalized) at a word start, best first:
+        title-start matches, then matches inside the title, shorter titles first. When fewer
+        than `limit` are found, titles within `max_edits` typos follow (default by query length,
+        see default_max_edits).
+        """
+        normalized = normalize_title(query).encode("ascii")
+        if not normalized:
+            return []
+        lengths = self.title_lengths
+        rows, starts = self.prefix_rows(normalized)
+        order = np.lexsort((rows, lengths[rows], starts > 0))
+        ranked: Dict[int, None] = dict.fromkeys(rows[order].tolist())
+        if len(ranked) < limit:
+            if max_edits is None:
+                max_edits = default_max_edits(len(normalized))
+            if max_edits:
+                fuzzy_rows, distances = self.fuzzy_rows(normalized, max_edits)
+                for row in fuzzy_rows[np.lexsort((fuzzy_rows, lengths[fuzzy_rows], distances))].tolist():
+                    ranked.setdefault(row, None)
+        return decode_ids(self.doc_ids[list(ranked)[:limit]]) if ranked else []
+
+    # --- Persistence ---
+
+    def save(self, directory: str):
+        """Writes the header and arrays into `directory` (temporary files, then rename)."""
+        os.makedirs(directory, exist_ok=True)
+        for name in _ARRAYS:
+            path = os.path.join(directory, array_filename(name))
+            with open(path + ".tmp", "wb") as f:
+                np.save(f, getattr(self, name))
+            os.replace(path + ".tmp", path)
+        header_path = os.path.join(directory, TITLE_INDEX_HEADER)
+        with open(header_path + ".tmp", "w", encoding="utf-8") as f:
+            json.dump({"titles": len(self), "suffix_key_bytes": _SUFFIX_KEY_BYTES}, f)
+        os.replace(header_path + ".tmp", header_path)
+
+    @staticmethod
+    def exists(directory: str) -> bool:
+        return os.path.exists(os.path.join(directory, TITLE_INDEX_HEADER))
+
+    @classmethod
+    def load(cls, directory: str) -> "TitleIndex":
+        """Loads an index saved with save(); arrays are memory-mapped read-only."""
+        return cls(**{name: np.load(os.path.join(directory, array_filename(name)), mmap_mode="r") for name in _ARRAYS})
+
+    @classmethod
+    def from_bundle(cls, bundle: IndexBundle) -> "TitleIndex":
+        """Loads the index from bundle sections as zero-copy views into the bundle mapping."""
+        return cls(**{name: bundle.read_array(array_filename(name)) for name in _ARRAYS})
+
+def array_filename(name: str) -> str:
+    return f"{TITLE_INDEX_PREFIX}.{name}.npy"
@@ -0,0 +1,169 @@
+"""
+Pre-tokenized corpus artifact, so rebuilds do not tokenize unchanged documents again.
+
+With token_cache_enabled, IndexBuilder tokenizes each document's text (and its metadata header,
+which is embedded with every chunk) once with the embedding model's WordPiece tokenizer and
+keeps the token ids in storage_dir/token_cache/, keyed by a hash of the text. Chunking by token
+count and the encoder's input then come straight from the stored ids (see
+IndexBuilder.chunk_with_token_cache), and a rebuild only tokenizes texts whose hash is not in
+the cache yet.
+
+The artifact is a directory of .npy files, memory-mapped on load:
+    keys.npy     sorted hex content hashes ('S32'), one per text
+    offsets.npy  int64, len(keys) + 1: text i's tokens are ids[offsets[i]:offsets[i + 1]]
+    ids.npy      token ids, uint16 when every id fits (BERT-style vocabularies do), else uint32
+    starts.npy   uint32 character offset of each token in its text, to cut chunk text at token boundaries
+    header.json  tokenizer name and entry count
+It lives in a subdirectory, so write_bundle_from_dir does not pack it into the bundle.
+"""
+import os
+import json
+import shutil
+import hashlib
+from typing import Callable, Dict, Iterable, List, Optional, Tuple
+
+import numpy as np
+
+TOKEN_CACHE_DIR = "token_cache"
+TOKEN_CACHE_HEADER = "header.json"
+
+# Token ids and character starts of one text
+Tokens = Tuple[np.ndarray, np.ndarray]
+
+def content_key(text: str) -> bytes:
+    """Hex hash identifying a text in the cache."""
+    return hashlib.blake2b(text.encode("utf-8"), digest_size=16).hexdigest().encode("ascii")
+
+def token_windows(count: int, size: int, overlap: int) -> List[Tuple[int, int]]:
+    """
+    [start, end) token ranges of at most `size` tokens covering `count` tokens, consecutive
+    ranges sharing `overlap` tokens. An empty text still gets one (empty) range.
+    """
+    if size <= 0:
+        raise ValueError("Chunk size must be positive.")
+    if not 0 <= overlap < size:
+        raise ValueError(f"Chunk overlap ({overlap}) must be smaller than the chunk size ({size}).")
+    windows = [(0, min(size, count))]
+    while windows[-1][1] < count:
+        start = windows[-1][1] - overlap
+        windows.append((start, min(start + size, count)))
+    return windows
+
+class TokenCache:
+    """
+    Read-only view of a token cache directory.
+
+    Args:
+        keys (np.ndarray): Sorted content keys (see content_key).
+        offsets (np.ndarray): Token range of each key.
+        ids (np.ndarray): Concatenated token ids.
+        starts (np.ndarray): Character offset of each token.
+        tokenizer (str): Name of the tokenizer that produced the ids.
+    """
+    def __init__(self, keys: np.ndarray, offsets: np.ndarray, ids: np.ndarray, starts: np.ndarray, tokenizer: str):
+        self.keys = keys
+        self.offsets = offsets
+        self.ids = ids
+        self.starts = starts
+        self.tokenizer = tokenizer
+
+    def __len__(self) -> int:
+        return len(self.keys)
+
+    @classmethod
+    def load(cls, directory: str, tokenizer: str) -> Optional["TokenCache"]:
+        """The cache in `directory`, or None if there is none for this tokenizer."""
+        try:
+            with open(os.path.join(directory, TOKEN_CACHE_HEADER), "r", encoding="utf-8") as f:
+                header = json.load(f)
+        except FileNotFoundError:
+            return None
+        if header["tokenizer"] != tokenizer:
+            return None
+        arrays = [np.load(os.path.join(directory, f"{part}.npy"), mmap_mode="r") for part in ("keys", "offsets", "ids", "starts")]
+        return cls(*arrays, tokenizer=tokenizer)
+
+    def find(self, key: bytes) -> int:
+        """Row of `key`, or -1."""
+        row = int(np.searchsorted(self.keys, key))
+        return row if row < len(self.keys) and self.keys[row] == key else -1
+
+    def find_all(self, keys: List[bytes]) -> np.ndarray:
+        """Row of each key, -1 where missing."""
+        wanted = np.array(keys, dtype="S32")
+        rows = np.minimum(np.searchsorted(self.keys, wanted), max(len(self.keys) - 1, 0))
+        found = self.keys[rows] == wanted if len(self.keys) else np.zeros(len(wanted), dtype=bool)
+        return np.where(found, rows, -1)
+
+    def tokens(self, key: bytes) -> Optional[Tokens]:
+        row = self.find(key)
+        if row < 0:
+            return None
+        start, end = self.offsets[row], self.offsets[row + 1]
+        return self.ids[start:end], self.starts[start:end]
+
+    @staticmethod
+    def write(directory: str, tokenizer: str, entries: Dict[bytes, Tokens]):
+        """Writes `entries` as the cache in `directory`, replacing any previous one."""
+        keys = sorted(entries)
+        lengths = np.array([len(entries[key][0]) for key in keys], dtype=np.int64)
+        offsets = np.zeros(len(keys) + 1, dtype=np.int64)
+        np.cumsum(lengths, out=offsets[1:])
+        max_id = max((int(entries[key][0].max()) for key in keys if len(entries[key][0])), default=0)
+        id_dtype = np.uint16 if max_id <= np.iinfo(np.uint16).max else np.uint32
+        tmp_dir = directory + ".tmp"
+        shutil.rmtree(tmp_dir, ignore_errors=True)
+        os.makedirs(tmp_dir)
+        np.save(os.path.join(tmp_dir, "keys.npy"), np.array(keys, dtype="S32"))
+        np.save(os.path.join(tmp_dir, "offsets.npy"), offsets)
+        total = int(offsets[-1])
+        for part, dtype, column in (("ids", id_dtype, 0), ("starts", np.uint32, 1)):
+            path = os.path.join(tmp_dir, f"{part}.npy")
+            if not total:
+                np.save(path, np.empty(0, dtype=dtype))
+                continue
+            out = np.lib.format.open_memmap(path, mode="w+", dtype=dtype, shape=(total,))
+            np.concatenate([entries[key][column] for key in keys], out=out, casting="unsafe")
+            out.flush()
+            del out
+        with open(os.path.join(tmp_dir, TOKEN_CACHE_HEADER), "w", encoding="utf-8") as f:
+            json.dump({"tokenizer": tokenizer, "count": len(keys), "id_dtype": np.dtype(id_dtype).name}, f)
+        # A previous cache still mapped by a reader stays valid after its files are removed
+        shutil.rmtree(directory, ignore_errors=True)
+        os.replace(tmp_dir, directory)
+
+def update_token_cache(
+    directory: str,
+    tokenizer: str,
+    texts: Iterable[str],
+    tokenize: Callable[[List[str]], List[Tokens]],
+    batch_size: int = 256
+) -> Tuple[TokenCache, int]:
+    """
+    Makes the cache in `directory` hold exactly the given texts, tokenizing only those not
+    cached yet. When nothing changed, the cache is not rewritten.
+    Returns:
+        Tuple[TokenCache, int]: The cache, and the number of texts tokenized.
+    """
+    cached = TokenCache.load(directory, tokenizer)
+    wanted: Dict[bytes, str] = {}
+    for text in texts:
+        wanted.setdefault(content_key(text), text)
+    keys = list(wanted)
+    rows = cached.find_all(keys) if cached is not None else np.full(len(keys), -1)
+    missing = [key for key, row in zip(keys, rows.tolist()) if row < 0]
+    if cached is not None and not missing and len(cached) == len(wanted):
+        return cached, 0
+    entries: Dict[bytes, Tokens] = {}
+    if cached is not None:
+        # Plain views of the mapped arrays slice much faster than np.memmap objects
+        offsets, ids, starts = cached.offsets.tolist(), np.asarray(cached.ids), np.asarray(cached.starts)
+        for key, row in zip(keys, rows.tolist()):
+            if row >= 0:
+                entries[key] = ids[offsets[row]:offsets[row + 1]], starts[offsets[row]:offsets[row + 1]]
+    for start in range(0, len(missing), batch_size):
+        batch = missing[start:start + batch_size]
+        for key, tokens in zip(batch, tokenize([wanted[key] for key in batch])):
+            entries[key] = tokens
+    TokenCache.write(directory, tokenizer, entries)
+    return TokenCache.load(directory, tokenizer), len(missing)
@@ -0,0 +1,368 @@
+import os
+import json
+import threading
+from typing import Any, Dict, List, NamedTuple, Optional, Sequence, Tuple
+
+import numpy as np
+from llama_index.core.bridge.pydantic import PrivateAttr
+from llama_index.core.schema import BaseNode
+from llama_index.core.vector_stores.types import (
+    BasePydanticVectorStore,
+    VectorStoreQuery,
+    VectorStoreQueryResult,
+)
+
+from src.index_bundle import IndexBundle
+from src.index_views import decode_ids, encode_ids, flat_store_files, read_only
+from src.deadlines import Deadline
+from src.profiling import QueryProfile
+from src.kernels import (
+    STORAGE_DTYPES, encode_vectors, feedback_top_k, flat_top_k, flat_top_k_with_candidates, numpy_storage_dtype
+)
+
+FLAT_VECTOR_STORE_TYPE = "flat_vector_store"
+# Name LlamaIndex's StorageContext.persist gives the default vector store
+DEFAULT_VECTOR_STORE_FILENAME = "default__vector_store.json"
+
+def vectors_filename(header_filename: str) -> str:
+    """Companion .npy file holding the matrix, e.g. default__vector_store.vectors.npy."""
+    return flat_store_files(header_filename)["vectors"]
+
+class FlatSnapshot(NamedTuple):
+    """
+    The store's rows at one point in time. Updates replace the store's matrix and id lists
+    instead of changing them, so a snapshot stays consistent while rows are added or removed.
+    """
+    vectors: np.ndarray
+    node_ids: List[str]
+    ref_doc_ids: List[str]
+    version: int
+
+class FlatHits(NamedTuple):
+    """Search results, best first, with the snapshot their rows index into."""
+    node_ids: List[str]
+    scores: np.ndarray
+    rows: np.ndarray
+    snapshot: FlatSnapshot
+
+    @classmethod
+    def from_rows(cls, snapshot: FlatSnapshot, rows: np.ndarray, scores: np.ndarray) -> "FlatHits":
+        return cls([snapshot.node_ids[row] for row in rows], scores, rows, snapshot)
+
+class FlatVectorStore(BasePydanticVectorStore):
+    """
+    Exact (brute-force) vector store over a contiguous embedding matrix.
+
+    Vectors are kept as float32, float16 or bfloat16; half-width formats halve memory and
+    scan bandwidth and are widened on the fly during the dot-product scan (see src.kernels).
+    Persisted as a small JSON header at the path LlamaIndex assigns to the vector store plus
+    .npy files next to it (the matrix and the node / ref doc id arrays), memory-mapped
+    read-only on load. See src.index_views for reading them without LlamaIndex.
+
+    Queries may run while nodes are inserted or deleted: each search works on one snapshot
+    (see FlatSnapshot) and returns node ids from it.
+
+    Args:
+        dtype (str): Storage format, one of "float32", "float16", "bfloat16".
+    """
+    stores_text: bool = False
+    is_embedding_query: bool = True
+    dtype: str = "float32"
+
+    _vectors: np.ndarray = PrivateAttr()
+    _pending: List[np.ndarray] = PrivateAttr(default_factory=list)
+    _node_ids: List[str] = PrivateAttr(default_factory=list)
+    _ref_doc_ids: List[str] = PrivateAttr(default_factory=list)
+    _version: int = PrivateAttr(default=0)
+    _ordering: str = PrivateAttr(default="")
+    # Serializes updates and taking snapshots; searches run outside it
+    _lock: threading.Lock = PrivateAttr(default_factory=threading.Lock)
+
+    def __init__(self, dtype: str = "float32", **kwargs: Any):
+        if dtype not in STORAGE_DTYPES:
+            raise ValueError(f"Unsupported vector storage dtype '{dtype}'. Expected one of {STORAGE_DTYPES}.")
+        super().__init__(dtype=dtype, **kwargs)
+        self._vectors = np.empty((0, 0), dtype=numpy_storage_dtype(dtype))
+
+    @classmethod
+    def class_name(cls) -> str:
+        return "FlatVectorStore"
+
+    @property
+    def client(self) -> Any:
+        return None
+
+    # --- Accessors ---
+
+    def __len__(self) -> int:
+        return len(self._node_ids)
+
+    @property
+    def node_ids(self) -> List[str]:
+        return self._node_ids
+
+    @property
+    def ref_doc_ids(self) -> List[str]:
+        return self._ref_doc_ids
+
+    @property
+    def version(self) -> int:
+        """Bumped whenever rows are added or removed, so row-aligned side data can tell it is stale."""
+        return self._version
+
+    @property
+    def ordering(self) -> str:
+        """How the rows were reordered for locality (see src.locality.describe_order); "" for insertion order."""
+        return self._ordering
+
+    @property
+    def dim(self) -> Optional[int]:
+        """Embedding dimension, or None while the store is empty."""
+        vectors, pending = self._vectors, self._pending
+        if len(vectors):
+            return vectors.shape[1]
+        return pending[0].shape[1] if pending else None
+
+    @property
+    def vectors(self) -> np.ndarray:
+        """The stored (N, D) matrix in its storage format."""
+        return self.snapshot().vectors
+
+    def snapshot(self) -> FlatSnapshot:
+        """The current rows; later updates do not change it."""
+        with self._lock:
+            self._consolidate()
+            return FlatSnapshot(self._vectors, self._node_ids, self._ref_doc_ids, self._version)
+
+    def embeddings_view(self) -> np.ndarray:
+        """Read-only zero-copy view of the matrix, for analytics that must not mutate the store."""
+        return read_only(self.vectors)
+
+    def node_id_array(self) -> np.ndarray:
+        """Node ids as an 'S' array aligned with the matrix rows (see src.index_views.encode_ids)."""
+        return encode_ids(self._node_ids)
+
+    def _consolidate(self):
+        # Batches from add() are buffered and concatenated once, not per call. Called with _lock held.
+        if self._pending:
+            parts = ([self._vectors] if len(self._vectors) else []) + self._pending
+            self._vectors = np.ascontiguousarray(np.concatenate(parts, axis=0))
+            self._pending = []
+
+    # --- Mutation ---
+
+    def add(self, nodes: Sequence[BaseNode], **add_kwargs: Any) -> List[str]:
+        if not nodes:
+            return []
+        embeddings = np.asarray([node.get_embedding() for node in nodes], dtype=np.float32)
+        encoded = encode_vectors(embeddings, self.dtype)
+        with self._lock:
+            dim = self.dim
+            if dim is not None and embeddings.shape[1] != dim:
+                raise ValueError(f"Embedding dimension {embeddings.shape[1]} does not match store dimension {dim}.")
+            # New lists rather than appends: snapshots keep the old ones
+            self._pending = self._pending + [encoded]
+            self._node_ids = self._node_ids + [node.node_id for node in nodes]
+            self._ref_doc_ids = self._ref_doc_ids + [node.ref_doc_id or node.node_id for node in nodes]
+            self._version += 1
+        return [node.node_id for node in nodes]
+
+    def delete(self, ref_doc_id: str, **delete_kwargs: Any) -> None:
+        with self._lock:
+            keep = [i for i, ref in enumerate(self._ref_doc_ids) if ref != ref_doc_id]
+            if len(keep) < len(self._ref_doc_ids):
+                self._keep_rows(keep)
+
+    def reorder(self, order: np.ndarray, ordering: str = ""):
+        """
+        Permutes the rows: row i becomes the former row order[i]. Node and ref doc ids move with
+        their vectors, so search results keep mapping to the same nodes and documents.
+        """
+        order = np.asarray(order, dtype=np.int64)
+        with self._lock:
+            if not np.array_equal(np.sort(order), np.arange(len(self._node_ids))):
+                raise ValueError("order must be a permutation of the store's rows.")
+            self._keep_rows(order.tolist())
+            self._ordering = ordering
+
+    def _keep_rows(self, keep: List[int]):
+        # Called with _lock held
+        self._consolidate()
+        self._vectors = np.ascontiguousarray(self._vectors[keep]) if keep else self._vectors[:0]
+        self._node_ids = [self._node_ids[i] for i in keep]
+        self._ref_doc_ids = [self._ref_doc_ids[i] for i in keep]
+        self._version += 1
+
+    # --- Search ---
+
+    def row_mask(
+        self,
+        node_ids: Optional[List[str]] = None,
+        doc_ids: Optional[List[str]] = None,
+        snapshot: Optional[FlatSnapshot] = None
+    ) -> Optional[np.ndarray]:
+        """Boolean row mask restricting a search to the given node and/or ref doc ids (None = all rows)."""
+        if node_ids is None and doc_ids is None:
+            return None
+        if snapshot is None:
+            snapshot = self.snapshot()
+        count = len(snapshot.node_ids)
+        mask = np.ones(count, dtype=bool)
+        if node_ids is not None:
+            allowed = set(node_ids)
+            mask &= np.fromiter((n in allowed for n in snapshot.node_ids), dtype=bool, count=count)
+        if doc_ids is not None:
+            allowed = set(doc_ids)
+            mask &= np.fromiter((r in allowed for r in snapshot.ref_doc_ids), dtype=bool, count=count)
+        return mask
+
+    def search(
+        self,
+        query_embedding: Sequence[float],
+        top_k: int,
+        mask: Optional[np.ndarray] = None,
+        deadline: Optional[Deadline] = None,
+        profile: Optional[QueryProfile] = None,
+        snapshot: Optional[FlatSnapshot] = None
+    ) -> FlatHits:
+        """
+        Exact top-k by dot product, over `snapshot` or else the current rows. With a deadline
+        the scan may stop early and return the best rows seen so far (see src.kernels.flat_top_k).
+        `profile` receives the filter selectivity when a mask is given.
+        """
+        if snapshot is None:
+            snapshot = self.snapshot()
+        if not len(snapshot.vectors):
+            return FlatHits([], np.empty(0, dtype=np.float32), np.empty(0, dtype=np.int64), snapshot)
+        if profile is not None and mask is not None:
+            profile.set("filter_selectivity", float(mask.mean()))
+        rows, scores = flat_top_k(
+            snapshot.vectors, np.asarray(query_embedding, dtype=np.float32), self.dtype, top_k, mask=mask, deadline=deadline
+        )
+        return FlatHits.from_rows(snapshot, rows, scores)
+
+    def search_with_candidates(
+        self,
+        query_embedding: Sequence[float],
+        top_k: int,
+        candidates: int,
+        min_score: Optional[float] = None,
+        mask: Optional[np.ndarray] = None,
+        profile: Optional[QueryProfile] = None,
+        snapshot: Optional[FlatSnapshot] = None
+    ) -> Tuple[FlatHits, np.ndarray]:
+        """
+        Exact top-k together with the candidate rows around it (the best `candidates` rows,
+        or every row scoring at least `min_score`), from one scan; used for facet counts.
+        Always scans every row (no deadline).
+        Returns:
+            Tuple[FlatHits, np.ndarray]: Top-k hits and the candidate rows of their snapshot.
+        """
+        if snapshot is None:
+            snapshot = self.snapshot()
+        if not len(snapshot.vectors):
+            empty = np.empty(0, dtype=np.int64)
+            return FlatHits([], np.empty(0, dtype=np.float32), empty, snapshot), empty
+        if profile is not None and mask is not None:
+            profile.set("filter_selectivity", float(mask.mean()))
+        rows, scores, candidate_rows = flat_top_k_with_candidates(
+            snapshot.vectors, np.asarray(query_embedding, dtype=np.float32), self.dtype, top_k, candidates, min_score=min_score, mask=mask
+        )
+        return FlatHits.from_rows(snapshot, rows, scores), candidate_rows
+
+    def rescore_with_feedback(
+        self,
+        query_embedding: Sequence[float],
+        hits: FlatHits,
+        top_k: int,
+        feedback_rows: int,
+        alpha: float = 1.0,
+        beta: float = 0.75
+    ) -> FlatHits:
+        """
+        Pseudo-relevance feedback over the hits of a first search, in their snapshot: the query
+        moves towards the stored vectors of the best `feedback_rows`, and only those hits are
+        rescored (see src.kernels.feedback_top_k). Nothing is re-embedded.
+        """
+        rows, scores = feedback_top_k(
+            hits.snapshot.vectors, np.asarray(query_embedding, dtype=np.float32), self.dtype, hits.rows, top_k, feedback_rows, alpha, beta
+        )
+        return FlatHits.from_rows(hits.snapshot, rows, scores)
+
+    def query(self, query: VectorStoreQuery, **kwargs: Any) -> VectorStoreQueryResult:
+        if query.filters is not None:
+            raise NotImplementedError("Metadata filters are not supported by FlatVectorStore.")
+        if query.query_embedding is None:
+            raise ValueError("FlatVectorStore requires a query embedding.")
+        snapshot = self.snapshot()
+        mask = self.row_mask(node_ids=query.node_ids, doc_ids=query.doc_ids, snapshot=snapshot)
+        hits = self.search(query.query_embedding, query.similarity_top_k, mask=mask, snapshot=snapshot)
+        return VectorStoreQueryResult(similarities=hits.scores.tolist(), ids=hits.node_ids)
+
+    # --- Persistence ---
+
+    def persist(self, persist_path: str, fs: Any = None) -> None:
+        """
+        Writes the JSON header to `persist_path` and the matrix and id arrays next to it.
+        All are written to temporary files and renamed, so an existing read-only
+        mapping of the previous files stays valid.
+        """
+        snapshot = self.snapshot()
+        dirpath = os.path.dirname(persist_path)
+        if dirpath:
+            os.makedirs(dirpath, exist_ok=True)
+        names = flat_store_files(persist_path)
+        arrays = {
+            "vectors": snapshot.vectors,
+            "node_ids": encode_ids(snapshot.node_ids),
+            "ref_doc_ids": encode_ids(snapshot.ref_doc_ids),
+        }
+        for part, array in arrays.items():
+            with open(names[part] + ".tmp", "wb") as f:
+                np.save(f, array)
+            os.replace(names[part] + ".tmp", names[part])
+        header = {
+            "__type__": FLAT_VECTOR_STORE_TYPE,
+            "dtype": self.dtype,
+            "count": len(snapshot.node_ids),
+        }
+        if self._ordering:
+            header["ordering"] = self._ordering
+        with open(persist_path + ".tmp", "w", encoding="utf-8") as f:
+            json.dump(header, f)
+        os.replace(persist_path + ".tmp", persist_path)
+
+    @classmethod
+    def _from_parts(cls, header: Dict[str, Any], read_array) -> "FlatVectorStore":
+        if header.get("__type__") != FLAT_VECTOR_STORE_TYPE:
+            raise ValueError("Not a FlatVectorStore header.")
+        store = cls(dtype=header["dtype"])
+        store._vectors = read_array("vectors")
+        store._node_ids = decode_ids(read_array("node_ids"))
+        store._ref_doc_ids = decode_ids(read_array("ref_doc_ids"))
+        store._ordering = header.get("ordering", "")
+        return store
+
+    @classmethod
+    def from_persist_path(cls, persist_path: str, fs: Any = None) -> "FlatVectorStore":
+        """Loads a persisted store, memory-mapping the matrix read-only."""
+        with open(persist_path, "r", encoding="utf-8") as f:
+            header = json.load(f)
+        names = flat_store_files(persist_path)
+        return cls._from_parts(header, lambda part: np.load(names[part], mmap_mode="r"))
+
+    @classmethod
+    def from_bundle(cls, bundle: IndexBundle, header_section: str) -> "FlatVectorStore":
+        """Loads a store from bundle sections; the matrix is a zero-copy view into the bundle mapping."""
+        names = flat_store_files(header_section)
+        return cls._from_parts(bundle.read_json(header_section), lambda part: bundle.read_array(names[part]))
+
+    @classmethod
+    def from_arrays(cls, vectors: np.ndarray, node_ids: np.ndarray, ref_doc_ids: np.ndarray, dtype: str = "float32") -> "FlatVectorStore":
+        """A store over existing (e.g. memory-mapped) arrays: the matrix in storage format `dtype`, ids as 'S' arrays."""
+        arrays = {"vectors": vectors, "node_ids": node_ids, "ref_doc_ids": ref_doc_ids}
+        return cls._from_parts({"__type__": FLAT_VECTOR_STORE_TYPE, "dtype": dtype}, arrays.__getitem__)
+
+    @staticmethod
+    def is_flat_header(header: Dict[str, Any]) -> bool:
+        return isinstance(header, dict) and header.get("__type__") == FLAT_VECTOR_STORE_TYPE
@@ -0,0 +1,248 @@
+"""
+Append-only write-ahead log for incremental index updates.
+
+IndexBuilder logs each insert (node payload plus its embedding) and delete here before
+applying it to the in-memory index, so small updates are durable without rewriting the
+persisted stores. load() replays the log over the persisted index; checkpoint() persists
+the index and empties the log.
+
+File layout: an 8-byte magic and the LSN the log starts after (u64), then records of
+
+    crc32c (u32) | lsn (u64) | op (u8) | length (u32) | payload (length bytes)
+
+where the CRC covers everything after itself. Log sequence numbers (LSNs) increase by one
+per record and keep increasing across checkpoints. A torn or corrupt tail, left by a crash
+mid-append, ends the log; it is cut off when the log is reopened.
+
+Group commit: append() only buffers a record. commit(lsn) makes it durable. The first
+waiting caller becomes the flush leader and writes every buffered record with a single
+fsync, so concurrent writers share fsyncs. Records appended while an fsync runs form the
+next batch; in "group" mode the leader also waits up to group_commit_ms until the batch is
+as large as the previous one, so it only waits when there are other writers to wait for.
+If the write or fsync fails, the leader's commit raises, the partial write is cut off and
+the batch goes back to the buffer: a commit only returns once its records are durable.
+"""
+import os
+import json
+import struct
+import threading
+import time
+from typing import Any, Dict, Iterator, List, Optional, Tuple
+
+import numpy as np
+
+from src.index_bundle import crc32c
+
+WAL_MAGIC = b"ARAGWAL1"
+OP_INSERT = 1
+OP_DELETE = 2
+# Durability modes: "group" waits group_commit_ms to gather writers into one fsync,
+# "fsync" syncs each flush immediately, "off" only hands writes to the OS (not crash-safe).
+SYNC_MODES = ("group", "fsync", "off")
+
+_FILE_HEADER = struct.Struct("<8sQ")
+_RECORD = struct.Struct("<IQBI")
+_CRC = struct.Struct("<I")
+_PAYLOAD_HEADER = struct.Struct("<II")
+
+def encode_insert(node: Dict[str, Any], embedding: np.ndarray) -> bytes:
+    """Insert payload: the node's JSON (without its embedding) and the embedding as float32."""
+    body = json.dumps(node).encode("utf-8")
+    vector = np.ascontiguousarray(embedding, dtype=np.float32)
+    return _PAYLOAD_HEADER.pack(len(body), vector.size) + body + vector.tobytes()
+
+def decode_insert(payload: bytes) -> Tuple[Dict[str, Any], np.ndarray]:
+    body_length, dim = _PAYLOAD_HEADER.unpack_from(payload)
+    start = _PAYLOAD_HEADER.size
+    node = json.loads(payload[start:start + body_length].decode("utf-8"))
+    embedding = np.frombuffer(payload, dtype=np.float32, count=dim, offset=start + body_length)
+    return node, embedding
+
+def encode_delete(ref_doc_id: str) -> bytes:
+    return ref_doc_id.encode("utf-8")
+
+def decode_delete(payload: bytes) -> str:
+    return payload.decode("utf-8")
+
+def _encode_record(lsn: int, op: int, payload: bytes) -> bytes:
+    body = _RECORD.pack(0, lsn, op, len(payload))[_CRC.size:] + payload
+    return _CRC.pack(crc32c(body)) + body
+
+def _scan(data: bytes) -> Iterator[Tuple[int, int, int, bytes]]:
+    """Yields (end_offset, lsn, op, payload) for each intact record, stopping at the first bad one."""
+    offset = _FILE_HEADER.size
+    while offset + _RECORD.size <= len(data):
+        crc, lsn, op, length = _RECORD.unpack_from(data, offset)
+        end = offset + _RECORD.size + length
+        if end > len(data) or crc32c(data[offset + _CRC.size:end]) != crc:
+            return
+        yield end, lsn, op, data[offset + _RECORD.size:end]
+        offset = end
+
+def _fsync_dir(path: str):
+    if hasattr(os, "O_DIRECTORY"):
+        fd = os.open(path, os.O_RDONLY | os.O_DIRECTORY)
+        try:
+            os.fsync(fd)
+        finally:
+            os.close(fd)
+
+class WriteAheadLog:
+    """
+    Args:
+        path (str): Log file; created (with its directory) if missing.
+        sync (str): One of SYNC_MODES.
+        group_commit_ms (float): How long a "group" flush leader waits for more records.
+    """
+    def __init__(self, path: str, sync: str = "group", group_commit_ms: float = 2.0):
+        if sync not in SYNC_MODES:
+            raise ValueError(f"Unknown WAL sync mode '{sync}'. Expected one of {SYNC_MODES}.")
+        self.path = path
+        self.sync = sync
+        self.group_commit_ms = group_commit_ms
+        self.fsyncs = 0
+        self._cond = threading.Condition()
+        self._buffer: List[bytes] = []
+        self._flushing = False
+        self._last_batch = 0
+        self._broken: Optional[OSError] = None
+
+        os.makedirs(os.path.dirname(path) or ".", exist_ok=True)
+        last_lsn, valid_end, records = 0, _FILE_HEADER.size, 0
+        if os.path.exists(path):
+            with open(path, "rb") as f:
+                data = f.read()
+            if len(data) < _FILE_HEADER.size or data[:len(WAL_MAGIC)] != WAL_MAGIC:
+                raise ValueError(f"{path} is not a write-ahead log.")
+            last_lsn = _FILE_HEADER.unpack_from(data)[1]
+            for valid_end, last_lsn, _, _ in _scan(data):
+                records += 1
+            if valid_end < len(data):
+                print(f"WAL: discarding {len(data) - valid_end} bytes of torn tail in {path}.")
+        else:
+            self._create_empty(path)
+        self._file = open(path, "r+b")
+        self._file.truncate(valid_end)
+        self._file.seek(valid_end)
+        self._records = records
+        self._next_lsn = last_lsn + 1
+        self._durable_lsn = last_lsn
+
+    @staticmethod
+    def _create_empty(path: str, base_lsn: int = 0):
+        with open(path + ".tmp", "wb") as f:
+            f.write(_FILE_HEADER.pack(WAL_MAGIC, base_lsn))
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(path + ".tmp", path)
+        _fsync_dir(os.path.dirname(path) or ".")
+
+    @property
+    def last_lsn(self) -> int:
+        """LSN of the most recently appended record (0 if none ever was)."""
+        with self._cond:
+            return self._next_lsn - 1
+
+    @property
+    def records_since_checkpoint(self) -> int:
+        with self._cond:
+            return self._records
+
+    def append(self, op: int, payload: bytes) -> int:
+        """Buffers a record and returns its LSN. It is not durable until commit(lsn) returns."""
+        with self._cond:
+            lsn = self._next_lsn
+            self._next_lsn += 1
+            self._buffer.append(_encode_record(lsn, op, payload))
+            self._records += 1
+            if self._flushing:
+                self._cond.notify_all()
+            return lsn
+
+    def commit(self, lsn: Optional[int] = None):
+        """Blocks until every record up to `lsn` (default: all appended so far) is durable."""
+        with self._cond:
+            if lsn is None:
+                lsn = self._next_lsn - 1
+            while self._durable_lsn < lsn:
+                if self._broken is not None:
+                    raise RuntimeError(f"{self.path} could not be repaired after a failed write; reopen the log.") from self._broken
+                if self._flushing:
+                    self._cond.wait()
+                    continue
+                self._flushing = True
+                if self.sync == "group" and self._last_batch > 1:
+                    gather_until = time.monotonic() + self.group_commit_ms / 1000.0
+                    while len(self._buffer) < self._last_batch:
+                        remaining = gather_until - time.monotonic()
+                        if remaining <= 0:
+                            break
+                        self._cond.wait(remaining)
+                batch, self._buffer = self._buffer, []
+                self._last_batch = len(batch)
+                batch_lsn = self._next_lsn - 1
+                start = self._file.tell()
+                error = None
+                self._cond.release()
+                try:
+                    self._file.write(b"".join(batch))
+                    self._file.flush()
+                    if self.sync != "off":
+                        os.fsync(self._file.fileno())
+                except BaseException as e:
+                    error = e
+                    self._discard_tail(start)
+                self._cond.acquire()
+                self._flushing = False
+                self._cond.notify_all()
+                if error is not None:
+                    # Nothing in the batch is durable: put it back, so whoever commits next
+                    # (a waiter whose record was in it, or a retry) writes it again
+                    self._buffer[:0] = batch
+                    raise error
+                if self.sync != "off":
+                    self.fsyncs += 1
+                self._durable_lsn = batch_lsn
+
+    def _discard_tail(self, offset: int):
+        """
+        Cuts the file back to `offset` after a failed write or fsync, so a retried batch is not
+        appended behind a partial copy of itself. The file is reopened because the buffered
+        writer may still hold the unwritten bytes. If that fails too, the log is marked broken.
+        """
+        try:
+            try:
+                self._file.close()
+            except OSError:
+                pass
+            self._file = open(self.path, "r+b")
+            self._file.truncate(offset)
+            self._file.seek(offset)
+        except OSError as e:
+            self._broken = e
+
+    def records(self, after_lsn: int = 0) -> Iterator[Tuple[int, int, bytes]]:
+        """Yields the durable (lsn, op, payload) records with lsn > after_lsn, in log order."""
+        with open(self.path, "rb") as f:
+            data = f.read()
+        for _, lsn, op, payload in _scan(data):
+            if lsn > after_lsn:
+                yield lsn, op, payload
+
+    def reset(self):
+        """
+        Empties the log after a checkpoint has made every committed record part of the
+        persisted index. LSNs continue from where they were.
+        """
+        self.commit()
+        with self._cond:
+            self._file.close()
+            self._create_empty(self.path, self._next_lsn - 1)
+            self._file = open(self.path, "r+b")
+            self._file.seek(0, os.SEEK_END)
+            self._records = 0
+
+    def close(self):
+        self.commit()
+        with self._cond:
+            self._file.close()
@@ -0,0 +1,62 @@
+import shutil
+import tempfile
+
+import numpy as np
+import pytest
+
+from src.autotune import TuningResult, autotune_multivector, exact_maxsim_top_k
+from src.multivector import MultiVectorIndex
+
+@pytest.fixture(scope="module")
+def index_and_queries():
+    rng = np.random.default_rng(0)
+    topics = rng.standard_normal((40, 32), dtype=np.float32)
+    token_sets = []
+    for _ in range(400):
+        doc_topics = topics[rng.choice(len(topics), 3, replace=False)]
+        token_sets.append(doc_topics[rng.integers(0, 3, 12)] + rng.standard_normal((12, 32), dtype=np.float32))
+    index = MultiVectorIndex.build([str(i) for i in range(400)], token_sets, residual_bits=4, num_centroids=64)
+    queries = [token_sets[i][:4] for i in rng.choice(400, 20, replace=False)]
+    return index, queries
+
+def test_exact_ground_truth_matches_full_search(index_and_queries):
+    index, queries = index_and_queries
+    truth = exact_maxsim_top_k(index, queries, 5)
+    rows, _ = index.search(queries[0], 5, nprobe=len(index.centroids), candidates=len(index))
+    assert rows.tolist() == truth[0]
+    # Scoring in chunks of nodes, with a running top-k, gives the same answer
+    assert exact_maxsim_top_k(index, queries, 5, chunk_rows=37) == truth
+    assert exact_maxsim_top_k(index, queries, 5, chunk_rows=1) == truth
+
+def test_autotune_meets_target_at_lowest_cost(index_and_queries):
+    index, queries = index_and_queries
+    tuning = autotune_multivector(index, queries, k=10, target_recall=0.95)
+    assert tuning.met_target and tuning.recall >= 0.95
+    assert min(trial["recall"] for trial in tuning.trials) < 0.95
+    meeting = [trial for trial in tuning.trials if trial["recall"] >= 0.95]
+    assert tuning.cost == min(trial["cost"] for trial in meeting)
+    # Exhaustive search costs every token of every node
+    assert tuning.cost < index.num_tokens
+
+def test_unreachable_target_returns_best_recall(index_and_queries):
+    index, queries = index_and_queries
+    tuning = autotune_multivector(index, queries, k=5, target_recall=1.01, nprobe_grid=(1, 2), candidates_grid=(8, 16))
+    assert not tuning.met_target
+    assert tuning.recall == max(trial["recall"] for trial in tuning.trials)
+
+def test_k_above_every_grid_value_tries_k(index_and_queries):
+    index, queries = index_and_queries
+    tuning = autotune_multivector(index, queries[:3], k=50, nprobe_grid=(len(index.centroids),), candidates_grid=(16, 32))
+    assert [trial["candidates"] for trial in tuning.trials] == [50]
+    assert tuning.params["candidates"] == 50 and tuning.recall > 0
+
+def test_tuning_round_trip():
+    tuning = TuningResult(params={"nprobe": 4, "candidates": 128}, recall=0.97, cost=900.0, latency_ms=1.5,
+                          target_recall=0.95, k=10, num_queries=50, met_target=True)
+    temp_dir = tempfile.mkdtemp(prefix="test_autotune_")
+    try:
+        assert TuningResult.load(temp_dir) is None
+        tuning.save(temp_dir)
+        assert TuningResult.load(temp_dir) == tuning
+    finally:
+        shutil.rmtree(temp_dir)
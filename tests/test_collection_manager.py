@@ -0,0 +1,135 @@
+import os
+import threading
+
+import pytest
+
+from src.collection_manager import CollectionManager, LoadedCollection, storage_footprint
+from src.config_loader import AppConfig, IndexBuilderConfig, QueryEngineBuilderConfig
+
+MB = 2**20
+
+class FakeQueryEngine:
+    def __init__(self, name):
+        self.name = name
+
+    def query(self, text):
+        return f"{self.name}: {text}"
+
+def _configs(storage_dir, size_mb):
+    os.makedirs(storage_dir, exist_ok=True)
+    with open(os.path.join(storage_dir, "index.bundle"), "wb") as f:
+        f.truncate(size_mb * MB)
+    index_cfg = IndexBuilderConfig(
+        storage_dir=storage_dir, embedding_model_name="m", corpus_path="corpus.json", corpus_id_field="id",
+        corpus_text_fields=["text"], corpus_metadata_fields=[], chunk_size=100, chunk_overlap=10
+    )
+    query_cfg = QueryEngineBuilderConfig(embedding_model_name="m", chunk_size=100, chunk_overlap=10, similarity_top_k=2)
+    return index_cfg, query_cfg
+
+@pytest.fixture
+def collections(tmp_path):
+    return {name: _configs(str(tmp_path / name), size) for name, size in (("acl", 3), ("reports", 2), ("memos", 2))}
+
+def fake_loader(loads):
+    def load(index_cfg, query_cfg):
+        name = os.path.basename(index_cfg.storage_dir)
+        loads.append(name)
+        return LoadedCollection(query_engine=FakeQueryEngine(name), nbytes=storage_footprint(index_cfg))
+    return load
+
+def test_queries_are_routed_and_collections_load_lazily(collections):
+    loads = []
+    manager = CollectionManager(collections, loader=fake_loader(loads))
+    assert manager.loaded() == []
+    assert manager.query("reports", "q1") == "reports: q1"
+    assert manager.query("acl", "q2") == "acl: q2"
+    assert manager.query("reports", "q3") == "reports: q3"
+    assert loads == ["reports", "acl"]
+    assert manager.loaded() == ["acl", "reports"]
+    assert manager.resident_bytes == 5 * MB
+    with pytest.raises(KeyError):
+        manager.query("unknown", "q")
+
+def test_least_recently_used_collection_is_evicted_under_budget(collections):
+    loads = []
+    manager = CollectionManager(collections, memory_budget_bytes=5 * MB, loader=fake_loader(loads))
+    manager.query("acl", "q")
+    manager.query("reports", "q")
+    manager.query("acl", "q")
+    # memos does not fit next to both: reports is the least recently used
+    manager.query("memos", "q")
+    assert manager.loaded() == ["acl", "memos"]
+    assert manager.stats.evicted == ["reports"]
+    manager.query("reports", "q")
+    assert loads == ["acl", "reports", "memos", "reports"]
+    assert manager.resident_bytes <= 5 * MB
+
+def test_collections_serving_a_query_are_not_evicted(collections):
+    manager = CollectionManager(collections, memory_budget_bytes=4 * MB, loader=fake_loader([]))
+    with manager.acquire("acl"):
+        manager.query("reports", "q")
+        # Over budget while acl is pinned: reports goes instead
+        assert manager.loaded() == ["acl"]
+        assert not manager.evict("acl")
+    manager.query("memos", "q")
+    assert manager.loaded() == ["memos"]
+
+def test_concurrent_first_queries_load_once(collections):
+    loads = []
+    loader = fake_loader(loads)
+    manager = CollectionManager(collections, loader=lambda *cfgs: (threading.Event().wait(0.05), loader(*cfgs))[1])
+    threads = [threading.Thread(target=manager.query, args=("acl", "q")) for _ in range(8)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert loads == ["acl"]
+    assert manager.stats.hits == 7
+
+def test_serving_config_resolves_paths(tmp_path):
+    (tmp_path / "main.yaml").write_text(
+        "serving:\n  collections:\n    acl: main.yaml\n    reports: reports/config.yaml\n  memory_budget_mb: 512\n"
+    )
+    (tmp_path / "solo.yaml").write_text("index_builder: {}\n")
+    serving = AppConfig(str(tmp_path / "main.yaml")).get_serving_config()
+    assert serving.collections == {"acl": None, "reports": str(tmp_path / "reports" / "config.yaml")}
+    assert serving.memory_budget_mb == 512
+    assert AppConfig(str(tmp_path / "solo.yaml")).get_serving_config().collections == {"default": None}
+
+def test_boolean_flags_parse_strictly(tmp_path):
+    required = (
+        "index_builder:\n  storage_dir: s\n  embedding_model_name: m\n  corpus_path: c\n  corpus_id_field: id\n"
+        "  corpus_text_fields: [text]\n  corpus_metadata_fields: []\n  chunk_size: 100\n  chunk_overlap: 10\n"
+    )
+    (tmp_path / "flags.yaml").write_text(
+        required + "  wal_enabled: \"false\"\n  multivector_enabled: \"True\"\n  title_index_enabled: 1\n  token_cache_enabled: \"0\"\n"
+    )
+    cfg = AppConfig(str(tmp_path / "flags.yaml")).get_index_builder_config()
+    assert cfg.wal_enabled is False and cfg.multivector_enabled is True
+    assert cfg.title_index_enabled is True and cfg.token_cache_enabled is False
+    assert cfg.autotune_enabled is False
+
+    (tmp_path / "bad.yaml").write_text(required + "  wal_enabled: \"no thanks\"\n")
+    with pytest.raises(ValueError, match="'wal_enabled' must be true or false"):
+        AppConfig(str(tmp_path / "bad.yaml")).get_index_builder_config()
+
+def test_rebuilt_collection_is_reloaded_once_idle(collections):
+    class Builder:
+        replaced = False
+        def bundle_replaced(self):
+            return self.replaced
+    builders = []
+    def load(index_cfg, query_cfg):
+        builders.append(Builder())
+        return LoadedCollection(query_engine=FakeQueryEngine(str(len(builders))), nbytes=0, index_builder=builders[-1])
+    manager = CollectionManager(collections, loader=load)
+    assert manager.query("acl", "q") == "1: q"
+    builders[0].replaced = True
+    with manager.acquire("acl") as first:
+        assert first.query_engine.name == "2"
+        builders[1].replaced = True
+        # Still serving a query on the old generation: it stays loaded until idle
+        with manager.acquire("acl") as second:
+            assert second is first
+    assert manager.query("acl", "q") == "3: q"
+    assert manager.stats.reloads == 2
@@ -146,4 +146,40 @@ def test_load_data_empty_json_list(mock_print, mock_file_open, document_loader):
     documents = document_loader.load_data()
 
     assert len(documents) == 0
-    mock_print.assert_any_call(f"No documents were loaded from {document_loader.corpus_path}. Check the file content and format.") 
\ No newline at end of file
+    mock_print.assert_any_call(f"No documents were loaded from {document_loader.corpus_path}. Check the file content and format.") 
+
+def test_load_data_from_shard_manifest(tmp_path, sample_data):
+    """Test loading the shards listed in a bib_to_json manifest, filtered by partition value."""
+    shards = [("corpus.year-0000.json", ["2023", "2025"], [sample_data[0], sample_data[2]]),
+              ("corpus.year-0001.json", ["2024"], [sample_data[1]])]
+    for name, _, entries in shards:
+        (tmp_path / name).write_text(json.dumps(entries), encoding="utf-8")
+    manifest = {
+        "partition": "year", "num_shards": 2, "records": 3,
+        "shards": [{"path": name, "records": len(entries), "bytes": 0, "values": values} for name, values, entries in shards],
+    }
+    manifest_path = tmp_path / "corpus.manifest.json"
+    manifest_path.write_text(json.dumps(manifest), encoding="utf-8")
+
+    def loader(partition_values=None):
+        return DocumentLoader(str(manifest_path), ["title", "abstract"], ["year"], "doc_id_key", partition_values=partition_values)
+
+    assert [doc.doc_id for doc in loader().load_data()] == ["doc1", "entry_1", "doc2"]
+    assert [doc.doc_id for doc in loader([2024]).load_data()] == ["doc2"]
+    assert loader(["1999"]).load_data() == []
+
+def test_iter_documents_matches_load_data(tmp_path, sample_data):
+    """Test that the streaming reader yields the same documents as load_data, for a file and a manifest."""
+    corpus_path = tmp_path / "corpus.json"
+    corpus_path.write_text(json.dumps(sample_data + ["not a dict", sample_data[0]], indent=2), encoding="utf-8")
+    (tmp_path / "corpus.hash-0000.json").write_text(json.dumps(sample_data), encoding="utf-8")
+    manifest_path = tmp_path / "corpus.manifest.json"
+    manifest_path.write_text(json.dumps({"partition": "hash", "num_shards": 1, "records": len(sample_data), "shards": [
+        {"path": "corpus.hash-0000.json", "records": len(sample_data), "bytes": 0}
+    ]}), encoding="utf-8")
+
+    for path in (corpus_path, manifest_path):
+        loader = DocumentLoader(str(path), ["title", "abstract"], ["year"], "doc_id_key")
+        loaded = loader.load_data()
+        streamed = list(loader.iter_documents())
+        assert [(d.doc_id, d.text, d.metadata) for d in streamed] == [(d.doc_id, d.text, d.metadata) for d in loaded]
@@ -0,0 +1,130 @@
+import time
+import asyncio
+import threading
+
+import numpy as np
+import pytest
+
+from src import kernels
+from src.deadlines import AdmissionController, Deadline, QueryRejected
+from src.kernels import flat_top_k, top_k_indices
+from src.multivector import MultiVectorIndex
+
+def test_deadline_expiry_and_partial_flag():
+    deadline = Deadline.after_ms(10_000)
+    assert not deadline.expired() and deadline.remaining_s() > 9
+    assert not deadline.partial
+    deadline.mark_partial("flat_scan")
+    deadline.mark_partial("flat_scan")
+    assert deadline.partial and deadline.partial_stages == ["flat_scan"]
+    assert Deadline.after_ms(0).expired()
+
+def test_flat_top_k_without_deadline_is_exact(monkeypatch):
+    monkeypatch.setattr(kernels, "DEADLINE_CHECK_ROWS", 100)
+    rng = np.random.default_rng(0)
+    matrix = rng.standard_normal((1000, 16), dtype=np.float32)
+    query = rng.standard_normal(16, dtype=np.float32)
+    expected = top_k_indices(matrix @ query, 5)[0]
+
+    deadline = Deadline.after_ms(60_000)
+    rows, _ = flat_top_k(matrix, query, "float32", 5, deadline=deadline)
+    assert rows.tolist() == expected.tolist()
+    assert not deadline.partial
+
+def test_flat_top_k_stops_at_deadline(monkeypatch):
+    """An expired deadline stops the scan after the first chunk and returns that chunk's best rows."""
+    monkeypatch.setattr(kernels, "DEADLINE_CHECK_ROWS", 100)
+    rng = np.random.default_rng(1)
+    matrix = rng.standard_normal((1000, 16), dtype=np.float32)
+    query = rng.standard_normal(16, dtype=np.float32)
+
+    deadline = Deadline.after_ms(0)
+    rows, scores = flat_top_k(matrix, query, "float32", 5, deadline=deadline)
+    assert deadline.partial_stages == ["flat_scan"]
+    assert rows.tolist() == top_k_indices(matrix[:100] @ query, 5)[0].tolist()
+    assert np.all(np.diff(scores) <= 0)
+
+def test_multivector_search_stops_at_deadline():
+    rng = np.random.default_rng(2)
+    token_sets = [rng.standard_normal((4, 16), dtype=np.float32) for _ in range(200)]
+    index = MultiVectorIndex.build([str(i) for i in range(200)], token_sets, residual_bits=8, num_centroids=8)
+
+    deadline = Deadline.after_ms(0)
+    rows, _ = index.search(token_sets[0], top_k=3, nprobe=8, candidates=200, deadline=deadline)
+    assert deadline.partial_stages == ["maxsim"]
+    assert 0 < len(rows) <= 3
+
+def test_admission_rejects_when_estimate_exceeds_budget():
+    admission = AdmissionController(max_concurrent=1, initial_service_ms=100)
+    with pytest.raises(QueryRejected):
+        with admission.admit(Deadline.after_ms(20)):
+            pass
+    with admission.admit(Deadline.after_ms(1_000)):
+        pass
+    with admission.admit(None):
+        pass
+    assert admission.rejected == 1 and admission.admitted == 2
+
+def test_admission_rejects_queued_query_whose_deadline_passes():
+    admission = AdmissionController(max_concurrent=1, initial_service_ms=1)
+    holding = threading.Event()
+    release = threading.Event()
+
+    def hold_slot():
+        with admission.admit(None):
+            holding.set()
+            release.wait(5)
+
+    worker = threading.Thread(target=hold_slot)
+    worker.start()
+    holding.wait(5)
+    start = time.monotonic()
+    with pytest.raises(QueryRejected):
+        with admission.admit(Deadline.after_ms(50)):
+            pass
+    assert time.monotonic() - start < 1
+    release.set()
+    worker.join()
+
+def test_async_admission_shares_slots_without_blocking_the_loop():
+    admission = AdmissionController(max_concurrent=1, initial_service_ms=1)
+    holding = threading.Event()
+    release = threading.Event()
+
+    def hold_slot():
+        with admission.admit(None):
+            holding.set()
+            release.wait(5)
+
+    async def main():
+        ticks = 0
+
+        async def tick():
+            nonlocal ticks
+            while True:
+                await asyncio.sleep(0.005)
+                ticks += 1
+
+        ticker = asyncio.create_task(tick())
+        # The slot is held by a thread: a queued coroutine gives up at its deadline
+        with pytest.raises(QueryRejected):
+            async with admission.aadmit(Deadline.after_ms(50)):
+                pass
+        loop = asyncio.get_running_loop()
+        loop.call_later(0.05, release.set)
+        async with admission.aadmit(None):
+            # Admitted once the thread let go, and the loop kept running meanwhile
+            assert release.is_set() and ticks >= 5
+            with pytest.raises(QueryRejected):
+                async with admission.aadmit(Deadline.after_ms(20)):
+                    pass
+        ticker.cancel()
+
+    worker = threading.Thread(target=hold_slot)
+    worker.start()
+    holding.wait(5)
+    asyncio.run(main())
+    worker.join()
+    assert admission.admitted == 2 and admission.rejected == 2
+    with admission.admit(Deadline.after_ms(1_000)):
+        pass
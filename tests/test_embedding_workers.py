@@ -0,0 +1,95 @@
+import hashlib
+import multiprocessing
+import os
+import tempfile
+import threading
+
+import numpy as np
+import pytest
+
+from src.embedding_workers import EmbeddingCoordinator, run_worker
+
+DIM = 8
+
+def fake_embed(texts):
+    """Deterministic stand-in for an encoder: vectors derived from a hash of each text."""
+    return np.stack([
+        np.frombuffer(hashlib.sha256(text.encode("utf-8")).digest()[:DIM * 4], dtype=np.uint32).astype(np.float32) / 2**32
+        for text in texts
+    ])
+
+def _worker(address, model="m", fail_on=None, crash_on=None):
+    """Worker process: optionally reports an error for, or dies on, batches containing a marker text."""
+    def embed(texts):
+        if crash_on is not None and crash_on in texts:
+            os._exit(1)
+        if fail_on is not None and fail_on in texts:
+            raise RuntimeError("out of memory")
+        return fake_embed(texts)
+    run_worker(address, embed, model=model, connect_timeout_s=10)
+
+def _start_workers(address, count, **kwargs):
+    context = multiprocessing.get_context("spawn")
+    workers = [context.Process(target=_worker, args=(address,), kwargs=kwargs, daemon=True) for _ in range(count)]
+    for worker in workers:
+        worker.start()
+    return workers
+
+@pytest.fixture
+def texts():
+    return [f"chunk {i} " + "word " * (i % 7) for i in range(203)]
+
+def _embed_with(workers, texts, batch_size, **worker_kwargs):
+    with EmbeddingCoordinator("127.0.0.1:0", model="m", batch_size=batch_size, lease_s=10) as coordinator:
+        processes = _start_workers(coordinator.address, workers, **worker_kwargs)
+        vectors = coordinator.embed([f"n{i}" for i in range(len(texts))], texts, timeout_s=60)
+        stats = coordinator.stats
+    for process in processes:
+        process.join(timeout=10)
+    return vectors, stats
+
+def test_results_match_local_embedding_for_any_worker_count(texts):
+    expected = fake_embed(texts)
+    for workers in (1, 3):
+        vectors, stats = _embed_with(workers, texts, batch_size=16)
+        np.testing.assert_array_equal(vectors, expected)
+        assert stats.batches == 13 and stats.retries == 0
+
+def test_crashed_worker_batch_is_retried_elsewhere(texts):
+    with EmbeddingCoordinator("127.0.0.1:0", model="m", batch_size=16, lease_s=10) as coordinator:
+        result = {}
+        job = threading.Thread(target=lambda: result.update(vectors=coordinator.embed(
+            [f"n{i}" for i in range(len(texts))], texts, timeout_s=60
+        )))
+        job.start()
+        # The only worker dies on the batch holding texts[40]; workers started later finish the job
+        crashed = _start_workers(coordinator.address, 1, crash_on=texts[40])[0]
+        crashed.join(timeout=30)
+        assert crashed.exitcode == 1
+        processes = _start_workers(coordinator.address, 2)
+        job.join(timeout=60)
+        assert coordinator.stats.retries == 1 and coordinator.stats.workers >= 2
+    for process in processes:
+        process.join(timeout=10)
+    np.testing.assert_array_equal(result["vectors"], fake_embed(texts))
+
+def test_batch_failing_everywhere_fails_the_job(texts):
+    with EmbeddingCoordinator("127.0.0.1:0", model="m", batch_size=16, lease_s=10, max_attempts=2) as coordinator:
+        processes = _start_workers(coordinator.address, 2, fail_on=texts[0])
+        with pytest.raises(RuntimeError, match="out of memory"):
+            coordinator.embed([f"n{i}" for i in range(len(texts))], texts, timeout_s=60)
+    for process in processes:
+        process.join(timeout=10)
+
+def test_unix_socket_and_model_check(texts):
+    path = os.path.join(tempfile.mkdtemp(prefix="test_embed_"), "coordinator.sock")
+    with EmbeddingCoordinator(f"unix:{path}", model="m", batch_size=50) as coordinator:
+        with pytest.raises(ConnectionRefusedError):
+            run_worker(coordinator.address, fake_embed, model="other")
+        processes = _start_workers(coordinator.address, 2)
+        vectors = coordinator.embed([f"n{i}" for i in range(len(texts))], texts, timeout_s=60)
+        assert coordinator.stats.rejected_workers == 1
+    for process in processes:
+        process.join(timeout=10)
+    np.testing.assert_array_equal(vectors, fake_embed(texts))
+    assert not os.path.exists(path)
@@ -0,0 +1,92 @@
+import json
+import os
+
+import numpy as np
+import pytest
+
+from src import kernels
+from src.external_build import ExternalBuild, iter_json_array
+from src.shared_segments import JSONSegment
+
+ENTRIES = [
+    {"ID": f"paper{i}", "title": "Brackets ] and \"quotes\" [{" * (i % 3), "abstract": "é☃ " * i, "year": 2000 + i}
+    for i in range(50)
+] + [[1, 2], -0.5e3, 12345, "text", None, True]
+
+def test_iter_json_array_matches_json_load(tmp_path):
+    path = str(tmp_path / "corpus.json")
+    for indent in (None, 2):
+        with open(path, "w", encoding="utf-8") as f:
+            json.dump(ENTRIES, f, indent=indent)
+        # Chunks this small cut strings, escapes and numbers ("-0." of "-0.5e3") at every position
+        for chunk_chars in (1, 3, 64, 1 << 20):
+            assert list(iter_json_array(path, chunk_chars)) == ENTRIES
+    with open(path, "w", encoding="utf-8") as f:
+        f.write(" [ ] ")
+    assert list(iter_json_array(path)) == []
+    with open(path, "w", encoding="utf-8") as f:
+        f.write('[{"a": 1}, {"b": ')
+    with pytest.raises(json.JSONDecodeError):
+        list(iter_json_array(path, 4))
+
+def _batches(count: int, dim: int = 16):
+    """Batches shaped like IndexBuilder.build_out_of_core's: document hashes, the batch docstore, flat rows."""
+    rng = np.random.default_rng(0)
+    for b in range(count):
+        node_ids = [f"{rng.integers(1 << 40):x}-{b}-{i}" for i in range(12)]
+        hashes = {"docstore/metadata": {f"doc-{b}-{i}": {"doc_hash": f"h{b}{i}"} for i in range(3)}}
+        docstore = {
+            "docstore/data": {node_id: {"__data__": {"id_": node_id, "text": "chunk " * (len(node_id) % 7)}} for node_id in node_ids},
+            "docstore/metadata": {node_id: {"doc_hash": node_id[::-1], "ref_doc_id": f"doc-{b}-{i % 3}"} for i, node_id in enumerate(node_ids)},
+            "docstore/ref_doc_info": {f"doc-{b}-{d}": {"node_ids": node_ids[d::3], "metadata": {}} for d in range(3)},
+        }
+        vectors = kernels.encode_vectors(rng.standard_normal((12, dim), dtype=np.float32), "float16")
+        yield hashes, docstore, vectors, node_ids, [f"doc-{b}-{i % 3}" for i in range(12)]
+
+def test_runs_merge_into_the_in_memory_result(tmp_path):
+    expected = {}
+    with ExternalBuild(str(tmp_path / "spill"), memory_bytes=8192) as external:
+        batches = list(_batches(30))
+        for hashes, docstore, vectors, node_ids, ref_doc_ids in batches:
+            external.add_entries(hashes, stream=0)
+            external.add_entries(docstore, stream=1)
+            external.add_rows(vectors, node_ids, ref_doc_ids)
+        assert external.runs > 5
+        vectors, node_ids, ref_doc_ids = external.merge_rows()
+        segment = external.merge_entries()
+    assert not os.path.exists(tmp_path / "spill")
+
+    # What one SimpleKVStore filled in the same order holds: every document hash, then the nodes
+    for stream in (0, 1):
+        for batch in batches:
+            for name, values in batch[stream].items():
+                expected.setdefault(name, {}).update(values)
+    in_memory = JSONSegment.build(expected)
+    assert segment.collections == list(expected)
+    for name in expected:
+        for merged, built in zip(segment.arrays(name), in_memory.arrays(name)):
+            assert merged.dtype == built.dtype and np.array_equal(merged, built)
+        assert segment.keys(name) == list(expected[name])
+    assert dict(segment.items("docstore/data")) == expected["docstore/data"]
+
+    assert np.array_equal(vectors, np.concatenate([batch[2] for batch in batches]))
+    assert node_ids.tolist() == [node_id.encode() for batch in batches for node_id in batch[3]]
+    assert ref_doc_ids.tolist() == [ref.encode() for batch in batches for ref in batch[4]]
+
+def test_duplicate_keys_across_runs_are_rejected(tmp_path):
+    with ExternalBuild(str(tmp_path / "spill"), memory_bytes=1) as external:
+        external.add_entries({"docstore/metadata": {"doc-1": {"doc_hash": "a"}}})
+        external.add_entries({"docstore/metadata": {"doc-1": {"doc_hash": "b"}}})
+        assert external.runs == 2
+        with pytest.raises(ValueError, match="doc-1"):
+            external.merge_entries()
+
+def test_segment_keeps_insertion_order_through_save_and_load(tmp_path):
+    data = {"docstore/data": {key: {"v": i} for i, key in enumerate(["zeta", "alpha", "mu", "beta"])}}
+    JSONSegment.build(data).save(str(tmp_path))
+    loaded = JSONSegment.load(str(tmp_path))
+    assert loaded.keys("docstore/data") == ["zeta", "alpha", "mu", "beta"]
+    assert [raw for _, raw in loaded.raw_items("docstore/data")] == [json.dumps(v).encode() for v in data["docstore/data"].values()]
+    # Segments saved without an order iterate in key order
+    keys, offsets, blob, _ = loaded.arrays("docstore/data")
+    assert JSONSegment({"docstore/data": (keys, offsets, blob)}).keys("docstore/data") == ["alpha", "beta", "mu", "zeta"]
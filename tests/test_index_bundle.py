@@ -0,0 +1,84 @@
+import os
+import json
+import shutil
+import tempfile
+
+import pytest
+
+from src import index_bundle
+from src.index_bundle import IndexBundle, BundleFormatError, SECTION_ALIGNMENT, crc32c, write_bundle, write_bundle_from_dir
+
+@pytest.fixture
+def storage_dir():
+    temp_dir = tempfile.mkdtemp(prefix="test_index_bundle_")
+    yield temp_dir
+    shutil.rmtree(temp_dir)
+
+def test_crc32c_known_vector():
+    """CRC32C check value from the Castagnoli polynomial specification."""
+    assert crc32c(b"123456789") == 0xE3069283
+
+def test_crc32c_fallback_matches(monkeypatch):
+    """The table-driven fallback must agree with the accelerated path."""
+    data = os.urandom(4096)
+    expected = crc32c(data)
+    monkeypatch.setattr(index_bundle, "google_crc32c", None)
+    assert crc32c(data) == expected
+    assert crc32c(b"123456789") == 0xE3069283
+
+def test_write_and_read_sections(storage_dir):
+    """Sections round-trip and start on 64-byte boundaries."""
+    bundle_path = os.path.join(storage_dir, "index.bundle")
+    sections = {"docstore.json": json.dumps({"a": 1}).encode(), "vectors.bin": bytes(range(200))}
+    write_bundle(sections, bundle_path)
+
+    with IndexBundle(bundle_path) as bundle:
+        assert sorted(bundle.names()) == sorted(sections)
+        assert bundle.read_json("docstore.json") == {"a": 1}
+        assert bytes(bundle.section("vectors.bin")) == sections["vectors.bin"]
+        for offset, _, _ in bundle._sections.values():
+            assert offset % SECTION_ALIGNMENT == 0
+
+def test_write_bundle_from_dir_skips_bundle(storage_dir):
+    """Packing a storage dir includes its files but not the bundle itself."""
+    for name in ["docstore.json", "index_store.json"]:
+        with open(os.path.join(storage_dir, name), "w") as f:
+            json.dump({"name": name}, f)
+    bundle_path = os.path.join(storage_dir, "index.bundle")
+
+    assert write_bundle_from_dir(storage_dir, bundle_path) == ["docstore.json", "index_store.json"]
+    # Repacking must not pick up the previous bundle
+    assert write_bundle_from_dir(storage_dir, bundle_path) == ["docstore.json", "index_store.json"]
+    with IndexBundle(bundle_path) as bundle:
+        assert bundle.read_json("index_store.json") == {"name": "index_store.json"}
+
+def test_write_bundle_from_empty_dir(storage_dir):
+    """Nothing is written when the storage dir holds no files."""
+    bundle_path = os.path.join(storage_dir, "index.bundle")
+    assert write_bundle_from_dir(storage_dir, bundle_path) == []
+    assert not os.path.exists(bundle_path)
+
+def test_corrupt_section_detected_lazily(storage_dir):
+    """A flipped payload byte is reported when (and only when) that section is read."""
+    bundle_path = os.path.join(storage_dir, "index.bundle")
+    write_bundle({"a.json": b'{"ok": true}', "b.bin": b"x" * 100}, bundle_path)
+    with IndexBundle(bundle_path) as bundle:
+        offset, length, _ = bundle._sections["b.bin"]
+    with open(bundle_path, "r+b") as f:
+        f.seek(offset + length - 1)
+        f.write(b"y")
+
+    with IndexBundle(bundle_path) as bundle:
+        assert bundle.read_json("a.json") == {"ok": True}
+        with pytest.raises(BundleFormatError, match="Checksum mismatch"):
+            bundle.section("b.bin")
+    with IndexBundle(bundle_path, verify=False) as bundle:
+        assert bytes(bundle.section("b.bin")).endswith(b"y")
+
+def test_rejects_non_bundle(storage_dir):
+    """Opening an arbitrary file raises BundleFormatError."""
+    path = os.path.join(storage_dir, "docstore.json")
+    with open(path, "w") as f:
+        f.write(json.dumps({"not": "a bundle"}) * 10)
+    with pytest.raises(BundleFormatError, match="not an index bundle"):
+        IndexBundle(path)
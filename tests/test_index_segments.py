@@ -0,0 +1,50 @@
+import os
+
+import numpy as np
+
+from src.index_segments import SEGMENTS_DIR, SegmentManifest, merge_top_k
+
+def test_manifest_persists_live_segments_and_never_reuses_names(tmp_path):
+    manifest = SegmentManifest(str(tmp_path))
+    assert manifest.names == []
+    first, second = manifest.new_name(), manifest.new_name()
+    assert first != second
+    manifest.add(first)
+    manifest.add(second)
+    assert manifest.segment_dir(first) == os.path.join(str(tmp_path), SEGMENTS_DIR, first)
+
+    reopened = SegmentManifest(str(tmp_path))
+    assert reopened.names == [first, second]
+    reopened.remove([first])
+    # A reserved name that was never added (an interrupted build) is not handed out again either
+    abandoned = reopened.new_name()
+    reopened.add(reopened.new_name())
+    reopened = SegmentManifest(str(tmp_path))
+    assert reopened.names[0] == second and len(reopened.names) == 2
+    assert reopened.new_name() not in (first, second, abandoned, reopened.names[1])
+    assert not os.path.exists(reopened.path + ".tmp")
+
+def test_merge_top_k_orders_dedupes_and_truncates():
+    main = (["a", "b", "c"], np.array([0.9, 0.5, 0.1], dtype=np.float32))
+    segment = (["d", "b", "e"], np.array([0.7, 0.5, 0.4], dtype=np.float32))
+    node_ids, scores = merge_top_k([main, segment], 4)
+    # "b" is in both while a merge is in progress: kept once
+    assert node_ids == ["a", "d", "b", "e"]
+    assert np.allclose(scores, [0.9, 0.7, 0.5, 0.4])
+    assert merge_top_k([main, segment], 10)[0] == ["a", "d", "b", "e", "c"]
+    assert merge_top_k([main], 2)[0] == ["a", "b"]
+    node_ids, scores = merge_top_k([([], np.empty(0)), ([], np.empty(0))], 3)
+    assert node_ids == [] and scores.shape == (0,)
+
+def test_merge_top_k_matches_a_single_scan():
+    rng = np.random.default_rng(0)
+    scores = rng.standard_normal(300).astype(np.float32)
+    node_ids = [f"node-{i}" for i in range(300)]
+    parts = []
+    for start in range(0, 300, 70):
+        part = np.argsort(-scores[start:start + 70], kind="stable")[:10] + start
+        parts.append(([node_ids[i] for i in part], scores[part]))
+    expected = np.argsort(-scores, kind="stable")[:10]
+    merged_ids, merged_scores = merge_top_k(parts, 10)
+    assert merged_ids == [node_ids[i] for i in expected]
+    assert np.array_equal(merged_scores, scores[expected])
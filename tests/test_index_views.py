@@ -0,0 +1,109 @@
+import os
+import json
+import shutil
+import tempfile
+
+import numpy as np
+import pytest
+
+from src.index_bundle import write_bundle_from_dir
+from src.index_views import (
+    IndexViews, MetadataColumns, MISSING_CODE, decode_ids, encode_ids, flat_store_files
+)
+from src.kernels import encode_vectors
+
+@pytest.fixture
+def storage_dir():
+    temp_dir = tempfile.mkdtemp(prefix="test_index_views_")
+    yield temp_dir
+    shutil.rmtree(temp_dir)
+
+def _write_flat_store(storage_dir, vectors, dtype, node_ids, ref_doc_ids):
+    """Writes the files FlatVectorStore.persist produces, without LlamaIndex."""
+    header = "default__vector_store.json"
+    names = flat_store_files(header)
+    np.save(os.path.join(storage_dir, names["vectors"]), encode_vectors(vectors, dtype))
+    np.save(os.path.join(storage_dir, names["node_ids"]), encode_ids(node_ids))
+    np.save(os.path.join(storage_dir, names["ref_doc_ids"]), encode_ids(ref_doc_ids))
+    with open(os.path.join(storage_dir, header), "w", encoding="utf-8") as f:
+        json.dump({"__type__": "flat_vector_store", "dtype": dtype, "count": len(node_ids)}, f)
+
+def test_ids_round_trip_utf8():
+    ids = ["a", "node-ü-2", ""]
+    encoded = encode_ids(ids)
+    assert encoded.dtype.kind == "S"
+    assert decode_ids(encoded) == ids
+    assert encode_ids([]).shape == (0,)
+
+def test_metadata_columns_dictionary_encoding():
+    columns = MetadataColumns.build(
+        ["n0", "n1", "n2", "n3"],
+        ["d0", "d0", "d1", "d2"],
+        [{"year": "2020", "venue": "ACL"}, {"year": "2021"}, {"year": "2020", "venue": "EMNLP"}, {}],
+        ["year", "venue"]
+    )
+    assert columns.fields == ["year", "venue"]
+    assert columns.codes("year").tolist() == [0, 1, 0, MISSING_CODE]
+    assert columns.dictionaries["year"] == ["2020", "2021"]
+    assert columns.values("venue").tolist() == ["ACL", None, "EMNLP", None]
+    assert decode_ids(columns.ref_doc_ids) == ["d0", "d0", "d1", "d2"]
+    with pytest.raises(ValueError):
+        columns.codes("year")[0] = 5
+
+def test_metadata_columns_updated_keeps_codes_and_extends_dictionaries():
+    columns = MetadataColumns.build(["n0", "n1", "n2"], ["d0", "d0", "d1"], [{"year": "2020"}, {"year": "2021"}, {}], ["year"])
+    updated = columns.updated(["n2", "n0", "n3", "n4"], {"n3": ("d2", {"year": "2019"}), "n4": ("d3", {"year": "2020"})})
+    assert decode_ids(updated.node_ids) == ["n2", "n0", "n3", "n4"]
+    assert decode_ids(updated.ref_doc_ids) == ["d1", "d0", "d2", "d3"]
+    assert updated.dictionaries["year"] == ["2020", "2021", "2019"]
+    assert updated.values("year").tolist() == [None, "2020", "2019", "2020"]
+
+def test_views_are_zero_copy_and_read_only(storage_dir):
+    rng = np.random.default_rng(0)
+    vectors = rng.standard_normal((10, 8), dtype=np.float32)
+    _write_flat_store(storage_dir, vectors, "float32", [f"n{i}" for i in range(10)], [f"d{i // 2}" for i in range(10)])
+    MetadataColumns.build([f"n{i}" for i in range(10)], [f"d{i // 2}" for i in range(10)],
+                          [{"year": str(2000 + i % 3)} for i in range(10)], ["year"]).save(storage_dir)
+
+    views = IndexViews.open(storage_dir)
+    assert isinstance(views.vectors.base, np.memmap) or isinstance(views.vectors, np.memmap)
+    assert not views.vectors.flags.writeable
+    np.testing.assert_array_equal(views.vectors, vectors)
+    assert decode_ids(views.node_ids)[3] == "n3"
+    assert views.columns.codes("year").tolist() == [0, 1, 2, 0, 1, 2, 0, 1, 2, 0]
+
+def test_views_from_bundle_match_directory(storage_dir):
+    rng = np.random.default_rng(1)
+    vectors = rng.standard_normal((50, 16), dtype=np.float32)
+    node_ids = [f"n{i}" for i in range(50)]
+    _write_flat_store(storage_dir, vectors, "float16", node_ids, node_ids)
+    MetadataColumns.build(node_ids, node_ids, [{"year": str(i % 4)} for i in range(50)], ["year"]).save(storage_dir)
+    write_bundle_from_dir(storage_dir, os.path.join(storage_dir, "index.bundle"))
+
+    views = IndexViews.open(storage_dir)
+    assert views._bundle is not None and views.dtype == "float16"
+    assert not views.vectors.flags.writeable
+    assert decode_ids(views.node_ids) == node_ids
+    assert views.columns.values("year").tolist()[:5] == ["0", "1", "2", "3", "0"]
+
+    blocks = list((start, block.copy()) for start, block in views.iter_float32_blocks(block_rows=16))
+    assert [start for start, _ in blocks] == [0, 16, 32, 48]
+    widened = np.concatenate([block for _, block in blocks])
+    assert widened.dtype == np.float32
+    np.testing.assert_allclose(widened, vectors, atol=1e-2)
+    views.close()
+
+def test_facet_counts_over_aligned_rows():
+    columns = MetadataColumns.build(
+        ["n0", "n1", "n2", "n3"], ["d0", "d1", "d2", "d3"],
+        [{"year": "2020"}, {"year": "2021"}, {"year": "2020"}, {}], ["year"]
+    )
+    assert columns.facet_counts("year", columns.codes("year")) == {"2020": 2, "2021": 1}
+    assert columns.facet_counts("year", columns.codes("year"), np.array([1, 3])) == {"2021": 1}
+
+    # A store whose rows are reordered and include a node the columns do not cover
+    store_ids = encode_ids(["n2", "new", "n1", "n0"])
+    codes = columns.aligned_codes("year", store_ids)
+    assert codes.tolist() == [0, MISSING_CODE, 1, 0]
+    assert columns.facet_counts("year", codes, np.array([0, 1, 2])) == {"2020": 1, "2021": 1}
+    assert not columns.aligned_codes("year", columns.node_ids).flags.writeable
@@ -1,14 +1,24 @@
 import os
+import re
+import zlib
+import dataclasses
+import threading
 import unittest
 import shutil
 import tempfile
+import numpy as np
 from unittest.mock import patch, MagicMock, call
 
 from llama_index.core import Document, VectorStoreIndex, Settings
+from llama_index.core.embeddings import MockEmbedding
+from llama_index.core.schema import TextNode
 from llama_index.core.node_parser import SentenceSplitter # Used for isinstance check
 from llama_index.embeddings.huggingface import HuggingFaceEmbedding
 
 from src.index_builder import IndexBuilder
+from src.index_bundle import IndexBundle
+from src.index_views import IndexViews, decode_ids
+from src.vector_store import FlatVectorStore
 from src.config_loader import IndexBuilderConfig
 # DocumentLoader and initialize_hf_embedding_model are dependencies of IndexBuilder,
 # so they will be mocked where necessary.
@@ -83,7 +93,7 @@ def test_build_new_index_no_documents_provided(mock_os_path_exists, mock_persist
     assert call(target_docstore_path) in mock_os_path_exists.call_args_list
     assert len(mock_os_path_exists.call_args_list) >= 1 # Ensure it was called at all
 
-    mock_init_embed.assert_called_once_with(model_name=index_builder_config.embedding_model_name)
+    mock_init_embed.assert_called_once_with(model_name=index_builder_config.embedding_model_name, precision=index_builder_config.embedding_precision)
     assert Settings.node_parser is not None
     assert isinstance(Settings.node_parser, SentenceSplitter)
     assert Settings.node_parser.chunk_size == index_builder_config.chunk_size
@@ -91,7 +101,8 @@ def test_build_new_index_no_documents_provided(mock_os_path_exists, mock_persist
         corpus_path=index_builder_config.corpus_path,
         text_fields=index_builder_config.corpus_text_fields,
         metadata_fields=index_builder_config.corpus_metadata_fields,
-        id_field=index_builder_config.corpus_id_field
+        id_field=index_builder_config.corpus_id_field,
+        partition_values=index_builder_config.corpus_partition_values
     )
     mock_doc_loader_instance.load_data.assert_called_once()
     mock_from_documents.assert_called_once_with(mock_documents, show_progress=True)
@@ -119,7 +130,7 @@ def test_build_new_index_with_documents_provided(mock_os_path_exists, mock_persi
     target_docstore_path = os.path.join(index_builder_config.storage_dir, index_builder_config.docstore_filename)
     assert call(target_docstore_path) in mock_os_path_exists.call_args_list
 
-    mock_init_embed.assert_called_once_with(model_name=index_builder_config.embedding_model_name)
+    mock_init_embed.assert_called_once_with(model_name=index_builder_config.embedding_model_name, precision=index_builder_config.embedding_precision)
     mock_from_documents.assert_called_once_with(mock_documents, show_progress=True)
     assert index is mock_index_instance
     mock_persist.assert_called_once()
@@ -130,8 +141,9 @@ def test_build_new_index_with_documents_provided(mock_os_path_exists, mock_persi
 @patch('os.path.exists') # Keep the mock
 def test_load_existing_index(mock_os_path_exists, mock_storage_context_from_defaults, mock_load_idx_from_storage, mock_init_embed, index_builder_config):
     """Test loading an index when it exists on disk and force_rebuild is False."""
-    # Only control the *first* call to os.path.exists
-    mock_os_path_exists.return_value = True # Simulate index existing initially
+    # Simulate the loose index files existing on disk, but no bundle
+    bundle_path = os.path.join(index_builder_config.storage_dir, index_builder_config.bundle_filename)
+    mock_os_path_exists.side_effect = lambda path: path != bundle_path
 
     mock_init_embed.return_value = MagicMock(spec=HuggingFaceEmbedding)
     mock_storage_context_instance = MagicMock()
@@ -148,7 +160,7 @@ def test_load_existing_index(mock_os_path_exists, mock_storage_context_from_defa
     assert call(target_docstore_path) in mock_os_path_exists.call_args_list
 
     # build() calls self.load() in this case
-    mock_init_embed.assert_called_once_with(model_name=index_builder_config.embedding_model_name)
+    mock_init_embed.assert_called_once_with(model_name=index_builder_config.embedding_model_name, precision=index_builder_config.embedding_precision)
     assert Settings.node_parser is not None
     assert isinstance(Settings.node_parser, SentenceSplitter)
     # Corrected assertion for from_defaults call
@@ -183,13 +195,32 @@ def test_build_force_rebuild(mock_os_path_exists, mock_persist, mock_from_docume
     assert call(target_docstore_path) in mock_os_path_exists.call_args_list
 
     # Even though exists, should proceed with build steps
-    mock_init_embed.assert_called_once_with(model_name=index_builder_config.embedding_model_name)
+    mock_init_embed.assert_called_once_with(model_name=index_builder_config.embedding_model_name, precision=index_builder_config.embedding_precision)
     MockDocumentLoader.assert_called_once()
     mock_doc_loader_instance.load_data.assert_called_once()
     mock_from_documents.assert_called_once_with(mock_documents, show_progress=True)
     assert index is mock_index_instance
     mock_persist.assert_called_once()
 
+@patch('src.index_builder.initialize_hf_embedding_model')
+@patch('src.index_builder.load_index_from_storage')
+@patch('llama_index.core.storage.storage_context.StorageContext.from_defaults')
+@patch('src.index_builder.IndexBuilder._storage_context_from_bundle')
+def test_load_prefers_bundle(mock_from_bundle, mock_storage_context_from_defaults, mock_load_idx_from_storage, mock_init_embed, index_builder_config):
+    """Test that load() reads the bundle instead of the loose files when one exists."""
+    open(os.path.join(index_builder_config.storage_dir, index_builder_config.bundle_filename), 'wb').close()
+    mock_bundle_context = MagicMock()
+    mock_from_bundle.return_value = mock_bundle_context
+    mock_load_idx_from_storage.return_value = MagicMock(spec=VectorStoreIndex)
+
+    builder = IndexBuilder(config=index_builder_config)
+    index = builder.load()
+
+    mock_from_bundle.assert_called_once()
+    mock_storage_context_from_defaults.assert_not_called()
+    mock_load_idx_from_storage.assert_called_once_with(mock_bundle_context)
+    assert index is mock_load_idx_from_storage.return_value
+
 def test_persist_no_index(index_builder_config):
     """Test persist raises RuntimeError if index is not built."""
     builder = IndexBuilder(config=index_builder_config)
@@ -224,6 +255,55 @@ def test_get_index_success(index_builder_config):
     builder.index = mock_index
     assert builder.get_index() is mock_index
 
+def test_out_of_core_build_needs_flat_store(index_builder_config):
+    """Test that build_memory_mb is rejected unless the flat vector store is used."""
+    index_builder_config.build_memory_mb = 64
+    with pytest.raises(ValueError, match="build_memory_mb"):
+        IndexBuilder(config=index_builder_config)
+    index_builder_config.vector_store_type = "flat"
+    index_builder_config.locality_order = "cluster"
+    with pytest.raises(ValueError, match="locality_order"):
+        IndexBuilder(config=index_builder_config)
+
+class _TextHashEmbedding(MockEmbedding):
+    """Deterministic embedding that differs between texts."""
+    def _get_vector(self, text: str = "") -> list:
+        return np.random.default_rng(zlib.crc32(text.encode("utf-8"))).standard_normal(self.embed_dim).tolist()
+
+    def _get_text_embedding(self, text: str) -> list:
+        return self._get_vector(text)
+
+    def _get_text_embeddings(self, texts: list) -> list:
+        return [self._get_vector(text) for text in texts]
+
+@patch('src.index_builder.initialize_hf_embedding_model')
+def test_out_of_core_build_persists_same_index(mock_init_embed, index_builder_config, tmp_path):
+    """Test that building with build_memory_mb persists the same vectors, ids and docstore as an in-memory build."""
+    mock_init_embed.side_effect = lambda **kwargs: setattr(Settings, "embed_model", _TextHashEmbedding(embed_dim=8))
+    documents = [
+        Document(text=" ".join(f"word{i}-{j}." for j in range(40)), metadata={"meta": f"m{i % 3}"}, doc_id=f"doc-{i}")
+        for i in range(7)
+    ]
+    persisted = []
+    for build_memory_mb in (0, 1):
+        config = dataclasses.replace(
+            index_builder_config, storage_dir=str(tmp_path / f"memory_{build_memory_mb}"),
+            vector_store_type="flat", build_memory_mb=build_memory_mb, build_batch_documents=2
+        )
+        # Node ids derived from the document, so both builds name their nodes alike
+        splitter = SentenceSplitter(chunk_size=config.chunk_size, chunk_overlap=config.chunk_overlap,
+                                    id_func=lambda i, document: f"{document.doc_id}-{i}")
+        IndexBuilder(config=config, node_parser=splitter).build(documents=documents, force_rebuild=True)
+        views = IndexViews.open(config.storage_dir, config.bundle_filename)
+        with IndexBundle(os.path.join(config.storage_dir, config.bundle_filename)) as bundle:
+            docstore = bundle.read_json("docstore.json")
+        persisted.append((np.array(views.vectors), views.node_ids.tolist(), views.ref_doc_ids.tolist(), docstore))
+        views.close()
+    (vectors, node_ids, ref_doc_ids, docstore), out_of_core = persisted
+    assert len(node_ids) > len(documents)
+    np.testing.assert_array_equal(out_of_core[0], vectors)
+    assert out_of_core[1:] == (node_ids, ref_doc_ids, docstore)
+
 @patch('src.index_builder.os.makedirs') # Mock os.makedirs
 @patch('src.index_builder.initialize_hf_embedding_model')
 @patch('src.index_builder.DocumentLoader')
@@ -271,5 +351,156 @@ def test_build_creates_storage_dir(
     mock_storage_context_from_defaults.assert_not_called()
     mock_load_idx_from_storage.assert_not_called()
 
+@patch('src.index_builder.initialize_hf_embedding_model')
+def test_logged_inserts_are_replayed_until_checkpoint(mock_init_embed, index_builder_config, mock_documents):
+    """Test that load() replays inserts from the write-ahead log and checkpoint() folds them in and empties it."""
+    mock_init_embed.side_effect = lambda **kwargs: setattr(Settings, "embed_model", MockEmbedding(embed_dim=8))
+    index_builder_config.wal_enabled = True
+    index_builder_config.wal_sync = "fsync"
+    builder = IndexBuilder(config=index_builder_config)
+    builder.build(documents=mock_documents)
+    builder.insert_nodes([TextNode(text="Logged node", id_="node-logged")])
+    builder.wal.close()
+
+    reloaded = IndexBuilder(config=index_builder_config)
+    reloaded.load()
+    assert "node-logged" in reloaded.index.docstore.docs
+    assert reloaded.wal.records_since_checkpoint == 1
+    reloaded.checkpoint()
+    assert list(reloaded.wal.records()) == [] and reloaded.wal.records_since_checkpoint == 0
+    reloaded.wal.close()
+
+    checkpointed = IndexBuilder(config=index_builder_config)
+    checkpointed.load()
+    # Now part of the persisted index, with nothing left to replay
+    assert "node-logged" in checkpointed.index.docstore.docs
+    assert checkpointed.replay_wal() == 0
+    checkpointed.wal.close()
+
+@patch('src.index_builder.initialize_hf_embedding_model')
+def test_checkpoint_extends_derived_structures(mock_init_embed, index_builder_config):
+    """Test that checkpoint() adds logged nodes to the metadata columns and title index without rebuilding them."""
+    mock_init_embed.side_effect = lambda **kwargs: setattr(Settings, "embed_model", MockEmbedding(embed_dim=8))
+    index_builder_config.vector_store_type = "flat"
+    index_builder_config.wal_enabled = True
+    index_builder_config.metadata_column_fields = ["year"]
+    index_builder_config.title_index_enabled = True
+    builder = IndexBuilder(config=index_builder_config)
+    builder.build(documents=[Document(text="Body", metadata={"title": "Graph Networks", "year": "2020"}, id_="doc-1")])
+    builder.insert_nodes([TextNode(text="Logged node", id_="node-logged", metadata={"title": "Sparse Attention", "year": "2024"})])
+    with patch.object(IndexBuilder, "build_metadata_columns", side_effect=AssertionError("rebuilt")), \
+            patch.object(IndexBuilder, "build_title_index", side_effect=AssertionError("rebuilt")):
+        builder.checkpoint()
+    assert decode_ids(builder.metadata_columns.node_ids) == builder.index.vector_store.node_ids
+    assert builder.metadata_columns.values("year").tolist() == ["2020", "2024"]
+    assert builder.search_titles("sparse") == ["node-logged"]
+    assert builder.search_titles("graph") == ["doc-1"]
+    builder.delete_ref_doc("doc-1")
+    builder.checkpoint()
+    assert builder.search_titles("graph") == []
+    assert builder.metadata_columns.values("year").tolist() == ["2024"]
+    builder.wal.close()
+
+def test_add_segment_needs_loaded_flat_index(index_builder_config, mock_documents):
+    """Test that segments are only added next to a loaded index with the flat vector store."""
+    builder = IndexBuilder(config=index_builder_config)
+    with pytest.raises(RuntimeError, match="Build or load"):
+        builder.add_segment(mock_documents)
+    builder.index = MagicMock(spec=VectorStoreIndex)
+    with pytest.raises(ValueError, match="flat"):
+        builder.add_segment(mock_documents)
+    assert builder.live_segments() == []
+    assert builder.merge_segments() == 0
+
+def test_flat_store_search_ids_match_scored_rows_during_inserts():
+    """Test that FlatVectorStore.search returns the ids of the rows it scored while another thread inserts."""
+    store = FlatVectorStore()
+    store.add([TextNode(text="", id_="node-1", embedding=[1.0, 0.0])])
+    def insert():
+        for i in range(2, 500):
+            store.add([TextNode(text="", id_=f"node-{i}", embedding=[float(i), 0.0])])
+    inserter = threading.Thread(target=insert)
+    inserter.start()
+    try:
+        while inserter.is_alive():
+            hits = store.search([1.0, 0.0], 3)
+            # Each node's score is its number
+            assert hits.node_ids == [f"node-{int(score)}" for score in hits.scores]
+    finally:
+        inserter.join()
+    assert store.search([1.0, 0.0], 1).node_ids == ["node-499"]
+
+@patch('src.index_builder.initialize_hf_embedding_model')
+def test_search_while_segments_merge(mock_init_embed, index_builder_config, mock_documents):
+    """Test that searches running while merge_segments inserts into the index see consistent rows."""
+    mock_init_embed.side_effect = lambda **kwargs: setattr(Settings, "embed_model", MockEmbedding(embed_dim=8))
+    index_builder_config.vector_store_type = "flat"
+    builder = IndexBuilder(config=index_builder_config)
+    builder.build(documents=mock_documents)
+    for i in range(3):
+        builder.add_segment([Document(text=f"Segment doc {i}", id_=f"segment-doc-{i}")])
+    store = builder.index.vector_store
+    errors, sizes = [], []
+    done = threading.Event()
+    def search():
+        while not done.is_set():
+            try:
+                hits = store.search(np.ones(8, dtype=np.float32), 100)
+                assert hits.node_ids == [hits.snapshot.node_ids[row] for row in hits.rows]
+                assert len(hits.node_ids) == len(hits.snapshot.vectors) == len(hits.snapshot.node_ids)
+                # Every row found is already in the docstore
+                builder.index.docstore.get_nodes(hits.node_ids)
+                sizes.append(len(hits.node_ids))
+            except Exception as e:
+                errors.append(e)
+                return
+    searcher = threading.Thread(target=search)
+    searcher.start()
+    try:
+        assert builder.merge_segments() == 3
+    finally:
+        done.set()
+        searcher.join()
+    assert not errors
+    # Merging only adds rows
+    assert sizes and sizes == sorted(sizes)
+    assert len(store.search(np.ones(8, dtype=np.float32), 100).node_ids) == len(store) == 5
+
+@patch('src.index_builder.embed_token_ids')
+@patch('src.index_builder.tokenize_with_offsets')
+def test_chunk_with_token_cache_reuses_token_ids(mock_tokenize, mock_embed, index_builder_config):
+    """Test token-count chunking from the token cache, and that a second build tokenizes nothing."""
+    index_builder_config.chunk_size = 8
+    index_builder_config.chunk_overlap = 2
+    index_builder_config.token_cache_enabled = True
+    # One token per word, starting where the word does
+    mock_tokenize.side_effect = lambda model, texts: [
+        (np.arange(len(text.split()), dtype=np.uint32) + 100, np.array([m.start() for m in re.finditer(r"\S+", text)], dtype=np.uint32))
+        for text in texts
+    ]
+    mock_embed.side_effect = lambda model, sequences: [[float(len(sequence))] for sequence in sequences]
+    builder = IndexBuilder(config=index_builder_config)
+    documents = [Document(text=" ".join(f"w{i}" for i in range(20)), metadata={"title": "T"}, doc_id="doc-1")]
+
+    nodes = builder.chunk_with_token_cache(documents)
+    # "title: T" takes 2 of the 8 tokens, leaving windows of 6 words overlapping by 2
+    assert [node.text for node in nodes] == [
+        " ".join(f"w{i}" for i in range(start, min(start + 6, 20))) for start in (0, 4, 8, 12, 16)
+    ]
+    assert all(node.ref_doc_id == "doc-1" for node in nodes)
+    assert [node.embedding for node in nodes] == [[8.0], [8.0], [8.0], [8.0], [6.0]]
+    assert nodes[1].prev_node.node_id == nodes[0].node_id
+    tokenize_calls = mock_tokenize.call_count
+    builder.chunk_with_token_cache(documents)
+    assert mock_tokenize.call_count == tokenize_calls
+
+def test_token_cache_needs_in_process_build(index_builder_config):
+    """Test that the token cache is rejected together with the out-of-core build."""
+    index_builder_config.vector_store_type = "flat"
+    index_builder_config.build_memory_mb = 64
+    index_builder_config.token_cache_enabled = True
+    with pytest.raises(ValueError, match="token_cache_enabled"):
+        IndexBuilder(config=index_builder_config)
+
 if __name__ == "__main__":
-    unittest.main() 
\ No newline at end of file
+    unittest.main() 
@@ -6,6 +6,7 @@ import yaml
 
 from src.config_loader import AppConfig, IndexBuilderConfig, QueryEngineBuilderConfig
 from src.index_builder import IndexBuilder
+from src.index_bundle import IndexBundle
 from src.query_engine_builder import QueryEngineBuilder
 from llama_index.core.base.response.schema import Response
 from llama_index.core import Settings
@@ -60,12 +61,14 @@ def test_build_and_query_end_to_end(temp_index_storage_dir):
     assert index is not None
     print("Index built successfully.")
 
-    # Check if index files were created
-    assert os.path.exists(os.path.join(index_builder_cfg.storage_dir, index_builder_cfg.docstore_filename))
-    # For the default SimpleVectorStore, LlamaIndex persists it as default__vector_store.json
-    expected_vector_store_filename = "default__vector_store.json" 
-    assert os.path.exists(os.path.join(index_builder_cfg.storage_dir, expected_vector_store_filename))
-    assert os.path.exists(os.path.join(index_builder_cfg.storage_dir, index_builder_cfg.index_store_filename))
+    # Check if index files were packed into the bundle, without loose copies left next to it
+    with IndexBundle(os.path.join(index_builder_cfg.storage_dir, index_builder_cfg.bundle_filename)) as bundle:
+        assert index_builder_cfg.docstore_filename in bundle
+        # For the default SimpleVectorStore, LlamaIndex persists it as default__vector_store.json
+        expected_vector_store_filename = "default__vector_store.json"
+        assert expected_vector_store_filename in bundle
+        assert index_builder_cfg.index_store_filename in bundle
+    assert not os.path.exists(os.path.join(index_builder_cfg.storage_dir, index_builder_cfg.docstore_filename))
     print("Index files found on disk.")
 
     # 2. Build the Query Engine
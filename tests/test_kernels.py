@@ -0,0 +1,157 @@
+import asyncio
+import threading
+
+import numpy as np
+import pytest
+
+from src import kernels
+from src.kernels import decode_vectors, encode_vectors, flat_scores, top_k_indices
+
+@pytest.fixture
+def embeddings():
+    rng = np.random.default_rng(0)
+    vectors = rng.standard_normal((3000, 100), dtype=np.float32)  # odd dim exercises the SIMD tail
+    return vectors / np.linalg.norm(vectors, axis=1, keepdims=True)
+
+@pytest.mark.parametrize("dtype", ["float16", "bfloat16"])
+def test_encode_decode_roundtrip(embeddings, dtype):
+    """Half-width storage halves the bytes and stays within the format's precision."""
+    stored = encode_vectors(embeddings, dtype)
+    assert stored.nbytes == embeddings.nbytes // 2
+    tolerance = 1e-3 if dtype == "float16" else 8e-3
+    np.testing.assert_allclose(decode_vectors(stored, dtype), embeddings, atol=tolerance)
+
+def test_bfloat16_rounds_to_nearest_even():
+    values = np.array([1.0, 1.0 + 2**-8, 1.0 + 3 * 2**-8], dtype=np.float32)
+    decoded = decode_vectors(encode_vectors(values, "bfloat16"), "bfloat16")
+    assert decoded.tolist() == [1.0, 1.0, 1.0 + 2**-6]
+
+@pytest.mark.parametrize("dtype", ["float16", "bfloat16"])
+def test_flat_scores_match_float32(embeddings, dtype, monkeypatch):
+    """Native and NumPy scan paths agree with a float32 scan of the decoded matrix."""
+    stored = encode_vectors(embeddings, dtype)
+    query = embeddings[7]
+    expected = decode_vectors(stored, dtype) @ query
+    np.testing.assert_allclose(flat_scores(stored, query, dtype, block_rows=512), expected, atol=1e-5)
+    monkeypatch.setattr(kernels, "_native", None)
+    np.testing.assert_allclose(flat_scores(stored, query, dtype, block_rows=512), expected, atol=1e-5)
+
+def test_top_k_indices_orders_and_masks():
+    scores = np.array([0.1, 0.9, 0.5, 0.7], dtype=np.float32)
+    rows, top = top_k_indices(scores, 2)
+    assert rows.tolist() == [1, 3]
+    assert top.tolist() == pytest.approx([0.9, 0.7])
+    rows, _ = top_k_indices(scores, 10, mask=np.array([True, False, True, False]))
+    assert rows.tolist() == [2, 0]
+
+def test_maxsim_scores_native_and_numpy_agree(monkeypatch):
+    """Each document scores the sum over query tokens of its best token match; empty documents score 0."""
+    rng = np.random.default_rng(2)
+    query = rng.standard_normal((5, 24), dtype=np.float32)
+    tokens = rng.standard_normal((40, 24), dtype=np.float32)
+    offsets = np.array([0, 10, 10, 33, 40])
+    expected = [(query @ tokens[a:b].T).max(axis=1).sum() if b > a else 0.0 for a, b in zip(offsets[:-1], offsets[1:])]
+    np.testing.assert_allclose(kernels.maxsim_scores(query, tokens, offsets), expected, rtol=1e-5)
+    monkeypatch.setattr(kernels, "_native", None)
+    np.testing.assert_allclose(kernels.maxsim_scores(query, tokens, offsets), expected, rtol=1e-5)
+
+@pytest.mark.parametrize("native", [True, False])
+def test_facet_counts_match_bincount(native, monkeypatch):
+    if native and not kernels.native_kernels_available():
+        pytest.skip("native kernels not built")
+    if not native:
+        monkeypatch.setattr(kernels, "_native", None)
+    rng = np.random.default_rng(5)
+    codes = rng.integers(-1, 7, 1003).astype(np.int32)
+    rows = rng.choice(1003, 301, replace=False)
+    expected = np.bincount(codes[rows][codes[rows] >= 0], minlength=7)
+    assert kernels.facet_counts(codes, rows, 7).tolist() == expected.tolist()
+    assert kernels.facet_counts(codes, None, 7).tolist() == np.bincount(codes[codes >= 0], minlength=7).tolist()
+
+@pytest.mark.parametrize("dtype", ["float32", "bfloat16"])
+def test_masked_top_k_skips_blocks_without_allowed_rows(embeddings, dtype):
+    stored = encode_vectors(embeddings, dtype)
+    query = embeddings[11]
+    clustered = np.zeros(len(embeddings), dtype=bool)
+    clustered[600:900] = True
+    scattered = np.zeros(len(embeddings), dtype=bool)
+    scattered[::10] = True
+    for mask in (clustered, scattered, np.zeros(len(embeddings), dtype=bool)):
+        expected = top_k_indices(flat_scores(stored, query, dtype), 10, mask=mask)
+        before = kernels.counters.rows_scanned
+        rows, scores = kernels.flat_top_k(stored, query, dtype, 10, mask=mask)
+        scanned = kernels.counters.rows_scanned - before
+        assert rows.tolist() == expected[0].tolist()
+        np.testing.assert_allclose(scores, expected[1], atol=1e-6)
+        if mask is clustered:
+            # Rows 600-899 lie in blocks 512-767 and 768-1023
+            assert kernels.masked_row_ranges(mask) == [(512, 1024)]
+            assert scanned == 512
+        elif mask is scattered:
+            assert scanned == len(embeddings)
+
+def test_flat_top_k_with_candidates():
+    rng = np.random.default_rng(6)
+    matrix = rng.standard_normal((500, 16), dtype=np.float32)
+    query = rng.standard_normal(16, dtype=np.float32)
+    scores = matrix @ query
+    rows, top_scores, candidates = kernels.flat_top_k_with_candidates(matrix, query, "float32", 5, 50)
+    assert rows.tolist() == kernels.top_k_indices(scores, 5)[0].tolist()
+    assert candidates[:5].tolist() == rows.tolist() and len(candidates) == 50
+    _, _, above = kernels.flat_top_k_with_candidates(matrix, query, "float32", 5, 50, min_score=1.0)
+    assert sorted(above.tolist()) == np.flatnonzero(scores >= 1.0).tolist()
+
+@pytest.mark.parametrize("dtype", ["float32", "float16"])
+def test_feedback_top_k_rescores_only_first_pass_rows(dtype):
+    rng = np.random.default_rng(8)
+    matrix = rng.standard_normal((300, 16), dtype=np.float32)
+    matrix /= np.linalg.norm(matrix, axis=1, keepdims=True)
+    query = matrix[0] + 0.1 * rng.standard_normal(16, dtype=np.float32)
+    stored = encode_vectors(matrix, dtype)
+    pool, _ = kernels.flat_top_k(stored, query, dtype, 40)
+    rows, scores = kernels.feedback_top_k(stored, query, dtype, pool, 5, 3, 1.0, 0.75)
+    assert set(rows.tolist()) <= set(pool.tolist()) and len(rows) == 5
+    refined = kernels.rocchio_query(query, decode_vectors(stored[pool[:3]], dtype), 1.0, 0.75)
+    assert np.isclose(np.linalg.norm(refined), 1.0)
+    expected = decode_vectors(stored[pool], dtype) @ refined
+    np.testing.assert_allclose(scores, np.sort(expected)[::-1][:5], rtol=1e-3, atol=1e-3)
+    # beta = 0 leaves the ranking of the pool unchanged
+    rows, _ = kernels.feedback_top_k(stored, query, dtype, pool, 5, 3, 1.0, 0.0)
+    assert rows.tolist() == pool[:5].tolist()
+    assert len(kernels.feedback_top_k(stored, query, dtype, pool[:0], 5, 3, 1.0, 0.75)[0]) == 0
+
+def test_qgram_candidates_native_and_numpy_agree(monkeypatch):
+    if not kernels.native_kernels_available():
+        pytest.skip("native kernels not built")
+    rng = np.random.default_rng(7)
+    # 40 grams with postings over 200 titles
+    counts = rng.integers(0, 30, 40)
+    gram_offsets = np.concatenate([[0], np.cumsum(counts)]).astype(np.int64)
+    post_rows = rng.integers(0, 200, gram_offsets[-1]).astype(np.int32)
+    post_pos = rng.integers(0, 12, gram_offsets[-1]).astype(np.int32)
+    slots = rng.choice(40, 10, replace=False)
+    positions = np.arange(10)
+    native = kernels.qgram_candidates(post_rows, post_pos, gram_offsets, slots, positions, 200, 3, 1, 50)
+    monkeypatch.setattr(kernels, "_native", None)
+    fallback = kernels.qgram_candidates(post_rows, post_pos, gram_offsets, slots, positions, 200, 3, 1, 50)
+    assert len(native[0]) > 0
+    assert native[0].tolist() == fallback[0].tolist()
+    assert native[1].tolist() == fallback[1].tolist()
+
+def test_run_native_completes_on_the_pool(embeddings):
+    stored = encode_vectors(embeddings, "float16")
+    expected = kernels.flat_top_k(stored, embeddings[3], "float16", 5)
+
+    async def search_concurrently():
+        calls = [kernels.run_native(lambda q: (threading.current_thread().name, kernels.flat_top_k(stored, q, "float16", 5)), embeddings[3])
+                 for _ in range(8)]
+        return await asyncio.gather(*calls)
+
+    kernels.configure_native_pool(2)
+    try:
+        results = asyncio.run(search_concurrently())
+    finally:
+        kernels.configure_native_pool(0)
+    assert all(name.startswith("native") for name, _ in results)
+    for _, (rows, scores) in results:
+        assert rows.tolist() == expected[0].tolist()
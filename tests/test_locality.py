@@ -0,0 +1,42 @@
+import numpy as np
+import pytest
+
+from src import kernels
+from src.locality import chain_order, cluster_order, describe_order, locality_order, metadata_order
+
+def test_metadata_order_sorts_by_fields_with_missing_values_last():
+    metadata = [
+        {"year": "2021", "booktitle": "ACL"},
+        {"year": "2020", "booktitle": "EMNLP"},
+        {"booktitle": "ACL"},
+        {"year": "2020", "booktitle": "ACL"},
+        {"year": "2021", "booktitle": "ACL"},
+    ]
+    assert metadata_order(metadata, ["year", "booktitle"]).tolist() == [3, 1, 0, 4, 2]
+    assert describe_order("metadata", ["year", "booktitle"]) == "metadata:year,booktitle"
+
+def test_cluster_order_groups_rows_of_a_topic():
+    rng = np.random.default_rng(0)
+    topics = rng.standard_normal((8, 64), dtype=np.float32)
+    labels = rng.integers(0, 8, size=2000)
+    vectors = topics[labels] + 0.05 * rng.standard_normal((2000, 64), dtype=np.float32)
+    vectors /= np.linalg.norm(vectors, axis=1, keepdims=True)
+    stored = kernels.encode_vectors(vectors, "float16")
+    order = cluster_order(stored, "float16", num_clusters=32)
+    assert sorted(order.tolist()) == list(range(2000))
+    # A topic's rows form a few contiguous runs (at most one per cluster) instead of ~1750 in corpus order
+    runs = 1 + int(np.count_nonzero(np.diff(labels[order])))
+    assert runs <= 32
+
+def test_chain_order_visits_every_centroid_once():
+    centroids = np.eye(5, dtype=np.float32)
+    assert sorted(chain_order(centroids).tolist()) == list(range(5))
+
+def test_locality_order_strategies():
+    matrix = np.eye(4, dtype=np.float32)
+    assert locality_order("", matrix, "float32") is None
+    assert locality_order("metadata", matrix, "float32", metadata=[{"y": v} for v in "dcba"], fields=["y"]).tolist() == [3, 2, 1, 0]
+    with pytest.raises(ValueError):
+        locality_order("metadata", matrix, "float32")
+    with pytest.raises(ValueError):
+        locality_order("hilbert", matrix, "float32")
@@ -0,0 +1,87 @@
+import numpy as np
+import pytest
+
+from src.index_bundle import IndexBundle, write_bundle_from_dir
+from src.kernels import maxsim_scores, top_k_indices
+from src.multivector import MultiVectorIndex, ResidualCodec
+
+@pytest.fixture
+def token_sets():
+    """Documents whose tokens cluster around a few shared topics."""
+    rng = np.random.default_rng(0)
+    topics = rng.standard_normal((20, 64), dtype=np.float32)
+    sets = []
+    for _ in range(120):
+        n_tokens = int(rng.integers(5, 30))
+        tokens = topics[rng.choice(20, n_tokens)] + 0.3 * rng.standard_normal((n_tokens, 64), dtype=np.float32)
+        sets.append(tokens / np.linalg.norm(tokens, axis=1, keepdims=True))
+    return sets
+
+@pytest.fixture
+def index(token_sets):
+    return MultiVectorIndex.build([f"node-{i}" for i in range(len(token_sets))], token_sets, residual_bits=4, num_centroids=32)
+
+@pytest.mark.parametrize("bits", [1, 2, 4, 8])
+def test_residual_codec_roundtrip(bits):
+    """Packed codes use bits/8 bytes per dimension and more bits give a closer reconstruction."""
+    residuals = np.random.default_rng(1).normal(0, 0.1, (50, 64)).astype(np.float32)
+    codec = ResidualCodec.train(residuals, bits)
+    packed = codec.encode(residuals)
+    assert packed.shape == (50, 64 * bits // 8)
+    error = np.abs(codec.decode(packed) - residuals).mean()
+    assert error < 0.1 / bits
+
+def test_decompress_is_close_to_original(index, token_sets):
+    tokens, offsets = index.decompress(np.array([3, 7]))
+    original = np.concatenate([token_sets[3], token_sets[7]])
+    assert offsets.tolist() == [0, len(token_sets[3]), len(original)]
+    assert np.mean(np.sum(tokens * original, axis=1)) > 0.95
+
+def test_search_matches_exact_maxsim(index, token_sets):
+    """With every centroid probed, compressed search ranks like exact MaxSim on the originals."""
+    query = token_sets[10][:8]
+    rows, scores = index.search(query, top_k=5, nprobe=len(index.centroids), candidates=len(index))
+    exact, _ = top_k_indices(maxsim_scores(query, np.concatenate(token_sets), index.doc_offsets), 5)
+    assert rows[0] == 10
+    assert len(set(rows.tolist()) & set(exact.tolist())) >= 4
+    assert np.all(np.diff(scores) <= 0)
+
+def test_search_respects_mask(index, token_sets):
+    mask = np.zeros(len(index), dtype=bool)
+    mask[[1, 2, 3]] = True
+    rows, _ = index.search(token_sets[10][:8], top_k=5, nprobe=len(index.centroids), mask=mask)
+    assert set(rows.tolist()) <= {1, 2, 3}
+
+def test_updated_encodes_only_added_nodes(token_sets):
+    """Kept nodes keep their encoded tokens, added ones are searchable, removed ones are gone."""
+    base = MultiVectorIndex.build([f"node-{i}" for i in range(100)], token_sets[:100], residual_bits=4, num_centroids=32)
+    node_ids = [f"node-{i}" for i in range(120) if i != 7]
+    updated = base.updated(node_ids, {f"node-{i}": token_sets[i] for i in range(100, 120)})
+    assert updated.node_ids == node_ids and len(updated) == 119
+    assert updated.centroids is base.centroids
+    # node-10 moved up a row after node-7
+    kept, _ = updated.decompress(np.array([0, 9]))
+    assert np.array_equal(kept, base.decompress(np.array([0, 10]))[0])
+
+    added, offsets = updated.decompress(np.array([node_ids.index("node-110")]))
+    assert offsets[-1] == len(token_sets[110])
+    assert np.mean(np.sum(added * token_sets[110], axis=1)) > 0.95
+    rows, _ = updated.search(token_sets[110][:8], top_k=3, nprobe=4)
+    assert updated.node_ids[rows[0]] == "node-110"
+    # Posting lists cover exactly the rows of the updated index
+    assert set(updated.ivf_docs.tolist()) == set(range(len(updated)))
+
+def test_save_load_and_bundle(index, token_sets, tmp_path):
+    index.save(str(tmp_path))
+    assert MultiVectorIndex.exists(str(tmp_path))
+    query = token_sets[4][:6]
+    expected = index.search(query, top_k=3)[0].tolist()
+
+    loaded = MultiVectorIndex.load(str(tmp_path))
+    assert loaded.node_ids == index.node_ids
+    assert loaded.search(query, top_k=3)[0].tolist() == expected
+
+    write_bundle_from_dir(str(tmp_path), str(tmp_path / "index.bundle"))
+    with IndexBundle(str(tmp_path / "index.bundle")) as bundle:
+        bundled = MultiVectorIndex.from_bundle(bundle)
+        assert bundled.search(query, top_k=3)[0].tolist() == expected
@@ -0,0 +1,46 @@
+import json
+
+import numpy as np
+
+from src import kernels
+from src.multivector import MultiVectorIndex
+from src.profiling import QueryProfile
+
+def test_stages_accumulate_and_render_as_json():
+    profile = QueryProfile()
+    with profile.stage("search"):
+        pass
+    with profile.stage("search"):
+        pass
+    profile.count("candidates_scored", 3)
+    profile.count("candidates_scored", 2)
+    profile.set("filter_selectivity", 0.25)
+    profile.finish()
+
+    rendered = json.loads(profile.to_json())
+    assert set(rendered["stages_ms"]) == {"search"}
+    assert rendered["counters"] == {"candidates_scored": 5, "filter_selectivity": 0.25}
+    assert rendered["total_ms"] >= rendered["stages_ms"]["search"]
+
+def test_kernel_counters_attribute_work():
+    """Counter snapshots taken around a scan give rows scanned and distance computations."""
+    matrix = np.ones((300, 8), dtype=np.float32)
+    before = kernels.counters.snapshot()
+    kernels.flat_scores(matrix, np.ones(8, dtype=np.float32), "float32")
+    kernels.maxsim_scores(np.ones((2, 8), dtype=np.float32), matrix[:10], np.array([0, 4, 10]))
+
+    profile = QueryProfile()
+    profile.add_counter_deltas(before, kernels.counters.snapshot())
+    assert profile.counters == {"rows_scanned": 300, "distance_computations": 300 + 2 * 10}
+
+def test_multivector_search_reports_candidates_and_selectivity():
+    rng = np.random.default_rng(0)
+    token_sets = [rng.standard_normal((4, 16), dtype=np.float32) for _ in range(50)]
+    index = MultiVectorIndex.build([str(i) for i in range(50)], token_sets, residual_bits=8, num_centroids=8)
+    mask = np.arange(50) < 10
+
+    profile = QueryProfile()
+    index.search(token_sets[0], top_k=3, nprobe=8, mask=mask, profile=profile)
+    assert profile.counters["candidates_generated"] == 50
+    assert profile.counters["candidates_scored"] == 10
+    assert profile.counters["filter_selectivity"] == 0.2
@@ -0,0 +1,109 @@
+import threading
+import time
+
+import numpy as np
+import pytest
+
+from src.deadlines import QueryRejected
+from src.query_log import QueryLog, QueryRecord, latency_summary, read_query_log, replay
+
+def test_log_round_trips_records_from_many_threads(tmp_path):
+    path = str(tmp_path / "logs" / "queries.ndjson")
+    log = QueryLog(path, flush_every=7)
+
+    def write(worker: int):
+        for i in range(50):
+            log.write(QueryRecord(ts=1000.0 + i, query=f"query \"{worker}\" é {i}\n", latency_ms=float(i), deadline_ms=25.0))
+
+    threads = [threading.Thread(target=write, args=(worker,)) for worker in range(4)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    log.close()
+    records = list(read_query_log(path))
+    assert len(records) == 200
+    assert sorted(r.query for r in records) == sorted(f"query \"{w}\" é {i}\n" for w in range(4) for i in range(50))
+    assert all(r.deadline_ms == 25.0 and r.status == "ok" for r in records)
+
+    # The log is appended to, and a line torn by a crash is skipped
+    log = QueryLog(path)
+    log.write(QueryRecord(ts=2000.0, query="last", latency_ms=1.0, status="rejected"))
+    log.close()
+    with open(path, "ab") as f:
+        f.write(b'{"ts": 2001.0, "query": "tor')
+    records = list(read_query_log(path))
+    assert len(records) == 201 and records[-1].query == "last" and records[-1].status == "rejected"
+
+def test_latency_summary():
+    summary = latency_summary(np.arange(1, 101, dtype=np.float64))
+    assert summary["max"] == 100 and summary["mean"] == 50.5
+    assert summary["p50"] == pytest.approx(50.5) and summary["p99"] == pytest.approx(99.01)
+    assert latency_summary([]) == {}
+
+def _records(count: int, spacing_s: float):
+    return [QueryRecord(ts=100.0 + i * spacing_s, query=f"q{i}", latency_ms=1.0) for i in range(count)]
+
+def test_replay_follows_the_scaled_schedule():
+    sent = []
+
+    def run_query(record):
+        sent.append((record.query, time.perf_counter()))
+        return record.query == "q3"
+
+    start = time.perf_counter()
+    result = replay(_records(6, 0.05), run_query, speed=2.0, concurrency=2)
+    # 5 gaps of 50 ms at twice the recorded rate
+    assert 0.12 <= sent[-1][1] - start < 0.5
+    assert [query for query, _ in sent] == [f"q{i}" for i in range(6)]
+    summary = result.summary()
+    assert summary["queries"] == 6 and summary["ok"] == 6 and summary["partial"] == 1
+
+    sent.clear()
+    start = time.perf_counter()
+    replay(_records(6, 10.0), run_query, speed=0, concurrency=2)
+    assert sent[-1][1] - start < 1.0
+
+def test_replay_sends_in_arrival_order():
+    # Written as queries completed: a slow first query is logged after faster later ones
+    records = _records(5, 0.04)
+    records = records[2:] + records[:2]
+    sent = []
+
+    def run_query(record):
+        sent.append((record.query, time.perf_counter()))
+        return False
+
+    start = time.perf_counter()
+    result = replay(records, run_query, speed=1.0, concurrency=1)
+    assert [query for query, _ in sent] == [f"q{i}" for i in range(5)]
+    # The earliest arrival goes first and the span of 4 gaps is kept, not compressed or shifted negative
+    assert sent[0][1] - start < 0.03
+    assert 0.14 <= sent[-1][1] - sent[0][1] < 0.5
+    assert result.summary()["queries"] == 5
+
+def test_replay_counts_queueing_and_failures():
+    active, peak = [0], [0]
+    lock = threading.Lock()
+
+    def run_query(record):
+        with lock:
+            active[0] += 1
+            peak[0] = max(peak[0], active[0])
+        time.sleep(0.05)
+        with lock:
+            active[0] -= 1
+        if record.query == "q1":
+            raise QueryRejected("over budget")
+        if record.query == "q2":
+            raise RuntimeError("boom")
+        return False
+
+    # Eight queries sent at once through one worker: later ones wait for earlier ones
+    result = replay(_records(8, 0.0), run_query, speed=1.0, concurrency=1)
+    assert peak[0] == 1
+    assert result.statuses[:3] == ["ok", "rejected", "error"] and "boom" in result.errors[0]
+    assert result.latencies_ms[-1] >= 7 * 50 * 0.9
+    assert np.all(result.service_ms < result.latencies_ms[-1])
+    summary = result.summary()
+    assert summary["ok"] == 6 and summary["rejected"] == 1 and summary["errors"] == 1
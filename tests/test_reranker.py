@@ -0,0 +1,92 @@
+import time
+import asyncio
+
+import numpy as np
+import pytest
+from llama_index.core.schema import NodeWithScore, QueryBundle, TextNode
+
+from src.reranker import CrossEncoder, CrossEncoderReranker, length_buckets
+
+class FakeEncoder:
+    """Scores a pair by how often the query word occurs in the text; optionally slow."""
+    def __init__(self, seconds_per_batch=0.0):
+        self.seconds_per_batch = seconds_per_batch
+        self.batches = []
+
+    def tokenize(self, query, texts):
+        return [{"input_ids": [len(query)] + [hash(w) % 1000 for w in text.split()], "query": query, "text": text} for text in texts]
+
+    def score(self, pairs):
+        self.batches.append(len(pairs))
+        time.sleep(self.seconds_per_batch)
+        return np.array([pair["text"].split().count(pair["query"]) for pair in pairs], dtype=np.float32)
+
+def _nodes(texts):
+    return [NodeWithScore(node=TextNode(text=text, id_=f"n{i}"), score=1.0 - i * 0.1) for i, text in enumerate(texts)]
+
+def test_length_buckets_group_similar_lengths_best_ranked_first():
+    lengths = [50, 3, 48, 4, 49, 5]
+    batches = length_buckets(lengths, 2)
+    assert [sorted(batch.tolist()) for batch in batches] == [[0, 4], [1, 3], [2, 5]]
+    assert sorted(np.concatenate(batches).tolist()) == list(range(6))
+
+def test_reranker_orders_by_cross_encoder_score():
+    nodes = _nodes(["a b", "x x x", "x", "x x"])
+    reranker = CrossEncoderReranker(FakeEncoder(), top_n=3, batch_size=2)
+    result = reranker.postprocess_nodes(nodes, query_bundle=QueryBundle("x"))
+    assert [n.node.node_id for n in result] == ["n1", "n3", "n2"]
+    assert [n.score for n in result] == [3.0, 2.0, 1.0]
+    assert reranker.last_run["scored"] == 4 and not reranker.last_run["partial"]
+
+def test_awaitable_rerank_runs_on_the_native_pool():
+    nodes = _nodes(["a b", "x x x", "x", "x x"])
+    reranker = CrossEncoderReranker(FakeEncoder(), top_n=3, batch_size=2)
+    result = asyncio.run(reranker._apostprocess_nodes(nodes, query_bundle=QueryBundle("x")))
+    assert [n.node.node_id for n in result] == ["n1", "n3", "n2"]
+
+def test_budget_stops_scoring_and_keeps_retrieval_order_for_the_rest():
+    encoder = FakeEncoder(seconds_per_batch=0.02)
+    nodes = _nodes([" ".join(["y"] * (i + 1)) + " x" * i for i in range(8)])
+    reranker = CrossEncoderReranker(encoder, top_n=8, batch_size=2, budget_ms=30)
+    result = reranker.postprocess_nodes(nodes, query_bundle=QueryBundle("x"))
+    assert reranker.last_run["partial"]
+    scored = reranker.last_run["scored"]
+    assert 0 < scored < 8
+    # Unscored candidates follow, in their original order
+    rest = [n.node.node_id for n in result[scored:]]
+    assert rest == sorted(rest, key=lambda node_id: int(node_id[1:]))
+    assert reranker.ms_per_token is not None
+
+    # With a cost estimate, the next query only admits what fits the budget
+    encoder.batches.clear()
+    reranker.postprocess_nodes(nodes, query_bundle=QueryBundle("x"))
+    assert sum(encoder.batches) < 8
+
+def test_random_weight_cross_encoder_scores_are_padding_invariant(tmp_path):
+    pytest.importorskip("transformers")
+    import torch
+    from transformers import BertConfig, BertForSequenceClassification, BertTokenizerFast
+
+    words = ["neural", "machine", "translation", "parsing", "speech", "attention", "model", "data"]
+    vocab = tmp_path / "vocab.txt"
+    vocab.write_text("\n".join(["[PAD]", "[UNK]", "[CLS]", "[SEP]", "[MASK]"] + words) + "\n")
+    tokenizer = BertTokenizerFast(vocab_file=str(vocab))
+    torch.manual_seed(0)
+    model = BertForSequenceClassification(BertConfig(
+        vocab_size=len(words) + 5, hidden_size=32, num_hidden_layers=2, num_attention_heads=2,
+        intermediate_size=64, num_labels=1
+    ))
+    encoder = CrossEncoder(model, tokenizer, max_length=32)
+    pairs = encoder.tokenize("neural translation", ["machine translation", "speech attention model data parsing", "data"])
+    together = encoder.score(pairs)
+    alone = np.array([encoder.score([pair])[0] for pair in pairs])
+    np.testing.assert_allclose(together, alone, atol=1e-5)
+
+    encoder.quantize_int8()
+    quantized = encoder.score(pairs)
+    assert quantized.shape == (3,) and np.all(np.isfinite(quantized))
+
+    reranker = CrossEncoderReranker(encoder, top_n=2, batch_size=2)
+    result = reranker.postprocess_nodes(_nodes(["machine translation", "speech attention model data parsing", "data"]),
+                                        query_bundle=QueryBundle("neural translation"))
+    assert len(result) == 2
@@ -0,0 +1,28 @@
+import numpy as np
+import pytest
+
+from src.retrieval_metrics import exact_top_k, recall_at_k
+
+def test_exact_top_k_orders_by_score():
+    """Neighbours come back best first, by dot product."""
+    corpus = np.array([[1.0, 0.0], [0.0, 1.0], [0.7, 0.7]], dtype=np.float32)
+    queries = np.array([[1.0, 0.1], [0.0, 1.0]], dtype=np.float32)
+
+    top = exact_top_k(queries, corpus, k=2)
+
+    assert top.tolist() == [[0, 2], [1, 2]]
+
+def test_exact_top_k_caps_k_at_corpus_size():
+    corpus = np.eye(3, dtype=np.float32)
+    assert exact_top_k(corpus[:1], corpus, k=10).shape == (1, 3)
+
+def test_recall_at_k():
+    """Recall is averaged over queries and ignores order within the cutoff."""
+    truth = [["a", "b"], ["c", "d"]]
+    retrieved = [["b", "a"], ["c", "x"]]
+    assert recall_at_k(retrieved, truth, k=2) == pytest.approx(0.75)
+    assert recall_at_k(retrieved, truth, k=1) == pytest.approx(0.5)
+
+def test_recall_at_k_length_mismatch():
+    with pytest.raises(ValueError):
+        recall_at_k([[1]], [[1], [2]], k=1)
@@ -0,0 +1,123 @@
+import os
+import json
+import shutil
+import tempfile
+
+import pytest
+
+from src.index_bundle import IndexBundle, write_bundle_from_dir
+from src.shared_segments import (
+    GENERATION_FILENAME, JSONSegment, bundle_identity, read_generation, write_next_generation
+)
+
+DOCSTORE = {
+    "docstore/data": {f"node-{i}": {"__data__": {"text": f"text {i} " * (i % 5), "id_": f"node-{i}"}} for i in range(300)},
+    "docstore/ref_doc_info": {"doc-1": {"node_ids": ["node-1", "node-2"], "metadata": {"year": 2020}}},
+    "docstore/metadata": {},
+}
+
+@pytest.fixture
+def storage_dir():
+    temp_dir = tempfile.mkdtemp(prefix="test_segments_")
+    yield temp_dir
+    shutil.rmtree(temp_dir)
+
+def test_lookups_match_the_source_dict():
+    segment = JSONSegment.build(DOCSTORE)
+    assert segment.collections == list(DOCSTORE)
+    assert len(segment) == 301
+    for key in ("node-0", "node-17", "node-299"):
+        assert segment.get("docstore/data", key) == DOCSTORE["docstore/data"][key]
+    assert segment.get("docstore/data", "node-300") is None
+    assert segment.get("docstore/data", "a-key-longer-than-any-stored-key") is None
+    assert segment.get("docstore/missing", "node-1") is None
+    assert segment.get("docstore/metadata", "node-1") is None
+    assert ("docstore/ref_doc_info", "doc-1") in segment
+    assert segment.keys("docstore/data") == list(DOCSTORE["docstore/data"])
+    assert dict(segment.items("docstore/ref_doc_info")) == DOCSTORE["docstore/ref_doc_info"]
+
+def test_save_load_from_directory_and_bundle(storage_dir):
+    JSONSegment.build(DOCSTORE).save(storage_dir, generation=3)
+    assert JSONSegment.exists(storage_dir)
+    loaded = JSONSegment.load(storage_dir)
+    assert loaded.generation == 3
+    assert loaded.get("docstore/data", "node-42") == DOCSTORE["docstore/data"]["node-42"]
+
+    bundle_path = os.path.join(storage_dir, "index.bundle")
+    write_bundle_from_dir(storage_dir, bundle_path)
+    with IndexBundle(bundle_path) as bundle:
+        from_bundle = JSONSegment.from_bundle(bundle)
+    assert from_bundle.generation == 3
+    assert dict(from_bundle.items("docstore/data")) == DOCSTORE["docstore/data"]
+
+@pytest.mark.skipif(not os.path.exists("/proc/self/smaps"), reason="needs /proc/self/smaps")
+def test_reads_stay_in_shared_file_pages(storage_dir):
+    JSONSegment.build(DOCSTORE).save(storage_dir)
+    bundle_path = os.path.join(storage_dir, "index.bundle")
+    write_bundle_from_dir(storage_dir, bundle_path)
+    with IndexBundle(bundle_path) as bundle:
+        segment = JSONSegment.from_bundle(bundle)
+    assert sum(1 for _ in segment.items("docstore/data")) == 300
+    # Every page of the bundle mapping that was read is a clean page-cache page, shared by any
+    # process mapping the same file; none were copied into this process
+    with open("/proc/self/smaps") as f:
+        blocks = f.read().split("\n")
+    fields = {}
+    for i, line in enumerate(blocks):
+        if line.endswith(os.path.realpath(bundle_path)):
+            for entry in blocks[i + 1:i + 24]:
+                name, _, value = entry.partition(":")
+                if value.strip().endswith("kB"):
+                    fields[name] = fields.get(name, 0) + int(value.split()[0])
+    assert fields.get("Rss", 0) > 0
+    assert fields["Private_Dirty"] == 0 and fields.get("Anonymous", 0) == 0
+
+def test_generations_and_replaced_bundles(storage_dir):
+    assert read_generation(storage_dir) == 0
+    assert write_next_generation(storage_dir) == 1
+    assert write_next_generation(storage_dir) == 2
+    bundle_path = os.path.join(storage_dir, "index.bundle")
+    JSONSegment.build(DOCSTORE).save(storage_dir, generation=2)
+    write_bundle_from_dir(storage_dir, bundle_path)
+    old_identity = bundle_identity(bundle_path)
+    old = IndexBundle(bundle_path)
+    old_segment = JSONSegment.from_bundle(old)
+
+    # A rebuild replaces the bundle; the old mapping keeps serving the old generation
+    JSONSegment.build({"docstore/data": {"node-new": {"x": 1}}}).save(storage_dir, generation=write_next_generation(storage_dir))
+    write_bundle_from_dir(storage_dir, bundle_path)
+    assert bundle_identity(bundle_path) != old_identity
+    assert old_segment.get("docstore/data", "node-7") == DOCSTORE["docstore/data"]["node-7"]
+    assert old.read_json(GENERATION_FILENAME) == {"generation": 2}
+    old.close()
+    with IndexBundle(bundle_path) as bundle:
+        assert JSONSegment.from_bundle(bundle).generation == 3
+        assert bundle.read_json(GENERATION_FILENAME) == {"generation": 3}
+    assert bundle_identity(os.path.join(storage_dir, "missing.bundle")) is None
+
+def test_segment_docstore_reads_segment_and_keeps_changes_in_overlay(storage_dir):
+    pytest.importorskip("llama_index.core")
+    from llama_index.core.schema import TextNode
+    from llama_index.core.storage.docstore import SimpleDocumentStore
+    from src.segment_docstore import segment_docstore
+
+    original = SimpleDocumentStore()
+    original.add_documents([TextNode(text=f"chunk {i}", id_=f"n{i}") for i in range(5)])
+    path = os.path.join(storage_dir, "docstore.json")
+    docstore = segment_docstore(JSONSegment.build(original.to_dict()))
+    assert docstore.get_node("n3").get_content() == "chunk 3"
+
+    docstore.add_documents([TextNode(text="new", id_="n9")])
+    docstore.delete_document("n1")
+    assert docstore.get_node("n9").get_content() == "new"
+    assert not docstore.document_exists("n1")
+    assert sorted(docstore.docs) == ["n0", "n2", "n3", "n4", "n9"]
+
+    docstore.persist(path)
+    reloaded = SimpleDocumentStore.from_persist_path(path)
+    assert sorted(reloaded.docs) == ["n0", "n2", "n3", "n4", "n9"]
+    # Streamed in SimpleKVStore's order and format: the same file the plain docstore writes
+    original.add_documents([TextNode(text="new", id_="n9")])
+    original.delete_document("n1")
+    with open(path, "r", encoding="utf-8") as f:
+        assert f.read() == json.dumps(original.to_dict())
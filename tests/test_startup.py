@@ -0,0 +1,120 @@
+import time
+import threading
+from unittest.mock import patch, MagicMock
+
+import pytest
+import torch
+from llama_index.core import VectorStoreIndex, Settings
+
+from src import core_components
+from src.config_loader import IndexBuilderConfig, QueryEngineBuilderConfig
+from src.startup import StartupOrchestrator
+
+@pytest.fixture
+def configs(tmp_path):
+    index_cfg = IndexBuilderConfig(
+        storage_dir=str(tmp_path),
+        embedding_model_name="sentence-transformers/test-model",
+        corpus_path="dummy/corpus.json",
+        corpus_id_field="id",
+        corpus_text_fields=["text"],
+        corpus_metadata_fields=["meta"],
+        chunk_size=100,
+        chunk_overlap=10
+    )
+    query_cfg = QueryEngineBuilderConfig(
+        embedding_model_name="sentence-transformers/test-model",
+        chunk_size=100,
+        chunk_overlap=10,
+        similarity_top_k=2
+    )
+    return index_cfg, query_cfg
+
+@pytest.fixture(autouse=True)
+def reset_embed_model_cache():
+    core_components._embed_model_cache.clear()
+    yield
+    core_components._embed_model_cache.clear()
+    Settings.embed_model = None
+
+@patch('src.core_components.HuggingFaceEmbedding')
+def test_embedding_model_initialized_once(MockEmbedding):
+    """Repeated and concurrent initialization of the same model loads it only once."""
+    MockEmbedding.side_effect = lambda **kwargs: (time.sleep(0.05), MagicMock())[1]
+    threads = [threading.Thread(target=core_components.initialize_hf_embedding_model, args=("m",)) for _ in range(4)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    core_components.initialize_hf_embedding_model("m")
+    assert MockEmbedding.call_count == 1
+
+@patch('src.core_components.HuggingFaceEmbedding')
+def test_int8_precision_quantizes_linear_layers(MockEmbedding):
+    """precision="int8" replaces the encoder's linear layers with dynamically quantized ones."""
+    embed_model = MagicMock()
+    embed_model._model = torch.nn.Sequential(torch.nn.Linear(8, 16), torch.nn.ReLU(), torch.nn.Linear(16, 4))
+    MockEmbedding.return_value = embed_model
+    quantized = core_components.initialize_hf_embedding_model("m", precision="int8")
+    layers = [layer for layer in quantized._model if not isinstance(layer, torch.nn.ReLU)]
+    assert len(layers) == 2
+    assert all(isinstance(layer, torch.ao.nn.quantized.dynamic.Linear) for layer in layers)
+    assert all(layer.weight().dtype == torch.qint8 for layer in layers)
+    assert MockEmbedding.call_args.kwargs["device"] == "cpu"
+    assert quantized._model(torch.ones(2, 8)).shape == (2, 4)
+
+@patch('src.core_components.HuggingFaceEmbedding')
+def test_unknown_precision_raises(MockEmbedding):
+    with pytest.raises(ValueError, match="Unsupported embedding precision 'fp16'"):
+        core_components.initialize_hf_embedding_model("m", precision="fp16")
+    MockEmbedding.assert_not_called()
+
+@patch('src.startup.QueryEngineBuilder')
+@patch('src.index_builder.load_index_from_storage')
+@patch('src.index_builder.initialize_hf_embedding_model')
+@patch('src.startup.initialize_hf_embedding_model')
+def test_model_and_storage_load_concurrently(mock_startup_init, mock_builder_init, mock_load_idx, MockQueryEngineBuilder, configs):
+    """Model initialization and storage loading overlap instead of running back to back."""
+    index_cfg, query_cfg = configs
+    running = []
+    overlap = threading.Event()
+
+    def slow(name, result):
+        def run(*args, **kwargs):
+            running.append(name)
+            if len(running) == 2:
+                overlap.set()
+            overlap.wait(timeout=2)
+            return result
+        return run
+
+    mock_startup_init.side_effect = slow("model", MagicMock())
+    mock_load_idx.return_value = MagicMock(spec=VectorStoreIndex)
+    storage_context = MagicMock()
+
+    orchestrator = StartupOrchestrator(index_cfg, query_cfg, warmup_query=None)
+    with patch.object(orchestrator.index_builder, 'index_exists', return_value=True), \
+         patch.object(orchestrator.index_builder, 'load_storage_context', side_effect=slow("storage", storage_context)):
+        query_engine, report = orchestrator.start()
+
+    assert overlap.is_set()
+    mock_load_idx.assert_called_once_with(storage_context)
+    assert query_engine is MockQueryEngineBuilder.return_value.build.return_value
+    assert not report.built_index
+    assert report.time_to_ready_s >= report.index_ready_s > 0
+
+@patch('src.startup.QueryEngineBuilder')
+def test_builds_when_no_index(MockQueryEngineBuilder, configs):
+    """Without a persisted index the orchestrator falls back to a build and still warms up."""
+    index_cfg, query_cfg = configs
+    orchestrator = StartupOrchestrator(index_cfg, query_cfg)
+    built_index = MagicMock(spec=VectorStoreIndex)
+    with patch.object(orchestrator.index_builder, 'index_exists', return_value=False), \
+         patch.object(orchestrator.index_builder, 'build', return_value=built_index) as mock_build:
+        _, report = orchestrator.start()
+        orchestrator.wait_for_warmup(timeout=2)
+
+    mock_build.assert_called_once()
+    assert report.built_index
+    built_index.as_retriever.return_value.retrieve.assert_called_once_with("warmup")
+    assert report.warmup_s is not None
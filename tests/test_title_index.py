@@ -0,0 +1,130 @@
+import os
+import shutil
+import tempfile
+
+import numpy as np
+import pytest
+
+from src.index_bundle import IndexBundle, write_bundle_from_dir
+from src import kernels
+from src.title_index import TitleIndex, normalize_title
+
+TITLES = [
+    "Attention Is All You Need",
+    "BERT: Pre-training of Deep Bidirectional Transformers for Language Understanding",
+    "Neural Machine Translation by Jointly Learning to Align and Translate",
+    "Deep Contextualized Word Representations",
+    "Attention-Based Models for Speech Recognition",
+    "Émotion Détection in Tweets",
+]
+DOC_IDS = [f"P{i}" for i in range(len(TITLES))]
+
+@pytest.fixture
+def index():
+    return TitleIndex.build(DOC_IDS, TITLES)
+
+def test_normalize_title_folds_case_accents_and_punctuation():
+    assert normalize_title("BERT: Pre-training  of Deep") == "bert pre training of deep"
+    assert normalize_title("Émotion Détection") == "emotion detection"
+
+def test_prefix_matches_title_start_before_inner_words(index):
+    assert index.search("attention") == ["P0", "P4"]
+    assert index.search("Attention is a") == ["P0"]
+    # Prefix of a word inside the title
+    assert index.search("bidirect") == ["P1"]
+    assert index.search("deep") == ["P3", "P1"]
+    assert index.search("emotion det") == ["P5"]
+    assert index.search("") == []
+    assert index.search("attention", limit=1) == ["P0"]
+
+def test_fuzzy_matches_within_edit_distance(index):
+    # One substitution, one transposition-like pair of edits, one deletion
+    assert index.search("attentoin is all") == ["P0"]
+    assert index.search("neural machine translaton") == ["P2"]
+    assert index.search("contextualised word") == ["P3"]
+    assert index.search("contextualised word", max_edits=0) == []
+    # Too far from any title
+    assert index.search("quantum chromodynamics") == []
+
+@pytest.mark.parametrize("native", [True, False])
+def test_fuzzy_matches_short_queries(native, index, monkeypatch):
+    if native and not kernels.native_kernels_available():
+        pytest.skip("native kernels not built")
+    if not native:
+        monkeypatch.setattr(kernels, "_native", None)
+    # Lengths 4, 5 and 8 leave the 3-gram count filter nothing to require
+    assert index.search("deap") == ["P3", "P1"]
+    assert index.search("neurl") == ["P2"]
+    assert index.search("atention") == ["P0", "P4"]
+    assert index.search("atention", max_edits=1) == ["P0", "P4"]
+    assert index.search("machne") == ["P2"]
+    # Two edits away at length 5, and too short for any typo at length 3
+    assert index.search("nerl") == []
+    assert index.search("dep") == []
+
+@pytest.mark.parametrize("native", [True, False])
+def test_prefix_edit_distances_match_reference(native, monkeypatch):
+    if native and not kernels.native_kernels_available():
+        pytest.skip("native kernels not built")
+    if not native:
+        monkeypatch.setattr(kernels, "_native", None)
+
+    def reference(query, text, slack):
+        previous = [max(j - slack, 0) for j in range(len(text) + 1)]
+        for i, a in enumerate(query, start=1):
+            current = [i]
+            for j, b in enumerate(text, start=1):
+                current.append(min(previous[j] + 1, current[j - 1] + 1, previous[j - 1] + (a != b)))
+            previous = current
+        return min(previous)
+
+    rng = np.random.default_rng(0)
+    texts = [bytes(rng.choice(list(b"abc"), rng.integers(0, 10))) for _ in range(50)]
+    blob = np.frombuffer(b"".join(texts), dtype=np.uint8)
+    lengths = np.array([len(t) for t in texts])
+    starts = np.concatenate([[0], np.cumsum(lengths)[:-1]])
+    for slack in (0, 2):
+        expected = [reference(b"abcab", t, slack) for t in texts]
+        assert kernels.prefix_edit_distances(b"abcab", blob, starts, lengths, slack).tolist() == expected
+
+def test_updated_drops_removed_documents_and_adds_titles(index):
+    updated = index.updated({"P0", "P1", "P2", "P3", "P4"}, {"P6": "Attention Please", "P3": "Deep Residual Learning"})
+    assert len(updated) == 6
+    assert sorted(updated.search("attention")) == ["P0", "P4", "P6"]
+    assert updated.search("emotion") == []
+    assert updated.search("deep") == ["P3", "P1"] and updated.search("residual") == ["P3"]
+    assert index.updated(None, {}).search("emotion") == ["P5"]
+
+def test_round_trip_through_directory_and_bundle(index):
+    temp_dir = tempfile.mkdtemp(prefix="test_title_index_")
+    try:
+        assert not TitleIndex.exists(temp_dir)
+        index.save(temp_dir)
+        assert TitleIndex.exists(temp_dir)
+        loaded = TitleIndex.load(temp_dir)
+        assert loaded.search("deep con") == ["P3"]
+        assert loaded.title(5) == "emotion detection in tweets"
+
+        write_bundle_from_dir(temp_dir, os.path.join(temp_dir, "index.bundle"))
+        bundle = IndexBundle(os.path.join(temp_dir, "index.bundle"))
+        assert TitleIndex.from_bundle(bundle).search("attentoin is all") == ["P0"]
+        bundle.close()
+    finally:
+        shutil.rmtree(temp_dir)
+
+def test_lookups_on_large_title_set():
+    rng = np.random.default_rng(1)
+    letters = np.array(list("abcdefghijklmnopqrstuvwxyz"))
+    words = np.array(["".join(letters[rng.integers(0, 26, rng.integers(3, 10))]) for _ in range(3000)])
+    titles = [" ".join(words[rng.integers(0, len(words), rng.integers(4, 12))]) for _ in range(20000)]
+    index = TitleIndex.build([str(i) for i in range(len(titles))], titles)
+    for i in rng.choice(len(titles), 50, replace=False).tolist():
+        query = titles[i][:12]
+        typo = query[:5] + ("x" if query[5] != "x" else "y") + query[6:]
+        assert str(i) in index.search(query)
+        # One substitution, found through the 3-gram filter and ranked ahead of unrelated titles
+        assert str(i) in index.search(typo)
+        word = titles[i].split()[0]
+        if len(word) >= 5:
+            # A first word with a dropped letter, including lengths the 3-gram filter cannot serve
+            assert str(i) in index.search(word[:2] + word[3:], limit=len(titles))
@@ -0,0 +1,76 @@
+import os
+
+import numpy as np
+import pytest
+
+from src.token_cache import TOKEN_CACHE_HEADER, TokenCache, content_key, token_windows, update_token_cache
+
+class WordTokenizer:
+    """Stand-in tokenizer: one token per whitespace-separated word, ids from a growing vocabulary."""
+    def __init__(self, first_id: int = 100):
+        self.vocab = {}
+        self.first_id = first_id
+        self.calls = []
+
+    def __call__(self, texts):
+        self.calls.append(list(texts))
+        results = []
+        for text in texts:
+            ids, starts, position = [], [], 0
+            for word in text.split():
+                position = text.index(word, position)
+                ids.append(self.vocab.setdefault(word, self.first_id + len(self.vocab)))
+                starts.append(position)
+                position += len(word)
+            results.append((np.array(ids, dtype=np.uint32), np.array(starts, dtype=np.uint32)))
+        return results
+
+TEXTS = ["Neural machine translation with attention", "A survey of parsing", "", "title: A survey of parsing"]
+
+def test_token_windows_cover_the_text_with_overlap():
+    assert token_windows(0, 4, 1) == [(0, 0)]
+    assert token_windows(3, 4, 1) == [(0, 3)]
+    assert token_windows(10, 4, 1) == [(0, 4), (3, 7), (6, 10)]
+    assert token_windows(8, 4, 0) == [(0, 4), (4, 8)]
+    with pytest.raises(ValueError, match="overlap"):
+        token_windows(10, 4, 4)
+
+def test_rebuild_only_tokenizes_changed_texts(tmp_path):
+    directory = str(tmp_path / "token_cache")
+    tokenizer = WordTokenizer()
+    cache, tokenized = update_token_cache(directory, "model-a", TEXTS + TEXTS[:1], tokenizer, batch_size=2)
+    assert tokenized == 4 and len(cache) == 4
+    ids, starts = cache.tokens(content_key(TEXTS[0]))
+    assert ids.dtype == np.uint16 and isinstance(ids, np.memmap)
+    assert [TEXTS[0][start:].split()[0] for start in starts] == TEXTS[0].split()
+    assert np.array_equal(ids, tokenizer([TEXTS[0]])[0][0])
+    assert len(cache.tokens(content_key(""))[0]) == 0
+    assert cache.tokens(content_key("not cached")) is None
+
+    # Unchanged corpus: nothing is tokenized and the artifact is not rewritten
+    mtime = os.stat(os.path.join(directory, "ids.npy")).st_mtime_ns
+    tokenizer.calls.clear()
+    cache, tokenized = update_token_cache(directory, "model-a", TEXTS, tokenizer)
+    assert tokenized == 0 and tokenizer.calls == []
+    assert os.stat(os.path.join(directory, "ids.npy")).st_mtime_ns == mtime
+
+    # One edited text: only it is tokenized, and the stale entry is dropped
+    edited = TEXTS[:1] + ["A survey of dependency parsing"] + TEXTS[2:]
+    cache, tokenized = update_token_cache(directory, "model-a", edited, tokenizer)
+    assert tokenized == 1 and tokenizer.calls == [["A survey of dependency parsing"]]
+    assert len(cache) == 4 and cache.tokens(content_key(TEXTS[1])) is None
+    assert len(cache.tokens(content_key(edited[1]))[0]) == 5
+    assert np.array_equal(cache.tokens(content_key(TEXTS[0]))[0], tokenizer([TEXTS[0]])[0][0])
+
+    # Ids from another tokenizer are not reused
+    assert TokenCache.load(directory, "model-b") is None
+    cache, tokenized = update_token_cache(directory, "model-b", edited, tokenizer)
+    assert tokenized == 4
+    assert not os.path.exists(directory + ".tmp")
+    assert os.path.exists(os.path.join(directory, TOKEN_CACHE_HEADER))
+
+def test_large_vocabularies_use_32_bit_ids(tmp_path):
+    directory = str(tmp_path / "token_cache")
+    cache, _ = update_token_cache(directory, "model-a", TEXTS, WordTokenizer(first_id=70000))
+    ids, _ = cache.tokens(content_key(TEXTS[1]))
+    assert ids.dtype == np.uint32 and ids.tolist() == [70005, 70006, 70007, 70008]
@@ -0,0 +1,154 @@
+import os
+import shutil
+import tempfile
+import threading
+
+import numpy as np
+import pytest
+
+from src.wal import (
+    OP_DELETE, OP_INSERT, WriteAheadLog, decode_delete, decode_insert, encode_delete, encode_insert
+)
+
+@pytest.fixture
+def wal_path():
+    temp_dir = tempfile.mkdtemp(prefix="test_wal_")
+    yield os.path.join(temp_dir, "wal", "index.wal")
+    shutil.rmtree(temp_dir)
+
+def test_payload_round_trip():
+    embedding = np.arange(8, dtype=np.float32)
+    node, decoded = decode_insert(encode_insert({"id_": "n1", "text": "ü"}, embedding))
+    assert node == {"id_": "n1", "text": "ü"}
+    np.testing.assert_array_equal(decoded, embedding)
+    assert decode_delete(encode_delete("doc-1")) == "doc-1"
+
+def test_records_survive_reopen(wal_path):
+    wal = WriteAheadLog(wal_path, sync="fsync")
+    first = wal.append(OP_INSERT, b"a")
+    wal.append(OP_DELETE, b"b")
+    wal.commit()
+    wal.close()
+
+    reopened = WriteAheadLog(wal_path)
+    assert [(lsn, op, payload) for lsn, op, payload in reopened.records()] == [(first, OP_INSERT, b"a"), (first + 1, OP_DELETE, b"b")]
+    assert list(reopened.records(after_lsn=first)) == [(first + 1, OP_DELETE, b"b")]
+    assert reopened.append(OP_INSERT, b"c") == first + 2
+    reopened.close()
+
+def test_uncommitted_records_are_not_on_disk(wal_path):
+    wal = WriteAheadLog(wal_path)
+    wal.append(OP_INSERT, b"pending")
+    assert list(wal.records()) == []
+    wal.commit()
+    assert len(list(wal.records())) == 1
+    wal.close()
+
+def test_torn_tail_is_discarded(wal_path):
+    wal = WriteAheadLog(wal_path, sync="off")
+    for i in range(3):
+        wal.append(OP_INSERT, bytes([i]) * 100)
+    wal.close()
+    size = os.path.getsize(wal_path)
+    with open(wal_path, "r+b") as f:
+        f.truncate(size - 10)
+
+    reopened = WriteAheadLog(wal_path)
+    assert [payload[0] for _, _, payload in reopened.records()] == [0, 1]
+    assert reopened.append(OP_INSERT, b"next") == 3
+    reopened.commit()
+    assert [lsn for lsn, _, _ in reopened.records()] == [1, 2, 3]
+    reopened.close()
+
+def test_corrupt_record_ends_the_log(wal_path):
+    wal = WriteAheadLog(wal_path, sync="off")
+    for i in range(3):
+        wal.append(OP_INSERT, bytes([i]) * 100)
+    wal.close()
+    with open(wal_path, "r+b") as f:
+        f.seek(os.path.getsize(wal_path) - 50)
+        f.write(b"\xff")
+    assert len(list(WriteAheadLog(wal_path).records())) == 2
+
+def test_reset_keeps_lsns_increasing(wal_path):
+    wal = WriteAheadLog(wal_path)
+    for _ in range(5):
+        wal.append(OP_INSERT, b"x")
+    wal.reset()
+    assert list(wal.records()) == [] and wal.records_since_checkpoint == 0
+    wal.close()
+
+    reopened = WriteAheadLog(wal_path)
+    assert reopened.last_lsn == 5
+    assert reopened.append(OP_INSERT, b"y") == 6
+    reopened.close()
+
+def test_concurrent_writers_share_fsyncs(wal_path):
+    wal = WriteAheadLog(wal_path, sync="group", group_commit_ms=5)
+    writers, per_writer = 8, 50
+
+    def write(part):
+        for i in range(per_writer):
+            wal.commit(wal.append(OP_INSERT, f"{part}:{i}".encode()))
+
+    threads = [threading.Thread(target=write, args=(part,)) for part in range(writers)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    records = list(wal.records())
+    assert [lsn for lsn, _, _ in records] == list(range(1, writers * per_writer + 1))
+    assert wal.fsyncs < writers * per_writer
+    wal.close()
+
+class _FailingFile:
+    """Writes the first `limit` bytes of a write to the real file, then fails like a full disk."""
+    def __init__(self, f, limit: int):
+        self._f, self._limit = f, limit
+
+    def write(self, data):
+        self._f.write(data[:self._limit])
+        self._f.flush()
+        raise OSError(28, "No space left on device")
+
+    def __getattr__(self, name):
+        return getattr(self._f, name)
+
+def test_failed_write_is_retried_not_reported_durable(wal_path):
+    wal = WriteAheadLog(wal_path, sync="fsync")
+    wal.commit(wal.append(OP_INSERT, b"before"))
+    first = wal.append(OP_INSERT, b"a" * 100)
+    second = wal.append(OP_DELETE, b"b")
+    wal._file = _FailingFile(wal._file, limit=30)
+    with pytest.raises(OSError):
+        wal.commit(first)
+    # The failed batch held `second` too: committing it writes both again instead of returning
+    assert [payload for _, _, payload in wal.records()] == [b"before"]
+    wal.commit(second)
+    assert [(lsn, payload) for lsn, _, payload in wal.records()] == [(1, b"before"), (first, b"a" * 100), (second, b"b")]
+    wal.close()
+    assert [lsn for lsn, _, _ in WriteAheadLog(wal_path).records()] == [1, first, second]
+
+def test_failed_fsync_is_retried(wal_path, monkeypatch):
+    wal = WriteAheadLog(wal_path, sync="fsync")
+    lsn = wal.append(OP_INSERT, b"x")
+    real_fsync = os.fsync
+    failures = [OSError(5, "Input/output error")]
+
+    def fsync(fd):
+        if failures:
+            raise failures.pop()
+        real_fsync(fd)
+
+    monkeypatch.setattr("src.wal.os.fsync", fsync)
+    with pytest.raises(OSError):
+        wal.commit(lsn)
+    assert wal.fsyncs == 0
+    wal.commit(lsn)
+    # Written once: the partial copy from the failed attempt was cut off
+    assert [(l, payload) for l, _, payload in wal.records()] == [(lsn, b"x")]
+    wal.close()
+
+def test_unknown_sync_mode(wal_path):
+    with pytest.raises(ValueError):
+        WriteAheadLog(wal_path, sync="sometimes")